@@ -1,6 +1,7 @@
 import os
 import sys
 import argparse
+from contextlib import contextmanager
 
 
 def _load_dotenv_if_present() -> None:
@@ -73,6 +74,35 @@ def _get_project_root() -> str:
 	return parent
 
 
+def _print_llm_metrics(m: dict | None) -> None:
+	"""One-line summary of LLM request metrics (see qt_test_ai.http_client)."""
+	if not m or not m.get("requests"):
+		return
+	print(f"   LLM 请求: {m['requests']} 次 (缓存命中 {m.get('cache_hits', 0)}, 错误 {m.get('errors', 0)})"
+		f"，延迟 p50 {m.get('latency_p50_s')}s / p95 {m.get('latency_p95_s')}s"
+		f"，tokens {m.get('prompt_tokens', 0)} + {m.get('completion_tokens', 0)}"
+		f" [{m.get('http_backend', '')}]")
+
+
+@contextmanager
+def _traced(label: str):
+	"""Trace the command as one stage; afterwards export to reports/traces and print its timing (see qt_test_ai.tracing)."""
+	from datetime import datetime
+	from pathlib import Path
+	from qt_test_ai import tracing
+	trace_id = tracing.begin()
+	try:
+		with tracing.span(label, tracing.STAGE):
+			yield
+	finally:
+		t = tracing.finish(trace_id, Path(__file__).resolve().parent / "reports" / "traces", label=f"{label}_{datetime.now():%Y%m%d_%H%M%S}")
+		for name, st in (t.get("stages") or {}).items():
+			cats = ", ".join(f"{c} {v['total_s']}s×{v['count']}" for c, v in sorted(st["by_category"].items(), key=lambda kv: -kv[1]["total_s"]))
+			print(f"   ⏱ {name}: {st['wall_s']}s" + (f" ({cats})" if cats else ""))
+		if (t.get("export") or {}).get("chrome"):
+			print(f"   trace: {t['export']['chrome']}")
+
+
 def cmd_generate_tests(args) -> int:
 	"""LLM 驱动的测试生成命令"""
 	from pathlib import Path
@@ -83,7 +113,8 @@ def cmd_generate_tests(args) -> int:
 	if args.task and args.llm_service:
 		# 直接运行特定任务
 		generator = LLMTestGenerator(project_root)
-		result = generator.run_full_cycle(args.task, args.llm_service)
+		with _traced("generate_tests"):
+			result = generator.run_full_cycle(args.task, args.llm_service)
 		
 		if result["status"] == "success":
 			print(f"\n✅ 任务成功: {args.task}")
@@ -117,7 +148,8 @@ def cmd_full_cycle(args) -> int:
 	
 	# 使用默认任务
 	task = args.task or "phase1_diagram_item"
-	result = generator.run_full_cycle(task, args.llm_service or "auto")
+	with _traced("full_cycle"):
+		result = generator.run_full_cycle(task, args.llm_service or "auto")
 	
 	if result["status"] == "success":
 		print(f"\n✅ 周期完成！")
@@ -125,6 +157,7 @@ def cmd_full_cycle(args) -> int:
 		print(f"   生成测试数: {result.get('generation', {}).get('tests_generated', 0)}")
 		print(f"   通过: {result.get('compilation', {}).get('passed', 0)}")
 		print(f"   失败: {result.get('compilation', {}).get('failed', 0)}")
+		_print_llm_metrics(result.get("llm_metrics"))
 		return 0
 	else:
 		print(f"\n❌ 周期失败")
@@ -133,6 +166,335 @@ def cmd_full_cycle(args) -> int:
 		return 1
 
 
+def cmd_generate_batch(args) -> int:
+	"""并发生成多个任务的测试，生成与编译重叠"""
+	from pathlib import Path
+	from qt_test_ai.llm_test_generator import LLMTestGenerator
+	
+	project_root = Path(_get_project_root())
+	generator = LLMTestGenerator(project_root)
+	
+	tasks = [t.strip() for t in (args.tasks or "").split(",") if t.strip()]
+	if not tasks:
+		tasks = list(generator.load_prompts().keys())
+	if not tasks:
+		print("❌ 没有可用任务")
+		return 1
+	
+	print(f"\n🚀 并发生成 {len(tasks)} 个任务: {', '.join(tasks)}")
+	with _traced("generate_batch"):
+		result = generator.generate_tests_batch(
+			tasks,
+			args.llm_service or "auto",
+			concurrency=args.concurrency,
+			compile_tests=not args.no_compile,
+		)
+	
+	for entry in result["tasks"]:
+		gen = entry.get("generation") or {}
+		comp = entry.get("compilation") or {}
+		status = "✅" if gen.get("success") and (args.no_compile or comp.get("success")) else "❌"
+		print(f"  {status} {entry['task']}: 生成 {gen.get('tests_generated', 0)} 个测试"
+			+ (f"，通过 {comp.get('passed', 0)} / 失败 {comp.get('failed', 0)}" if comp else ""))
+	print(f"   总耗时: {result['wall_s']}s (并发 {result['concurrency']})")
+	_print_llm_metrics(result.get("llm_metrics"))
+	return 0 if result["status"] == "success" else 1
+
+
+def cmd_coverage_map(args) -> int:
+	"""查看逐测试覆盖率映射：哪些测试覆盖了某个文件 / 行，各自贡献多少独有行"""
+	from pathlib import Path
+	from qt_test_ai import per_test_coverage
+	
+	project_root = Path(_get_project_root())
+	ptc = per_test_coverage.load_map(project_root / "tests" / "generated")
+	if ptc is None:
+		print("❌ 没有逐测试覆盖率映射；设置 QT_TEST_AI_PER_TEST_COVERAGE=1 后重新运行测试")
+		return 1
+	
+	print(f"\n🧩 逐测试覆盖率映射 ({ptc.created_at})，共 {len(ptc.test_names())} 个测试")
+	if args.file and args.line:
+		tests = ptc.tests_covering(args.file, args.line)
+		print(f"   覆盖 {args.file}:{args.line} 的测试: {', '.join(tests) if tests else '(无)'}")
+		return 0
+	rows = ptc.contribution(args.file)
+	if args.file:
+		rows = [r for r in rows if r["lines"]]
+		print(f"   文件: {args.file}")
+	for r in rows[: args.top]:
+		print(f"  {r['test']:<40} 覆盖 {r['lines']:>5} 行，独有 {r['unique']:>5} 行")
+	redundant = [r["test"] for r in rows if r["lines"] and not r["unique"]]
+	if redundant:
+		print(f"   没有独有贡献的测试: {', '.join(redundant)}")
+	return 0
+
+
+def cmd_select_tests(args) -> int:
+	"""预览增量测试选择：相对逐测试覆盖率映射，哪些测试函数受改动影响"""
+	from pathlib import Path
+	from qt_test_ai import test_selection
+	
+	project_root = Path(_get_project_root())
+	sel = test_selection.select_tests(project_root, project_root / "tests" / "generated", base=args.base)
+	print(f"\n🎯 测试选择: {sel.describe()}")
+	for t in sel.tests:
+		print(f"  {t:<40} {'; '.join(sel.reasons.get(t) or [])}")
+	if sel.skipped:
+		print(f"   跳过（沿用缓存结果）: {', '.join(sel.skipped)}")
+	return 0
+
+
+def cmd_bench(args) -> int:
+	"""生成并运行 DiagramScene 热点路径的 QBENCHMARK 基准，按场景规模比较、检查超线性增长"""
+	from pathlib import Path
+	from qt_test_ai import benchmark_suite
+	
+	project_root = Path(_get_project_root())
+	tests_dir = project_root / "tests" / "generated"
+	if args.write_only:
+		pro = benchmark_suite.write_suite(project_root, tests_dir)
+		print(f"✅ 基准工程已生成: {pro}")
+		return 0
+	funcs = [f.strip() for f in (args.functions or "").split(",") if f.strip()]
+	print(f"\n📈 基准测试（规模 {', '.join(map(str, benchmark_suite.sizes()))}）...")
+	findings, meta = benchmark_suite.run(project_root, tests_dir, functions=funcs or None)
+	if meta.get("results"):
+		# 同时写入运行数据库，供历史面板 / 趋势查询使用
+		try:
+			from qt_test_ai import db as dbmod
+			conn = dbmod.open_db(dbmod.DEFAULT_DB_PATH)
+			dbmod.save_benchmarks(conn, str(project_root), meta.get("backend"), meta["results"])
+			conn.close()
+		except Exception as e:
+			print(f"⚠️ 基准结果未写入数据库: {e}")
+	for fn, rows in sorted((meta.get("results") or {}).items()):
+		cells = ", ".join(f"n={tag}: {r['value']:.4g}" for tag, r in rows.items())
+		print(f"  {fn:<20} {cells}")
+	for f in findings:
+		mark = {"error": "❌", "warning": "⚠️"}.get(f.severity, "  ")
+		print(f"{mark} {f.title}")
+		if f.details and f.severity != "info":
+			print("     " + f.details.replace("\n", "\n     "))
+	return 1 if any(f.severity == "error" for f in findings) else 0
+
+
+def cmd_ui_load(args) -> int:
+	"""离屏回放 Diagramscene 的输入脚本，记录每个事件的处理延迟与帧时间"""
+	import subprocess
+	from pathlib import Path
+	from qt_test_ai import ui_load
+	
+	project_root = Path(_get_project_root())
+	tests_dir = project_root / "tests" / "generated"
+	if args.record:
+		ok, m_build = ui_load.build(project_root, tests_dir)
+		exe = ui_load.executable(tests_dir) if ok else None
+		if exe is None:
+			print("❌ UI 负载驱动编译失败")
+			return 1
+		out = ui_load.scripts_dir(tests_dir) / f"{args.record}.json"
+		out.parent.mkdir(parents=True, exist_ok=True)
+		print(f"🎬 录制中：在弹出的窗口里操作，关闭窗口后保存到 {out}")
+		return subprocess.run([str(exe), "--record", str(out)], cwd=str(ui_load.load_dir(tests_dir))).returncode
+	if args.write_only:
+		pro = ui_load.write_driver(project_root, tests_dir)
+		scripts = ui_load.write_scripts(tests_dir)
+		print(f"✅ 驱动工程已生成: {pro}（脚本 {len(scripts)} 个）")
+		return 0
+	names = [s.strip() for s in (args.scripts or "").split(",") if s.strip()]
+	print(f"\n🖱️ UI 负载回放（{ui_load.items()} 个元素，{ui_load.arrows()} 条箭头，offscreen）...")
+	findings, meta = ui_load.run(project_root, tests_dir, scripts=names or None)
+	bench = meta.get("benchmarks") or {}
+	if bench.get("results"):
+		# 与基准结果同表，便于趋势查询
+		try:
+			from qt_test_ai import db as dbmod
+			conn = dbmod.open_db(dbmod.DEFAULT_DB_PATH)
+			dbmod.save_benchmarks(conn, str(project_root), bench["backend"], bench["results"])
+			conn.close()
+		except Exception as e:
+			print(f"⚠️ UI 负载结果未写入数据库: {e}")
+	for f in findings:
+		mark = {"error": "❌", "warning": "⚠️"}.get(f.severity, "  ")
+		print(f"{mark} {f.title}")
+		if f.details and (f.severity != "info" or args.verbose):
+			print("     " + f.details.replace("\n", "\n     "))
+	return 1 if any(f.severity == "error" for f in findings) else 0
+
+
+def cmd_fuzz(args) -> int:
+	"""进程内覆盖率引导模糊测试：场景加载 / 反序列化与查找替换入口，语料在多次运行间保留并最小化"""
+	from pathlib import Path
+	from qt_test_ai import fuzz_harness
+	
+	project_root = Path(_get_project_root())
+	tests_dir = project_root / "tests" / "generated"
+	found = fuzz_harness.discover(project_root)
+	names = fuzz_harness.targets(found)
+	if args.list:
+		for n in names:
+			print(f"  {n}  (语料 {fuzz_harness.corpus_dir(tests_dir, n)})")
+		return 0
+	if args.write_only:
+		pro = fuzz_harness.write_harness(project_root, tests_dir, found)
+		print(f"✅ 模糊测试工程已生成: {pro}（入口 {len(names)} 个，引擎 {fuzz_harness.engine()}）")
+		return 0
+	only = [t.strip() for t in (args.targets or "").split(",") if t.strip()]
+	secs = args.seconds or fuzz_harness.seconds()
+	print(f"\n🧬 模糊测试（引擎 {fuzz_harness.engine()}，每个入口 {secs}s）...")
+	findings, meta = fuzz_harness.run(project_root, tests_dir, only=only or None, seconds_per_target=secs)
+	bench = meta.get("benchmarks") or {}
+	if bench.get("results"):
+		# exec/s 与特征数进基准表，便于看趋势
+		try:
+			from qt_test_ai import db as dbmod
+			conn = dbmod.open_db(dbmod.DEFAULT_DB_PATH)
+			dbmod.save_benchmarks(conn, str(project_root), bench["backend"], bench["results"])
+			conn.close()
+		except Exception as e:
+			print(f"⚠️ 模糊测试结果未写入数据库: {e}")
+	for f in findings:
+		mark = {"error": "❌", "warning": "⚠️"}.get(f.severity, "  ")
+		print(f"{mark} {f.title}")
+		if f.details and (f.severity != "info" or args.verbose):
+			print("     " + f.details.replace("\n", "\n     "))
+	return 1 if any(f.severity == "error" for f in findings) else 0
+
+
+def cmd_profile(args) -> int:
+	"""采样剖析：在 perf / gprof 下运行 UI 负载驱动、基准测试（或被测程序），报告项目代码的热点函数"""
+	from pathlib import Path
+	from qt_test_ai import profiling
+	
+	project_root = Path(_get_project_root())
+	tests_dir = project_root / "tests" / "generated"
+	only = [t.strip() for t in (args.targets or "").split(",") if t.strip()]
+	exe = None
+	if "app" in (only or profiling.targets()):
+		from qt_test_ai.dynamic_checks import pick_exe
+		exe, _, _ = pick_exe(project_root, Path(args.exe) if args.exe else None)
+	prof, _ = profiling.profiler()
+	print(f"\n🔥 采样剖析（{prof}，工作负载 {', '.join(only or profiling.targets())}）...")
+	findings, meta = profiling.run(project_root, tests_dir, only=only or None, app_exe=exe)
+	for f in findings:
+		mark = {"error": "❌", "warning": "⚠️"}.get(f.severity, "  ")
+		loc = f"  [{f.file}:{f.line}]" if f.file else ""
+		print(f"{mark} {f.title}{loc}")
+		if f.details and (f.severity != "info" or args.verbose):
+			print("     " + f.details.replace("\n", "\n     "))
+	if meta.get("hotspots"):
+		print(f"   热点已保存: {meta['hotspots']}（生成测试时作为 LLM 提示上下文）")
+	return 1 if any(f.severity == "error" for f in findings) else 0
+
+
+def cmd_profile_startup(args) -> int:
+	"""启动性能剖析：测量到主窗口显示 / 可交互的时间，高频采样资源并与基线比较"""
+	from pathlib import Path
+	from qt_test_ai.dynamic_checks import pick_exe, run_smoke_test
+	
+	project_root = Path(_get_project_root())
+	exe, findings, _ = pick_exe(project_root, Path(args.exe) if args.exe else None)
+	if exe is None:
+		print("❌ 未找到被测程序 exe，请用 --exe 指定")
+		return 1
+	print(f"\n⏱️ 启动剖析: {exe}（{args.duration}s）")
+	f_smoke, meta = run_smoke_test(exe, workdir=project_root, timeout_sec=args.duration, profile=True, update_baseline=args.update_baseline)
+	for f in f_smoke:
+		if f.title in ("stdout", "stderr"):
+			continue
+		mark = {"error": "❌", "warning": "⚠️"}.get(f.severity, "  ")
+		print(f"{mark} {f.title}")
+		if f.details:
+			print("     " + f.details.replace("\n", "\n     "))
+	return 1 if any(f.severity == "error" for f in f_smoke) else 0
+
+
+def cmd_artifacts(args) -> int:
+	"""报告制品存储：按命名空间列出运行、与上一次比较，按保留策略回收"""
+	from qt_test_ai import artifact_store
+	
+	store = artifact_store.ArtifactStore()
+	if args.gc:
+		r = store.gc()
+		print(f"🧹 回收 {r['removed_runs']} 个运行清单、{r['removed_objects']} 个对象，释放 {r['freed_bytes'] / 1024:.1f} KB")
+	u = store.usage()
+	print(f"\n📦 制品存储 {store.root}")
+	print(f"   实际占用 {u['stored_bytes'] / 1024:.1f} KB，按运行逐份保存需 {u['logical_bytes'] / 1024:.1f} KB")
+	for ns, n in u["runs"].items():
+		if args.namespace and not ns.startswith(args.namespace):
+			continue
+		runs = store.runs(ns)
+		latest = store.load(ns, runs[-1]) if runs else None
+		print(f"  {ns:<45} {n:>4} 次运行" + (f"；最近 {artifact_store.describe(latest)}" if latest else ""))
+	return 0
+
+
+def cmd_dist(args) -> int:
+	"""分布式模式：协调端排队分发 构建 / 测试 / 覆盖率 作业，远程 agent 按 Qt 套件领取，结果合并进本地数据库"""
+	import time
+	from qt_test_ai import distributed
+	
+	projects = [p.strip() for p in (args.projects or "").split(",") if p.strip()]
+	kit = {k: v for k, v in (("qt", args.kit_qt), ("spec", args.kit_spec)) if v}
+	params = {k: v for k, v in (("task", args.task), ("llm_service", args.llm_service)) if v}
+	
+	if args.action == "serve":
+		try:
+			httpd, coord = distributed.serve(args.host, args.port)
+		except ValueError as e:
+			print(f"❌ {e}")
+			return 1
+		print(f"🛰️ 协调端监听 {args.host}:{httpd.server_address[1]}，状态目录 {coord.root}")
+		for name in projects:
+			job = coord.submit(name, args.stage, params, kit)
+			print(f"   已排队 {job['id']}: {name} / {args.stage}")
+		last = None
+		try:
+			while True:
+				time.sleep(2)
+				counts = coord.status()["counts"]
+				if counts != last:
+					print("   " + "，".join(f"{k} {v}" for k, v in sorted(counts.items())))
+					last = counts
+				if args.exit_when_done and coord.drained():
+					failed = counts.get("failed", 0)
+					print(f"{'❌' if failed else '✅'} 全部作业结束（失败 {failed}）")
+					return 1 if failed else 0
+		except KeyboardInterrupt:
+			return 0
+		finally:
+			httpd.shutdown()
+	
+	client = distributed.Client(args.coordinator)
+	if args.action == "agent":
+		agent = distributed.Agent(client, distributed.local_projects(args.project))
+		if not agent.projects:
+			print("❌ 没有可服务的工程：用 --project 名称=路径 或 QT_TEST_AI_DIST_PROJECTS 指定")
+			return 1
+		try:
+			agent.loop(once=args.once)
+		except KeyboardInterrupt:
+			pass
+		return 0
+	if args.action == "submit":
+		if not projects:
+			print("❌ 用 --projects 指定工程名（逗号分隔），例如 Diagramscene_ultima-main,Diagramscene_ultima-syz")
+			return 1
+		for name in projects:
+			job = client.call("POST", "/api/jobs", {"project": name, "stage": args.stage, "params": params, "kit": kit})
+			print(f"✅ 已排队 {job['id']}: {name} / {args.stage}")
+		return 0
+	st = client.call("GET", "/api/status")
+	print(f"\n🛰️ 协调端 {client.base}：" + "，".join(f"{k} {v}" for k, v in sorted(st["counts"].items())))
+	for w in st["workers"]:
+		kits = ", ".join(f"{k.get('qt')}/{k.get('spec')}" for k in w.get("kits") or [])
+		print(f"  worker {w['name']:<20} {w.get('platform') or ''}  套件 {kits or '-'}" + (f"  正在执行 {w['busy']}" if w.get("busy") else ""))
+	for j in st["jobs"][-args.limit:]:
+		extra = f" run #{j['run_id']}" if j.get("run_id") else (f" {j['error']}" if j.get("error") else "")
+		print(f"  {j['id']}  {j['status']:<8} {j['project']} / {j['stage']}  {j.get('worker') or ''}{extra}")
+	return 0
+
+
 def cmd_normal_mode(args) -> int:
 	"""正常模式: 启动GUI应用"""
 	from qt_test_ai.app import run_app
@@ -184,6 +546,216 @@ def main() -> int:
 	)
 	full_parser.set_defaults(func=cmd_full_cycle)
 	
+	# generate-batch 命令
+	batch_parser = subparsers.add_parser("generate-batch", help="并发生成多个任务的测试（生成与编译重叠）")
+	batch_parser.add_argument(
+		"-t", "--tasks",
+		help="逗号分隔的任务名称（默认全部任务）",
+		default=None
+	)
+	batch_parser.add_argument(
+		"-s", "--llm-service",
+		help="LLM服务 (openai, claude, auto)",
+		default="auto"
+	)
+	batch_parser.add_argument(
+		"-j", "--concurrency",
+		help="并发请求数（默认 QT_TEST_AI_TESTGEN_CONCURRENCY 或 4）",
+		type=int,
+		default=None
+	)
+	batch_parser.add_argument(
+		"--no-compile",
+		help="只生成，不编译运行",
+		action="store_true"
+	)
+	batch_parser.set_defaults(func=cmd_generate_batch)
+	
+	# coverage-map 命令
+	cmap_parser = subparsers.add_parser("coverage-map", help="查看逐测试覆盖率映射（QT_TEST_AI_PER_TEST_COVERAGE=1 时生成）")
+	cmap_parser.add_argument(
+		"-f", "--file",
+		help="只看某个源文件，例如 diagramscene.cpp",
+		default=None
+	)
+	cmap_parser.add_argument(
+		"-l", "--line",
+		help="配合 --file：列出覆盖该行的测试",
+		type=int,
+		default=None
+	)
+	cmap_parser.add_argument(
+		"--top",
+		help="最多显示多少个测试（默认 30）",
+		type=int,
+		default=30
+	)
+	cmap_parser.set_defaults(func=cmd_coverage_map)
+	
+	# select-tests 命令
+	sel_parser = subparsers.add_parser("select-tests", help="预览基于改动的测试选择（QT_TEST_AI_TEST_SELECTION=1 时测试循环按此只运行受影响的测试）")
+	sel_parser.add_argument(
+		"--base",
+		help="与哪个 git 提交比较（默认使用覆盖率映射记录时的提交）",
+		default=None
+	)
+	sel_parser.set_defaults(func=cmd_select_tests)
+	
+	# bench 命令
+	bench_parser = subparsers.add_parser("bench", help="生成并运行 DiagramScene 的 QBENCHMARK 基准（-tickcounter / -callgrind），检查 O(n²) 回退")
+	bench_parser.add_argument(
+		"-f", "--functions",
+		help="逗号分隔的基准函数（默认全部），例如 insertItems,dragSelection",
+		default=None
+	)
+	bench_parser.add_argument(
+		"--write-only",
+		help="只生成基准源码与工程，不编译运行",
+		action="store_true"
+	)
+	bench_parser.set_defaults(func=cmd_bench)
+	
+	# ui-load 命令
+	ui_parser = subparsers.add_parser("ui-load", help="离屏（-platform offscreen）回放输入脚本：插入元素、连线、框选、拖动、撤销，记录事件延迟与帧时间")
+	ui_parser.add_argument(
+		"-s", "--scripts",
+		help="逗号分隔的脚本名（默认 scripts/ 下全部），例如 diagram_session",
+		default=None
+	)
+	ui_parser.add_argument(
+		"--record",
+		metavar="NAME",
+		help="打开真实窗口录制一个新脚本，保存为 scripts/NAME.json",
+		default=None
+	)
+	ui_parser.add_argument(
+		"--write-only",
+		help="只生成驱动源码、工程与默认脚本，不编译运行",
+		action="store_true"
+	)
+	ui_parser.add_argument(
+		"-v", "--verbose",
+		help="显示每个阶段的延迟分布明细",
+		action="store_true"
+	)
+	ui_parser.set_defaults(func=cmd_ui_load)
+	
+	# fuzz 命令
+	fuzz_parser = subparsers.add_parser("fuzz", help="进程内覆盖率引导模糊测试：DiagramScene 加载 / 反序列化与查找替换入口，报告 exec/s 与新覆盖")
+	fuzz_parser.add_argument(
+		"-t", "--targets",
+		help="逗号分隔的入口名（默认全部，用 --list 查看）",
+		default=None
+	)
+	fuzz_parser.add_argument(
+		"--seconds",
+		help="每个入口的模糊测试时长，秒（默认 QT_TEST_AI_FUZZ_SECONDS 或 60）",
+		type=int,
+		default=None
+	)
+	fuzz_parser.add_argument(
+		"--list",
+		help="只列出发现的入口",
+		action="store_true"
+	)
+	fuzz_parser.add_argument(
+		"--write-only",
+		help="只生成模糊测试源码与工程，不编译运行",
+		action="store_true"
+	)
+	fuzz_parser.add_argument(
+		"-v", "--verbose",
+		help="显示每个入口的执行与语料明细",
+		action="store_true"
+	)
+	fuzz_parser.set_defaults(func=cmd_fuzz)
+	
+	# profile 命令
+	hot_parser = subparsers.add_parser("profile", help="采样剖析：perf（Linux）/ gprof（MinGW）下运行 UI 负载、基准测试或被测程序，报告热点函数的 self / inclusive 占比")
+	hot_parser.add_argument(
+		"-t", "--targets",
+		help="逗号分隔的工作负载：uiload, bench, app（默认 QT_TEST_AI_PROFILE_TARGETS 或 uiload,bench）",
+		default=None
+	)
+	hot_parser.add_argument(
+		"--exe",
+		help="app 工作负载剖析的被测程序（默认自动查找构建目录中的 exe，仅 perf）",
+		default=None
+	)
+	hot_parser.add_argument(
+		"-v", "--verbose",
+		help="显示每个工作负载的库函数热点与热点函数签名",
+		action="store_true"
+	)
+	hot_parser.set_defaults(func=cmd_profile)
+	
+	# profile-startup 命令
+	prof_parser = subparsers.add_parser("profile-startup", help="启动性能剖析：到主窗口可交互的时间与资源 p50/p95/峰值，与基线比较")
+	prof_parser.add_argument(
+		"--exe",
+		help="被测程序（默认自动查找构建目录中的 exe）",
+		default=None
+	)
+	prof_parser.add_argument(
+		"-d", "--duration",
+		help="采样时长，秒（默认 15）",
+		type=int,
+		default=15
+	)
+	prof_parser.add_argument(
+		"--update-baseline",
+		help="把本次结果记录为新基线",
+		action="store_true"
+	)
+	prof_parser.set_defaults(func=cmd_profile_startup)
+	
+	# artifacts 命令
+	art_parser = subparsers.add_parser("artifacts", help="报告制品存储（按内容去重）：用量、与上一次运行的差异、按保留策略回收")
+	art_parser.add_argument(
+		"-n", "--namespace",
+		help="只显示该前缀的命名空间，例如 stage_reports/Diagramscene_ultima-syz",
+		default=None
+	)
+	art_parser.add_argument(
+		"--gc",
+		help="按 QT_TEST_AI_ARTIFACT_KEEP_RUNS / KEEP_DAYS 回收旧运行和无引用对象",
+		action="store_true"
+	)
+	art_parser.set_defaults(func=cmd_artifacts)
+	
+	# dist 命令
+	dist_parser = subparsers.add_parser("dist", help="分布式模式：serve 启动协调端，agent 在构建机上领取作业，submit 排队，status 查看")
+	dist_parser.add_argument("action", choices=["serve", "agent", "submit", "status"], help="serve / agent / submit / status")
+	dist_parser.add_argument(
+		"--projects",
+		help="逗号分隔的工程名（与 agent 端 --project 的名称一致），serve 时直接排队",
+		default=None
+	)
+	dist_parser.add_argument(
+		"--stage",
+		help="作业阶段（默认 coverage）",
+		choices=["static", "tests", "coverage", "full_cycle"],
+		default="coverage"
+	)
+	dist_parser.add_argument("--task", help="full_cycle 的任务名", default=None)
+	dist_parser.add_argument("--llm-service", help="full_cycle 使用的 LLM 服务", default=None)
+	dist_parser.add_argument("--kit-qt", help="要求的 Qt 版本前缀，例如 6.5", default=None)
+	dist_parser.add_argument("--kit-spec", help="要求的 qmake spec，例如 win32-g++", default=None)
+	dist_parser.add_argument(
+		"--project",
+		metavar="NAME=PATH",
+		help="agent 服务的工程检出（可重复；默认 QT_TEST_AI_DIST_PROJECTS 或工具目录旁的 Diagramscene*）",
+		action="append",
+		default=None
+	)
+	dist_parser.add_argument("--coordinator", help="协调端地址（默认 QT_TEST_AI_DIST_COORDINATOR）", default=None)
+	dist_parser.add_argument("--host", help="serve 监听地址（默认 127.0.0.1；其他地址必须设置 QT_TEST_AI_DIST_TOKEN）", default="127.0.0.1")
+	dist_parser.add_argument("--port", help="serve 监听端口（默认 8765）", type=int, default=8765)
+	dist_parser.add_argument("--exit-when-done", help="serve：排队的作业全部结束后退出", action="store_true")
+	dist_parser.add_argument("--once", help="agent：队列里没有可领的作业时退出", action="store_true")
+	dist_parser.add_argument("--limit", help="status 显示的作业数（默认 30）", type=int, default=30)
+	dist_parser.set_defaults(func=cmd_dist)
+	
 	# normal 命令
 	normal_parser = subparsers.add_parser("normal", help="启动GUI应用")
 	normal_parser.set_defaults(func=cmd_normal_mode)
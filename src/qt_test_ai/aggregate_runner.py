@@ -0,0 +1,529 @@
+from __future__ import annotations
+
+import os
+import re
+import subprocess
+import time
+from pathlib import Path
+from typing import Any
+
+from . import coverage_build, project_lib, qtest_results, test_runner, tracing
+from .models import Finding
+
+AGG_DIR = "aggregate"
+AGG_TARGET = "qt_test_ai_aggregate"
+RUNNER_HEADER = "qt_test_ai_runner.h"
+RUNNER_SOURCE = "qt_test_ai_runner.cpp"
+CLASS_RESULT_TAG = "QT_TEST_AI_CLASS_RESULT"
+LIST_FLAG = "-qt-test-ai-functions"
+
+# 不是测试工程的子目录（构建产物 / 本工具生成的目录）
+_SKIP_DIRS = {AGG_DIR, project_lib.LIB_DIR, "pertest_gcda", "debug", "release", "obj", "moc", "rcc", "ui", "bin", "lib"}
+_MAIN_RE = re.compile(r"\b(?:QTEST_(?:APPLESS_|GUILESS_)?MAIN|QT_TEST_AI_TEST_MAIN)\s*\(\s*(\w+)\s*\)")
+
+
+def enabled() -> bool:
+    """Build every generated test class into one runner process (QT_TEST_AI_AGGREGATE)."""
+    return (os.getenv("QT_TEST_AI_AGGREGATE") or "0").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def agg_dir(tests_dir: Path) -> Path:
+    return Path(tests_dir) / AGG_DIR
+
+
+# ----------------------------
+# C++ side
+# ----------------------------
+_RUNNER_H = r"""// Generated by Smart Testing Tools (aggregate QtTest runner). Do not edit.
+//
+// Force-included (-include) into every translation unit of the aggregate
+// target. It pulls in <QtTest> first and then turns QTEST_MAIN,
+// QTEST_APPLESS_MAIN, QTEST_GUILESS_MAIN and the per-test harness's
+// QT_TEST_AI_TEST_MAIN into a static registration, so the test sources are
+// compiled unchanged and qt_test_ai_runner.cpp runs every class in one process.
+#pragma once
+#ifdef __cplusplus
+
+#include <QtTest>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace qt_test_ai {
+
+struct TestClass
+{
+    const char *name;
+    std::function<QObject *()> create;
+};
+
+inline std::vector<TestClass> &registry()
+{
+    static std::vector<TestClass> classes;
+    return classes;
+}
+
+struct Registrar
+{
+    Registrar(const char *name, std::function<QObject *()> create)
+    {
+        registry().push_back({name, std::move(create)});
+    }
+};
+
+} // namespace qt_test_ai
+
+#define QT_TEST_AI_REGISTER(TestObject) \
+    static const qt_test_ai::Registrar qt_test_ai_registrar_##TestObject(#TestObject, []() -> QObject * { return new TestObject; });
+
+#undef QTEST_MAIN
+#undef QTEST_APPLESS_MAIN
+#undef QTEST_GUILESS_MAIN
+#define QTEST_MAIN(TestObject) QT_TEST_AI_REGISTER(TestObject)
+#define QTEST_APPLESS_MAIN(TestObject) QT_TEST_AI_REGISTER(TestObject)
+#define QTEST_GUILESS_MAIN(TestObject) QT_TEST_AI_REGISTER(TestObject)
+#define QT_TEST_AI_TEST_MAIN(TestObject) QT_TEST_AI_REGISTER(TestObject)
+
+#endif // __cplusplus
+"""
+
+_RUNNER_CPP = r"""// Generated by Smart Testing Tools (aggregate QtTest runner). Do not edit.
+//
+// One QApplication, one QTest::qExec() per registered test class.
+// Arguments: QtTest options are forwarded to every class (-o <file> gets the
+// class name appended so the classes don't overwrite each other); other
+// arguments select what runs: "Class" (whole class), "Class::func[:tag]" or
+// "func[:tag]" (every class that has that function). After each class a line
+// "QT_TEST_AI_CLASS_RESULT <Class> <failures>" is printed.
+// -qt-test-ai-functions lists "Class::func()" for every registered class and
+// exits (QtTest's own -functions would only reach the first class).
+#include <QApplication>
+#include <QByteArray>
+#include <QList>
+#include <QMetaMethod>
+#include <cstdio>
+#include <memory>
+
+#if __has_include("qt_test_ai_pertest.h")
+#include "qt_test_ai_pertest.h"
+#define QT_TEST_AI_HAS_PER_TEST 1
+#endif
+
+namespace {
+
+bool hasFunction(const QObject *tc, const QByteArray &name)
+{
+    const QMetaObject *mo = tc->metaObject();
+    for (int i = mo->methodOffset(); i < mo->methodCount(); ++i) {
+        if (mo->method(i).name() == name)
+            return true;
+    }
+    return false;
+}
+
+QByteArray functionOf(const QByteArray &selector)
+{
+    QByteArray name = selector.left(selector.indexOf(':') > 0 ? selector.indexOf(':') : selector.size());
+    if (name.endsWith("()"))
+        name.chop(2);
+    return name;
+}
+
+QByteArray perClassOutput(const QByteArray &spec, const char *cls)
+{
+    const int comma = spec.lastIndexOf(',');
+    QByteArray file = comma >= 0 ? spec.left(comma) : spec;
+    const QByteArray format = comma >= 0 ? spec.mid(comma) : QByteArray();
+    if (file == "-")
+        return spec;
+    const int dot = file.lastIndexOf('.');
+    const int slash = qMax(file.lastIndexOf('/'), file.lastIndexOf('\\'));
+    if (dot > slash)
+        file.insert(dot, QByteArray("-") + cls);
+    else
+        file.append(QByteArray("-") + cls);
+    return file + format;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    app.setAttribute(Qt::AA_Use96Dpi, true);
+    QTEST_SET_MAIN_SOURCE_PATH
+
+    static const char *const valueOptions[] = {"-o", "-maxwarnings", "-eventdelay", "-keydelay", "-mousedelay", "-seed", "-repeat", "-platform"};
+    QList<QByteArray> options;
+    QList<QByteArray> selectors;
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray a(argv[i]);
+        if (!a.startsWith('-')) {
+            selectors << a;
+            continue;
+        }
+        options << a;
+        for (const char *v : valueOptions) {
+            if (a == v && i + 1 < argc) {
+                options << QByteArray(argv[++i]);
+                break;
+            }
+        }
+    }
+
+    const auto &classes = qt_test_ai::registry();
+    if (options.contains(QByteArray("-qt-test-ai-functions"))) {
+        for (const auto &entry : classes) {
+            std::unique_ptr<QObject> tc(entry.create());
+            const QMetaObject *mo = tc->metaObject();
+            for (int i = mo->methodOffset(); i < mo->methodCount(); ++i) {
+                const QMetaMethod m = mo->method(i);
+                if (m.methodType() == QMetaMethod::Slot && m.access() == QMetaMethod::Private && m.parameterCount() == 0)
+                    std::fprintf(stdout, "%s::%s()\n", entry.name, m.name().constData());
+            }
+        }
+        std::fflush(stdout);
+        return 0;
+    }
+    int failed = 0;
+    int classesRun = 0;
+    for (const auto &entry : classes) {
+        std::unique_ptr<QObject> tc(entry.create());
+        const QByteArray cls(entry.name);
+
+        QList<QByteArray> functions;
+        bool wholeClass = selectors.isEmpty();
+        for (const QByteArray &s : selectors) {
+            if (s == cls) {
+                wholeClass = true;
+            } else if (s.startsWith(cls + "::")) {
+                functions << s.mid(cls.size() + 2);
+            } else if (!s.contains("::") && hasFunction(tc.get(), functionOf(s))) {
+                functions << s;
+            }
+        }
+        if (!wholeClass && functions.isEmpty())
+            continue;
+
+        QList<QByteArray> args;
+        args << QByteArray(argv[0]);
+        for (int i = 0; i < options.size(); ++i) {
+            args << options[i];
+            if (options[i] == "-o" && i + 1 < options.size() && classes.size() > 1)
+                args << perClassOutput(options[++i], entry.name);
+        }
+        if (!wholeClass)
+            args << functions;
+
+        QList<char *> cargs;
+        for (QByteArray &a : args)
+            cargs << a.data();
+
+#ifdef QT_TEST_AI_HAS_PER_TEST
+        const int r = qt_test_ai::runPerTest(tc.get(), int(cargs.size()), cargs.data());
+#else
+        const int r = QTest::qExec(tc.get(), int(cargs.size()), cargs.data());
+#endif
+        std::fprintf(stdout, "QT_TEST_AI_CLASS_RESULT %s %d\n", entry.name, r);
+        std::fflush(stdout);
+        failed += r;
+        ++classesRun;
+    }
+    std::fprintf(stdout, "QT_TEST_AI_CLASS_RESULT * %d (%d classes)\n", failed, classesRun);
+    return qMin(failed, 127);
+}
+"""
+
+
+def write_runner(directory: Path) -> None:
+    coverage_build.write_if_changed(Path(directory) / RUNNER_HEADER, _RUNNER_H)
+    coverage_build.write_if_changed(Path(directory) / RUNNER_SOURCE, _RUNNER_CPP)
+
+
+# ----------------------------
+# project discovery
+# ----------------------------
+def _read(p: Path) -> str:
+    try:
+        return p.read_text(encoding="utf-8", errors="replace")
+    except Exception:
+        return ""
+
+
+def _pro_values(text: str, var: str) -> list[str]:
+    """Values of `VAR +=` / `VAR =` in a .pro, following backslash continuations."""
+    text = re.sub(r"\\\s*\n", " ", text)
+    out: list[str] = []
+    for m in re.finditer(rf"^\s*{var}\s*\+?=\s*(.*)$", text, re.M):
+        out.extend(v for v in m.group(1).split() if not v.startswith("$$"))
+    return out
+
+
+def discover(tests_dir: Path) -> dict[str, Any]:
+    """
+    Test sources to aggregate.
+
+    "top" are tests/generated/test_*.cpp (they test the project under test);
+    "subprojects" are tests/generated/<dir>/ with their own .pro, whose
+    SOURCES/HEADERS/QT are taken over.
+    """
+    tests_dir = Path(tests_dir)
+    top = sorted(p for p in tests_dir.glob("test_*.cpp") if _MAIN_RE.search(_read(p)))
+    subs: list[dict[str, Any]] = []
+    for d in sorted(p for p in tests_dir.iterdir() if p.is_dir() and p.name not in _SKIP_DIRS):
+        pros = sorted(d.glob("*.pro"))
+        if not pros:
+            continue
+        text = _read(pros[0])
+        sources = [(d / s).resolve() for s in _pro_values(text, "SOURCES")]
+        sources = [s for s in sources if s.exists()]
+        if not any(_MAIN_RE.search(_read(s)) for s in sources):
+            continue
+        headers = [(d / h).resolve() for h in _pro_values(text, "HEADERS")]
+        subs.append({
+            "dir": d,
+            "sources": sources,
+            "headers": [h for h in headers if h.exists()],
+            "qt": _pro_values(text, "QT"),
+        })
+    return {"top": top, "subprojects": subs}
+
+
+def test_classes(tests_dir: Path) -> list[str]:
+    found = discover(tests_dir)
+    files = list(found["top"]) + [s for sub in found["subprojects"] for s in sub["sources"]]
+    names: list[str] = []
+    for f in files:
+        for m in _MAIN_RE.finditer(_read(f)):
+            if m.group(1) not in names:
+                names.append(m.group(1))
+    return names
+
+
+def aggregate_pro_text(project_root: Path, tests_dir: Path) -> str:
+    d = agg_dir(tests_dir)
+
+    def rel(p: Path) -> str:
+        return project_lib.rel_path(Path(p), d)
+
+    found = discover(tests_dir)
+    top = found["top"]
+    subs = found["subprojects"]
+
+    qt = ["testlib", "widgets"]  # 运行器本身要 QApplication
+    for sub in subs:
+        qt.extend(q for q in sub["qt"] if q not in qt)
+    sources = [RUNNER_SOURCE, *(rel(p) for p in top)]
+    headers = [rel(p) for p in sorted(Path(tests_dir).glob("test_*.h"))]
+    includes = [rel(tests_dir)]
+    for sub in subs:
+        sources.extend(rel(s) for s in sub["sources"] if rel(s) not in sources)
+        headers.extend(rel(h) for h in sub["headers"] if rel(h) not in headers)
+        includes.append(rel(sub["dir"]))
+
+    project_part = ""
+    if top:
+        # 顶层测试针对被测项目：链接项目静态库，或直接编译项目源码
+        for mod in project_lib.qt_modules(project_root).split():
+            if mod not in qt:
+                qt.append(mod)
+        includes.insert(0, rel(project_root))
+        if project_lib.enabled():
+            project_part = project_lib.link_block(d, tests_dir)
+        else:
+            p_src, p_hdr = project_lib.project_sources(project_root)
+            sources.extend(rel(p) for p in p_src)
+            headers.extend(rel(p) for p in p_hdr)
+        for qrc in sorted(Path(project_root).glob("*.qrc")):
+            project_part += f"RESOURCES += {rel(qrc)}\n"
+
+    def _list(var: str, items: list[str]) -> str:
+        if not items:
+            return ""
+        return f"{var} += \\\n    " + " \\\n    ".join(items) + "\n\n"
+
+    return (
+        "# Generated by Smart Testing Tools (QT_TEST_AI_AGGREGATE=1); do not edit.\n"
+        "# Every generated QtTest class in one executable, see qt_test_ai_runner.cpp.\n"
+        "TEMPLATE = app\n"
+        f"TARGET = {AGG_TARGET}\n"
+        "CONFIG += console testcase debug c++17 object_parallel_to_source\n"
+        "CONFIG -= app_bundle\n"
+        f"QT += {' '.join(qt)}\n"
+        "DEFINES += QT_TEST_AI_AGGREGATE\n"
+        f"INCLUDEPATH += $$PWD {' '.join(includes)}\n"
+        f"QMAKE_CXXFLAGS += --coverage -include $$PWD/{RUNNER_HEADER}\n"
+        "QMAKE_LFLAGS += --coverage\n"
+        "\n"
+        + _list("SOURCES", sources)
+        + _list("HEADERS", headers)
+        + project_part
+        + ("\n" if project_part else "")
+        + "DESTDIR = $$PWD/bin\n"
+        "OBJECTS_DIR = $$PWD/obj\n"
+        "MOC_DIR = $$PWD/moc\n"
+        "RCC_DIR = $$PWD/rcc\n"
+        "UI_DIR = $$PWD/ui\n"
+    )
+
+
+def write_project(project_root: Path, tests_dir: Path) -> Path:
+    d = agg_dir(tests_dir)
+    write_runner(d)
+    pro = d / f"{AGG_TARGET}.pro"
+    coverage_build.write_if_changed(pro, aggregate_pro_text(project_root, tests_dir))
+    return pro
+
+
+def executable(tests_dir: Path) -> Path | None:
+    for name in (f"{AGG_TARGET}.exe", AGG_TARGET):
+        p = agg_dir(tests_dir) / "bin" / name
+        if p.is_file():
+            return p
+    return None
+
+
+def build(project_root: Path, tests_dir: Path | None = None) -> tuple[bool, dict[str, Any]]:
+    """Write the aggregate project and build it incrementally; the test sources are compiled unchanged."""
+    tests_dir = Path(tests_dir) if tests_dir is not None else Path(project_root) / "tests" / "generated"
+    if project_lib.enabled() and discover(tests_dir)["top"]:
+        ok, meta_lib = project_lib.ensure_built(project_root, tests_dir)
+        if not ok:
+            return False, {"project_lib": meta_lib}
+    pro = write_project(project_root, tests_dir)
+    ok, meta = coverage_build.build(pro, agg_dir(tests_dir), args=coverage_build.qmake_args(pro, agg_dir(tests_dir)))
+    meta["pro"] = str(pro)
+    return ok, meta
+
+
+# ----------------------------
+# results
+# ----------------------------
+_START_RE = re.compile(r"^\*{9} Start testing of (\w+) \*{9}", re.M)
+_TOTALS_RE = re.compile(r"^Totals:\s*(\d+)\s+passed,\s*(\d+)\s+failed,\s*(\d+)\s+skipped", re.M)
+_CLASS_RESULT_RE = re.compile(rf"^{CLASS_RESULT_TAG} (\w+) (-?\d+)", re.M)
+
+
+def parse_class_results(output: str) -> dict[str, dict[str, Any]]:
+    """
+    Per-class passed/failed/skipped from the runner's output.
+
+    A class with a start banner but no Totals line (or no runner result line)
+    crashed the process and is reported with "crashed": True.
+    """
+    output = output or ""
+    out: dict[str, dict[str, Any]] = {}
+    starts = list(_START_RE.finditer(output))
+    for i, m in enumerate(starts):
+        cls = m.group(1)
+        end = starts[i + 1].start() if i + 1 < len(starts) else len(output)
+        rec = out.setdefault(cls, {"passed": 0, "failed": 0, "skipped": 0, "crashed": False})
+        totals = list(_TOTALS_RE.finditer(output, m.end(), end))
+        if not totals:
+            rec["crashed"] = True
+        for t in totals:
+            rec["passed"] += int(t.group(1))
+            rec["failed"] += int(t.group(2))
+            rec["skipped"] += int(t.group(3))
+    reported = {m.group(1) for m in _CLASS_RESULT_RE.finditer(output)}
+    for cls, rec in out.items():
+        if cls not in reported:
+            rec["crashed"] = True
+    return out
+
+
+def _run_once(cmd: list[str], cwd: Path, env: dict[str, str] | None, timeout_s: float, meta: dict[str, Any]) -> None:
+    try:
+        p = tracing.run(
+            cmd,
+            trace_cat=tracing.TEST,
+            cwd=str(cwd),
+            capture_output=True,
+            text=True,
+            errors="replace",
+            timeout=timeout_s,
+            env={**os.environ, **env} if env else None,
+        )
+        meta["returncode"] = p.returncode
+        meta["stdout"] = p.stdout or ""
+        meta["stderr"] = p.stderr or ""
+    except subprocess.TimeoutExpired as e:
+        meta["returncode"] = -1
+        meta["stdout"] = getattr(e, "stdout", "") or ""
+        meta["stderr"] = "TIMEOUT"
+        meta["timed_out"] = True
+
+
+def run(
+    project_root: Path,
+    tests_dir: Path | None = None,
+    *,
+    args: list[str] | None = None,
+    env: dict[str, str] | None = None,
+    timeout_s: float = 600,
+) -> tuple[list[Finding], dict[str, Any]]:
+    """Build the aggregate runner if needed and run it once; meta carries stdout/returncode like QT_TEST_AI_TEST_CMD runs."""
+    project_root = Path(project_root)
+    tests_dir = Path(tests_dir) if tests_dir is not None else project_root / "tests" / "generated"
+    findings: list[Finding] = []
+    ok, m_build = build(project_root, tests_dir)
+    meta: dict[str, Any] = {"aggregate": True, "build": {k: m_build.get(k) for k in ("build_dir", "qmake_skipped", "jobs", "duration_s")}}
+    if not ok:
+        step = m_build.get("make") or m_build.get("qmake") or (m_build.get("project_lib") or {}).get("make") or {}
+        findings.append(Finding("tests", "error", "聚合测试程序编译失败", ((step.get("stderr") or "") + "\n" + (step.get("stdout") or ""))[-4000:]))
+        meta["returncode"] = -1
+        return findings, meta
+
+    exe = executable(tests_dir)
+    if exe is None:
+        findings.append(Finding("tests", "error", "未找到聚合测试程序", str(agg_dir(tests_dir) / "bin")))
+        meta["returncode"] = -1
+        return findings, meta
+
+    # 运行器会给每个测试类的 XML 日志加上类名后缀
+    results_dir = agg_dir(tests_dir) if qtest_results.enabled() else None
+    cmd = [str(exe), *(qtest_results.output_args(results_dir) if results_dir else []), *(args or [])]
+    meta["cmd"] = " ".join(cmd)
+    t0 = time.perf_counter()
+    if test_runner.shard_count() > 1:
+        # 所有测试类的函数按 Class::func 一起按历史耗时分片；同一个类可能分到多个进程，按类汇总时会合并
+        sharded = test_runner.run_sharded(
+            exe,
+            cwd=tests_dir,
+            tests_dir=tests_dir,
+            functions=args or None,
+            env=env,
+            timeout_s=timeout_s,
+            results_dir=results_dir,
+            list_flag=LIST_FLAG,
+        )
+        meta.update({k: sharded[k] for k in ("returncode", "stdout", "stderr", "timed_out", "shards")})
+    else:
+        if results_dir is not None:
+            qtest_results.clear(results_dir)
+        _run_once(cmd, tests_dir, env, timeout_s, meta)
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    res = qtest_results.collect(results_dir) if results_dir is not None else None
+    if res is not None:
+        meta["test_results"] = res.to_meta()
+        if test_runner.shard_count() <= 1:
+            test_runner.record_durations(tests_dir, res.durations_s(qualified=True))
+
+    classes = parse_class_results(meta.get("stdout") or "")
+    meta["classes"] = classes
+    for cls, rec in classes.items():
+        if rec["crashed"]:
+            detail = "聚合进程在该测试类执行期间退出，后续测试类未运行"
+            crashed = [f.name for f in (res.crashed() if res is not None else []) if f.cls == cls]
+            if crashed:
+                detail += f"\n崩溃于: {cls}::{crashed[0]}()"
+            findings.append(Finding("tests", "error", f"{cls} 运行中崩溃", detail))
+        elif rec["failed"]:
+            detail = f"通过 {rec['passed']}，跳过 {rec['skipped']}"
+            if res is not None:
+                where = qtest_results.TestResults([f for f in res.functions if f.cls == cls]).failure_report(limit=10)
+                detail += f"\n{where}" if where else ""
+            findings.append(Finding("tests", "error", f"{cls}: {rec['failed']} 个测试失败", detail))
+    if meta.get("returncode") == 0:
+        findings.append(Finding("tests", "info", f"聚合测试通过（{len(classes)} 个测试类，{meta['duration_s']}s）"))
+    return findings, meta
@@ -26,7 +26,13 @@ def _load_dotenv_if_present():
 
 _load_dotenv_if_present()
 
+from . import artifact_store
 from . import db as dbmod
+from . import fuzz_harness
+from . import http_client
+from . import profiling
+from . import tracing
+from . import ui_load
 from .doc_checks import run_doc_checks, run_llm_doc_checks, read_docx_text
 from .dynamic_checks import pick_exe, run_smoke_test, run_windows_ui_probe
 from .models import Finding, TestRun
@@ -41,7 +47,10 @@ from .functional_cases import (
 )
 from .llm import chat_completion_text, load_llm_config_from_env, load_llm_system_prompt_from_env
 from .qt_project import build_project_context
+from .scheduler import Stage, StageResult, run_stages, stage_timings, stage_workers_from_env
 
+# 历史面板每页条数（键集分页，"加载更早记录" 取下一页）
+HISTORY_PAGE_SIZE = 100
 
 def _env_flag(name: str) -> bool:
     v = (os.getenv(name) or "").strip().lower()
@@ -65,11 +74,14 @@ class Worker(QtCore.QObject):
     def __init__(self, opts: RunOptions):
         super().__init__()
         self.opts = opts
+        self._picked_exe: Path | None = None
 
     @QtCore.Slot()
     def run(self) -> None:
         findings: list[Finding] = []
         meta: dict = {"looks_like_qt_pro": looks_like_qt_pro(self.opts.project_root)}
+        llm_mark = http_client.metrics.mark()
+        trace_id = tracing.begin()
 
         try:
             meta["functional_cases"] = self.opts.functional_entries
@@ -85,261 +97,85 @@ class Worker(QtCore.QObject):
                         )
                     )
 
-            self.progress.emit("运行静态检查…")
-            f_static, m_static = run_static_checks(self.opts.project_root)
-            findings.extend(f_static)
-            meta["static"] = m_static
-
-            self.progress.emit("运行用户文档检查…")
-            f_docs, m_docs = run_doc_checks(self.opts.project_root)
-            findings.extend(f_docs)
-            meta["docs"] = m_docs
-
-            llm_cfg = load_llm_config_from_env()
-            if llm_cfg and m_docs.get("doc_files"):
-                self.progress.emit("运行 LLM 文档一致性检查…")
-                try:
-                    # 读取文档内容
-                    from .utils import read_text_best_effort
-                    doc_content = ""
-                    for dp in m_docs.get("doc_files", [])[:3]:  # 限制数量
-                        if Path(dp).exists() and Path(dp).suffix in [".md", ".txt"]:
-                            doc_content += f"\n=== {Path(dp).name} ===\n"
-                            doc_content += read_text_best_effort(Path(dp))[:3000]
-                    
-                    # 获取项目上下文
-                    ctx = build_project_context(self.opts.project_root)
-                    project_context = ctx.prompt_text if ctx else ""
-                    
-                    # 运行 LLM 文档检查
-                    f_llm_docs = run_llm_doc_checks(
-                        self.opts.project_root, 
-                        llm_cfg, 
-                        doc_content, 
-                        project_context
-                    )
-                    findings.extend(f_llm_docs)
-                    meta["docs"]["llm_checks"] = len(f_llm_docs)
-                except Exception as e:
-                    self.progress.emit(f"LLM 文档检查出错: {e}")
-
-            self.progress.emit("准备动态测试…")
-            exe, f_pick, m_pick = pick_exe(self.opts.project_root, self.opts.exe_path)
-            findings.extend(f_pick)
-            meta["dynamic_pick"] = m_pick
-
-            if exe is not None:
-                self.progress.emit("运行动态检测…")
-                f_smoke, m_smoke = run_smoke_test(exe, workdir=self.opts.project_root)
-                findings.extend(f_smoke)
-                meta["dynamic_smoke"] = m_smoke
-
-                if self.opts.enable_ui_probe:
-                    self.progress.emit("运行 Windows UI 探测…")
-                    f_ui, m_ui = run_windows_ui_probe(exe)
-                    findings.extend(f_ui)
-                    meta["dynamic_ui"] = m_ui
-                    
-                # 自动保存动态测试报告
-                try:
-                    ts = datetime.now().strftime("%Y%m%d_%H%M%S")
-                    # Always save to tool's reports/dynamic directory, as requested
-                    tool_root = Path(__file__).resolve().parents[2]
-                    dyn_dir = tool_root / "reports" / "dynamic"
-                    
-                    dyn_dir.mkdir(parents=True, exist_ok=True)
-                    dyn_out = dyn_dir / f"smoke_test_{ts}.json"
-                    
-                    # 构造简单报告内容
-                    dyn_report = {
-                        "exe_path": str(exe),
-                        "timestamp": datetime.now().isoformat(),
-                        "smoke_test": meta.get("dynamic_smoke"),
-                        "ui_probe": meta.get("dynamic_ui"),
-                        "findings": [
-                            {"title": f.title, "severity": f.severity, "details": f.details}
-                            for f in findings if f.category == "dynamic"
-                        ]
-                    }
-                    dyn_out.write_text(json.dumps(dyn_report, ensure_ascii=False, indent=2), encoding="utf-8")
-                    self.progress.emit(f"动态测试报告已保存：{dyn_out}")
-                except Exception as e:
-                    self.progress.emit(f"⚠️ 保存动态测试报告失败：{e}")
-
-            # 自动化：生成测试用例 / 运行测试 / 覆盖率（可选）
-            automation_enabled = _env_flag("QT_TEST_AI_ENABLE_AUTOMATION")
-            self.progress.emit(f"自动化启用状态: {automation_enabled} (QT_TEST_AI_ENABLE_AUTOMATION={os.getenv('QT_TEST_AI_ENABLE_AUTOMATION', 'NOT_SET')})")
-            if automation_enabled:
-                try:
-                    from .test_automation import (
-                        cleanup_coverage_artifacts,
-                        generate_qttest_via_llm,
-                        run_coverage_command,
-                        run_test_command,
-                        save_stage_report,
-                        run_single_file_test_loop,
-                    )
-
-                    # 统一本次 run 的阶段报告目录时间戳
-                    run_ts = datetime.now().strftime("%Y%m%d_%H%M%S")
-                    meta.setdefault("stage_reports", {})
-
-                    # 自动化执行前清理旧的覆盖率产物
-                    cov_cmd_env = os.getenv("QT_TEST_AI_COVERAGE_CMD") or ""
-                    f_clean, m_clean = cleanup_coverage_artifacts(
-                        self.opts.project_root,
-                        coverage_cmd=cov_cmd_env,
-                    )
-                    findings.extend(f_clean)
-                    meta["coverage_cleanup"] = m_clean
-                    if m_clean.get("enabled"):
-                        self.progress.emit(
-                            f"覆盖率清理已执行，删除 {m_clean.get('removed_files', 0)} 个文件"
-                        )
-                    else:
-                        self.progress.emit("覆盖率清理已跳过（QT_TEST_AI_COVERAGE_CLEAN_BEFORE=0）")
-
-                    if self.opts.single_file_mode and self.opts.single_file_path:
-                        # ----------------------------
-                        # 单文件循环模式
-                        # ----------------------------
-                        self.progress.emit(f"自动化：单文件循环模式 ({self.opts.single_file_path.name})…")
-                        f_loop, m_loop = run_single_file_test_loop(
-                            self.opts.project_root,
-                            self.opts.single_file_path
-                        )
-                        findings.extend(f_loop)
-                        meta["single_file_loop"] = m_loop
-                        
-                        rep_loop = save_stage_report(
-                            project_root=self.opts.project_root,
-                            stage="single_file_loop",
-                            findings=f_loop,
-                            meta=m_loop,
-                            run_ts=run_ts,
-                        )
-                        meta["stage_reports"]["single_file_loop"] = rep_loop
-                        self.progress.emit(f"单文件循环报告已保存：{rep_loop.get('out_dir')}")
-
-                    else:
-                        # ----------------------------
-                        # A) 生成 QtTest 用例
-                        # ----------------------------
-                        self.progress.emit("自动化：LLM 生成 QtTest 用例…")
-                        f_gen, m_gen = generate_qttest_via_llm(
-                            self.opts.project_root, 
-                            top_level_only=True,
-                            single_file_path=self.opts.single_file_path if self.opts.single_file_mode else None
-                        )
-                        findings.extend(f_gen)
-                        meta["testgen"] = m_gen
-
-                        # 终端打印 + UI 日志
-                        out_dir = (m_gen or {}).get("out_dir")
-                        files = (m_gen or {}).get("files") or []
-                        print("[testgen] out_dir:", out_dir)
-                        print("[testgen] files:")
-                        for p in files:
-                            print("  -", p)
-
-                        self.progress.emit(f"[testgen] out_dir: {out_dir or ''}")
-                        if files:
-                            self.progress.emit("[testgen] files:\n" + "\n".join([f"  - {p}" for p in files]))
-
-                        rep_gen = save_stage_report(
-                            project_root=self.opts.project_root,
-                            stage="testgen",
-                            findings=f_gen,
-                            meta=m_gen,
-                            run_ts=run_ts,
-                        )
-                        meta["stage_reports"]["testgen"] = rep_gen
-                        self.progress.emit(f"testgen 报告已保存：{rep_gen.get('out_dir')}")
-
-                        # ----------------------------
-                        # B) 运行测试命令
-                        # ----------------------------
-                        self.progress.emit("自动化：运行测试命令…")
-                        f_test, m_test = run_test_command(self.opts.project_root)
-                        findings.extend(f_test)
-                        meta["tests"] = m_test
-
-                        print("[tests] returncode:", (m_test or {}).get("returncode"))
-                        if (m_test or {}).get("timed_out"):
-                            print("[tests] timed out:", (m_test or {}).get("timeout_s"))
-                        print("[tests] cwd:", (m_test or {}).get("cwd"))
-                        print("[tests] cmd:", (m_test or {}).get("cmd"))
-
-                        self.progress.emit(
-                            f"[tests] returncode={(m_test or {}).get('returncode')} "
-                            + ("(timed out)" if (m_test or {}).get("timed_out") else "")
-                        )
-
-                        rep_test = save_stage_report(
-                            project_root=self.opts.project_root,
-                            stage="tests",
-                            findings=f_test,
-                            meta=m_test,
-                            run_ts=run_ts,
-                        )
-                        meta["stage_reports"]["tests"] = rep_test
-                        self.progress.emit(f"tests 报告已保存：{rep_test.get('out_dir')}")
-
-                        # ----------------------------
-                        # C) 运行覆盖率命令
-                        # ----------------------------
-                        self.progress.emit("自动化：运行覆盖率命令…")
-                        # Use the project path currently entered in the UI if available
-                        try:
-                            proj_text = self.project_edit.text().strip()
-                        except Exception:
-                            proj_text = ""
-                        if proj_text:
-                            pr_path = Path(proj_text)
-                            if not pr_path.exists():
-                                pr_path = self.opts.project_root
-                        else:
-                            pr_path = self.opts.project_root
-
-                        f_cov, m_cov = run_coverage_command(pr_path, top_level_only=True)
-                        findings.extend(f_cov)
-                        meta["coverage"] = m_cov
-
-                        print("[coverage] returncode:", (m_cov or {}).get("returncode"))
-                        if (m_cov or {}).get("summary"):
-                            print("[coverage] summary:", (m_cov or {}).get("summary"))
-                        print("[coverage] cmd:", (m_cov or {}).get("cmd"))
-
-                        self.progress.emit(
-                            f"[coverage] returncode={(m_cov or {}).get('returncode')} "
-                            + (f"summary={(m_cov or {}).get('summary')}" if (m_cov or {}).get("summary") else "")
-                        )
+            # 静态 / 文档 / 动态 / 自动化各阶段按依赖图并发执行：
+            # - dynamic 声明在最前并独占：冒烟测试的启动耗时 / 内存 / CPU 采样先单独跑完（通常只有几秒），
+            #   之后其余阶段全部并发，总耗时接近最长的那个阶段
+            # - llm_docs 依赖 docs 的文档列表
+            # - automation 依赖 dynamic：覆盖率清理会删除 .gcda，必须等冒烟测试进程退出后再做
+            # - UI 负载回放自己构建、自己计时，作为单独阶段与其他阶段并发
+            stages = [
+                Stage("dynamic", self._stage_dynamic, exclusive=True),
+                Stage("static", self._stage_static),
+                Stage("docs", self._stage_docs),
+                Stage("llm_docs", self._stage_llm_docs, deps=("docs",)),
+                Stage("automation", self._stage_automation, deps=("dynamic",)),
+            ]
+            if ui_load.enabled():
+                stages.append(Stage("ui_load", self._stage_ui_load))
+            if fuzz_harness.enabled():
+                # 插桩程序单独构建（trace-pc，不产生 .gcda），与其他阶段互不影响
+                stages.append(Stage("fuzz", self._stage_fuzz))
+            if profiling.enabled():
+                # 采样剖析放在最后并独占（等 fuzz 等阶段也结束），避免抢 CPU 而歪曲热点比例
+                stages.append(Stage("profile", self._stage_profile, deps=("dynamic", "automation"), exclusive=True))
+            workers = stage_workers_from_env()
+            meta["stage_parallelism"] = workers
+
+            def _on_start(stage: Stage) -> None:
+                self.progress.emit(f"[stage] {stage.name} 开始")
+
+            def _on_done(res: StageResult) -> None:
+                # 每个阶段完成后立即合并其 meta，findings 在最后按声明顺序拼接
+                meta.update(res.meta)
+                if res.status == "ok":
+                    self.progress.emit(f"[stage] {res.name} 完成，用时 {res.duration_s:.1f}s")
+                elif res.status == "skipped":
+                    self.progress.emit(f"[stage] {res.name} 已跳过：{res.error}")
+                else:
+                    self.progress.emit(f"[stage] {res.name} 失败，用时 {res.duration_s:.1f}s")
 
-                        rep_cov = save_stage_report(
-                            project_root=self.opts.project_root,
-                            stage="coverage",
-                            findings=f_cov,
-                            meta=m_cov,
-                            run_ts=run_ts,
-                        )
-                        meta["stage_reports"]["coverage"] = rep_cov
-                        self.progress.emit(f"coverage 报告已保存：{rep_cov.get('out_dir')}")
+            results = run_stages(stages, max_workers=workers, on_start=_on_start, on_done=_on_done)
+            meta["stage_timings"] = stage_timings(results)
 
-                except Exception as e:
-                    import traceback
-                    error_trace = traceback.format_exc()
-                    print(f"[AUTOMATION ERROR] {e}")
-                    print(error_trace)
+            for s in stages:
+                res = results.get(s.name)
+                if res is None:
+                    continue
+                findings.extend(res.findings)
+                if res.status == "error":
+                    meta["internal_error"] = (res.error or "").splitlines()[0] if res.error else ""
                     findings.append(
                         Finding(
-                            category="automation",
-                            severity="warning",
-                            title="自动化测试/覆盖率阶段失败",
-                            details=f"{str(e)}\n\nTraceback:\n{error_trace}",
+                            category="internal",
+                            severity="error",
+                            title=f"阶段 {s.name} 发生未处理异常",
+                            details=res.error or "",
                         )
                     )
-            else:
-                meta["automation"] = {"enabled": False, "hint_env": "QT_TEST_AI_ENABLE_AUTOMATION=1"}
+
+            auto_cases = meta.pop("functional_auto", None) or []
+            if auto_cases:
+                by_id = {c["id"]: c for c in auto_cases}
+                manual = [c for c in meta.get("functional_cases") or [] if c.get("id") not in by_id]
+                meta["functional_cases"] = [*auto_cases, *manual]
+                for c in auto_cases:
+                    if c["status"] == "fail":
+                        findings.append(
+                            Finding(
+                                category="functional",
+                                severity="error",
+                                title=f"功能用例失败：{c['id']} {c['title']}",
+                                details=str(c.get("actual") or ""),
+                                rule_id=c["id"],
+                            )
+                        )
+
+            exe = self._picked_exe
+            # 本次运行内所有 LLM 请求的延迟 / token / 缓存命中统计
+            meta["llm_metrics"] = http_client.metrics.summary(since=llm_mark)
+            # 各阶段的 shell / 构建 / LLM / gcovr / cppcheck / 冒烟 span：汇总进报告，明细导出为 chrome trace
+            trace_dir = Path(__file__).resolve().parents[2] / "reports" / "traces"
+            meta["trace"] = tracing.finish(trace_id, trace_dir, label=datetime.now().strftime("%Y%m%d_%H%M%S"))
 
             run = TestRun(
                 project_root=str(self.opts.project_root),
@@ -368,6 +204,312 @@ class Worker(QtCore.QObject):
             )
             self.finished.emit(run)
 
+    # ----------------------------
+    # 各阶段实现：返回 (findings, meta_updates)，在线程池中执行
+    # ----------------------------
+    def _stage_static(self, deps: dict) -> tuple[list[Finding], dict]:
+        self.progress.emit("运行静态检查…")
+        f_static, m_static = run_static_checks(self.opts.project_root)
+        return f_static, {"static": m_static}
+
+    def _stage_docs(self, deps: dict) -> tuple[list[Finding], dict]:
+        self.progress.emit("运行用户文档检查…")
+        f_docs, m_docs = run_doc_checks(self.opts.project_root)
+        return f_docs, {"docs": m_docs}
+
+    def _stage_llm_docs(self, deps: dict) -> tuple[list[Finding], dict]:
+        m_docs = deps["docs"].meta.get("docs") or {}
+        llm_cfg = load_llm_config_from_env()
+        if not (llm_cfg and m_docs.get("doc_files")):
+            return [], {}
+        self.progress.emit("运行 LLM 文档一致性检查…")
+        try:
+            # 读取文档内容
+            from .utils import read_text_best_effort
+            doc_content = ""
+            for dp in m_docs.get("doc_files", [])[:3]:  # 限制数量
+                if Path(dp).exists() and Path(dp).suffix in [".md", ".txt"]:
+                    doc_content += f"\n=== {Path(dp).name} ===\n"
+                    doc_content += read_text_best_effort(Path(dp))[:3000]
+
+            # 获取项目上下文
+            ctx = build_project_context(self.opts.project_root)
+            project_context = ctx.prompt_text if ctx else ""
+
+            # 运行 LLM 文档检查
+            f_llm_docs = run_llm_doc_checks(
+                self.opts.project_root,
+                llm_cfg,
+                doc_content,
+                project_context
+            )
+            # docs 阶段已结束，这里只有本阶段会写入它的 meta
+            m_docs["llm_checks"] = len(f_llm_docs)
+            return f_llm_docs, {}
+        except Exception as e:
+            self.progress.emit(f"LLM 文档检查出错: {e}")
+            return [], {}
+
+    def _stage_dynamic(self, deps: dict) -> tuple[list[Finding], dict]:
+        findings: list[Finding] = []
+        meta: dict = {}
+
+        self.progress.emit("准备动态测试…")
+        exe, f_pick, m_pick = pick_exe(self.opts.project_root, self.opts.exe_path)
+        findings.extend(f_pick)
+        meta["dynamic_pick"] = m_pick
+        self._picked_exe = exe
+
+        if exe is not None:
+            self.progress.emit("运行动态检测…")
+            f_smoke, m_smoke = run_smoke_test(exe, workdir=self.opts.project_root)
+            findings.extend(f_smoke)
+            meta["dynamic_smoke"] = m_smoke
+
+            if self.opts.enable_ui_probe:
+                self.progress.emit("运行 Windows UI 探测…")
+                f_ui, m_ui = run_windows_ui_probe(exe)
+                findings.extend(f_ui)
+                meta["dynamic_ui"] = m_ui
+
+            # 自动保存动态测试报告
+            try:
+                ts = datetime.now().strftime("%Y%m%d_%H%M%S")
+                # Always save to tool's reports/dynamic directory, as requested
+                tool_root = Path(__file__).resolve().parents[2]
+                dyn_dir = tool_root / "reports" / "dynamic"
+
+                # 构造简单报告内容
+                dyn_report = {
+                    "exe_path": str(exe),
+                    "timestamp": datetime.now().isoformat(),
+                    "smoke_test": meta.get("dynamic_smoke"),
+                    "ui_probe": meta.get("dynamic_ui"),
+                    "findings": [
+                        {"title": f.title, "severity": f.severity, "details": f.details}
+                        for f in findings if f.category == "dynamic"
+                    ]
+                }
+                dyn_text = json.dumps(dyn_report, ensure_ascii=False, indent=2)
+                if artifact_store.enabled():
+                    store = artifact_store.ArtifactStore(tool_root / "reports" / "artifacts")
+                    man = store.commit("dynamic/smoke_test", ts, {"smoke_test.json": dyn_text})
+                    artifact_store.maybe_gc(store)
+                    dyn_out = store.manifest_path("dynamic/smoke_test", ts)
+                    meta["dynamic_report"] = str(store.object_path(man["files"]["smoke_test.json"]["sha256"]))
+                else:
+                    dyn_dir.mkdir(parents=True, exist_ok=True)
+                    dyn_out = dyn_dir / f"smoke_test_{ts}.json"
+                    dyn_out.write_text(dyn_text, encoding="utf-8")
+                self.progress.emit(f"动态测试报告已保存：{dyn_out}")
+            except Exception as e:
+                self.progress.emit(f"⚠️ 保存动态测试报告失败：{e}")
+
+        return findings, meta
+
+    def _stage_ui_load(self, deps: dict) -> tuple[list[Finding], dict]:
+        self.progress.emit("运行 UI 负载回放（offscreen）…")
+        f_load, m_load = ui_load.run(self.opts.project_root)
+        # F01 / F02 由回放结果判定，不再依赖手工勾选
+        return f_load, {"dynamic_ui_load": m_load, "functional_auto": ui_load.case_entries(m_load)}
+
+    def _stage_profile(self, deps: dict) -> tuple[list[Finding], dict]:
+        prof, _ = profiling.profiler()
+        self.progress.emit(f"运行采样剖析（{prof}，工作负载 {', '.join(profiling.targets())}）…")
+        findings, m_prof = profiling.run(self.opts.project_root, app_exe=self._picked_exe)
+        return findings, {"profile": m_prof}
+
+    def _stage_fuzz(self, deps: dict) -> tuple[list[Finding], dict]:
+        self.progress.emit(f"运行模糊测试（每个入口 {fuzz_harness.seconds()}s，引擎 {fuzz_harness.engine()}）…")
+        findings, m_fuzz = fuzz_harness.run(self.opts.project_root)
+        return findings, {"fuzz": m_fuzz}
+
+    def _stage_automation(self, deps: dict) -> tuple[list[Finding], dict]:
+        findings: list[Finding] = []
+        meta: dict = {}
+
+        # 自动化：生成测试用例 / 运行测试 / 覆盖率（可选）
+        automation_enabled = _env_flag("QT_TEST_AI_ENABLE_AUTOMATION")
+        self.progress.emit(f"自动化启用状态: {automation_enabled} (QT_TEST_AI_ENABLE_AUTOMATION={os.getenv('QT_TEST_AI_ENABLE_AUTOMATION', 'NOT_SET')})")
+        if not automation_enabled:
+            meta["automation"] = {"enabled": False, "hint_env": "QT_TEST_AI_ENABLE_AUTOMATION=1"}
+            return findings, meta
+
+        try:
+            from .test_automation import (
+                cleanup_coverage_artifacts,
+                generate_qttest_via_llm,
+                run_coverage_command,
+                run_test_command,
+                save_stage_report,
+                run_single_file_test_loop,
+            )
+
+            # 统一本次 run 的阶段报告目录时间戳
+            run_ts = datetime.now().strftime("%Y%m%d_%H%M%S")
+            meta.setdefault("stage_reports", {})
+
+            # 自动化执行前清理旧的覆盖率产物
+            cov_cmd_env = os.getenv("QT_TEST_AI_COVERAGE_CMD") or ""
+            f_clean, m_clean = cleanup_coverage_artifacts(
+                self.opts.project_root,
+                coverage_cmd=cov_cmd_env,
+            )
+            findings.extend(f_clean)
+            meta["coverage_cleanup"] = m_clean
+            if m_clean.get("enabled"):
+                self.progress.emit(
+                    f"覆盖率清理已执行，删除 {m_clean.get('removed_files', 0)} 个文件"
+                )
+            else:
+                self.progress.emit("覆盖率清理已跳过（QT_TEST_AI_COVERAGE_CLEAN_BEFORE=0）")
+
+            if self.opts.single_file_mode and self.opts.single_file_path:
+                # ----------------------------
+                # 单文件循环模式
+                # ----------------------------
+                self.progress.emit(f"自动化：单文件循环模式 ({self.opts.single_file_path.name})…")
+                f_loop, m_loop = run_single_file_test_loop(
+                    self.opts.project_root,
+                    self.opts.single_file_path,
+                    progress=self.progress.emit,
+                )
+                findings.extend(f_loop)
+                meta["single_file_loop"] = m_loop
+
+                rep_loop = save_stage_report(
+                    project_root=self.opts.project_root,
+                    stage="single_file_loop",
+                    findings=f_loop,
+                    meta=m_loop,
+                    run_ts=run_ts,
+                )
+                meta["stage_reports"]["single_file_loop"] = rep_loop
+                self.progress.emit(f"单文件循环报告已保存：{rep_loop.get('out_dir')}")
+
+            else:
+                # ----------------------------
+                # A) 生成 QtTest 用例
+                # ----------------------------
+                self.progress.emit("自动化：LLM 生成 QtTest 用例…")
+                f_gen, m_gen = generate_qttest_via_llm(
+                    self.opts.project_root,
+                    top_level_only=True,
+                    single_file_path=self.opts.single_file_path if self.opts.single_file_mode else None,
+                    progress=self.progress.emit,
+                )
+                findings.extend(f_gen)
+                meta["testgen"] = m_gen
+
+                # 终端打印 + UI 日志
+                out_dir = (m_gen or {}).get("out_dir")
+                files = (m_gen or {}).get("files") or []
+                print("[testgen] out_dir:", out_dir)
+                print("[testgen] files:")
+                for p in files:
+                    print("  -", p)
+
+                self.progress.emit(f"[testgen] out_dir: {out_dir or ''}")
+                if files:
+                    self.progress.emit("[testgen] files:\n" + "\n".join([f"  - {p}" for p in files]))
+
+                rep_gen = save_stage_report(
+                    project_root=self.opts.project_root,
+                    stage="testgen",
+                    findings=f_gen,
+                    meta=m_gen,
+                    run_ts=run_ts,
+                )
+                meta["stage_reports"]["testgen"] = rep_gen
+                self.progress.emit(f"testgen 报告已保存：{rep_gen.get('out_dir')}")
+                if rep_gen.get("diff"):
+                    self.progress.emit(f"[artifacts] {rep_gen['diff']}")
+
+                # ----------------------------
+                # B) 运行测试命令
+                # ----------------------------
+                self.progress.emit("自动化：运行测试命令…")
+                f_test, m_test = run_test_command(self.opts.project_root)
+                findings.extend(f_test)
+                meta["tests"] = m_test
+
+                print("[tests] returncode:", (m_test or {}).get("returncode"))
+                if (m_test or {}).get("timed_out"):
+                    print("[tests] timed out:", (m_test or {}).get("timeout_s"))
+                print("[tests] cwd:", (m_test or {}).get("cwd"))
+                print("[tests] cmd:", (m_test or {}).get("cmd"))
+
+                self.progress.emit(
+                    f"[tests] returncode={(m_test or {}).get('returncode')} "
+                    + ("(timed out)" if (m_test or {}).get("timed_out") else "")
+                )
+
+                rep_test = save_stage_report(
+                    project_root=self.opts.project_root,
+                    stage="tests",
+                    findings=f_test,
+                    meta=m_test,
+                    run_ts=run_ts,
+                )
+                meta["stage_reports"]["tests"] = rep_test
+                self.progress.emit(f"tests 报告已保存：{rep_test.get('out_dir')}")
+
+                # ----------------------------
+                # C) 运行覆盖率命令
+                # ----------------------------
+                self.progress.emit("自动化：运行覆盖率命令…")
+                # Use the project path currently entered in the UI if available
+                try:
+                    proj_text = self.project_edit.text().strip()
+                except Exception:
+                    proj_text = ""
+                if proj_text:
+                    pr_path = Path(proj_text)
+                    if not pr_path.exists():
+                        pr_path = self.opts.project_root
+                else:
+                    pr_path = self.opts.project_root
+
+                f_cov, m_cov = run_coverage_command(pr_path, top_level_only=True)
+                findings.extend(f_cov)
+                meta["coverage"] = m_cov
+
+                print("[coverage] returncode:", (m_cov or {}).get("returncode"))
+                if (m_cov or {}).get("summary"):
+                    print("[coverage] summary:", (m_cov or {}).get("summary"))
+                print("[coverage] cmd:", (m_cov or {}).get("cmd"))
+
+                self.progress.emit(
+                    f"[coverage] returncode={(m_cov or {}).get('returncode')} "
+                    + (f"summary={(m_cov or {}).get('summary')}" if (m_cov or {}).get("summary") else "")
+                )
+
+                rep_cov = save_stage_report(
+                    project_root=self.opts.project_root,
+                    stage="coverage",
+                    findings=f_cov,
+                    meta=m_cov,
+                    run_ts=run_ts,
+                )
+                meta["stage_reports"]["coverage"] = rep_cov
+                self.progress.emit(f"coverage 报告已保存：{rep_cov.get('out_dir')}")
+
+        except Exception as e:
+            import traceback
+            error_trace = traceback.format_exc()
+            print(f"[AUTOMATION ERROR] {e}")
+            print(error_trace)
+            findings.append(
+                Finding(
+                    category="automation",
+                    severity="warning",
+                    title="自动化测试/覆盖率阶段失败",
+                    details=f"{str(e)}\n\nTraceback:\n{error_trace}",
+                )
+            )
+
+        return findings, meta
+
 
 class SummaryWidget(QtWidgets.QWidget):
     def __init__(self, parent=None):
@@ -411,13 +553,162 @@ class SummaryWidget(QtWidgets.QWidget):
         self.cards[2].setText(str(warn))
         self.cards[3].setText(pass_rate)
 
+class FindingsModel(QtCore.QAbstractTableModel):
+    """
+    Findings of one run for a QTableView.
+
+    Rows are exposed in batches through canFetchMore / fetchMore, so a run with
+    thousands of findings is attached instantly and the view only asks for
+    rows as the user scrolls.
+    """
+
+    HEADERS = ["类别", "级别", "标题", "文件"]
+    BATCH = 200
+    SEVERITY_RANK = {"error": 0, "warning": 1, "info": 2}
+
+    def __init__(self, parent=None):
+        super().__init__(parent)
+        self._findings: list[Finding] = []
+        self._loaded = 0
+
+    def set_findings(self, findings: list[Finding]) -> None:
+        self.beginResetModel()
+        self._findings = findings
+        self._loaded = min(len(findings), self.BATCH)
+        self.endResetModel()
+
+    def clear(self) -> None:
+        self.set_findings([])
+
+    def finding(self, row: int) -> Finding | None:
+        return self._findings[row] if 0 <= row < len(self._findings) else None
+
+    def fetch_all(self) -> None:
+        # 排序 / 筛选要看到全部行；代理只对已加载的行生效
+        if self._loaded < len(self._findings):
+            self.beginInsertRows(QtCore.QModelIndex(), self._loaded, len(self._findings) - 1)
+            self._loaded = len(self._findings)
+            self.endInsertRows()
+
+    def rowCount(self, parent=QtCore.QModelIndex()) -> int:
+        return 0 if parent.isValid() else self._loaded
+
+    def columnCount(self, parent=QtCore.QModelIndex()) -> int:
+        return 0 if parent.isValid() else len(self.HEADERS)
+
+    def canFetchMore(self, parent=QtCore.QModelIndex()) -> bool:
+        return not parent.isValid() and self._loaded < len(self._findings)
+
+    def fetchMore(self, parent=QtCore.QModelIndex()) -> None:
+        if parent.isValid():
+            return
+        end = min(len(self._findings), self._loaded + self.BATCH)
+        if end <= self._loaded:
+            return
+        self.beginInsertRows(QtCore.QModelIndex(), self._loaded, end - 1)
+        self._loaded = end
+        self.endInsertRows()
+
+    def headerData(self, section, orientation, role=QtCore.Qt.ItemDataRole.DisplayRole):
+        if role == QtCore.Qt.ItemDataRole.DisplayRole and orientation == QtCore.Qt.Orientation.Horizontal:
+            return self.HEADERS[section]
+        return None
+
+    def data(self, index, role=QtCore.Qt.ItemDataRole.DisplayRole):
+        if not index.isValid():
+            return None
+        f = self._findings[index.row()]
+        col = index.column()
+        if role in (QtCore.Qt.ItemDataRole.DisplayRole, QtCore.Qt.ItemDataRole.ToolTipRole):
+            if col == 0:
+                return f.category
+            if col == 1:
+                return f.severity
+            if col == 2:
+                return f.title
+            return f"{f.file}:{f.line}" if f.file and f.line else (f.file or "")
+        if role == QtCore.Qt.ItemDataRole.UserRole:
+            # 排序键：级别按严重程度，而不是字母序
+            return self.SEVERITY_RANK.get(f.severity, 9) if col == 1 else (f.file or "", f.line or 0) if col == 3 else None
+        return None
+
+
+class FindingsFilterProxy(QtCore.QSortFilterProxyModel):
+    """Severity + free-text filter and severity-aware sorting over FindingsModel."""
+
+    def __init__(self, parent=None):
+        super().__init__(parent)
+        self._severity = ""
+        self._text = ""
+
+    def set_severity(self, severity: str) -> None:
+        self._severity = severity
+        self.invalidateFilter()
+
+    def set_text(self, text: str) -> None:
+        self._text = text.strip().lower()
+        self.invalidateFilter()
+
+    def filterAcceptsRow(self, source_row, source_parent) -> bool:
+        f = self.sourceModel().finding(source_row)
+        if f is None:
+            return False
+        if self._severity and f.severity != self._severity:
+            return False
+        if self._text:
+            hay = f"{f.category}\n{f.title}\n{f.file or ''}".lower()
+            return self._text in hay
+        return True
+
+    def lessThan(self, left, right) -> bool:
+        lk = left.data(QtCore.Qt.ItemDataRole.UserRole)
+        rk = right.data(QtCore.Qt.ItemDataRole.UserRole)
+        if lk is not None and rk is not None:
+            return lk < rk
+        return str(left.data() or "") < str(right.data() or "")
+
+
+class ExportWorker(QtCore.QObject):
+    """Writes the HTML / JSON reports off the GUI thread."""
+
+    finished = QtCore.Signal(object, object)  # (paths, err)
+
+    def __init__(self, run: TestRun, out_dir: Path, *, db_path: Path | None = None, run_id: int | None = None):
+        super().__init__()
+        self.run_ = run
+        self.out_dir = out_dir
+        self.db_path = db_path
+        self.run_id = run_id
+
+    @QtCore.Slot()
+    def run(self):
+        try:
+            ts = self.run_.created_at.strftime("%Y%m%d_%H%M%S")
+            html_path = self.out_dir / f"qt_test_report_{ts}.html"
+            json_path = self.out_dir / f"qt_test_report_{ts}.json"
+            if self.run_id is not None and self.db_path is not None:
+                # 历史记录只加载了表头：在本线程另开连接，逐条解码 details 边读边写
+                conn = dbmod.open_db(self.db_path)
+                try:
+                    write_html(self.run_, html_path, findings=dbmod.iter_findings(conn, self.run_id))
+                    write_json(self.run_, json_path, findings=dbmod.iter_findings(conn, self.run_id))
+                finally:
+                    conn.close()
+            else:
+                write_html(self.run_, html_path)
+                write_json(self.run_, json_path)
+            self.finished.emit([html_path, json_path], None)
+        except Exception as e:
+            self.finished.emit(None, e)
+
+
 class MainWindow(QtWidgets.QMainWindow):
     def __init__(self) -> None:
         super().__init__()
         self.setWindowTitle("Qt 项目测试智能化工具")
         self.resize(1100, 760)
 
-        self._db_path = Path.home() / ".qt_test_ai" / "runs.sqlite3"
+        self._db_path = dbmod.DEFAULT_DB_PATH
         self._conn = dbmod.open_db(self._db_path)
 
         # UI
@@ -448,14 +739,25 @@ class MainWindow(QtWidgets.QMainWindow):
         self.log = QtWidgets.QPlainTextEdit()
         self.log.setReadOnly(True)
 
-        self.table = QtWidgets.QTableWidget(0, 4)
-        self.table.setHorizontalHeaderLabels(["类别", "级别", "标题", "文件"])
+        self.findings_model = FindingsModel(self)
+        self.findings_proxy = FindingsFilterProxy(self)
+        self.findings_proxy.setSourceModel(self.findings_model)
+        self.table = QtWidgets.QTableView()
+        self.table.setModel(self.findings_proxy)
         self.table.horizontalHeader().setStretchLastSection(True)
         self.table.verticalHeader().setVisible(False)
         self.table.setAlternatingRowColors(True)
         self.table.setSelectionBehavior(QtWidgets.QAbstractItemView.SelectionBehavior.SelectRows)
         self.table.setEditTriggers(QtWidgets.QAbstractItemView.EditTrigger.NoEditTriggers)
-        self.table.cellDoubleClicked.connect(self._show_selected_finding_details)
+        self.table.doubleClicked.connect(lambda _idx: self._show_selected_finding_details())
+        self.table.horizontalHeader().sortIndicatorChanged.connect(lambda *_: self.findings_model.fetch_all())
+        self.findings_filter = QtWidgets.QLineEdit()
+        self.findings_filter.setPlaceholderText("筛选发现项（类别 / 标题 / 文件）")
+        self.findings_filter.textChanged.connect(self._apply_findings_filter)
+        self.findings_severity = QtWidgets.QComboBox()
+        for label, sev in (("全部级别", ""), ("error", "error"), ("warning", "warning"), ("info", "info")):
+            self.findings_severity.addItem(label, sev)
+        self.findings_severity.currentIndexChanged.connect(lambda _i: self._apply_findings_filter())
 
         self.automation_btn = QtWidgets.QPushButton("运行自动化：生成测试/执行/覆盖率")
         self.automation_btn.setProperty("kind", "secondary")
@@ -504,9 +806,22 @@ class MainWindow(QtWidgets.QMainWindow):
         self.refresh_history_btn = QtWidgets.QPushButton("刷新历史")
         self.load_history_btn = QtWidgets.QPushButton("加载选中记录")
         self.delete_history_btn = QtWidgets.QPushButton("删除选中记录")
+        self.more_history_btn = QtWidgets.QPushButton("加载更早记录")
+        self.more_history_btn.setProperty("kind", "secondary")
         self.refresh_history_btn.setProperty("kind", "secondary")
         self.load_history_btn.setProperty("kind", "secondary")
         self.delete_history_btn.setProperty("kind", "secondary")
+        # 趋势视图：只查询规范化指标表，不解码历史 JSON
+        self.trend_metric = QtWidgets.QComboBox()
+        for key, (_sql, label, _worse) in dbmod.TREND_METRICS.items():
+            self.trend_metric.addItem(label, key)
+        self.trend_table = QtWidgets.QTableWidget(0, 3)
+        self.trend_table.setHorizontalHeaderLabels(["时间", "值", "变化"])
+        self.trend_table.horizontalHeader().setStretchLastSection(True)
+        self.trend_table.verticalHeader().setVisible(False)
+        self.trend_table.setEditTriggers(QtWidgets.QAbstractItemView.EditTrigger.NoEditTriggers)
+        self.trend_label = QtWidgets.QLabel("")
+        self.trend_label.setWordWrap(True)
 
         # --- Layout (with groups) ---
         header = QtWidgets.QLabel("Qt 项目测试智能化工具")
@@ -754,6 +1069,10 @@ class MainWindow(QtWidgets.QMainWindow):
         
         self.summary_widget = SummaryWidget()
         lfi.addWidget(self.summary_widget)
+        ffl = QtWidgets.QHBoxLayout()
+        ffl.addWidget(self.findings_filter, 1)
+        ffl.addWidget(self.findings_severity)
+        lfi.addLayout(ffl)
         lfi.addWidget(self.table)
         lfi.addWidget(self.llm_summary_btn, 0, QtCore.Qt.AlignmentFlag.AlignLeft)
 
@@ -849,9 +1168,14 @@ class MainWindow(QtWidgets.QMainWindow):
         rg.setContentsMargins(12, 14, 12, 12)
         rg.setSpacing(8)
         rg.addWidget(self.history, 1)
+        rg.addWidget(self.more_history_btn)
         rg.addWidget(self.refresh_history_btn)
         rg.addWidget(self.load_history_btn)
         rg.addWidget(self.delete_history_btn)
+        rg.addWidget(QtWidgets.QLabel("指标趋势（当前项目）"))
+        rg.addWidget(self.trend_metric)
+        rg.addWidget(self.trend_table, 1)
+        rg.addWidget(self.trend_label)
 
         right_widget = QtWidgets.QWidget()
         right = QtWidgets.QVBoxLayout(right_widget)
@@ -872,6 +1196,9 @@ class MainWindow(QtWidgets.QMainWindow):
 
         # state
         self._last_run: TestRun | None = None
+        # 从历史加载的记录只解码发现项表头；非 None 时 details 按需从数据库读取
+        self._last_run_db_id: int | None = None
+        self._history_cursor: int | None = None
 
         # signals
         self.project_btn.clicked.connect(self._pick_project)
@@ -884,8 +1211,10 @@ class MainWindow(QtWidgets.QMainWindow):
         self.functional_add_btn.clicked.connect(self._add_functional_row)
         self.functional_del_btn.clicked.connect(lambda: self._delete_selected_rows(self.functional_table))
         self.refresh_history_btn.clicked.connect(self._refresh_history)
+        self.more_history_btn.clicked.connect(self._load_more_history)
         self.load_history_btn.clicked.connect(self._load_selected_history)
         self.delete_history_btn.clicked.connect(self._delete_selected_history)
+        self.trend_metric.currentIndexChanged.connect(lambda _i: self._refresh_trend())
 
         self._refresh_history()
         self._log(f"数据库：{self._db_path}")
@@ -939,10 +1268,15 @@ class MainWindow(QtWidgets.QMainWindow):
     def _show_selected_finding_details(self) -> None:
         if not self._last_run:
             return
-        row = self.table.currentRow()
+        idx = self.table.currentIndex()
+        if not idx.isValid():
+            return
+        row = self.findings_proxy.mapToSource(idx).row()
         if row < 0 or row >= len(self._last_run.findings):
             return
         f = self._last_run.findings[row]
+        if self._last_run_db_id is not None and not f.details and not f.evidence:
+            f.details, f.evidence = dbmod.load_finding_details(self._conn, self._last_run_db_id, row)
         details = (f.details or "").strip()
         if not details:
             details = "（无详细输出）"
@@ -974,15 +1308,21 @@ class MainWindow(QtWidgets.QMainWindow):
         self.setFont(font)
 
         for t in (self.functional_table, self.table):
-            t.setSortingEnabled(False)
+            t.setSortingEnabled(t is self.table)
             t.setWordWrap(True)
             t.setCornerButtonEnabled(False)
             t.horizontalHeader().setHighlightSections(False)
             t.horizontalHeader().setDefaultAlignment(QtCore.Qt.AlignmentFlag.AlignLeft | QtCore.Qt.AlignmentFlag.AlignVCenter)
             # t.verticalHeader().setDefaultSectionSize(36) 
             # Fix: Auto-resize rows to fit wrapped text so it doesn't get cut off
-            t.verticalHeader().setSectionResizeMode(QtWidgets.QHeaderView.ResizeMode.ResizeToContents)
-            t.setTextElideMode(QtCore.Qt.TextElideMode.ElideNone)
+            if t is self.table:
+                # 发现项表按需取行：ResizeToContents 会逐行测量全部行，抵消虚拟化
+                t.setWordWrap(False)
+                t.verticalHeader().setSectionResizeMode(QtWidgets.QHeaderView.ResizeMode.Fixed)
+                t.setTextElideMode(QtCore.Qt.TextElideMode.ElideRight)
+            else:
+                t.verticalHeader().setSectionResizeMode(QtWidgets.QHeaderView.ResizeMode.ResizeToContents)
+                t.setTextElideMode(QtCore.Qt.TextElideMode.ElideNone)
             t.horizontalHeader().setSectionResizeMode(QtWidgets.QHeaderView.ResizeMode.Stretch)
             # Revert manual font sizing for table content to keep it standard
             
@@ -1179,7 +1519,7 @@ class MainWindow(QtWidgets.QMainWindow):
             # 创建工作线程
             self.run_btn.setEnabled(False)
             self.export_btn.setEnabled(False)
-            self.table.setRowCount(0)
+            self.findings_model.clear()
             self._log("开始单文件测试…")
 
             self._thread = QtCore.QThread(self)
@@ -1407,7 +1747,7 @@ class MainWindow(QtWidgets.QMainWindow):
 
         self.run_btn.setEnabled(False)
         self.export_btn.setEnabled(False)
-        self.table.setRowCount(0)
+        self.findings_model.clear()
         self._log("开始运行…")
         functional_entries = self._collect_functional_entries()
 
@@ -1431,6 +1771,7 @@ class MainWindow(QtWidgets.QMainWindow):
 
     def _on_finished(self, run: TestRun) -> None:
         self._last_run = run
+        self._last_run_db_id = None
         rid = dbmod.save_run(self._conn, run)
         self._log(f"完成：已保存记录 id={rid}")
         self._render_findings(run)
@@ -1452,6 +1793,51 @@ class MainWindow(QtWidgets.QMainWindow):
             os.environ.pop("QT_TEST_AI_SINGLE_FILE_PATH", None)
             os.environ.pop("QT_TEST_AI_ENABLE_AUTOMATION", None)
 
+    def _auto_tests_and_coverage(self) -> None:
+        """
+        QT_TEST_AI_AUTO_COVERAGE=1: run the tests and the coverage pipeline after an LLM action.
+
+        Traced like a Worker run / main.py command, so the build, test and gcovr
+        spans of this pipeline land in reports/traces too.
+        """
+        try:
+            if os.getenv("QT_TEST_AI_AUTO_COVERAGE", "0") != "1":
+                return
+            from .test_automation import run_test_command, run_full_coverage_pipeline, save_stage_report
+            project = self.project_edit.text().strip()
+            if not project:
+                self._log("自动覆盖率: 未配置项目路径，跳过")
+                return
+            pr = Path(project)
+            self._log("自动运行测试并收集覆盖率（QT_TEST_AI_AUTO_COVERAGE=1）...")
+            trace_id = tracing.begin()
+            try:
+                with tracing.span("tests", tracing.STAGE):
+                    try:
+                        t_findings, t_meta = run_test_command(pr)
+                        save_stage_report(project_root=pr, stage="tests", findings=t_findings, meta=t_meta)
+                        self._log("测试执行完成，已保存 tests 报告。")
+                    except Exception as e:
+                        self._log(f"自动运行测试失败: {e}")
+
+                with tracing.span("coverage", tracing.STAGE):
+                    try:
+                        c_findings, c_meta = run_full_coverage_pipeline(pr, top_level_only=True)
+                        # run_full_coverage_pipeline already saves stage report, but save again to ensure visibility
+                        save_stage_report(project_root=pr, stage="coverage", findings=c_findings, meta=c_meta)
+                        self._log("覆盖率收集完成，已保存 coverage 报告。")
+                    except Exception as e:
+                        self._log(f"自动收集覆盖率失败: {e}")
+            finally:
+                trace_dir = Path(__file__).resolve().parents[2] / "reports" / "traces"
+                t = tracing.finish(trace_id, trace_dir, label=f"auto_coverage_{datetime.now():%Y%m%d_%H%M%S}")
+                for name, st in (t.get("stages") or {}).items():
+                    self._log(f"⏱ {name}: {st['wall_s']}s")
+                if (t.get("export") or {}).get("chrome"):
+                    self._log(f"trace: {t['export']['chrome']}")
+        except Exception:
+            pass
+
     def _llm_run_async(self, *, title: str, messages: list[dict], on_ok) -> None:
         if self._llm_cfg is None:
             QtWidgets.QMessageBox.information(self, "LLM 未配置", "请先设置环境变量后再使用 LLM 功能。")
@@ -1475,7 +1861,7 @@ class MainWindow(QtWidgets.QMainWindow):
                         self.progress.emit("calling LLM")
                     except Exception:
                         pass
-                    text = chat_completion_text(self.cfg, messages=messages)
+                    text = chat_completion_text(self.cfg, messages=messages, on_progress=self.progress.emit)
                     try:
                         self.progress.emit("llm returned")
                     except Exception:
@@ -1711,30 +2097,7 @@ class MainWindow(QtWidgets.QMainWindow):
                 self._log(f"⚠️ 自动保存功能用例失败：{e}")
 
             # 自动运行测试和覆盖率（受 QT_TEST_AI_AUTO_COVERAGE 控制）
-            try:
-                if os.getenv("QT_TEST_AI_AUTO_COVERAGE", "0") == "1":
-                    from .test_automation import run_test_command, run_full_coverage_pipeline, save_stage_report
-                    project = self.project_edit.text().strip()
-                    if project:
-                        pr = Path(project)
-                        self._log("自动运行测试并收集覆盖率（QT_TEST_AI_AUTO_COVERAGE=1）...")
-                        try:
-                            t_findings, t_meta = run_test_command(pr)
-                            save_stage_report(project_root=pr, stage="tests", findings=t_findings, meta=t_meta)
-                            self._log("测试执行完成，已保存 tests 报告。")
-                        except Exception as e:
-                            self._log(f"自动运行测试失败: {e}")
-
-                        try:
-                            c_findings, c_meta = run_full_coverage_pipeline(pr, top_level_only=True)
-                            save_stage_report(project_root=pr, stage="coverage", findings=c_findings, meta=c_meta)
-                            self._log("覆盖率收集完成，已保存 coverage 报告。")
-                        except Exception as e:
-                            self._log(f"自动收集覆盖率失败: {e}")
-                    else:
-                        self._log("自动覆盖率: 未配置项目路径，跳过")
-            except Exception:
-                pass
+            self._auto_tests_and_coverage()
 
         self._llm_run_async(title="LLM 生成功能用例", messages=messages, on_ok=on_ok)
 
@@ -1901,39 +2264,14 @@ class MainWindow(QtWidgets.QMainWindow):
                     pass
 
             # If enabled, automatically run tests and coverage after import
-            try:
-                if os.getenv("QT_TEST_AI_AUTO_COVERAGE", "0") == "1":
-                    from .test_automation import run_test_command, run_full_coverage_pipeline, save_stage_report
-                    project = self.project_edit.text().strip()
-                    if project:
-                        pr = Path(project)
-                        self._log("自动运行测试并收集覆盖率（QT_TEST_AI_AUTO_COVERAGE=1）...")
-                        # run tests (if configured)
-                        try:
-                            t_findings, t_meta = run_test_command(pr)
-                            # save test stage
-                            save_stage_report(project_root=pr, stage="tests", findings=t_findings, meta=t_meta)
-                            self._log("测试执行完成，已保存 tests 报告。")
-                        except Exception as e:
-                            self._log(f"自动运行测试失败: {e}")
-
-                        try:
-                            c_findings, c_meta = run_full_coverage_pipeline(pr, top_level_only=True)
-                            # run_full_coverage_pipeline already saves stage report, but save again to ensure visibility
-                            save_stage_report(project_root=pr, stage="coverage", findings=c_findings, meta=c_meta)
-                            self._log("覆盖率收集完成，已保存 coverage 报告。")
-                        except Exception as e:
-                            self._log(f"自动收集覆盖率失败: {e}")
-                    else:
-                        self._log("自动覆盖率: 未配置项目路径，跳过")
-            except Exception:
-                pass
+            self._auto_tests_and_coverage()
 
         self._llm_run_async(title="从 QTest 代码导入", messages=messages, on_ok=on_ok)
 
     def _llm_summarize_last_run(self) -> None:
         if not self._last_run:
             return
+        self._ensure_run_details()
 
         run = self._last_run
         if run.meta is None:
@@ -1985,26 +2323,22 @@ class MainWindow(QtWidgets.QMainWindow):
 
         self._llm_run_async(title="LLM 生成测试总结", messages=messages, on_ok=on_ok)
 
+    def _apply_findings_filter(self, _text: str = "") -> None:
+        text = self.findings_filter.text()
+        sev = self.findings_severity.currentData() or ""
+        if text.strip() or sev:
+            self.findings_model.fetch_all()
+        self.findings_proxy.set_text(text)
+        self.findings_proxy.set_severity(sev)
+
     def _render_findings(self, run: TestRun) -> None:
-        self.table.setRowCount(0)
-        
+        self.findings_model.set_findings(run.findings)
+        self._apply_findings_filter()
+
         # Stats for dashboard
         total = len(run.findings)
-        err = 0
-        warn = 0
-        
-        for f in run.findings:
-            r = self.table.rowCount()
-            self.table.insertRow(r)
-            self.table.setItem(r, 0, QtWidgets.QTableWidgetItem(f.category))
-            self.table.setItem(r, 1, QtWidgets.QTableWidgetItem(f.severity))
-            self.table.setItem(r, 2, QtWidgets.QTableWidgetItem(f.title))
-            self.table.setItem(r, 3, QtWidgets.QTableWidgetItem(f.file or ""))
-            
-            if f.severity == "error":
-                err += 1
-            elif f.severity == "warning":
-                warn += 1
+        err = sum(1 for f in run.findings if f.severity == "error")
+        warn = sum(1 for f in run.findings if f.severity == "warning")
         
         # Calculate functional pass rate (if functional tests exist)
         pass_rate = "N/A"
@@ -2017,25 +2351,102 @@ class MainWindow(QtWidgets.QMainWindow):
         
         self.summary_widget.update_stats(total, err, warn, pass_rate)
 
+    def _ensure_run_details(self) -> None:
+        """Decode all finding details of a lazily loaded history run (export / LLM summary need them)."""
+        if self._last_run is None or self._last_run_db_id is None:
+            return
+        full = dbmod.load_run(self._conn, self._last_run_db_id)
+        self._last_run.findings = full.findings
+        self._last_run_db_id = None
+
     def _export(self) -> None:
         if not self._last_run:
             return
         out_dir = QtWidgets.QFileDialog.getExistingDirectory(self, "选择导出目录")
         if not out_dir:
             return
-        out = Path(out_dir)
-        ts = self._last_run.created_at.strftime("%Y%m%d_%H%M%S")
-        html_path = out / f"qt_test_report_{ts}.html"
-        json_path = out / f"qt_test_report_{ts}.json"
-        write_html(self._last_run, html_path)
-        write_json(self._last_run, json_path)
-        self._log(f"已导出：{html_path}")
-        self._log(f"已导出：{json_path}")
+        self.export_btn.setEnabled(False)
+        self._log("正在导出报告…")
+        self._export_thread = QtCore.QThread(self)
+        self._export_worker = ExportWorker(self._last_run, Path(out_dir), db_path=self._db_path, run_id=self._last_run_db_id)
+        self._export_worker.moveToThread(self._export_thread)
+        self._export_thread.started.connect(self._export_worker.run)
+        self._export_worker.finished.connect(self._on_export_finished)
+        self._export_worker.finished.connect(self._export_thread.quit)
+        self._export_worker.finished.connect(self._export_worker.deleteLater)
+        self._export_thread.finished.connect(self._export_thread.deleteLater)
+        self._export_thread.start()
+
+    def _on_export_finished(self, paths, err) -> None:
+        self.export_btn.setEnabled(True)
+        if err is not None:
+            self._log(f"导出失败：{err}")
+            return
+        for p in paths:
+            self._log(f"已导出：{p}")
 
     def _refresh_history(self) -> None:
         self.history.clear()
-        for rid, created_at, project_root, exe_path in dbmod.list_runs(self._conn, limit=50):
-            self.history.addItem(f"#{rid} {created_at.strftime('%Y-%m-%d %H:%M:%S')} | {project_root} | {exe_path or ''}")
+        self._history_cursor = None
+        self._load_more_history()
+        self._refresh_trend()
+
+    def _load_more_history(self) -> None:
+        page = dbmod.list_run_summaries(self._conn, limit=HISTORY_PAGE_SIZE, before_id=self._history_cursor)
+        if page:
+            self._history_cursor = page[-1]["id"]
+        self.more_history_btn.setEnabled(len(page) == HISTORY_PAGE_SIZE)
+        for r in page:
+            extra = f" | E{r['errors']} W{r['warnings']}"
+            if r["line_coverage"] is not None:
+                extra += f" | 覆盖 {r['line_coverage']:.1f}%"
+            if r["startup_ms"] is not None:
+                extra += f" | 启动 {r['startup_ms']:.0f}ms"
+            self.history.addItem(f"#{r['id']} {r['created_at'].strftime('%Y-%m-%d %H:%M:%S')} | {r['project_root']} | {r['exe_path'] or ''}{extra}")
+
+    def _trend_project(self) -> str | None:
+        roots = dbmod.project_roots(self._conn)
+        text = self.project_edit.text().strip()
+        if text:
+            try:
+                want = str(Path(text).resolve())
+            except Exception:
+                want = text
+            for r in roots:
+                if r == text or r == want:
+                    return r
+        return roots[0] if roots else None
+
+    def _refresh_trend(self) -> None:
+        self.trend_table.setRowCount(0)
+        self.trend_label.setText("")
+        project = self._trend_project()
+        key = self.trend_metric.currentData()
+        if not project or not key:
+            return
+        _sql, label, worse = dbmod.TREND_METRICS[key]
+        series = dbmod.trend(self._conn, project, key, limit=50)
+        prev = None
+        for _rid, at, v in reversed(series):
+            row = self.trend_table.rowCount()
+            self.trend_table.insertRow(row)
+            self.trend_table.setItem(row, 0, QtWidgets.QTableWidgetItem(at.strftime("%m-%d %H:%M")))
+            self.trend_table.setItem(row, 1, QtWidgets.QTableWidgetItem(f"{v:g}"))
+            self.trend_table.setItem(row, 2, QtWidgets.QTableWidgetItem(""))
+            if prev is not None and row > 0:
+                # 最新在上：上一行的变化 = 上一行值 - 本行值
+                self.trend_table.item(row - 1, 2).setText(f"{prev - v:+g}")
+            prev = v
+        notes = []
+        regs = dbmod.regressions(series, higher_is_worse=worse)
+        if regs:
+            last = regs[-1]
+            notes.append(f"{label} 回归 {len(regs)} 次；最近 {last['created_at'].strftime('%m-%d %H:%M')}：{last['value']:g}（基线 {last['baseline']:g}，{last['change_pct']:+.1f}%）")
+        if key == "line_coverage":
+            drops = dbmod.coverage_drops(self._conn, project)
+            if drops:
+                notes.append("覆盖率下降：" + "；".join(f"{Path(d['file']).name} {d['previous']}→{d['current']}%" for d in drops[:5]))
+        self.trend_label.setText("\n".join(notes))
 
     def _load_selected_history(self) -> None:
         item = self.history.currentItem()
@@ -2045,8 +2456,9 @@ class MainWindow(QtWidgets.QMainWindow):
         if not m.startswith("#"):
             return
         rid = int(m[1:])
-        run = dbmod.load_run(self._conn, rid)
+        run = dbmod.load_run(self._conn, rid, details=False)
         self._last_run = run
+        self._last_run_db_id = rid
         self._render_findings(run)
         self._restore_functional_from_run(run)
         self.export_btn.setEnabled(True)
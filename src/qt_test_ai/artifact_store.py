@@ -0,0 +1,262 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import threading
+import time
+from datetime import datetime
+from pathlib import Path
+from typing import Any
+
+# <tool_root>/reports/artifacts/
+#   objects/<sha[:2]>/<sha>                        内容寻址的文件本体，每种内容只存一份
+#   manifests/<namespace>/<run>.json               每次运行的清单：相对路径 -> sha / size，及与上一次的差异
+_OBJECTS = "objects"
+_MANIFESTS = "manifests"
+
+# 同一进程内并行阶段会同时往同一个运行清单里追加文件
+_lock = threading.Lock()
+# 刚写入 / 刚复用的对象可能还没进清单，gc 不动这段时间内的对象
+_GRACE_S = 3600.0
+_last_gc = 0.0
+
+
+def _tool_root() -> Path:
+    return Path(__file__).resolve().parents[2]
+
+
+def enabled() -> bool:
+    """Store reports by content hash (QT_TEST_AI_ARTIFACT_STORE, default on); off = the old timestamped copies."""
+    return (os.getenv("QT_TEST_AI_ARTIFACT_STORE") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def keep_runs() -> int:
+    """Newest runs kept per namespace by gc() (QT_TEST_AI_ARTIFACT_KEEP_RUNS, default 30)."""
+    try:
+        return max(1, int(os.getenv("QT_TEST_AI_ARTIFACT_KEEP_RUNS") or 30))
+    except ValueError:
+        return 30
+
+
+def keep_days() -> float:
+    """Runs younger than this are never collected (QT_TEST_AI_ARTIFACT_KEEP_DAYS, default 14; 0 = count only)."""
+    try:
+        return max(0.0, float(os.getenv("QT_TEST_AI_ARTIFACT_KEEP_DAYS") or 14))
+    except ValueError:
+        return 14.0
+
+
+def _sha256(data: bytes) -> str:
+    return hashlib.sha256(data).hexdigest()
+
+
+def _atomic_write(path: Path, data: bytes) -> None:
+    path.parent.mkdir(parents=True, exist_ok=True)
+    tmp = path.with_name(f".{path.name}.{os.getpid()}.{threading.get_ident()}.tmp")
+    tmp.write_bytes(data)
+    os.replace(tmp, path)
+
+
+def diff(old: dict[str, Any] | None, new: dict[str, Any]) -> dict[str, Any]:
+    """Compare two manifests' file maps: added / changed / removed paths and the unchanged count."""
+    a = (old or {}).get("files") or {}
+    b = new.get("files") or {}
+    return {
+        "added": sorted(k for k in b if k not in a),
+        "changed": sorted(k for k in b if k in a and a[k]["sha256"] != b[k]["sha256"]),
+        "removed": sorted(k for k in a if k not in b),
+        "unchanged": sum(1 for k in b if k in a and a[k]["sha256"] == b[k]["sha256"]),
+    }
+
+
+class ArtifactStore:
+    """
+    Content-addressed, deduplicated storage for per-run report artifacts.
+
+    A run is a manifest mapping relative paths to blob hashes; writing a run
+    only touches blobs whose content is new, so a re-run that regenerates the
+    same tests costs one small manifest instead of another full copy.
+    """
+
+    def __init__(self, root: Path | None = None) -> None:
+        self.root = Path(root) if root else _tool_root() / "reports" / "artifacts"
+
+    # ----------------------------
+    # blobs
+    # ----------------------------
+    def object_path(self, digest: str) -> Path:
+        return self.root / _OBJECTS / digest[:2] / digest
+
+    def put_bytes(self, data: bytes) -> tuple[str, bool]:
+        """Store `data`; returns (sha256, written) where written=False means it was already there."""
+        digest = _sha256(data)
+        p = self.object_path(digest)
+        if p.exists():
+            try:
+                os.utime(p)
+            except OSError:
+                pass
+            return digest, False
+        _atomic_write(p, data)
+        return digest, True
+
+    def get_bytes(self, digest: str) -> bytes:
+        return self.object_path(digest).read_bytes()
+
+    # ----------------------------
+    # manifests
+    # ----------------------------
+    def _ns_dir(self, namespace: str) -> Path:
+        return self.root / _MANIFESTS / namespace
+
+    def manifest_path(self, namespace: str, run: str) -> Path:
+        return self._ns_dir(namespace) / f"{run}.json"
+
+    def runs(self, namespace: str) -> list[str]:
+        """Run ids of a namespace, oldest first (run ids are timestamps, so name order is time order)."""
+        d = self._ns_dir(namespace)
+        return sorted(p.stem for p in d.glob("*.json")) if d.is_dir() else []
+
+    def namespaces(self) -> list[str]:
+        base = self.root / _MANIFESTS
+        if not base.is_dir():
+            return []
+        return sorted({p.parent.relative_to(base).as_posix() for p in base.rglob("*.json")})
+
+    def load(self, namespace: str, run: str) -> dict[str, Any] | None:
+        try:
+            return json.loads(self.manifest_path(namespace, run).read_text(encoding="utf-8"))
+        except Exception:
+            return None
+
+    def previous(self, namespace: str, run: str) -> dict[str, Any] | None:
+        older = [r for r in self.runs(namespace) if r < run]
+        return self.load(namespace, older[-1]) if older else None
+
+    def commit(self, namespace: str, run: str, files: dict[str, bytes | str | Path]) -> dict[str, Any]:
+        """
+        Add `files` (relative path -> bytes / text / source file) to the manifest of `run`.
+
+        Several stages of one run commit into the same manifest. The stored
+        manifest carries its diff against the previous run of the namespace
+        and how many bytes this run actually added to the store.
+        """
+        entries: dict[str, dict[str, Any]] = {}
+        written = 0
+        for rel, src in files.items():
+            if isinstance(src, Path):
+                try:
+                    data = src.read_bytes()
+                except OSError:
+                    continue
+            elif isinstance(src, str):
+                data = src.encode("utf-8")
+            else:
+                data = src
+            digest, new = self.put_bytes(data)
+            written += len(data) if new else 0
+            entries[rel.replace("\\", "/")] = {"sha256": digest, "size": len(data)}
+
+        with _lock:
+            man = self.load(namespace, run) or {
+                "namespace": namespace,
+                "run": run,
+                "created_at": datetime.now().isoformat(timespec="seconds"),
+                "files": {},
+                "bytes_written": 0,
+            }
+            man["files"].update(entries)
+            man["bytes_written"] = int(man.get("bytes_written") or 0) + written
+            prev = self.previous(namespace, run)
+            man["previous"] = prev.get("run") if prev else None
+            d = diff(prev, man)
+            man["diff"] = d
+            _atomic_write(self.manifest_path(namespace, run), json.dumps(man, ensure_ascii=False, indent=2).encode("utf-8"))
+        return man
+
+    def materialize(self, namespace: str, run: str, dest: Path) -> list[Path]:
+        """Write a run's files back out as a normal directory tree (e.g. to inspect an old run)."""
+        man = self.load(namespace, run)
+        if man is None:
+            raise KeyError(f"{namespace}/{run}")
+        out: list[Path] = []
+        for rel, ent in man["files"].items():
+            p = Path(dest) / rel
+            p.parent.mkdir(parents=True, exist_ok=True)
+            p.write_bytes(self.get_bytes(ent["sha256"]))
+            out.append(p)
+        return out
+
+    # ----------------------------
+    # retention
+    # ----------------------------
+    def gc(self, *, runs: int | None = None, days: float | None = None) -> dict[str, Any]:
+        """
+        Apply the retention policy, then delete blobs no remaining manifest references.
+
+        Per namespace the newest `runs` manifests are kept; older ones go
+        unless they are younger than `days`.
+        """
+        runs = keep_runs() if runs is None else runs
+        days = keep_days() if days is None else days
+        cutoff = time.time() - days * 86400.0
+        removed_runs = 0
+        with _lock:
+            live: set[str] = set()
+            for ns in self.namespaces():
+                names = self.runs(ns)
+                for i, name in enumerate(names):
+                    p = self.manifest_path(ns, name)
+                    if i < len(names) - runs and p.stat().st_mtime < cutoff:
+                        p.unlink(missing_ok=True)
+                        removed_runs += 1
+                        continue
+                    man = self.load(ns, name) or {}
+                    live.update(e["sha256"] for e in (man.get("files") or {}).values())
+            removed_objects = 0
+            freed = 0
+            obj_root = self.root / _OBJECTS
+            if obj_root.is_dir():
+                for p in obj_root.glob("*/*"):
+                    if p.name.startswith("."):
+                        # 其他线程正在写的临时文件
+                        continue
+                    if p.name not in live and p.stat().st_mtime < time.time() - _GRACE_S:
+                        freed += p.stat().st_size
+                        p.unlink(missing_ok=True)
+                        removed_objects += 1
+        return {"removed_runs": removed_runs, "removed_objects": removed_objects, "freed_bytes": freed}
+
+    def usage(self) -> dict[str, Any]:
+        """Stored bytes vs. what the same runs would take as plain per-run copies."""
+        stored = sum(p.stat().st_size for p in (self.root / _OBJECTS).glob("*/*")) if (self.root / _OBJECTS).is_dir() else 0
+        logical = 0
+        per_ns: dict[str, int] = {}
+        for ns in self.namespaces():
+            names = self.runs(ns)
+            per_ns[ns] = len(names)
+            for name in names:
+                logical += sum(e["size"] for e in ((self.load(ns, name) or {}).get("files") or {}).values())
+        return {"stored_bytes": stored, "logical_bytes": logical, "runs": per_ns}
+
+
+def maybe_gc(store: ArtifactStore) -> dict[str, Any] | None:
+    """gc() at most once per hour per process, so every run applies the retention policy without rescanning each stage."""
+    global _last_gc
+    now = time.time()
+    if now - _last_gc < _GRACE_S:
+        return None
+    _last_gc = now
+    try:
+        return store.gc()
+    except Exception:
+        return None
+
+
+def describe(man: dict[str, Any]) -> str:
+    d = man.get("diff") or {}
+    return (
+        f"{man.get('namespace')}/{man.get('run')}: +{len(d.get('added') or [])} ~{len(d.get('changed') or [])} "
+        f"-{len(d.get('removed') or [])} ={d.get('unchanged', 0)}，新写入 {man.get('bytes_written', 0)} 字节"
+    )
@@ -0,0 +1,475 @@
+from __future__ import annotations
+
+import math
+import os
+import shutil
+import subprocess
+import time
+from datetime import datetime
+from pathlib import Path
+from typing import Any
+
+from . import coverage_build, project_lib, qtest_results, workload
+from .models import Finding
+
+BENCH_DIR = "benchmarks"
+BENCH_TARGET = "qt_test_ai_bench"
+SUITE_FILE = "bench_diagramscene.cpp"
+HISTORY_FILE = "bench_results.json"
+DEFAULT_SIZES = (1000, 10000)
+BACKENDS = {"tickcounter", "callgrind", "walltime", "eventcounter"}
+
+
+def sizes() -> list[int]:
+    """Scene sizes used as QFETCH rows (QT_TEST_AI_BENCH_SIZES, default "1000,10000")."""
+    out: list[int] = []
+    for part in (os.getenv("QT_TEST_AI_BENCH_SIZES") or "").replace(";", ",").split(","):
+        try:
+            n = int(part.strip())
+        except ValueError:
+            continue
+        if n > 0 and n not in out:
+            out.append(n)
+    return sorted(out) or list(DEFAULT_SIZES)
+
+
+def backend() -> tuple[str, str | None]:
+    """
+    QtTest measurement backend (QT_TEST_AI_BENCH_BACKEND, default tickcounter).
+
+    Returns (backend, note); callgrind falls back to tickcounter when valgrind is not on PATH.
+    """
+    raw = (os.getenv("QT_TEST_AI_BENCH_BACKEND") or "tickcounter").strip().lower().lstrip("-")
+    if raw not in BACKENDS:
+        return "tickcounter", f"未知的基准后端 {raw}，改用 tickcounter"
+    if raw == "callgrind" and not shutil.which("valgrind"):
+        return "tickcounter", "PATH 上没有 valgrind，-callgrind 改用 -tickcounter"
+    return raw, None
+
+
+def max_exponent() -> float:
+    """Largest acceptable growth exponent k for cost ~ n^k between the smallest and largest size (QT_TEST_AI_BENCH_MAX_EXPONENT, default 1.5)."""
+    return workload.float_env("QT_TEST_AI_BENCH_MAX_EXPONENT", 1.5)
+
+
+def regression_pct() -> float:
+    """Allowed per-row slowdown against the previous run with the same backend (QT_TEST_AI_BENCH_REGRESSION_PCT, default 25)."""
+    return workload.float_env("QT_TEST_AI_BENCH_REGRESSION_PCT", 25.0, minimum=0.0)
+
+
+def bench_dir(tests_dir: Path) -> Path:
+    return Path(tests_dir) / BENCH_DIR
+
+
+# ----------------------------
+# generated suite
+# ----------------------------
+_SUITE = r"""// Generated by Smart Testing Tools (benchmark suite). Do not edit.
+//
+// QBENCHMARK cases for DiagramScene hot paths. Every case runs once per scene
+// size (data rows @SIZES@, see QT_TEST_AI_BENCH_SIZES) so
+// the tool can compare rows and flag super-linear growth. Run with
+// -tickcounter or -callgrind; set-up outside the QBENCHMARK blocks is not measured.
+#include <QtTest>
+#include <QtWidgets>
+#include <QUndoStack>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "arrow.h"
+#include "deletecommand.h"
+#include "diagramitem.h"
+#include "diagramitemgroup.h"
+#include "diagramscene.h"
+#include "diagramtextitem.h"
+
+// 查找 / 替换的处理函数是 MainWindow 的私有槽；标准库与 Qt 头已在上面包含
+#define private public
+#define protected public
+#include "mainwindow.h"
+#undef protected
+#undef private
+
+namespace {
+
+const int kColumns = 100;
+
+QPointF gridPos(int i)
+{
+    return QPointF((i % kColumns) * 150.0, (i / kColumns) * 150.0);
+}
+
+QList<DiagramItem *> populate(QGraphicsScene &scene, QMenu *menu, int n)
+{
+    QList<DiagramItem *> items;
+    items.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        auto *item = new DiagramItem(DiagramItem::Step, menu);
+        item->setPos(gridPos(i));
+        scene.addItem(item);
+        items << item;
+    }
+    return items;
+}
+
+// 相邻元素两两连线：n 个元素 n-1 条箭头
+QList<Arrow *> chain(QGraphicsScene &scene, const QList<DiagramItem *> &items)
+{
+    QList<Arrow *> arrows;
+    arrows.reserve(items.size());
+    for (int i = 1; i < items.size(); ++i) {
+        auto *arrow = new Arrow(items[i - 1], items[i]);
+        items[i - 1]->addArrow(arrow);
+        items[i]->addArrow(arrow);
+        scene.addItem(arrow);
+        arrow->updatePosition();
+        arrows << arrow;
+    }
+    return arrows;
+}
+
+void sizeRows()
+{
+    QTest::addColumn<int>("n");
+    for (int n : {@SIZES@})
+        QTest::newRow(QByteArray::number(n).constData()) << n;
+}
+
+} // namespace
+
+class BenchDiagramScene : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void insertItems_data() { sizeRows(); }
+    void insertItems()
+    {
+        QFETCH(int, n);
+        QBENCHMARK {
+            DiagramScene scene(&m_menu);
+            populate(scene, &m_menu, n);
+        }
+    }
+
+    void connectArrows_data() { sizeRows(); }
+    void connectArrows()
+    {
+        QFETCH(int, n);
+        DiagramScene scene(&m_menu);
+        const QList<DiagramItem *> items = populate(scene, &m_menu, n);
+        QList<Arrow *> arrows;
+        QBENCHMARK {
+            arrows = chain(scene, items);
+            // 拆掉本轮的箭头，下一轮从同样的状态开始（拆除也计入：连线的完整生命周期）
+            for (Arrow *a : arrows) {
+                a->startItem()->removeArrow(a);
+                a->endItem()->removeArrow(a);
+                scene.removeItem(a);
+                delete a;
+            }
+        }
+    }
+
+    // 拖动选中的元素：每次位移都要重算所有相连箭头的几何
+    void dragSelection_data() { sizeRows(); }
+    void dragSelection()
+    {
+        QFETCH(int, n);
+        DiagramScene scene(&m_menu);
+        const QList<DiagramItem *> items = populate(scene, &m_menu, n);
+        chain(scene, items);
+        for (DiagramItem *item : items)
+            item->setSelected(true);
+        const QList<QGraphicsItem *> selected = scene.selectedItems();
+        qreal dx = 1.0;
+        QBENCHMARK {
+            for (QGraphicsItem *item : selected)
+                item->moveBy(dx, 0.0);
+            dx = -dx;
+        }
+    }
+
+    void groupItems_data() { sizeRows(); }
+    void groupItems()
+    {
+        QFETCH(int, n);
+        QBENCHMARK {
+            DiagramScene scene(&m_menu);
+            const QList<DiagramItem *> items = populate(scene, &m_menu, n);
+            auto *group = new DiagramItemGroup();
+            scene.addItem(group);
+            for (DiagramItem *item : items)
+                group->addItem(item);
+        }
+    }
+
+    // 拖动一个组：组整体位移后，组内元素的箭头跟着更新
+    void dragGroup_data() { sizeRows(); }
+    void dragGroup()
+    {
+        QFETCH(int, n);
+        DiagramScene scene(&m_menu);
+        const QList<DiagramItem *> items = populate(scene, &m_menu, n);
+        const QList<Arrow *> arrows = chain(scene, items);
+        auto *group = new DiagramItemGroup();
+        scene.addItem(group);
+        for (DiagramItem *item : items)
+            group->addItem(item);
+        qreal dx = 1.0;
+        QBENCHMARK {
+            group->moveBy(dx, 0.0);
+            for (Arrow *a : arrows)
+                a->updatePosition();
+            dx = -dx;
+        }
+    }
+
+    // 整个选区一次删除（一个宏命令），测撤销 / 重做
+    void deleteUndoRedo_data() { sizeRows(); }
+    void deleteUndoRedo()
+    {
+        QFETCH(int, n);
+        DiagramScene scene(&m_menu);
+        const QList<DiagramItem *> items = populate(scene, &m_menu, n);
+        QUndoStack stack;
+        stack.beginMacro(QStringLiteral("delete selection"));
+        for (DiagramItem *item : items)
+            stack.push(new DeleteCommand(item, &scene));
+        stack.endMacro();
+        QBENCHMARK {
+            stack.undo();
+            stack.redo();
+        }
+    }
+
+    void findReplace_data() { sizeRows(); }
+    void findReplace()
+    {
+        QFETCH(int, n);
+        MainWindow window;
+        auto *scene = window.findChild<DiagramScene *>();
+        if (!scene) {
+            if (auto *view = window.findChild<QGraphicsView *>())
+                scene = qobject_cast<DiagramScene *>(view->scene());
+        }
+        if (!scene)
+            QSKIP("MainWindow has no DiagramScene child");
+        for (int i = 0; i < n; ++i) {
+            auto *text = new DiagramTextItem();
+            text->setPlainText(QStringLiteral("node %1 alpha").arg(i));
+            text->setPos(gridPos(i));
+            scene->addItem(text);
+        }
+        // 查找 / 替换可能弹出提示框：定时关掉模态窗口，基准不会卡住
+        QTimer closer;
+        connect(&closer, &QTimer::timeout, [] {
+            if (QWidget *w = QApplication::activeModalWidget())
+                w->close();
+        });
+        closer.start(10);
+        QBENCHMARK {
+            window.handleFindText(QStringLiteral("alpha"));
+            window.handleReplaceAllText(QStringLiteral("alpha"), QStringLiteral("beta"));
+            window.handleReplaceAllText(QStringLiteral("beta"), QStringLiteral("alpha"));
+        }
+    }
+
+private:
+    QMenu m_menu;
+};
+
+QTEST_MAIN(BenchDiagramScene)
+#include "bench_diagramscene.moc"
+"""
+
+
+def suite_text(row_sizes: list[int] | None = None) -> str:
+    return _SUITE.replace("@SIZES@", ", ".join(str(n) for n in (row_sizes or sizes())))
+
+
+def pro_text(project_root: Path, tests_dir: Path) -> str:
+    """Release build of the suite plus the application sources; no coverage flags, they would distort the numbers."""
+    d = bench_dir(tests_dir)
+    srcs, hdrs = project_lib.project_sources(project_root)
+    src = " \\\n    ".join([SUITE_FILE, *(project_lib.rel_path(f, d) for f in srcs)])
+    hdr = " \\\n    ".join(project_lib.rel_path(f, d) for f in hdrs)
+    return (
+        "# Generated by Smart Testing Tools (benchmark suite); do not edit.\n"
+        "TEMPLATE = app\n"
+        f"TARGET = {BENCH_TARGET}\n"
+        "CONFIG += release c++17 console testcase\n"
+        "CONFIG -= app_bundle debug\n"
+        f"QT += testlib {project_lib.qt_modules(project_root)}\n"
+        f"INCLUDEPATH += {project_lib.rel_path(Path(project_root), d)}\n"
+        "\n"
+        f"SOURCES += \\\n    {src}\n"
+        "\n"
+        f"HEADERS += \\\n    {hdr}\n"
+        "\n"
+        "DESTDIR = $$PWD/bin\n"
+        "OBJECTS_DIR = $$PWD/obj\n"
+        "MOC_DIR = $$PWD/moc\n"
+        "UI_DIR = $$PWD/ui\n"
+        "RCC_DIR = $$PWD/rcc\n"
+    )
+
+
+def write_suite(project_root: Path, tests_dir: Path) -> Path:
+    d = bench_dir(tests_dir)
+    coverage_build.write_if_changed(d / SUITE_FILE, suite_text())
+    pro = d / f"{BENCH_TARGET}.pro"
+    coverage_build.write_if_changed(pro, pro_text(project_root, tests_dir))
+    return pro
+
+
+def executable(tests_dir: Path) -> Path | None:
+    return workload.executable(bench_dir(tests_dir) / "bin", BENCH_TARGET)
+
+
+def build(project_root: Path, tests_dir: Path) -> tuple[bool, dict[str, Any]]:
+    pro = write_suite(project_root, tests_dir)
+    return coverage_build.build(pro, bench_dir(tests_dir), args=[])
+
+
+# ----------------------------
+# results
+# ----------------------------
+def results_from(res: qtest_results.TestResults) -> dict[str, dict[str, dict[str, Any]]]:
+    """{function: {row tag: {metric, value (per iteration), iterations}}}."""
+    out: dict[str, dict[str, dict[str, Any]]] = {}
+    for f in res.functions:
+        for b in f.benchmarks:
+            it = max(1, int(b.get("iterations") or 1))
+            out.setdefault(f.name, {})[b.get("tag") or ""] = {
+                "metric": b.get("metric") or "",
+                "value": float(b.get("value") or 0.0) / it,
+                "iterations": it,
+            }
+    return out
+
+
+def scaling(results: dict[str, dict[str, dict[str, Any]]]) -> list[dict[str, Any]]:
+    """Growth exponent k (cost ~ n^k) between the smallest and largest numeric row of each benchmark."""
+    out: list[dict[str, Any]] = []
+    for fn, rows in sorted(results.items()):
+        sized = sorted((int(tag), r) for tag, r in rows.items() if tag.isdigit() and r["value"] > 0)
+        if len(sized) < 2:
+            continue
+        (n1, r1), (n2, r2) = sized[0], sized[-1]
+        k = math.log(r2["value"] / r1["value"]) / math.log(n2 / n1)
+        out.append({"function": fn, "metric": r1["metric"], "n_small": n1, "n_large": n2, "ratio": round(r2["value"] / r1["value"], 2), "exponent": round(k, 2)})
+    return out
+
+
+def load_history(tests_dir: Path) -> dict[str, Any]:
+    return workload.load_history(bench_dir(tests_dir) / HISTORY_FILE)
+
+
+def record_run(tests_dir: Path, run: dict[str, Any]) -> None:
+    workload.record_run(bench_dir(tests_dir) / HISTORY_FILE, run)
+
+
+def compare_previous(results: dict[str, dict[str, dict[str, Any]]], previous: dict[str, Any] | None) -> list[dict[str, Any]]:
+    """Rows slower than the previous run by more than regression_pct()."""
+    if not previous:
+        return []
+    pct = regression_pct()
+    out: list[dict[str, Any]] = []
+    for fn, rows in sorted(results.items()):
+        for tag, r in rows.items():
+            old = ((previous.get("results") or {}).get(fn) or {}).get(tag)
+            if not old or old.get("metric") != r["metric"] or not old.get("value"):
+                continue
+            growth = (r["value"] - old["value"]) / old["value"] * 100.0
+            if growth > pct:
+                out.append({"function": fn, "tag": tag, "metric": r["metric"], "previous": old["value"], "current": r["value"], "growth_pct": round(growth, 1)})
+    return out
+
+
+def _fmt(v: float) -> str:
+    return f"{v:.4g}"
+
+
+def run(project_root: Path, tests_dir: Path | None = None, *, functions: list[str] | None = None, timeout_s: float = 3600) -> tuple[list[Finding], dict[str, Any]]:
+    """
+    Generate, build and run the benchmark suite, then store per-row results.
+
+    Findings flag benchmarks whose cost grows faster than n^max_exponent()
+    between the smallest and largest scene size (error) and rows slower than
+    the previous run with the same backend (warning).
+    """
+    project_root = Path(project_root)
+    tests_dir = Path(tests_dir) if tests_dir is not None else project_root / "tests" / "generated"
+    findings: list[Finding] = []
+    ok, m_build = build(project_root, tests_dir)
+    meta: dict[str, Any] = {"build": {k: m_build.get(k) for k in ("build_dir", "qmake_skipped", "jobs", "duration_s")}}
+    if not ok:
+        findings.append(Finding("performance", "error", "基准测试编译失败", workload.build_error(m_build)))
+        return findings, meta
+    exe = executable(tests_dir)
+    if exe is None:
+        findings.append(Finding("performance", "error", "未找到基准测试程序", str(bench_dir(tests_dir) / "bin")))
+        return findings, meta
+
+    be, note = backend()
+    if note:
+        findings.append(Finding("performance", "info", note))
+    d = bench_dir(tests_dir)
+    qtest_results.clear(d)
+    cmd = [str(exe), "-platform", "offscreen", f"-{be}", *qtest_results.output_args(d), *(functions or [])]
+    meta.update({"cmd": cmd, "backend": be})
+    t0 = time.perf_counter()
+    try:
+        p = subprocess.run(cmd, cwd=str(d), capture_output=True, text=True, errors="replace", timeout=timeout_s)
+        meta["returncode"] = p.returncode
+        meta["stdout"] = (p.stdout or "")[-20000:]
+        meta["stderr"] = (p.stderr or "")[-5000:]
+    except subprocess.TimeoutExpired:
+        meta["returncode"] = -1
+        meta["timed_out"] = True
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+
+    res = qtest_results.collect(d)
+    if res is None:
+        findings.append(Finding("performance", "error", "基准测试没有产生结果", (meta.get("stderr") or "")[-2000:]))
+        return findings, meta
+    meta["test_results"] = res.to_meta()
+    if res.failure_report():
+        findings.append(Finding("performance", "error", "基准测试运行失败", res.failure_report()))
+
+    results = results_from(res)
+    previous = next((r for r in reversed(load_history(tests_dir).get("runs") or []) if r.get("backend") == be), None)
+    scale = scaling(results)
+    regressions = compare_previous(results, previous)
+    meta.update({"results": results, "scaling": scale, "regressions": regressions})
+    record_run(tests_dir, {"at": datetime.now().isoformat(timespec="seconds"), "backend": be, "sizes": sizes(), "results": results})
+
+    limit = max_exponent()
+    for s in scale:
+        sev = "error" if s["exponent"] > limit else "info"
+        findings.append(
+            Finding(
+                "performance",
+                sev,  # type: ignore[arg-type]
+                f"{s['function']}: n={s['n_small']}→{s['n_large']} 耗时 ×{s['ratio']}（≈O(n^{s['exponent']})）",
+                f"指标 {s['metric']}；阈值 n^{limit}" + ("，增长超线性，疑似 O(n²) 路径" if sev == "error" else ""),
+            )
+        )
+    for r in regressions:
+        findings.append(
+            Finding(
+                "performance",
+                "warning",
+                f"基准回退: {r['function']}({r['tag']}) +{r['growth_pct']}%",
+                f"{r['metric']}: 上次 {_fmt(r['previous'])} → 本次 {_fmt(r['current'])}（阈值 {regression_pct():.0f}%）",
+            )
+        )
+    if results and not any(f.severity == "error" for f in findings):
+        findings.append(Finding("performance", "info", f"基准测试完成（{len(results)} 个，后端 {be}，{meta['duration_s']}s）"))
+    return findings, meta
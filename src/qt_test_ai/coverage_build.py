@@ -0,0 +1,306 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+import time
+from functools import lru_cache
+from pathlib import Path
+from typing import Any, Iterable
+
+from . import startup_profile, tracing
+
+STAMP_FILE = ".qt_test_ai_build.json"
+PCH_HEADER = "qt_test_ai_pch.h"
+COVERAGE_FLAGS = ("QMAKE_CFLAGS+=--coverage", "QMAKE_CXXFLAGS+=--coverage", "QMAKE_LFLAGS+=--coverage")
+
+_ON = {"1", "true", "yes", "y", "on"}
+_INCLUDE_RE = re.compile(r"^\s*include\s*\(\s*([^)]+?)\s*\)", re.M)
+_COVERAGE_RE = re.compile(r"fprofile-arcs|ftest-coverage|--coverage")
+
+
+def _flag(name: str, default: str = "0") -> bool:
+    return (os.getenv(name) or default).strip().lower() in _ON
+
+
+def enabled() -> bool:
+    """Keep build trees between runs and skip unchanged qmake steps (QT_TEST_AI_INCREMENTAL_BUILD, default on)."""
+    return _flag("QT_TEST_AI_INCREMENTAL_BUILD", "1")
+
+
+def build_jobs() -> int:
+    """Parallel make jobs (QT_TEST_AI_BUILD_JOBS, default CPU count)."""
+    try:
+        n = int((os.getenv("QT_TEST_AI_BUILD_JOBS") or "").strip() or 0)
+    except Exception:
+        n = 0
+    return max(1, n or (os.cpu_count() or 1))
+
+
+def make_command(base: str | None = None, jobs: int | None = None) -> str:
+    """QT_TEST_AI_MAKE_CMD (else `base`, else mingw32-make) with -j<N> added unless the command already sets it."""
+    cmd = (os.getenv("QT_TEST_AI_MAKE_CMD") or base or "mingw32-make").strip()
+    if re.search(r"(^|\s)(-j\s*\d*|--jobs\b)", cmd):
+        return cmd
+    return f"{cmd} -j{jobs or build_jobs()}"
+
+
+@lru_cache(maxsize=8)
+def kit_id(qmake: str = "qmake") -> str:
+    """Identify the Qt kit by qmake's location and version; results are cached per process."""
+    exe = shutil.which(qmake) or qmake
+    version = ""
+    try:
+        p = subprocess.run([exe, "-query", "QT_VERSION"], capture_output=True, text=True, timeout=30, errors="replace")
+        version = (p.stdout or "").strip()
+    except Exception:
+        pass
+    return f"{Path(exe).resolve() if os.path.isabs(exe) else exe}|{version}"
+
+
+def _ccache_args() -> list[str]:
+    """Compiler wrappers for QT_TEST_AI_CCACHE=1 (ignored when ccache is not on PATH)."""
+    if not _flag("QT_TEST_AI_CCACHE") or not shutil.which("ccache"):
+        return []
+    cc = os.getenv("QT_TEST_AI_CC") or "gcc"
+    cxx = os.getenv("QT_TEST_AI_CXX") or "g++"
+    return [f"QMAKE_CC=ccache {cc}", f"QMAKE_CXX=ccache {cxx}"]
+
+
+def _pch_text(pro_text: str) -> str:
+    # 只预编译 Qt 自身的头：项目头改动频繁，放进 PCH 反而让每次改动都重建整个 PCH
+    umbrella = "QtWidgets" if re.search(r"\bwidgets\b", pro_text) else "QtGui" if re.search(r"\bgui\b", pro_text) else "QtCore"
+    lines = [
+        "// Generated by Smart Testing Tools (QT_TEST_AI_PCH=1); do not edit.",
+        "#if defined(__cplusplus)",
+        f"#include <{umbrella}>",
+    ]
+    if re.search(r"\btestlib\b", pro_text):
+        lines.append("#include <QtTest>")
+    lines.append("#endif")
+    return "\n".join(lines) + "\n"
+
+
+def write_if_changed(path: Path, text: str) -> bool:
+    """Write only when the content differs, so make does not see a fresh mtime."""
+    path = Path(path)
+    try:
+        if path.exists() and path.read_text(encoding="utf-8", errors="replace") == text:
+            return False
+    except Exception:
+        pass
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(text, encoding="utf-8")
+    return True
+
+
+def qmake_args(pro: Path, build_dir: Path, *, extra: Iterable[str] = ()) -> list[str]:
+    """
+    Assignments passed to qmake for a coverage build.
+
+    Coverage flags go on the command line when the .pro lacks them, so the
+    project file is never rewritten (rewriting it bumps its mtime and makes
+    every Makefile regenerate). ccache and the QtWidgets PCH are opt-in.
+    """
+    pro = Path(pro)
+    try:
+        text = pro.read_text(encoding="utf-8", errors="replace")
+    except Exception:
+        text = ""
+    args = [a for a in extra if a]
+    if not _COVERAGE_RE.search(text):
+        args.extend(COVERAGE_FLAGS)
+    args.extend(_ccache_args())
+    if _flag("QT_TEST_AI_PCH") and "PRECOMPILED_HEADER" not in text:
+        header = Path(build_dir) / PCH_HEADER
+        write_if_changed(header, _pch_text(text))
+        args.extend(["CONFIG+=precompile_header", f"PRECOMPILED_HEADER={header.as_posix()}"])
+    return args
+
+
+def build_key(pro: Path, args: Iterable[str], *, spec: str | None = None, qmake: str = "qmake") -> str:
+    """Stable id of kit + spec + qmake assignments; one build tree per key."""
+    h = hashlib.sha1()
+    for part in (kit_id(qmake), spec or "", Path(pro).name, *sorted(args)):
+        h.update(part.encode("utf-8", "replace"))
+        h.update(b"\0")
+    return h.hexdigest()[:12]
+
+
+def build_dir_for(project_root: Path, key: str) -> Path:
+    return Path(project_root) / "build_coverage" / key
+
+
+def pro_fingerprint(pro: Path) -> str:
+    """Hash of the .pro and the .pri files it include()s directly."""
+    pro = Path(pro)
+    h = hashlib.sha1()
+    files = [pro]
+    try:
+        text = pro.read_text(encoding="utf-8", errors="replace")
+        for m in _INCLUDE_RE.finditer(text):
+            inc = m.group(1).strip().strip("\"'").replace("$$PWD", str(pro.parent))
+            p = Path(inc) if Path(inc).is_absolute() else pro.parent / inc
+            files.append(p)
+    except Exception:
+        pass
+    for f in files:
+        h.update(str(f.name).encode("utf-8"))
+        try:
+            h.update(f.read_bytes())
+        except Exception:
+            h.update(b"<missing>")
+    return h.hexdigest()
+
+
+def _load_stamp(build_dir: Path) -> dict[str, Any]:
+    try:
+        return json.loads((Path(build_dir) / STAMP_FILE).read_text(encoding="utf-8"))
+    except Exception:
+        return {}
+
+
+def _save_stamp(build_dir: Path, stamp: dict[str, Any]) -> None:
+    try:
+        (Path(build_dir) / STAMP_FILE).write_text(json.dumps(stamp, ensure_ascii=False, indent=1), encoding="utf-8")
+    except Exception:
+        pass
+
+
+def _quote(s: str) -> str:
+    # cmd.exe 与 sh 都接受双引号
+    return f'"{s}"'
+
+
+def _run(cmd: str, cwd: Path, timeout_s: float) -> dict[str, Any]:
+    meta: dict[str, Any] = {"cmd": cmd, "cwd": str(cwd)}
+    t0 = time.perf_counter()
+    try:
+        p = tracing.run(cmd, cwd=str(cwd), shell=True, capture_output=True, text=True, timeout=timeout_s, errors="replace")
+        meta["returncode"] = p.returncode
+        meta["stdout"] = p.stdout or ""
+        meta["stderr"] = p.stderr or ""
+    except subprocess.TimeoutExpired as e:
+        meta["returncode"] = -1
+        meta["stdout"] = getattr(e, "stdout", "") or ""
+        meta["stderr"] = (getattr(e, "stderr", "") or "") + "\nTIMEOUT"
+        meta["timed_out"] = True
+    except Exception as e:
+        meta["returncode"] = -1
+        meta["stdout"] = ""
+        meta["stderr"] = str(e)
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    return meta
+
+
+def needs_qmake(pro: Path, build_dir: Path, args: list[str], *, spec: str | None = None) -> bool:
+    stamp = _load_stamp(build_dir)
+    return not (
+        (Path(build_dir) / "Makefile").exists()
+        and stamp.get("pro") == pro_fingerprint(pro)
+        and stamp.get("args") == list(args)
+        and stamp.get("spec") == (spec or "")
+    )
+
+
+def mark_configured(pro: Path, build_dir: Path, args: list[str], *, spec: str | None = None, qmake: str = "qmake") -> None:
+    """Record a successful qmake so the next needs_qmake() with the same inputs is False."""
+    _save_stamp(build_dir, {"pro": pro_fingerprint(pro), "args": list(args), "spec": spec or "", "kit": kit_id(qmake), "configured_at": time.time()})
+
+
+def clear_gcda(build_dir: Path) -> int:
+    """
+    Drop coverage counters left by the previous run but keep objects and .gcno.
+
+    Objects that make rebuilds get fresh .gcno files; removing every .gcda up
+    front is what avoids gcov stamp mismatches, a clean build is not needed.
+    """
+    n = 0
+    for f in Path(build_dir).rglob("*.gcda"):
+        try:
+            f.unlink()
+            n += 1
+        except Exception:
+            pass
+    return n
+
+
+def build(
+    pro: Path,
+    build_dir: Path,
+    *,
+    args: list[str],
+    spec: str | None = None,
+    recursive: bool = False,
+    qmake: str = "qmake",
+    make: str | None = None,
+    timeout_s: float = 1800,
+) -> tuple[bool, dict[str, Any]]:
+    """
+    Configure (only when the .pro, assignments or spec changed) and build in `build_dir`.
+
+    Returns (ok, meta) with "qmake" (None when skipped), "make", "qmake_skipped",
+    "jobs" and "duration_s".
+    """
+    pro = Path(pro).resolve()
+    build_dir = Path(build_dir)
+    build_dir.mkdir(parents=True, exist_ok=True)
+    t0 = time.perf_counter()
+    meta: dict[str, Any] = {"build_dir": str(build_dir), "qmake": None, "qmake_skipped": False}
+
+    if enabled() and not needs_qmake(pro, build_dir, args, spec=spec):
+        meta["qmake_skipped"] = True
+    else:
+        parts = [_quote(qmake) if " " in qmake else qmake, _quote(str(pro))]
+        if recursive:
+            parts.append("-r")
+        if spec:
+            parts.extend(["-spec", spec])
+        parts.extend(_quote(a) if " " in a else a for a in args)
+        m_q = _run(" ".join(parts), build_dir, 300)
+        meta["qmake"] = m_q
+        if m_q.get("returncode") != 0:
+            meta["duration_s"] = round(time.perf_counter() - t0, 3)
+            return False, meta
+        mark_configured(pro, build_dir, args, spec=spec, qmake=qmake)
+
+    cmd = make_command(make)
+    meta["jobs"] = build_jobs()
+    m_make = _run(cmd, build_dir, timeout_s)
+    meta["make"] = m_make
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    return m_make.get("returncode") == 0, meta
+
+
+def prepare_project(
+    project_root: Path,
+    pro: Path,
+    *,
+    extra: Iterable[str] = (),
+    spec: str | None = None,
+    qmake: str = "qmake",
+) -> tuple[Path, list[str]]:
+    """
+    Build directory and qmake assignments for a project's coverage build.
+
+    With QT_TEST_AI_STARTUP_MARKER=1 the startup marker header is force-included
+    into every application TU, so the smoke test can time the first shown /
+    painted main window (see startup_profile).
+    """
+    extra = list(extra)
+    marker = startup_profile.marker_enabled()
+    key = build_key(
+        pro,
+        [*extra, *(["pch"] if _flag("QT_TEST_AI_PCH") else []), *(["ccache"] if _ccache_args() else []), *(["marker"] if marker else [])],
+        spec=spec,
+        qmake=qmake,
+    )
+    build_dir = build_dir_for(project_root, key) if enabled() else Path(project_root) / "build_coverage"
+    if marker:
+        header = build_dir / startup_profile.MARKER_HEADER
+        write_if_changed(header, startup_profile.marker_text())
+        extra.append(f"QMAKE_CXXFLAGS+=-include {header.as_posix()}")
+    return build_dir, qmake_args(pro, build_dir, extra=extra)
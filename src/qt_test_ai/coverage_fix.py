@@ -19,6 +19,8 @@ from typing import Any, Optional
 import ctypes
 from ctypes import wintypes
 
+from . import coverage_build, file_index
+
 
 class CoverageFixResult:
     """覆盖率修复结果"""
@@ -73,8 +75,9 @@ def find_executable(project_root: Path) -> Optional[Path]:
         "build/**/release/*.exe",
     ]
     
+    idx = file_index.get_index(project_root)
     for pattern in search_patterns:
-        exes = list(project_root.glob(pattern))
+        exes = idx.glob(pattern)
         # 排除 moc, qrc, uic, test 等工具生成的文件
         exes = [e for e in exes if not any(x in e.stem.lower() for x in ['moc', 'qrc', 'uic', 'test', 'a.exe'])]
         if exes:
@@ -85,12 +88,11 @@ def find_executable(project_root: Path) -> Optional[Path]:
 
 def find_object_dir(project_root: Path) -> Optional[Path]:
     """查找包含 .gcno 文件的目录"""
-    for pattern in ["debug", "build/**/debug", "build/**/*Debug*"]:
-        for d in project_root.glob(pattern):
-            if d.is_dir():
-                gcno_files = list(d.glob("*.gcno"))
-                if gcno_files:
-                    return d
+    idx = file_index.get_index(project_root)
+    for pattern in ["debug", "build/**/debug", "build/**/*Debug*", "build_coverage/*/debug"]:
+        dirs = idx.dirs_with(".gcno", pattern)
+        if dirs:
+            return dirs[0]
     return None
 
 
@@ -105,8 +107,8 @@ def add_coverage_flags(pro_file: Path) -> bool:
     try:
         content = pro_file.read_text(encoding="utf-8", errors="ignore")
         
-        if "coverage flags" in content:
-            return True  # 已存在
+        if "coverage flags" in content or check_coverage_flags(pro_file):
+            return True  # 已存在（不重写，避免 .pro 的 mtime 变化触发整个项目重新 qmake）
         
         coverage_block = """
 # --- coverage flags (auto-added by Smart Testing Tools) ---
@@ -143,9 +145,11 @@ def deploy_qt_dlls(exe_path: Path, qt_bin: str) -> bool:
 def clear_gcda_files(project_root: Path) -> int:
     """清理旧的 .gcda 文件"""
     count = 0
-    for gcda in project_root.rglob("*.gcda"):
+    idx = file_index.get_index(project_root)
+    for gcda in idx.gcda():
         try:
             gcda.unlink()
+            idx.note_removed(gcda)
             count += 1
         except Exception:
             pass
@@ -200,45 +204,34 @@ def run_program_gracefully(exe_path: Path, duration: int = 5) -> bool:
 
 def count_gcda_files(project_root: Path) -> int:
     """统计 .gcda 文件数量"""
-    return len(list(project_root.rglob("*.gcda")))
+    return file_index.get_index(project_root).count(".gcda")
 
 
 def run_gcovr(project_root: Path, object_dir: Path, gcov_exe: str) -> dict[str, Any]:
-    """运行 gcovr 并解析结果"""
-    import sys
-    
-    cmd = [
-        sys.executable, "-m", "gcovr",
-        "-r", str(project_root),
-        "--object-directory", str(object_dir),
-        "--gcov-executable", gcov_exe,
-        "--exclude-directories", ".git",
-        "--exclude-directories", "build",
-        "--print-summary"
-    ]
-    
+    """运行 gcovr（gcov 并行，-j 由 QT_TEST_AI_GCOV_JOBS 控制）并从 JSON 模型读取结果"""
+    from .coverage_model import collect
+
     try:
-        result = subprocess.run(
-            cmd,
-            capture_output=True,
-            text=True,
-            timeout=300,
-            cwd=str(project_root)
+        model, meta = collect(
+            project_root,
+            object_dir=object_dir,
+            gcov_exe=gcov_exe,
+            extra_args=["--exclude-directories", ".git", "--exclude-directories", "build"],
+            timeout_s=300,
         )
-        
-        output = result.stdout + "\n" + result.stderr
-        
-        # 解析覆盖率
         coverage = {}
-        for metric in ["lines", "functions", "branches"]:
-            match = re.search(rf"{metric}:\s*(\d+\.?\d*)%", output, re.I)
-            if match:
-                coverage[metric] = float(match.group(1))
-        
+        if model is not None and not model.empty:
+            coverage = {k: m.percent for k, m in model.totals.items() if m.total > 0}
+        output = meta.get("output") or ""
+        if model is not None:
+            output = model.summary_text() + "\n" + output
         return {
-            "success": result.returncode == 0 or bool(coverage),
+            "success": meta.get("returncode") == 0 or bool(coverage),
             "coverage": coverage,
-            "output": output
+            "output": output,
+            "model": model,
+            "duration_s": meta.get("duration_s"),
+            "jobs": meta.get("jobs"),
         }
     except Exception as e:
         return {
@@ -346,20 +339,33 @@ def fix_coverage(project_root: Path, run_program: bool = True, build: bool = Fal
         result.steps_completed.append("找到项目文件")
         
         # Step 3: 确保覆盖率标志存在
-        if pro_file.suffix == ".pro":
-            if not check_coverage_flags(pro_file):
-                if add_coverage_flags(pro_file):
-                    result.steps_completed.append("添加覆盖率编译标志")
-                    build = True  # 需要重新编译
+        # 自己编译时标志经 qmake 命令行传入（coverage_build），不改写 .pro；
+        # 只有不编译、依赖用户自己的构建时才把标志写进 .pro
+        if pro_file.suffix == ".pro" and not check_coverage_flags(pro_file):
+            if build or coverage_build.enabled():
+                build = True
+            elif add_coverage_flags(pro_file):
+                result.steps_completed.append("添加覆盖率编译标志")
+                result.warnings.append("已向 .pro 添加覆盖率标志，请重新编译后再运行")
         
-        # Step 4: 编译（如果需要）
-        if build:
+        # Step 4: 编译（如果需要）：持久的 build_coverage/<套件+参数> 目录，.pro 未变时跳过 qmake，make -j
+        exe = None
+        if build and pro_file.suffix == ".pro":
             result.steps_completed.append("开始编译...")
-            # 这里调用外部脚本或内部编译逻辑
-            # 简化起见，我们假设编译成功
+            build_dir, args = coverage_build.prepare_project(project_root, pro_file, extra=["CONFIG+=debug"])
+            make_exe = paths["make"]
+            ok, meta = coverage_build.build(pro_file, build_dir, args=args, qmake=paths["qmake"], make=f'"{make_exe}"' if " " in make_exe else make_exe)
+            if not ok:
+                step = meta.get("make") or meta.get("qmake") or {}
+                result.errors.append(f"编译失败: {(step.get('stderr') or step.get('stdout') or '')[-1500:]}")
+                return result
+            result.steps_completed.append(
+                f"编译完成（{'跳过 qmake，' if meta.get('qmake_skipped') else ''}-j{meta.get('jobs')}，{meta.get('duration_s')}s）"
+            )
+            exe = find_executable(build_dir)
         
         # Step 5: 查找可执行文件
-        exe = find_executable(project_root)
+        exe = exe or find_executable(project_root)
         if not exe:
             result.errors.append("未找到可执行文件")
             return result
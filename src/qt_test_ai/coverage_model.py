@@ -0,0 +1,427 @@
+from __future__ import annotations
+
+import html
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Any, Callable, Iterable
+
+from . import tracing
+
+
+METRICS = ("lines", "functions", "branches")
+
+
+def gcov_jobs() -> int:
+    """Parallel gcov processes for one gcovr pass (QT_TEST_AI_GCOV_JOBS, default cpu count)."""
+    try:
+        v = int((os.getenv("QT_TEST_AI_GCOV_JOBS") or "").strip() or 0)
+    except Exception:
+        v = 0
+    return max(1, v or (os.cpu_count() or 1))
+
+
+_JOBS_FLAG_RE = re.compile(r"(?:^|\s)(?:-j\s*\d*|--jobs\b)")
+
+
+def with_jobs(cmd: str, jobs: int | None = None) -> str:
+    """
+    Add `-j N` to a user supplied gcovr shell command (QT_TEST_AI_COVERAGE_CMD etc.)
+    so gcov runs over the .gcda files in parallel. Non-gcovr commands and commands
+    that already set -j are returned unchanged.
+    """
+    s = (cmd or "").strip()
+    if "gcovr" not in s or _JOBS_FLAG_RE.search(s):
+        return cmd
+    n = jobs or gcov_jobs()
+    if n <= 1:
+        return cmd
+    m = re.search(r"gcovr(?:\.exe)?[\"']?", s)
+    if not m:
+        return cmd
+    return s[: m.end()] + f" -j {n}" + s[m.end():]
+
+
+# ----------------------------
+# model
+# ----------------------------
+@dataclass
+class Metric:
+    covered: int = 0
+    total: int = 0
+
+    @property
+    def percent(self) -> float:
+        return round(100.0 * self.covered / self.total, 1) if self.total > 0 else 0.0
+
+    def add(self, other: "Metric") -> None:
+        self.covered += other.covered
+        self.total += other.total
+
+    def to_dict(self) -> dict[str, Any]:
+        return {"covered": self.covered, "total": self.total, "percent": self.percent}
+
+
+@dataclass
+class FileCoverage:
+    file: str
+    lines: Metric = field(default_factory=Metric)
+    functions: Metric = field(default_factory=Metric)
+    branches: Metric = field(default_factory=Metric)
+    # 已覆盖 / 未覆盖的可执行行号（仅 --json 明细格式可得）
+    covered_lines: list[int] = field(default_factory=list)
+    missed_lines: list[int] = field(default_factory=list)
+
+    def metric(self, name: str) -> Metric:
+        return getattr(self, name)
+
+    def to_dict(self) -> dict[str, Any]:
+        return {"file": self.file, **{k: self.metric(k).to_dict() for k in METRICS}, "missed_lines": list(self.missed_lines)}
+
+
+def _int(v: Any) -> int:
+    try:
+        return int(v or 0)
+    except Exception:
+        return 0
+
+
+def _file_entries(data: Any) -> list[dict[str, Any]]:
+    """File objects from gcovr --json / --json-summary, in dict or list (multi-report / gcovr 4.x) form."""
+    if isinstance(data, dict):
+        files = data.get("files") or data.get("data") or []
+        return [f for f in files if isinstance(f, dict)]
+    if isinstance(data, list):
+        if data and isinstance(data[0], dict) and "files" in data[0]:
+            out: list[dict[str, Any]] = []
+            for report in data:
+                if isinstance(report, dict):
+                    out.extend(f for f in report.get("files", []) if isinstance(f, dict))
+            return out
+        return [f for f in data if isinstance(f, dict)]
+    return []
+
+
+def _summary_metric(obj: Any) -> Metric | None:
+    if isinstance(obj, dict) and ("total" in obj or "covered" in obj):
+        return Metric(_int(obj.get("covered")), _int(obj.get("total")))
+    return None
+
+
+def _parse_file(ent: dict[str, Any]) -> FileCoverage:
+    fc = FileCoverage(file=str(ent.get("file") or ent.get("filename") or ""))
+
+    # --json-summary: line_covered / line_total ...
+    if "line_total" in ent or "function_total" in ent or "branch_total" in ent:
+        fc.lines = Metric(_int(ent.get("line_covered")), _int(ent.get("line_total")))
+        fc.functions = Metric(_int(ent.get("function_covered")), _int(ent.get("function_total")))
+        fc.branches = Metric(_int(ent.get("branch_covered")), _int(ent.get("branch_total")))
+        return fc
+
+    lines = ent.get("lines")
+    if isinstance(lines, list):
+        for ln in lines:
+            if not isinstance(ln, dict) or ln.get("gcovr/noncode") or ln.get("gcovr/excluded"):
+                continue
+            fc.lines.total += 1
+            if _int(ln.get("count")) > 0:
+                fc.lines.covered += 1
+                if ln.get("line_number") is not None:
+                    fc.covered_lines.append(_int(ln.get("line_number")))
+            elif ln.get("line_number") is not None:
+                fc.missed_lines.append(_int(ln.get("line_number")))
+            # gcovr >= 5：分支挂在行上
+            for br in ln.get("branches") or []:
+                if isinstance(br, dict) and not br.get("gcovr/excluded"):
+                    fc.branches.total += 1
+                    if _int(br.get("count")) > 0:
+                        fc.branches.covered += 1
+    else:
+        fc.lines = _summary_metric(lines) or fc.lines
+
+    funcs = ent.get("functions")
+    if isinstance(funcs, list):
+        for fn in funcs:
+            if not isinstance(fn, dict) or fn.get("gcovr/excluded"):
+                continue
+            fc.functions.total += 1
+            if _int(fn.get("execution_count", fn.get("count"))) > 0:
+                fc.functions.covered += 1
+    else:
+        fc.functions = _summary_metric(funcs) or fc.functions
+
+    branches = ent.get("branches")
+    if isinstance(branches, list):
+        # 旧格式：文件级分支列表
+        for br in branches:
+            if isinstance(br, dict):
+                fc.branches.total += 1
+                if _int(br.get("count", br.get("taken"))) > 0:
+                    fc.branches.covered += 1
+    elif fc.branches.total == 0:
+        fc.branches = _summary_metric(branches) or fc.branches
+    return fc
+
+
+class CoverageModel:
+    """
+    Coverage of one gcovr pass, parsed once from its JSON.
+
+    Everything downstream (text summary, per-file stats, percentages shown in
+    findings, filtered totals for top-level-only reports) is derived from this
+    object instead of re-running gcovr or scraping its text output.
+    """
+
+    def __init__(self, files: list[FileCoverage], *, reported_totals: dict[str, Metric] | None = None, source: str = "") -> None:
+        self.files = files
+        self.source = source
+        totals = {k: Metric() for k in METRICS}
+        for f in files:
+            for k in METRICS:
+                totals[k].add(f.metric(k))
+        # gcovr 自带的 totals 更权威（考虑了 exclusion 等），有则优先
+        for k, m in (reported_totals or {}).items():
+            if m.total > 0:
+                totals[k] = m
+        self.totals = totals
+
+    # ----------------------------
+    # construction
+    # ----------------------------
+    @classmethod
+    def from_json(cls, data: Any, *, source: str = "") -> "CoverageModel":
+        files = [_parse_file(e) for e in _file_entries(data)]
+        reported: dict[str, Metric] = {}
+        if isinstance(data, dict):
+            if "line_total" in data:
+                reported = {
+                    "lines": Metric(_int(data.get("line_covered")), _int(data.get("line_total"))),
+                    "functions": Metric(_int(data.get("function_covered")), _int(data.get("function_total"))),
+                    "branches": Metric(_int(data.get("branch_covered")), _int(data.get("branch_total"))),
+                }
+            else:
+                t = data.get("totals") or data.get("metrics")
+                if isinstance(t, dict):
+                    for k in METRICS:
+                        m = _summary_metric(t.get(k))
+                        if m is not None:
+                            reported[k] = m
+        return cls(files, reported_totals=reported, source=source)
+
+    @classmethod
+    def load(cls, path: Path) -> "CoverageModel":
+        return cls.from_json(json.loads(Path(path).read_text(encoding="utf-8")), source=str(path))
+
+    # ----------------------------
+    # views
+    # ----------------------------
+    def percent(self, metric: str = "lines") -> float:
+        return self.totals[metric].percent
+
+    @property
+    def empty(self) -> bool:
+        return not self.files and all(m.total == 0 for m in self.totals.values())
+
+    def as_percent_strings(self) -> dict[str, str | None]:
+        """{"lines": "85.7%", ...} as used by coverage findings / meta["coverage_summary"]."""
+        return {k: (f"{self.totals[k].percent}%" if self.totals[k].total > 0 else None) for k in METRICS}
+
+    def per_file(self) -> list[dict[str, Any]]:
+        """Per-file covered / total counts without line lists, for meta["coverage_per_file"] and the run DB."""
+        return [{"file": f.file, **{k: f.metric(k).to_dict() for k in METRICS}} for f in self.files]
+
+    def summary_text(self) -> str:
+        """Same shape as `gcovr --print-summary`."""
+        out = []
+        for k in METRICS:
+            m = self.totals[k]
+            out.append(f"{k}: {m.percent}% ({m.covered} out of {m.total})")
+        return "\n".join(out)
+
+    def file_stats(self, hint: str) -> FileCoverage | None:
+        """Per-file stats by base name; falls back to an underscore-insensitive match (diagram_item.cpp ~ diagramitem.cpp)."""
+        h = Path(hint or "").name.lower()
+        if not h:
+            return None
+        h_clean = h.replace("_", "")
+        fuzzy = None
+        for f in self.files:
+            base = Path(f.file.replace("\\", "/")).name.lower()
+            if base == h:
+                return f
+            if fuzzy is None and base.replace("_", "") == h_clean:
+                fuzzy = f
+        return fuzzy
+
+    def filtered(self, keep: Callable[[FileCoverage], bool]) -> "CoverageModel":
+        return CoverageModel([f for f in self.files if keep(f)], source=self.source)
+
+    def top_level_only(self) -> "CoverageModel":
+        """Only files directly under the gcovr root (no directory part)."""
+        return self.filtered(lambda f: "/" not in f.file and "\\" not in f.file)
+
+    def write_html(self, path: Path, *, title: str = "Coverage") -> Path:
+        """Totals + per-file table rendered from this model (same numbers as summary / per_file, no second gcovr run)."""
+        esc = html.escape
+        out = [
+            "<!doctype html>",
+            f'<html><head><meta charset="utf-8"><title>{esc(title)}</title>',
+            "<style>table{border-collapse:collapse;width:100%}th,td{border:1px solid #ccc;padding:6px;text-align:left}th{background:#f3f3f3}</style>",
+            "</head><body>",
+            f"<h1>{esc(title)}</h1>",
+            "<h2>Totals</h2>",
+            "<ul>",
+        ]
+        for k in METRICS:
+            m = self.totals[k]
+            out.append(f"<li>{k.capitalize()}: {f'{m.percent}% ({m.covered}/{m.total})' if m.total > 0 else 'N/A'}</li>")
+        out += ["</ul>", "<h2>Files</h2>", "<table>", "<thead><tr><th>File</th>" + "".join(f"<th>{k.capitalize()}</th>" for k in METRICS) + "</tr></thead>", "<tbody>"]
+        for f in sorted(self.files, key=lambda x: x.file):
+            cells = []
+            for k in METRICS:
+                m = f.metric(k)
+                cells.append(f"<td>{m.percent}% ({m.covered}/{m.total})</td>" if m.total > 0 else "<td>N/A</td>")
+            out.append(f"<tr><td>{esc(f.file)}</td>{''.join(cells)}</tr>")
+        out += ["</tbody>", "</table>", "</body></html>"]
+        p = Path(path)
+        p.write_text("\n".join(out), encoding="utf-8")
+        return p
+
+    def to_dict(self) -> dict[str, Any]:
+        return {
+            "summary": {k: self.totals[k].to_dict() for k in METRICS},
+            "files": [f.to_dict() for f in self.files],
+        }
+
+
+def load_model(path: Path) -> CoverageModel | None:
+    try:
+        if Path(path).exists():
+            return CoverageModel.load(path)
+    except Exception:
+        pass
+    return None
+
+
+# ----------------------------
+# collection
+# ----------------------------
+def _needs_ignore_retry(text: str) -> bool:
+    t = text.lower()
+    return "no_working_dir_found" in t or "could not infer a working directory" in t or "gcov produced the following errors" in t
+
+
+def gcovr_command(
+    root: Path,
+    *,
+    json_path: Path,
+    object_dir: Path | None = None,
+    gcov_exe: str | None = None,
+    html_path: Path | None = None,
+    extra_args: Iterable[str] = (),
+    search_paths: Iterable[Path] = (),
+    jobs: int | None = None,
+) -> list[str]:
+    cmd = [sys.executable, "-m", "gcovr", "-r", str(root), "-j", str(jobs or gcov_jobs())]
+    if object_dir:
+        cmd += ["--object-directory", str(object_dir)]
+    if gcov_exe:
+        cmd += ["--gcov-executable", str(gcov_exe)]
+    cmd += list(extra_args)
+    # 同一次 gcov 运行同时输出 JSON（模型）和 HTML，不再为报告单独跑一遍 gcov
+    cmd.append(f"--json={json_path}")
+    if html_path:
+        cmd.append(f"--html-details={html_path}")
+    # 只在这些目录里找 .gcda（默认整个 root）
+    cmd += [str(p) for p in search_paths]
+    return cmd
+
+
+def collect(
+    root: Path,
+    *,
+    cwd: Path | None = None,
+    object_dir: Path | None = None,
+    gcov_exe: str | None = None,
+    json_path: Path | None = None,
+    html_path: Path | None = None,
+    extra_args: Iterable[str] = (),
+    search_paths: Iterable[Path] = (),
+    jobs: int | None = None,
+    timeout_s: float = 300.0,
+) -> tuple[CoverageModel | None, dict[str, Any]]:
+    """
+    Run gcovr once with `-j` and parse its JSON into a CoverageModel.
+
+    json_path None writes to a temporary file that is removed afterwards.
+    When gcov cannot infer working dirs (common for moc_/qrc_ objects), the
+    pass is retried once with --gcov-ignore-errors=no_working_dir_found.
+    Returns (model or None, meta with cmd/returncode/output/duration_s).
+    """
+    extra = list(extra_args)
+    search = list(search_paths)
+    tmp: Path | None = None
+    if json_path is None:
+        fd, name = tempfile.mkstemp(prefix="qt_test_ai_cov_", suffix=".json")
+        os.close(fd)
+        tmp = json_path = Path(name)
+    n = jobs or gcov_jobs()
+    meta: dict[str, Any] = {"jobs": n, "json": None if tmp else str(json_path)}
+    try:
+        for attempt in range(2):
+            try:
+                Path(json_path).unlink()
+            except Exception:
+                pass
+            cmd = gcovr_command(root, json_path=json_path, object_dir=object_dir, gcov_exe=gcov_exe, html_path=html_path, extra_args=extra, search_paths=search, jobs=n)
+            meta["cmd"] = " ".join(shlex.quote(c) for c in cmd)
+            t0 = time.perf_counter()
+            try:
+                p = tracing.run(
+                    cmd,
+                    trace_cat=tracing.GCOVR,
+                    cwd=str(cwd or root),
+                    capture_output=True,
+                    text=True,
+                    errors="replace",
+                    timeout=timeout_s,
+                )
+                meta["returncode"] = p.returncode
+                meta["output"] = (p.stdout or "") + "\n" + (p.stderr or "")
+            except subprocess.TimeoutExpired:
+                meta["returncode"] = None
+                meta["timed_out"] = True
+                meta["output"] = f"gcovr 超时（{timeout_s}s）"
+            except Exception as e:
+                meta["returncode"] = None
+                meta["output"] = str(e)
+            meta["duration_s"] = round(time.perf_counter() - t0, 3)
+
+            if (
+                attempt == 0
+                and meta.get("returncode")
+                and _needs_ignore_retry(meta.get("output") or "")
+                and not any("no_working_dir_found" in a for a in extra)
+            ):
+                extra.append("--gcov-ignore-errors=no_working_dir_found")
+                meta["retried_ignore_errors"] = True
+                continue
+            break
+
+        model = load_model(Path(json_path))
+        if model is not None and html_path and Path(html_path).exists():
+            meta["html"] = str(html_path)
+        return model, meta
+    finally:
+        if tmp is not None:
+            try:
+                tmp.unlink()
+            except Exception:
+                pass
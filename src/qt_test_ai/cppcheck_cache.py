@@ -0,0 +1,176 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import re
+import time
+from pathlib import Path
+from typing import Any
+
+from .utils import cache_dir
+
+
+_CACHE_VERSION = 1
+
+_INCLUDE_RE = re.compile(rb'^[ \t]*#[ \t]*include[ \t]*[<"]([^>"\r\n]+)[>"]', re.M)
+
+
+def _is_under(path: Path, parent: Path) -> bool:
+    try:
+        path.relative_to(parent)
+        return True
+    except Exception:
+        return False
+
+
+def _sha256_bytes(data: bytes) -> str:
+    return hashlib.sha256(data).hexdigest()
+
+
+def config_key(parts: dict[str, Any]) -> str:
+    """Hash of everything (outside the sources) that changes cppcheck's answer."""
+    blob = json.dumps(parts, sort_keys=True, ensure_ascii=False).encode("utf-8")
+    return _sha256_bytes(blob)
+
+
+class CppcheckCache:
+    """
+    Per translation-unit cppcheck result cache.
+
+    Key = config hash + TU content hash + hashes of every project header the TU
+    (transitively) includes. Headers are only resolved inside the project (the
+    TU's own directory, project include dirs, project root); Qt/system headers
+    are part of the config key via the include/define set instead.
+    """
+
+    def __init__(self, project_root: Path, *, config: str, include_dirs: list[str] | None = None) -> None:
+        self.project_root = project_root.resolve()
+        self.config = config
+        self.search_dirs: list[Path] = []
+        for d in include_dirs or []:
+            try:
+                p = Path(d).resolve()
+            except Exception:
+                continue
+            if _is_under(p, self.project_root) and p.is_dir():
+                self.search_dirs.append(p)
+        if self.project_root not in self.search_dirs:
+            self.search_dirs.append(self.project_root)
+
+        tag = hashlib.sha1(str(self.project_root).lower().encode("utf-8")).hexdigest()[:10]
+        self.path = cache_dir("cppcheck") / f"{self.project_root.name}_{tag}.json"
+        self.entries: dict[str, dict] = {}
+        self._file_info: dict[Path, tuple[str, list[Path]]] = {}
+        self._dirty = False
+        self._load()
+
+    # ----------------------------
+    # persistence
+    # ----------------------------
+    def _load(self) -> None:
+        try:
+            data = json.loads(self.path.read_text(encoding="utf-8"))
+        except Exception:
+            return
+        if not isinstance(data, dict) or data.get("version") != _CACHE_VERSION:
+            return
+        entries = data.get("entries") if isinstance(data.get("entries"), dict) else {}
+        if data.get("config") != self.config:
+            # 配置变化：结果全部失效，但保留历史耗时供分片估算
+            self.entries = {k: {"cost_s": v.get("cost_s")} for k, v in entries.items() if isinstance(v, dict)}
+            self._dirty = True
+            return
+        self.entries = entries
+
+    def save(self) -> None:
+        if not self._dirty:
+            return
+        payload = {"version": _CACHE_VERSION, "config": self.config, "saved_at": time.time(), "entries": self.entries}
+        tmp = self.path.with_suffix(".tmp")
+        try:
+            tmp.write_text(json.dumps(payload, ensure_ascii=False), encoding="utf-8")
+            os.replace(tmp, self.path)
+            self._dirty = False
+        except Exception:
+            pass
+
+    # ----------------------------
+    # keys
+    # ----------------------------
+    def rel(self, tu: Path) -> str:
+        try:
+            return tu.resolve().relative_to(self.project_root).as_posix()
+        except Exception:
+            return str(tu)
+
+    def _info(self, path: Path) -> tuple[str, list[Path]]:
+        hit = self._file_info.get(path)
+        if hit is not None:
+            return hit
+        try:
+            data = path.read_bytes()
+        except Exception:
+            info = ("missing", [])
+            self._file_info[path] = info
+            return info
+
+        deps: list[Path] = []
+        for m in _INCLUDE_RE.finditer(data):
+            name = m.group(1).decode("utf-8", errors="replace").strip()
+            for base in [path.parent, *self.search_dirs]:
+                cand = base / name
+                if cand.is_file():
+                    deps.append(cand.resolve())
+                    break
+        info = (_sha256_bytes(data), deps)
+        self._file_info[path] = info
+        return info
+
+    def key_for(self, tu: Path) -> str:
+        root = tu.resolve()
+        seen: set[Path] = set()
+        stack = [root]
+        parts: list[str] = []
+        while stack:
+            p = stack.pop()
+            if p in seen:
+                continue
+            seen.add(p)
+            digest, deps = self._info(p)
+            parts.append(f"{self.rel(p)}={digest}")
+            stack.extend(d for d in deps if d not in seen)
+        h = hashlib.sha256(self.config.encode("utf-8"))
+        for item in sorted(parts):
+            h.update(item.encode("utf-8"))
+            h.update(b"\n")
+        return h.hexdigest()
+
+    # ----------------------------
+    # entries
+    # ----------------------------
+    def get(self, tu: Path, key: str) -> str | None:
+        e = self.entries.get(self.rel(tu))
+        if isinstance(e, dict) and e.get("key") == key and isinstance(e.get("output"), str):
+            return e["output"]
+        return None
+
+    def put(self, tu: Path, key: str, output: str, *, cost_s: float) -> None:
+        self.entries[self.rel(tu)] = {"key": key, "output": output, "cost_s": round(float(cost_s), 4)}
+        self._dirty = True
+
+    def cost(self, tu: Path) -> float | None:
+        e = self.entries.get(self.rel(tu))
+        try:
+            return float(e.get("cost_s")) if isinstance(e, dict) and e.get("cost_s") is not None else None
+        except Exception:
+            return None
+
+    def prune(self, keep: list[Path]) -> None:
+        """Forget TUs that no longer exist in the project."""
+        wanted = {self.rel(p) for p in keep}
+        stale = [k for k in self.entries if k not in wanted]
+        for k in stale:
+            del self.entries[k]
+        if stale:
+            self._dirty = True
@@ -1,18 +1,226 @@
 from __future__ import annotations
 
 import json
+import re
 import sqlite3
-from dataclasses import asdict
+import zlib
 from datetime import datetime
 from pathlib import Path
+from typing import Any, Iterator
 
 from .models import Finding, TestRun
 
+DEFAULT_DB_PATH = Path.home() / ".qt_test_ai" / "runs.sqlite3"
+# PRAGMA user_version：1 = 只有 test_runs；2 = 规范化指标表；3 = 压缩存储、发现项移入子表
+SCHEMA_VERSION = 3
+# test_runs.storage：1 = meta / findings 为 JSON 文本；2 = meta 为 zlib 压缩 JSON，发现项在 findings 表
+STORAGE_INLINE = 1
+STORAGE_PACKED = 2
+
+_SCHEMA = """
+CREATE TABLE IF NOT EXISTS findings (
+    run_id INTEGER NOT NULL REFERENCES test_runs(id) ON DELETE CASCADE,
+    project_root TEXT NOT NULL,
+    created_at TEXT NOT NULL,
+    category TEXT NOT NULL,
+    severity TEXT NOT NULL,
+    title TEXT NOT NULL,
+    file TEXT,
+    line INTEGER,
+    rule_id TEXT,
+    ord INTEGER,
+    details BLOB
+);
+CREATE INDEX IF NOT EXISTS idx_findings_run ON findings(run_id, ord);
+CREATE INDEX IF NOT EXISTS idx_findings_trend ON findings(project_root, created_at, file);
+
+CREATE TABLE IF NOT EXISTS coverage_files (
+    run_id INTEGER NOT NULL REFERENCES test_runs(id) ON DELETE CASCADE,
+    project_root TEXT NOT NULL,
+    created_at TEXT NOT NULL,
+    file TEXT NOT NULL,
+    lines_covered INTEGER, lines_total INTEGER,
+    functions_covered INTEGER, functions_total INTEGER,
+    branches_covered INTEGER, branches_total INTEGER
+);
+CREATE INDEX IF NOT EXISTS idx_coverage_run ON coverage_files(run_id);
+CREATE INDEX IF NOT EXISTS idx_coverage_trend ON coverage_files(project_root, created_at, file);
+CREATE INDEX IF NOT EXISTS idx_coverage_file ON coverage_files(project_root, file, created_at);
+
+CREATE TABLE IF NOT EXISTS test_durations (
+    run_id INTEGER NOT NULL REFERENCES test_runs(id) ON DELETE CASCADE,
+    project_root TEXT NOT NULL,
+    created_at TEXT NOT NULL,
+    test_class TEXT,
+    test TEXT NOT NULL,
+    status TEXT,
+    duration_ms REAL
+);
+CREATE INDEX IF NOT EXISTS idx_durations_run ON test_durations(run_id);
+CREATE INDEX IF NOT EXISTS idx_durations_trend ON test_durations(project_root, created_at, test);
+CREATE INDEX IF NOT EXISTS idx_durations_test ON test_durations(project_root, test, created_at);
+
+CREATE TABLE IF NOT EXISTS smoke_metrics (
+    run_id INTEGER NOT NULL REFERENCES test_runs(id) ON DELETE CASCADE,
+    project_root TEXT NOT NULL,
+    created_at TEXT NOT NULL,
+    exe_path TEXT,
+    startup_ms REAL,
+    startup_source TEXT,
+    rss_p50 REAL, rss_p95 REAL, rss_peak REAL,
+    cpu_p50 REAL, cpu_p95 REAL, cpu_peak REAL,
+    handles_peak REAL, threads_peak REAL,
+    samples INTEGER
+);
+CREATE INDEX IF NOT EXISTS idx_smoke_run ON smoke_metrics(run_id);
+CREATE INDEX IF NOT EXISTS idx_smoke_trend ON smoke_metrics(project_root, created_at);
+
+CREATE TABLE IF NOT EXISTS benchmark_results (
+    run_id INTEGER REFERENCES test_runs(id) ON DELETE CASCADE,
+    project_root TEXT NOT NULL,
+    created_at TEXT NOT NULL,
+    function TEXT NOT NULL,
+    tag TEXT NOT NULL,
+    metric TEXT,
+    backend TEXT,
+    value REAL,
+    iterations INTEGER
+);
+CREATE INDEX IF NOT EXISTS idx_bench_run ON benchmark_results(run_id);
+CREATE INDEX IF NOT EXISTS idx_bench_trend ON benchmark_results(project_root, created_at, function);
+CREATE INDEX IF NOT EXISTS idx_bench_function ON benchmark_results(project_root, function, tag, created_at);
+
+CREATE INDEX IF NOT EXISTS idx_runs_trend ON test_runs(project_root, created_at);
+"""
+
+# 趋势查询可用的指标：(SQL, 显示名, 数值越大越差)
+# SQL 的参数依次是 project_root、limit；每行 (run_id, created_at, value)
+TREND_METRICS: dict[str, tuple[str, str, bool]] = {
+    "line_coverage": (
+        "SELECT id, created_at, line_coverage FROM test_runs WHERE project_root=? AND line_coverage IS NOT NULL ORDER BY created_at DESC LIMIT ?",
+        "行覆盖率 %",
+        False,
+    ),
+    "startup_ms": (
+        "SELECT run_id, created_at, startup_ms FROM smoke_metrics WHERE project_root=? AND startup_ms IS NOT NULL ORDER BY created_at DESC LIMIT ?",
+        "启动耗时 ms",
+        True,
+    ),
+    "rss_p95": (
+        "SELECT run_id, created_at, rss_p95 FROM smoke_metrics WHERE project_root=? AND rss_p95 IS NOT NULL ORDER BY created_at DESC LIMIT ?",
+        "内存 p95 MB",
+        True,
+    ),
+    "cpu_p95": (
+        "SELECT run_id, created_at, cpu_p95 FROM smoke_metrics WHERE project_root=? AND cpu_p95 IS NOT NULL ORDER BY created_at DESC LIMIT ?",
+        "CPU p95 %",
+        True,
+    ),
+    "test_time_ms": (
+        "SELECT run_id, created_at, SUM(duration_ms) FROM test_durations WHERE project_root=? GROUP BY run_id ORDER BY created_at DESC LIMIT ?",
+        "测试总耗时 ms",
+        True,
+    ),
+    "failed_tests": (
+        "SELECT run_id, created_at, SUM(status IN ('fail', 'crash')) FROM test_durations WHERE project_root=? GROUP BY run_id ORDER BY created_at DESC LIMIT ?",
+        "失败测试数",
+        True,
+    ),
+    "error_count": (
+        "SELECT id, created_at, error_count FROM test_runs WHERE project_root=? ORDER BY created_at DESC LIMIT ?",
+        "错误数",
+        True,
+    ),
+}
+
+
+def _pack(obj: Any) -> bytes:
+    return zlib.compress(json.dumps(obj, ensure_ascii=False).encode("utf-8"), 6)
+
+
+def _unpack(value: Any) -> Any:
+    """Decode a stored JSON value: zlib BLOB (storage 2) or plain TEXT (storage 1)."""
+    if value is None or value == "":
+        return None
+    if isinstance(value, (bytes, memoryview)):
+        return json.loads(zlib.decompress(bytes(value)).decode("utf-8"))
+    return json.loads(value)
+
+
+def _columns(conn: sqlite3.Connection, table: str) -> set[str]:
+    return {r[1] for r in conn.execute(f"PRAGMA table_info({table})")}
+
+
+def _inline_run(row: tuple) -> TestRun | None:
+    rid, created_at, project_root, exe_path, meta_json, findings_json = row
+    try:
+        return TestRun(
+            project_root=project_root,
+            exe_path=exe_path,
+            created_at=datetime.fromisoformat(created_at),
+            findings=[Finding(**fr) for fr in json.loads(findings_json)],
+            meta=json.loads(meta_json),
+        )
+    except Exception:
+        return None
+
+
+def _migrate(conn: sqlite3.Connection) -> None:
+    version = int(conn.execute("PRAGMA user_version").fetchone()[0])
+    if version >= SCHEMA_VERSION:
+        return
+    cols = _columns(conn, "test_runs")
+    if "line_coverage" not in cols:
+        conn.execute("ALTER TABLE test_runs ADD COLUMN line_coverage REAL")
+    if "storage" not in cols:
+        conn.execute(f"ALTER TABLE test_runs ADD COLUMN storage INTEGER DEFAULT {STORAGE_INLINE}")
+    if "findings" in {r[0] for r in conn.execute("SELECT name FROM sqlite_master WHERE type='table'")}:
+        fcols = _columns(conn, "findings")
+        if "ord" not in fcols:
+            conn.execute("ALTER TABLE findings ADD COLUMN ord INTEGER")
+            conn.execute("ALTER TABLE findings ADD COLUMN details BLOB")
+            conn.execute("DROP INDEX IF EXISTS idx_findings_run")
+    conn.executescript(_SCHEMA)
+
+    # 一次性迁移：旧记录的 JSON 只在这里解码一次。v1 回填指标表；v1/v2 的发现项
+    # 改存 findings 子表（v2 回填的行没有 ord / details，先删掉重建），meta 压缩
+    select = "SELECT id, created_at, project_root, exe_path, meta_json, findings_json FROM test_runs WHERE storage=? AND id>? ORDER BY id LIMIT 200"
+    last = 0
+    migrated = 0
+    while True:
+        rows = conn.execute(select, (STORAGE_INLINE, last)).fetchall()
+        if not rows:
+            break
+        for row in rows:
+            last = int(row[0])
+            run = _inline_run(row)
+            if run is None:
+                continue
+            if version < 2:
+                _insert_metrics(conn, last, run)
+            conn.execute("DELETE FROM findings WHERE run_id=?", (last,))
+            _insert_findings(conn, last, run)
+            conn.execute(
+                "UPDATE test_runs SET meta_json=?, findings_json='', storage=? WHERE id=?",
+                (_pack(run.meta), STORAGE_PACKED, last),
+            )
+            migrated += 1
+        conn.commit()
+    conn.execute(f"PRAGMA user_version={SCHEMA_VERSION}")
+    conn.commit()
+    if migrated:
+        # 回收未压缩 JSON 留下的空闲页；只在迁移时做一次
+        try:
+            conn.execute("VACUUM")
+        except sqlite3.OperationalError:
+            pass
+
 
 def open_db(db_path: Path) -> sqlite3.Connection:
     db_path.parent.mkdir(parents=True, exist_ok=True)
     conn = sqlite3.connect(str(db_path))
     conn.execute("PRAGMA journal_mode=WAL;")
+    conn.execute("PRAGMA foreign_keys=ON;")
     conn.execute(
         """
         CREATE TABLE IF NOT EXISTS test_runs (
@@ -28,7 +236,7 @@ def open_db(db_path: Path) -> sqlite3.Connection:
         );
         """
     )
-    
+
     # Auto-migration: check if columns exist, if not add them
     try:
         conn.execute("SELECT total_findings FROM test_runs LIMIT 1")
@@ -36,45 +244,174 @@ def open_db(db_path: Path) -> sqlite3.Connection:
         conn.execute("ALTER TABLE test_runs ADD COLUMN total_findings INTEGER DEFAULT 0")
         conn.execute("ALTER TABLE test_runs ADD COLUMN error_count INTEGER DEFAULT 0")
         conn.execute("ALTER TABLE test_runs ADD COLUMN warning_count INTEGER DEFAULT 0")
-        
+
+    _migrate(conn)
     return conn
 
 
+# ----------------------------
+# extraction from run meta
+# ----------------------------
+def _pct(value: Any) -> float | None:
+    if isinstance(value, (int, float)):
+        return float(value)
+    m = re.match(r"\s*([0-9]+(?:\.[0-9]+)?)", str(value or ""))
+    return float(m.group(1)) if m else None
+
+
+def line_coverage(meta: dict[str, Any]) -> float | None:
+    cov = meta.get("coverage") or {}
+    return _pct((cov.get("coverage_summary") or {}).get("lines") or cov.get("summary"))
+
+
+def _smoke_row(smoke: dict[str, Any]) -> dict[str, Any] | None:
+    if not smoke:
+        return None
+    prof = smoke.get("profile")
+    if prof:
+        st = prof.get("startup") or {}
+
+        def g(metric: str, stat: str) -> Any:
+            return (prof.get(metric) or {}).get(stat)
+
+        return {
+            "startup_ms": st.get("ready_ms") if st.get("ready_ms") is not None else st.get("alive_ms"),
+            "startup_source": st.get("source"),
+            "rss_p50": g("rss_mb", "p50"), "rss_p95": g("rss_mb", "p95"), "rss_peak": g("rss_mb", "peak"),
+            "cpu_p50": g("cpu_percent", "p50"), "cpu_p95": g("cpu_percent", "p95"), "cpu_peak": g("cpu_percent", "peak"),
+            "handles_peak": g("handles", "peak"), "threads_peak": g("threads", "peak"),
+            "samples": g("rss_mb", "n"),
+        }
+    # 普通冒烟测试：只有少量样本，同样折算成分位数
+    from .startup_profile import summarize
+
+    rss = summarize([float(v) for v in smoke.get("memory_samples_mb") or []])
+    cpu = summarize([float(v) for v in smoke.get("cpu_samples") or []])
+    if not smoke.get("alive"):
+        return None
+    return {
+        "startup_ms": round(float(smoke.get("startup_time_s") or 0) * 1000.0, 1),
+        "startup_source": "liveness",
+        "rss_p50": rss["p50"], "rss_p95": rss["p95"], "rss_peak": rss["peak"],
+        "cpu_p50": cpu["p50"], "cpu_p95": cpu["p95"], "cpu_peak": cpu["peak"],
+        "handles_peak": None, "threads_peak": None,
+        "samples": rss["n"],
+    }
+
+
+def _insert_findings(conn: sqlite3.Connection, run_id: int, run: TestRun) -> None:
+    # 列表视图只需要表头列；details / evidence（常含整段 stdout）压缩存放，打开时才解码
+    created = run.created_at.isoformat(timespec="seconds")
+    conn.executemany(
+        "INSERT INTO findings(run_id, project_root, created_at, category, severity, title, file, line, rule_id, ord, details) "
+        "VALUES(?,?,?,?,?,?,?,?,?,?,?)",
+        [
+            (
+                run_id, run.project_root, created, f.category, f.severity, f.title, f.file, f.line, f.rule_id, i,
+                _pack({"details": f.details, "evidence": f.evidence}) if (f.details or f.evidence) else None,
+            )
+            for i, f in enumerate(run.findings)
+        ],
+    )
+
+
+def _insert_metrics(conn: sqlite3.Connection, run_id: int, run: TestRun) -> None:
+    created = run.created_at.isoformat(timespec="seconds")
+    root = run.project_root
+    meta = run.meta or {}
+    conn.execute("UPDATE test_runs SET line_coverage=? WHERE id=?", (line_coverage(meta), run_id))
+
+    files = (meta.get("coverage") or {}).get("coverage_per_file") or []
+    conn.executemany(
+        "INSERT INTO coverage_files(run_id, project_root, created_at, file, lines_covered, lines_total, "
+        "functions_covered, functions_total, branches_covered, branches_total) VALUES(?,?,?,?,?,?,?,?,?,?)",
+        [
+            (
+                run_id, root, created, f.get("file"),
+                *((f.get(m) or {}).get(k) for m in ("lines", "functions", "branches") for k in ("covered", "total")),
+            )
+            for f in files
+            if f.get("file")
+        ],
+    )
+
+    tests = ((meta.get("tests") or {}).get("test_results") or {}).get("functions") or []
+    conn.executemany(
+        "INSERT INTO test_durations(run_id, project_root, created_at, test_class, test, status, duration_ms) VALUES(?,?,?,?,?,?,?)",
+        [(run_id, root, created, t.get("cls"), t.get("name"), t.get("status"), t.get("duration_ms")) for t in tests if t.get("name")],
+    )
+
+    smoke = _smoke_row(meta.get("dynamic_smoke") or {})
+    if smoke:
+        conn.execute(
+            f"INSERT INTO smoke_metrics(run_id, project_root, created_at, exe_path, {', '.join(smoke)}) VALUES(?,?,?,?,{','.join('?' * len(smoke))})",
+            (run_id, root, created, run.exe_path, *smoke.values()),
+        )
+
+    # UI 负载回放 / 模糊测试阶段的 {"backend", "results"}，与 `main.py bench` 的独立记录同表
+    for stage in ("dynamic_ui_load", "fuzz"):
+        bench = (meta.get(stage) or {}).get("benchmarks") or {}
+        if bench.get("results"):
+            _insert_benchmarks(conn, run_id, root, created, bench.get("backend"), bench["results"])
+
+
+def _insert_benchmarks(conn: sqlite3.Connection, run_id: int | None, project_root: str, created_at: str, backend: str | None, results: dict[str, Any]) -> None:
+    conn.executemany(
+        "INSERT INTO benchmark_results(run_id, project_root, created_at, function, tag, metric, backend, value, iterations) VALUES(?,?,?,?,?,?,?,?,?)",
+        [
+            (run_id, project_root, created_at, fn, tag, r.get("metric"), backend, r.get("value"), r.get("iterations"))
+            for fn, rows in results.items()
+            for tag, r in rows.items()
+        ],
+    )
+
+
 def save_run(conn: sqlite3.Connection, run: TestRun) -> int:
-    findings_json = json.dumps([asdict(f) for f in run.findings], ensure_ascii=False)
-    meta_json = json.dumps(run.meta, ensure_ascii=False)
-    
     # Calculate stats
     total = len(run.findings)
     err = sum(1 for f in run.findings if f.severity == "error")
     warn = sum(1 for f in run.findings if f.severity == "warning")
-    
+
     cur = conn.execute(
         """
         INSERT INTO test_runs(
             created_at, project_root, exe_path, meta_json, findings_json,
-            total_findings, error_count, warning_count
-        ) VALUES(?,?,?,?,?,?,?,?)
+            total_findings, error_count, warning_count, storage
+        ) VALUES(?,?,?,?,?,?,?,?,?)
         """,
         (
             run.created_at.isoformat(timespec="seconds"),
             run.project_root,
             run.exe_path,
-            meta_json,
-            findings_json,
+            _pack(run.meta),
+            "",
             total,
             err,
-            warn
+            warn,
+            STORAGE_PACKED,
         ),
     )
+    rid = int(cur.lastrowid)
+    _insert_findings(conn, rid, run)
+    try:
+        _insert_metrics(conn, rid, run)
+    except Exception:
+        # 指标表只是索引；写失败不影响记录本身
+        pass
     conn.commit()
-    return int(cur.lastrowid)
+    return rid
 
 
-def list_runs(conn: sqlite3.Connection, limit: int = 50) -> list[tuple[int, datetime, str, str | None]]:
+def save_benchmarks(conn: sqlite3.Connection, project_root: str, backend: str | None, results: dict[str, Any], created_at: datetime | None = None) -> None:
+    """Store a standalone benchmark run (e.g. `main.py bench`), not attached to a test run."""
+    _insert_benchmarks(conn, None, project_root, (created_at or datetime.now()).isoformat(timespec="seconds"), backend, results)
+    conn.commit()
+
+
+def list_runs(conn: sqlite3.Connection, limit: int = 50, before_id: int | None = None) -> list[tuple[int, datetime, str, str | None]]:
     rows = conn.execute(
-        "SELECT id, created_at, project_root, exe_path FROM test_runs ORDER BY id DESC LIMIT ?",
-        (limit,),
+        "SELECT id, created_at, project_root, exe_path FROM test_runs WHERE id < ? ORDER BY id DESC LIMIT ?",
+        (before_id if before_id is not None else 2**62, limit),
     ).fetchall()
     out = []
     for rid, created_at, project_root, exe_path in rows:
@@ -82,17 +419,136 @@ def list_runs(conn: sqlite3.Connection, limit: int = 50) -> list[tuple[int, date
     return out
 
 
-def load_run(conn: sqlite3.Connection, run_id: int) -> TestRun:
+def list_run_summaries(conn: sqlite3.Connection, limit: int = 50, before_id: int | None = None) -> list[dict[str, Any]]:
+    """
+    One page of runs, newest first, with counters, coverage and startup time, without touching the blobs.
+
+    Keyset pagination: pass the last `id` of a page as `before_id` to get the
+    next one, so every page is an index range scan whatever the history size.
+    """
+    rows = conn.execute(
+        """
+        SELECT r.id, r.created_at, r.project_root, r.exe_path, r.error_count, r.warning_count, r.line_coverage,
+               (SELECT s.startup_ms FROM smoke_metrics s WHERE s.run_id = r.id LIMIT 1)
+        FROM test_runs r WHERE r.id < ? ORDER BY r.id DESC LIMIT ?
+        """,
+        (before_id if before_id is not None else 2**62, limit),
+    ).fetchall()
+    keys = ("id", "created_at", "project_root", "exe_path", "errors", "warnings", "line_coverage", "startup_ms")
+    out = []
+    for row in rows:
+        d = dict(zip(keys, row))
+        d["created_at"] = datetime.fromisoformat(d["created_at"])
+        out.append(d)
+    return out
+
+
+def project_roots(conn: sqlite3.Connection) -> list[str]:
+    return [r[0] for r in conn.execute("SELECT project_root FROM test_runs GROUP BY project_root ORDER BY MAX(created_at) DESC")]
+
+
+def trend(conn: sqlite3.Connection, project_root: str, metric: str, limit: int = 200) -> list[tuple[int | None, datetime, float]]:
+    """Oldest-first (run_id, created_at, value) series of one TREND_METRICS metric."""
+    sql = TREND_METRICS[metric][0]
+    rows = conn.execute(sql, (project_root, limit)).fetchall()
+    return [(rid, datetime.fromisoformat(at), float(v)) for rid, at, v in reversed(rows) if v is not None]
+
+
+def file_coverage_trend(conn: sqlite3.Connection, project_root: str, file: str, limit: int = 200) -> list[tuple[int, datetime, float]]:
+    rows = conn.execute(
+        "SELECT run_id, created_at, lines_covered, lines_total FROM coverage_files "
+        "WHERE project_root=? AND file=? ORDER BY created_at DESC LIMIT ?",
+        (project_root, file, limit),
+    ).fetchall()
+    return [(rid, datetime.fromisoformat(at), round(100.0 * c / t, 1)) for rid, at, c, t in reversed(rows) if t]
+
+
+def test_duration_trend(conn: sqlite3.Connection, project_root: str, test: str, limit: int = 200) -> list[tuple[int, datetime, float]]:
+    rows = conn.execute(
+        "SELECT run_id, created_at, SUM(duration_ms) FROM test_durations "
+        "WHERE project_root=? AND test=? GROUP BY run_id ORDER BY created_at DESC LIMIT ?",
+        (project_root, test, limit),
+    ).fetchall()
+    return [(rid, datetime.fromisoformat(at), float(v)) for rid, at, v in reversed(rows) if v is not None]
+
+
+def benchmark_trend(conn: sqlite3.Connection, project_root: str, function: str, tag: str, limit: int = 200) -> list[tuple[int | None, datetime, float]]:
+    rows = conn.execute(
+        "SELECT run_id, created_at, value FROM benchmark_results "
+        "WHERE project_root=? AND function=? AND tag=? ORDER BY created_at DESC LIMIT ?",
+        (project_root, function, tag, limit),
+    ).fetchall()
+    return [(rid, datetime.fromisoformat(at), float(v)) for rid, at, v in reversed(rows) if v is not None]
+
+
+def regressions(
+    series: list[tuple[Any, datetime, float]], *, higher_is_worse: bool = True, pct: float = 10.0, window: int = 5
+) -> list[dict[str, Any]]:
+    """Points that are worse than the median of the preceding `window` points by more than `pct` percent."""
+    out: list[dict[str, Any]] = []
+    for i in range(1, len(series)):
+        prev = sorted(v for _, _, v in series[max(0, i - window):i])
+        base = prev[len(prev) // 2]
+        rid, at, v = series[i]
+        if base == 0:
+            continue
+        change = (v - base) / abs(base) * 100.0
+        if (change if higher_is_worse else -change) > pct:
+            out.append({"run_id": rid, "created_at": at, "value": v, "baseline": base, "change_pct": round(change, 1)})
+    return out
+
+
+def coverage_drops(conn: sqlite3.Connection, project_root: str, min_drop: float = 1.0) -> list[dict[str, Any]]:
+    """Files whose line coverage fell between the two latest runs that recorded per-file coverage."""
+    ids = [r[0] for r in conn.execute(
+        "SELECT run_id FROM coverage_files WHERE project_root=? GROUP BY run_id ORDER BY MAX(created_at) DESC LIMIT 2",
+        (project_root,),
+    )]
+    if len(ids) < 2:
+        return []
+    rows = conn.execute(
+        """
+        SELECT cur.file,
+               100.0 * prev.lines_covered / prev.lines_total,
+               100.0 * cur.lines_covered / cur.lines_total
+        FROM coverage_files cur JOIN coverage_files prev ON prev.file = cur.file AND prev.run_id = ?
+        WHERE cur.run_id = ? AND cur.lines_total > 0 AND prev.lines_total > 0
+        """,
+        (ids[1], ids[0]),
+    ).fetchall()
+    return sorted(
+        ({"file": f, "previous": round(p, 1), "current": round(c, 1), "drop": round(p - c, 1)} for f, p, c in rows if p - c >= min_drop),
+        key=lambda d: -d["drop"],
+    )
+
+
+def load_run(conn: sqlite3.Connection, run_id: int, *, details: bool = True) -> TestRun:
+    """
+    Rebuild a stored run.
+
+    details=False leaves every Finding's details / evidence empty; fetch them
+    per row with load_finding_details() when the row is opened.
+    """
     row = conn.execute(
-        "SELECT created_at, project_root, exe_path, meta_json, findings_json FROM test_runs WHERE id=?",
+        "SELECT created_at, project_root, exe_path, meta_json, findings_json, storage FROM test_runs WHERE id=?",
         (run_id,),
     ).fetchone()
     if not row:
         raise KeyError(f"run_id not found: {run_id}")
-    created_at_s, project_root, exe_path, meta_json, findings_json = row
-    findings_raw = json.loads(findings_json)
-    findings = [Finding(**fr) for fr in findings_raw]
-    meta = json.loads(meta_json)
+    created_at_s, project_root, exe_path, meta_json, findings_json, storage = row
+    if storage == STORAGE_PACKED:
+        findings = []
+        cols = "category, severity, title, file, line, rule_id" + (", details" if details else "")
+        for r in conn.execute(f"SELECT {cols} FROM findings WHERE run_id=? ORDER BY ord", (run_id,)):
+            f = Finding(category=r[0], severity=r[1], title=r[2], file=r[3], line=r[4], rule_id=r[5])
+            if details and r[6] is not None:
+                d = _unpack(r[6]) or {}
+                f.details = d.get("details") or ""
+                f.evidence = d.get("evidence") or {}
+            findings.append(f)
+    else:
+        findings = [Finding(**fr) for fr in json.loads(findings_json)]
+    meta = _unpack(meta_json) or {}
     return TestRun(
         project_root=project_root,
         exe_path=exe_path,
@@ -102,8 +558,38 @@ def load_run(conn: sqlite3.Connection, run_id: int) -> TestRun:
     )
 
 
+def iter_findings(conn: sqlite3.Connection, run_id: int) -> Iterator[Finding]:
+    """Yield a run's findings with details, decoding one row at a time (streaming export)."""
+    row = conn.execute("SELECT findings_json, storage FROM test_runs WHERE id=?", (run_id,)).fetchone()
+    if not row:
+        raise KeyError(f"run_id not found: {run_id}")
+    if row[1] != STORAGE_PACKED:
+        yield from (Finding(**fr) for fr in json.loads(row[0]))
+        return
+    cur = conn.execute(
+        "SELECT category, severity, title, file, line, rule_id, details FROM findings WHERE run_id=? ORDER BY ord",
+        (run_id,),
+    )
+    for r in cur:
+        d = _unpack(r[6]) or {}
+        yield Finding(
+            category=r[0], severity=r[1], title=r[2], file=r[3], line=r[4], rule_id=r[5],
+            details=d.get("details") or "", evidence=d.get("evidence") or {},
+        )
+
+
+def load_finding_details(conn: sqlite3.Connection, run_id: int, index: int) -> tuple[str, dict[str, Any]]:
+    """(details, evidence) of the `index`-th finding of a run, decoded on demand."""
+    row = conn.execute("SELECT details FROM findings WHERE run_id=? AND ord=?", (run_id, index)).fetchone()
+    d = (_unpack(row[0]) if row else None) or {}
+    return d.get("details") or "", d.get("evidence") or {}
+
+
 def delete_run(conn: sqlite3.Connection, run_id: int) -> bool:
     """Delete a test run by ID. Returns True if deleted, False if not found."""
+    # 指标表对旧库可能没有外键级联（ALTER 不能补外键），显式删除
+    for table in ("findings", "coverage_files", "test_durations", "smoke_metrics", "benchmark_results"):
+        conn.execute(f"DELETE FROM {table} WHERE run_id=?", (run_id,))
     cur = conn.execute("DELETE FROM test_runs WHERE id=?", (run_id,))
     conn.commit()
     return cur.rowcount > 0
@@ -0,0 +1,875 @@
+from __future__ import annotations
+
+import hmac
+import ipaddress
+import itertools
+import json
+import re
+import os
+import platform
+import shutil
+import socket
+import tempfile
+import threading
+import time
+import traceback
+import urllib.error
+import urllib.request
+import zipfile
+from dataclasses import asdict
+from datetime import datetime
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from typing import Any, Callable
+from urllib.parse import parse_qs, quote, unquote, urlparse
+
+from . import artifact_store, coverage_build
+from . import db as dbmod
+from .models import Finding, TestRun
+
+# 协调端把每个作业当成一次普通运行写进 db.py：stage -> TestRun.meta 里的键
+STAGES = {"static": "static", "tests": "tests", "coverage": "coverage", "full_cycle": "full_cycle"}
+DEFAULT_PORT = 8765
+TOKEN_HEADER = "X-Qt-Test-AI-Token"
+STATE_FILE = "jobs.json"
+# 作业 params.env 只能改这些开关 / 数值设置。命令类（QT_TEST_AI_TEST_CMD、_COVERAGE_CMD、_MAKE_CMD 等以 shell=True 执行）
+# 和路径类变量不在其中：能提交作业的人不能借此在 agent 上执行任意命令
+JOB_ENV_ALLOWLIST = frozenset(
+    {
+        "QT_TEST_AI_AGGREGATE",
+        "QT_TEST_AI_AUTO_COVERAGE",
+        "QT_TEST_AI_BUILD_JOBS",
+        "QT_TEST_AI_CCACHE",
+        "QT_TEST_AI_COVERAGE_CLEAN_BEFORE",
+        "QT_TEST_AI_COVERAGE_TIMEOUT_S",
+        "QT_TEST_AI_CPPCHECK_CACHE",
+        "QT_TEST_AI_CPPCHECK_JOBS",
+        "QT_TEST_AI_GCOV_JOBS",
+        "QT_TEST_AI_INCREMENTAL_BUILD",
+        "QT_TEST_AI_LLM_CACHE",
+        "QT_TEST_AI_LLM_STREAM",
+        "QT_TEST_AI_PCH",
+        "QT_TEST_AI_PER_TEST_COVERAGE",
+        "QT_TEST_AI_QUARANTINE",
+        "QT_TEST_AI_RERUN_COUNT",
+        "QT_TEST_AI_TESTGEN_CASE_LIMIT",
+        "QT_TEST_AI_TESTGEN_CONCURRENCY",
+        "QT_TEST_AI_TESTGEN_FILE_LIMIT",
+        "QT_TEST_AI_TEST_SELECTION",
+        "QT_TEST_AI_TEST_SHARDS",
+        "QT_TEST_AI_TEST_TIMEOUT_S",
+        "QT_TEST_AI_TRACE",
+    }
+)
+# 开关 / 数值 / 短名字；不允许空格、引号和 shell 元字符
+_SAFE_VALUE_RE = re.compile(r"^[\w.,:+\-]{0,64}$")
+# tests 阶段的 params.args 会拼进测试命令（shell=True）：只放行 QtTest 风格的参数
+_SAFE_ARG_RE = re.compile(r"^[\w.,:=/+\-]{1,200}$")
+# 工程名会拼进制品库命名空间 distributed/<project>/<stage>：必须以字母数字开头，不含路径分隔符（排除 ".."）
+_SAFE_NAME_RE = re.compile(r"^\w[\w.+\-]{0,63}$")
+# 上传的单个制品上限；.gcda 包通常只有几 MB
+_MAX_UPLOAD = 512 * 1024 * 1024
+# JSON 请求体上限（complete 里带 findings / meta，通常远小于 1 MB）
+_MAX_JSON = 32 * 1024 * 1024
+_CHUNK = 1 << 16
+
+
+def _tool_root() -> Path:
+    return Path(__file__).resolve().parents[2]
+
+
+def _num_env(name: str, default: float) -> float:
+    try:
+        return max(0.0, float((os.getenv(name) or "").strip() or default))
+    except ValueError:
+        return default
+
+
+def token() -> str:
+    """Shared secret between coordinator and agents (QT_TEST_AI_DIST_TOKEN; empty = no check, trusted network only)."""
+    return (os.getenv("QT_TEST_AI_DIST_TOKEN") or "").strip()
+
+
+def is_loopback(host: str) -> bool:
+    if host.strip().lower() == "localhost":
+        return True
+    try:
+        return ipaddress.ip_address(host.strip().strip("[]")).is_loopback
+    except ValueError:
+        return False
+
+
+def check_params(params: dict[str, Any] | None) -> dict[str, Any]:
+    """
+    Validate job params: env overrides limited to JOB_ENV_ALLOWLIST with plain values, test args without shell syntax.
+
+    Raises ValueError naming the offending entry; the coordinator rejects the
+    submission and the agent refuses the job.
+    """
+    params = dict(params or {})
+    env = params.get("env") or {}
+    if not isinstance(env, dict):
+        raise ValueError("params.env must be an object")
+    for k, v in env.items():
+        if k not in JOB_ENV_ALLOWLIST:
+            raise ValueError(f"params.env: {k} is not an allowed job setting")
+        if not _SAFE_VALUE_RE.match(str(v)):
+            raise ValueError(f"params.env: bad value for {k}")
+    args = params.get("args") or []
+    if not isinstance(args, list) or not all(isinstance(a, str) and _SAFE_ARG_RE.match(a) for a in args):
+        raise ValueError("params.args: only plain test arguments are allowed")
+    for k in ("task", "llm_service"):
+        if params.get(k) is not None and not _SAFE_VALUE_RE.match(str(params[k])):
+            raise ValueError(f"params.{k}: bad value")
+    return params
+
+
+def coordinator_url() -> str:
+    """Where agents and `dist submit` reach the coordinator (QT_TEST_AI_DIST_COORDINATOR)."""
+    return (os.getenv("QT_TEST_AI_DIST_COORDINATOR") or f"http://127.0.0.1:{DEFAULT_PORT}").strip().rstrip("/")
+
+
+def lease_s() -> float:
+    """A job whose agent sent no heartbeat for this long goes back to the queue (QT_TEST_AI_DIST_LEASE_S, default 900)."""
+    return _num_env("QT_TEST_AI_DIST_LEASE_S", 900) or 900
+
+
+def max_attempts() -> int:
+    """Dispatches per job before it is marked failed (QT_TEST_AI_DIST_MAX_ATTEMPTS, default 2)."""
+    return int(_num_env("QT_TEST_AI_DIST_MAX_ATTEMPTS", 2)) or 2
+
+
+def state_dir() -> Path:
+    return _tool_root() / "reports" / "distributed"
+
+
+# ----------------------------
+# kits and projects
+# ----------------------------
+def local_kits() -> list[dict[str, str]]:
+    """
+    Qt kits this machine can build with.
+
+    QT_TEST_AI_DIST_QMAKES lists qmake executables (';' separated, default
+    the one on PATH); the spec is QT_TEST_AI_QMAKE_SPEC, as for local builds.
+    """
+    spec = os.getenv("QT_TEST_AI_QMAKE_SPEC") or "win32-g++"
+    qmakes = [q.strip() for q in (os.getenv("QT_TEST_AI_DIST_QMAKES") or "qmake").split(";") if q.strip()]
+    kits: list[dict[str, str]] = []
+    for q in qmakes:
+        kid = coverage_build.kit_id(q)
+        path, _, version = kid.rpartition("|")
+        if version:
+            kits.append({"id": kid, "qmake": path, "qt": version, "spec": spec})
+    return kits
+
+
+def kit_matches(want: dict[str, Any] | None, kits: list[dict[str, Any]]) -> dict[str, Any] | None:
+    """First kit satisfying `want` ({qt: version prefix, spec: exact}); an empty requirement takes any kit."""
+    want = want or {}
+    if not want:
+        return kits[0] if kits else {}
+    for k in kits:
+        if want.get("qt") and not str(k.get("qt") or "").startswith(str(want["qt"])):
+            continue
+        if want.get("spec") and k.get("spec") != want["spec"]:
+            continue
+        return k
+    return None
+
+
+def local_projects(spec: list[str] | None = None) -> dict[str, str]:
+    """
+    Project checkouts this agent serves: name -> path.
+
+    From `NAME=PATH` entries (CLI --project, else QT_TEST_AI_DIST_PROJECTS
+    separated by ';'); without any, every Diagramscene_* sibling of the tool root
+    that has a .pro, named after its directory, so forks line up across machines.
+    """
+    entries = list(spec or []) or [e for e in (os.getenv("QT_TEST_AI_DIST_PROJECTS") or "").split(";") if e.strip()]
+    out: dict[str, str] = {}
+    for e in entries:
+        name, sep, path = e.partition("=")
+        if sep and name.strip() and Path(path.strip()).is_dir():
+            out[name.strip()] = str(Path(path.strip()).resolve())
+    if entries:
+        return out
+    for d in sorted(_tool_root().parent.glob("Diagramscene*")):
+        if d.is_dir() and any(d.glob("*.pro")):
+            out[d.name] = str(d.resolve())
+    return out
+
+
+# ----------------------------
+# wire format
+# ----------------------------
+def _jsonable(obj: Any) -> Any:
+    """Round-trip through JSON so Paths, datetimes and sets in stage meta survive the wire as strings."""
+    return json.loads(json.dumps(obj, ensure_ascii=False, default=str))
+
+
+def findings_to_wire(findings: list[Finding]) -> list[dict[str, Any]]:
+    return _jsonable([asdict(f) for f in findings])
+
+
+def findings_from_wire(rows: list[dict[str, Any]]) -> list[Finding]:
+    fields = set(Finding.__dataclass_fields__)
+    return [Finding(**{k: v for k, v in r.items() if k in fields}) for r in rows or []]
+
+
+# ----------------------------
+# coordinator
+# ----------------------------
+class Coordinator:
+    """
+    Job queue shared by remote agents.
+
+    Agents register their Qt kits and project checkouts, lease the oldest
+    queued job they can run, renew the lease by heartbeat, upload artifacts
+    and complete the job. Completed jobs are merged into the local db.py
+    store as one TestRun each; artifacts go to the content-addressed store
+    under distributed/<project>/<stage>. State survives a restart in
+    reports/distributed/jobs.json; jobs that were running go back to the queue.
+    """
+
+    def __init__(
+        self,
+        root: Path | None = None,
+        db_path: Path | None = None,
+        store: artifact_store.ArtifactStore | None = None,
+        project_roots: dict[str, str] | None = None,
+    ) -> None:
+        self.root = Path(root) if root else state_dir()
+        # 工程名 -> 协调端本机检出路径：合并的运行与本地运行同一个 project_root，趋势连在一起
+        self.project_roots = local_projects() if project_roots is None else project_roots
+        self.db_path = Path(db_path) if db_path else dbmod.DEFAULT_DB_PATH
+        self.store = store or artifact_store.ArtifactStore()
+        self.lock = threading.Lock()
+        self.changed = threading.Condition(self.lock)
+        self.jobs: dict[str, dict[str, Any]] = {}
+        self.workers: dict[str, dict[str, Any]] = {}
+        self._seq = itertools.count(1)
+        self._load()
+
+    # 状态文件
+    def _load(self) -> None:
+        try:
+            data = json.loads((self.root / STATE_FILE).read_text(encoding="utf-8"))
+        except Exception:
+            return
+        for j in data.get("jobs") or []:
+            if j.get("status") in ("running", "merging"):
+                j.update(status="queued", worker=None, lease_until=None)
+            self.jobs[j["id"]] = j
+
+    def _save(self) -> None:
+        self.root.mkdir(parents=True, exist_ok=True)
+        tmp = self.root / f".{STATE_FILE}.tmp"
+        tmp.write_text(json.dumps({"jobs": list(self.jobs.values())}, ensure_ascii=False, indent=1), encoding="utf-8")
+        os.replace(tmp, self.root / STATE_FILE)
+
+    def spool(self, job_id: str) -> Path:
+        return self.root / "spool" / job_id
+
+    # 作业
+    def submit(self, project: str, stage: str, params: dict[str, Any] | None = None, kit: dict[str, Any] | None = None) -> dict[str, Any]:
+        if stage not in STAGES:
+            raise ValueError(f"unknown stage {stage!r}; expected one of {', '.join(STAGES)}")
+        if not isinstance(project, str) or not _SAFE_NAME_RE.match(project):
+            raise ValueError(f"bad project name {project!r}")
+        params = check_params(params)
+        with self.lock:
+            # 作业 id 以时间开头：制品库按名字排序就是时间顺序
+            jid = f"{datetime.now().strftime('%Y%m%d_%H%M%S')}_{next(self._seq):04d}"
+            while jid in self.jobs:
+                jid = f"{jid[:15]}_{next(self._seq):04d}"
+            job = {
+                "id": jid,
+                "project": project,
+                "stage": stage,
+                "params": params or {},
+                "kit": kit or {},
+                "status": "queued",
+                "attempts": 0,
+                "worker": None,
+                "created_at": datetime.now().isoformat(timespec="seconds"),
+            }
+            self.jobs[jid] = job
+            self._save()
+            self.changed.notify_all()
+            return dict(job)
+
+    def register(self, info: dict[str, Any]) -> dict[str, Any]:
+        with self.lock:
+            wid = str(info.get("name") or "worker")
+            self.workers[wid] = {
+                "name": wid,
+                "kits": info.get("kits") or [],
+                "projects": sorted(info.get("projects") or []),
+                "platform": info.get("platform"),
+                "seen": time.time(),
+                "busy": None,
+            }
+            return {"worker_id": wid, "lease_s": lease_s()}
+
+    def _expire(self, now: float) -> None:
+        for j in self.jobs.values():
+            if j["status"] == "running" and (j.get("lease_until") or 0) < now:
+                j["log"] = (j.get("log") or []) + [f"lease of {j.get('worker')} expired"]
+                j.update(status="queued" if j["attempts"] < max_attempts() else "failed", worker=None, lease_until=None)
+                if j["status"] == "failed":
+                    j["error"] = "lease expired on every attempt"
+
+    def lease(self, worker_id: str, wait_s: float = 20.0) -> dict[str, Any] | None:
+        """Oldest queued job this worker has the project and a matching kit for; long-polls up to `wait_s`."""
+        deadline = time.time() + wait_s
+        with self.lock:
+            while True:
+                now = time.time()
+                self._expire(now)
+                w = self.workers.get(worker_id)
+                if w is None:
+                    return None
+                w["seen"] = now
+                queued = sorted((j for j in self.jobs.values() if j["status"] == "queued"), key=lambda j: j["id"])
+                for j in queued:
+                    if j["project"] not in w["projects"]:
+                        continue
+                    kit = kit_matches(j.get("kit"), w["kits"])
+                    if kit is None:
+                        continue
+                    j.update(
+                        status="running",
+                        worker=worker_id,
+                        kit_used=kit,
+                        attempts=j["attempts"] + 1,
+                        started_at=datetime.now().isoformat(timespec="seconds"),
+                        lease_until=now + lease_s(),
+                    )
+                    w["busy"] = j["id"]
+                    self._save()
+                    return dict(j)
+                if now >= deadline:
+                    return None
+                self.changed.wait(min(5.0, deadline - now))
+
+    def heartbeat(self, worker_id: str, job_id: str | None) -> bool:
+        with self.lock:
+            if worker_id in self.workers:
+                self.workers[worker_id]["seen"] = time.time()
+            j = self.jobs.get(job_id or "")
+            if not j or j["status"] != "running" or j.get("worker") != worker_id:
+                # 已被收回（租约过期后重新派发）：通知 agent 放弃
+                return False
+            j["lease_until"] = time.time() + lease_s()
+            return True
+
+    def receive_artifact(self, worker_id: str, job_id: str, name: str, stream: Any, length: int) -> int:
+        with self.lock:
+            j = self.jobs.get(job_id)
+            # 与 complete 相同：只有当前持有租约的 worker 能上传，收回后的旧 worker 不能覆盖新 worker 的制品
+            if not j or j["status"] != "running" or j.get("worker") != worker_id:
+                raise KeyError(job_id)
+        if length > _MAX_UPLOAD:
+            raise ValueError(f"artifact too large: {length}")
+        safe = Path(name).name
+        dest = self.spool(job_id) / safe
+        dest.parent.mkdir(parents=True, exist_ok=True)
+        done = 0
+        # 分块落盘，不把整个 .gcda 包读进内存
+        with open(dest.with_suffix(dest.suffix + ".part"), "wb") as f:
+            while done < length:
+                buf = stream.read(min(_CHUNK, length - done))
+                if not buf:
+                    break
+                f.write(buf)
+                done += len(buf)
+        if done != length:
+            raise IOError(f"short upload: {done}/{length}")
+        os.replace(dest.with_suffix(dest.suffix + ".part"), dest)
+        return done
+
+    def complete(self, worker_id: str, job_id: str, result: dict[str, Any]) -> dict[str, Any]:
+        with self.lock:
+            j = self.jobs.get(job_id)
+            if not j or j.get("worker") != worker_id or j["status"] != "running":
+                raise KeyError(job_id)
+            j["status"] = "merging"
+        run_id = None
+        err = None
+        try:
+            run_id, manifest = self._merge(j, result)
+        except Exception as e:
+            err = f"{type(e).__name__}: {e}"
+            manifest = None
+        with self.lock:
+            ok = result.get("status") == "ok" and err is None
+            j.update(
+                status="done" if ok else "failed",
+                finished_at=datetime.now().isoformat(timespec="seconds"),
+                duration_s=result.get("duration_s"),
+                run_id=run_id,
+                counts=result.get("counts"),
+                lease_until=None,
+                error=err or result.get("error"),
+                artifacts=sorted((manifest or {}).get("files") or {}),
+            )
+            if worker_id in self.workers and self.workers[worker_id].get("busy") == job_id:
+                self.workers[worker_id]["busy"] = None
+            self._save()
+            self.changed.notify_all()
+            return dict(j)
+
+    def _merge(self, job: dict[str, Any], result: dict[str, Any]) -> tuple[int | None, dict[str, Any] | None]:
+        """One TestRun per job in db.py; uploaded artifacts into the artifact store, then the spool is dropped."""
+        manifest = None
+        spool = self.spool(job["id"])
+        files = {p.name: p for p in sorted(spool.glob("*")) if p.is_file() and not p.name.endswith(".part")} if spool.is_dir() else {}
+        if files:
+            manifest = self.store.commit(f"distributed/{job['project']}/{job['stage']}", job["id"], files)
+        distributed = {
+            "job_id": job["id"],
+            "stage": job["stage"],
+            "worker": job.get("worker"),
+            "kit": job.get("kit_used"),
+            "worker_project_root": result.get("project_root"),
+            "attempts": job.get("attempts"),
+            "duration_s": result.get("duration_s"),
+            "artifacts": {k: v["sha256"] for k, v in ((manifest or {}).get("files") or {}).items()},
+        }
+        meta = {STAGES[job["stage"]]: result.get("meta") or {}, "distributed": distributed}
+        if result.get("error"):
+            meta["internal_error"] = str(result["error"]).splitlines()[0]
+        run = TestRun(
+            # 各机器上的检出路径不同：按协调端的路径（没有时用工程名）入库，同一工程的趋势跨机器合并
+            project_root=self.project_roots.get(job["project"], job["project"]),
+            exe_path=result.get("exe_path"),
+            created_at=datetime.now(),
+            findings=findings_from_wire(result.get("findings") or []),
+            meta=meta,
+        )
+        conn = dbmod.open_db(self.db_path)
+        try:
+            run_id = dbmod.save_run(conn, run)
+        finally:
+            conn.close()
+        shutil.rmtree(spool, ignore_errors=True)
+        return run_id, manifest
+
+    def status(self) -> dict[str, Any]:
+        with self.lock:
+            self._expire(time.time())
+            counts: dict[str, int] = {}
+            for j in self.jobs.values():
+                counts[j["status"]] = counts.get(j["status"], 0) + 1
+            return {"workers": list(self.workers.values()), "counts": counts, "jobs": sorted(self.jobs.values(), key=lambda j: j["id"])}
+
+    def drained(self) -> bool:
+        with self.lock:
+            return all(j["status"] in ("done", "failed") for j in self.jobs.values())
+
+
+def _handler(coord: Coordinator) -> type[BaseHTTPRequestHandler]:
+    class Handler(BaseHTTPRequestHandler):
+        server_version = "qt-test-ai-coordinator/1"
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt: str, *args: Any) -> None:
+            # 长轮询让访问日志太吵；错误都在响应体里
+            pass
+
+        def _send(self, code: int, body: Any) -> None:
+            data = json.dumps(body, ensure_ascii=False).encode("utf-8")
+            self.send_response(code)
+            self.send_header("Content-Type", "application/json; charset=utf-8")
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+        def _authorized(self) -> bool:
+            # 常量时间比较，不从响应时间泄露口令前缀
+            if token() and not hmac.compare_digest((self.headers.get(TOKEN_HEADER) or "").encode("utf-8"), token().encode("utf-8")):
+                self._send(403, {"error": "bad token"})
+                return False
+            return True
+
+        def _json(self) -> dict[str, Any]:
+            n = int(self.headers.get("Content-Length") or 0)
+            if n < 0 or n > _MAX_JSON:
+                # 请求体没读：这条连接不能再复用
+                self.close_connection = True
+                raise ValueError(f"request body too large: {n}")
+            return json.loads(self.rfile.read(n).decode("utf-8")) if n else {}
+
+        def do_GET(self) -> None:
+            if not self._authorized():
+                return
+            if urlparse(self.path).path == "/api/status":
+                self._send(200, coord.status())
+            else:
+                self._send(404, {"error": "not found"})
+
+        def do_POST(self) -> None:
+            if not self._authorized():
+                return
+            path = urlparse(self.path).path
+            try:
+                body = self._json()
+                if path == "/api/jobs":
+                    self._send(200, coord.submit(body["project"], body["stage"], body.get("params"), body.get("kit")))
+                elif path == "/api/register":
+                    self._send(200, coord.register(body))
+                elif path == "/api/lease":
+                    self._send(200, {"job": coord.lease(body["worker_id"], float(body.get("wait_s") or 20))})
+                elif path == "/api/heartbeat":
+                    self._send(200, {"keep": coord.heartbeat(body["worker_id"], body.get("job_id"))})
+                elif path.startswith("/api/jobs/") and path.endswith("/complete"):
+                    self._send(200, coord.complete(body["worker_id"], path.split("/")[3], body))
+                else:
+                    self._send(404, {"error": "not found"})
+            except KeyError as e:
+                self._send(409, {"error": f"unknown or reassigned job {e}"})
+            except Exception as e:
+                self._send(400, {"error": f"{type(e).__name__}: {e}"})
+
+        def do_PUT(self) -> None:
+            # /api/jobs/<id>/artifacts/<name>：请求体就是文件内容
+            if not self._authorized():
+                return
+            url = urlparse(self.path)
+            parts = url.path.split("/")
+            if len(parts) != 6 or parts[1:3] != ["api", "jobs"] or parts[4] != "artifacts":
+                self._send(404, {"error": "not found"})
+                return
+            worker_id = (parse_qs(url.query).get("worker_id") or [""])[0]
+            if not worker_id:
+                self.close_connection = True
+                self._send(400, {"error": "worker_id required"})
+                return
+            try:
+                n = coord.receive_artifact(worker_id, parts[3], unquote(parts[5]), self.rfile, int(self.headers.get("Content-Length") or 0))
+                self._send(200, {"bytes": n})
+            except KeyError as e:
+                self._send(409, {"error": f"unknown or reassigned job {e}"})
+            except Exception as e:
+                self.close_connection = True
+                self._send(400, {"error": f"{type(e).__name__}: {e}"})
+
+    return Handler
+
+
+def serve(host: str = "127.0.0.1", port: int = DEFAULT_PORT, coord: Coordinator | None = None) -> tuple[ThreadingHTTPServer, Coordinator]:
+    """
+    Start the coordinator's HTTP API on a background thread.
+
+    Listening beyond loopback requires QT_TEST_AI_DIST_TOKEN: whoever reaches
+    the API can queue jobs, register as a worker and write runs into the database.
+    """
+    if not token() and not is_loopback(host):
+        raise ValueError(f"refusing to listen on {host} without QT_TEST_AI_DIST_TOKEN; set a token or bind to 127.0.0.1")
+    coord = coord or Coordinator()
+    httpd = ThreadingHTTPServer((host, port), _handler(coord))
+    httpd.daemon_threads = True
+    threading.Thread(target=httpd.serve_forever, name="qt-test-ai-coordinator", daemon=True).start()
+    return httpd, coord
+
+
+# ----------------------------
+# agent
+# ----------------------------
+class Client:
+    """JSON calls to the coordinator with the shared token; artifacts are PUT straight from disk."""
+
+    def __init__(self, base: str | None = None, timeout_s: float = 60.0) -> None:
+        self.base = (base or coordinator_url()).rstrip("/")
+        self.timeout_s = timeout_s
+
+    def _headers(self, extra: dict[str, str] | None = None) -> dict[str, str]:
+        h = {TOKEN_HEADER: token()} if token() else {}
+        return {**h, **(extra or {})}
+
+    def call(self, method: str, path: str, body: Any = None, timeout_s: float | None = None) -> dict[str, Any]:
+        data = json.dumps(body, ensure_ascii=False).encode("utf-8") if body is not None else None
+        req = urllib.request.Request(self.base + path, data=data, method=method, headers=self._headers({"Content-Type": "application/json"}))
+        try:
+            with urllib.request.urlopen(req, timeout=timeout_s or self.timeout_s) as r:
+                return json.loads(r.read().decode("utf-8") or "{}")
+        except urllib.error.HTTPError as e:
+            detail = e.read().decode("utf-8", "replace")
+            raise RuntimeError(f"{method} {path}: HTTP {e.code} {detail}") from None
+
+    def upload(self, worker_id: str, job_id: str, path: Path) -> dict[str, Any]:
+        size = path.stat().st_size
+        url = f"{self.base}/api/jobs/{quote(job_id)}/artifacts/{quote(path.name)}?worker_id={quote(worker_id)}"
+        with open(path, "rb") as f:
+            req = urllib.request.Request(
+                url, data=f, method="PUT", headers=self._headers({"Content-Type": "application/octet-stream", "Content-Length": str(size)})
+            )
+            with urllib.request.urlopen(req, timeout=max(self.timeout_s, size / (1 << 20) + 60)) as r:
+                return json.loads(r.read().decode("utf-8") or "{}")
+
+
+def _bundle_gcda(build_dir: Path, out: Path) -> int:
+    """Zip every .gcda with its .gcno, paths relative to the build tree, so gcovr can run where the bundle lands."""
+    n = 0
+    with zipfile.ZipFile(out, "w", compression=zipfile.ZIP_DEFLATED) as z:
+        for gcda in Path(build_dir).rglob("*.gcda"):
+            z.write(gcda, gcda.relative_to(build_dir).as_posix())
+            gcno = gcda.with_suffix(".gcno")
+            if gcno.exists():
+                z.write(gcno, gcno.relative_to(build_dir).as_posix())
+            n += 1
+    if not n:
+        out.unlink(missing_ok=True)
+    return n
+
+
+def run_stage(stage: str, project_root: Path, params: dict[str, Any]) -> tuple[list[Finding], dict[str, Any], str | None]:
+    """The same entry points main.py and the GUI Worker call locally; returns (findings, meta, exe_path)."""
+    if stage == "static":
+        from .static_checks import run_static_checks
+
+        f, m = run_static_checks(project_root)
+        return f, m, None
+    if stage == "tests":
+        from .test_automation import run_test_command
+
+        f, m = run_test_command(project_root, args=params.get("args") or None)
+        return f, m, None
+    if stage == "coverage":
+        from .test_automation import run_full_coverage_pipeline
+
+        f, m = run_full_coverage_pipeline(project_root, top_level_only=bool(params.get("top_level_only")))
+        return f, m, None
+    if stage == "full_cycle":
+        from .llm_test_generator import LLMTestGenerator
+
+        result = LLMTestGenerator(project_root).run_full_cycle(params.get("task") or "phase1_diagram_item", params.get("llm_service") or "auto")
+        findings: list[Finding] = []
+        if result.get("status") != "success":
+            findings.append(Finding("automation", "error", f"完整周期失败：{params.get('task') or 'phase1_diagram_item'}", json.dumps(_jsonable(result), ensure_ascii=False)[:4000]))
+        return findings, result, None
+    raise ValueError(f"unknown stage {stage!r}")
+
+
+def collect_artifacts(stage: str, project_root: Path, meta: dict[str, Any], out_dir: Path) -> list[Path]:
+    """Findings / meta travel in the completion call; coverage JSON and the .gcda bundle are uploaded as files."""
+    files: list[Path] = []
+    if stage != "coverage":
+        return files
+    cov = Path(project_root) / "coverage.json"
+    if cov.is_file():
+        dst = out_dir / "coverage.json"
+        shutil.copy2(cov, dst)
+        files.append(dst)
+    build_dir = Path(((meta.get("build") or {}).get("build_dir")) or project_root)
+    bundle = out_dir / "gcda.zip"
+    if build_dir.is_dir() and _bundle_gcda(build_dir, bundle):
+        files.append(bundle)
+    return files
+
+
+class JobRevoked(Exception):
+    """The coordinator took the job back (heartbeat answered keep=false)."""
+
+
+class StageFailed(Exception):
+    """run_stage raised in the child process; carries the child's traceback."""
+
+    def __init__(self, message: str, child_traceback: str) -> None:
+        super().__init__(message)
+        self.child_traceback = child_traceback
+
+
+def _stage_child(stage: str, project_root: str, params: dict[str, Any], conn: Any) -> None:
+    # 自成进程组：收回作业时连同它启动的 make / 测试进程一起结束
+    if hasattr(os, "setpgrp"):
+        os.setpgrp()
+    try:
+        findings, meta, exe = run_stage(stage, Path(project_root), params)
+        conn.send(("ok", findings_to_wire(findings), _jsonable(meta), exe))
+    except BaseException as e:
+        conn.send(("error", f"{type(e).__name__}: {e}", traceback.format_exc()[-4000:], None))
+    finally:
+        conn.close()
+
+
+def _kill_tree(pid: int) -> None:
+    try:
+        import psutil
+
+        proc = psutil.Process(pid)
+        for p in proc.children(recursive=True) + [proc]:
+            try:
+                p.kill()
+            except psutil.Error:
+                pass
+    except Exception:
+        pass
+    if hasattr(os, "killpg"):
+        import signal
+
+        try:
+            os.killpg(pid, signal.SIGKILL)
+        except OSError:
+            pass
+
+
+class Agent:
+    """
+    Pull-mode worker: register, lease a job, run its stage against the local
+    checkout, stream the artifacts back, complete. No inbound port is needed on
+    the build machine. One job at a time; env overrides in job params (limited
+    to JOB_ENV_ALLOWLIST) apply to that job only.
+
+    The default runner executes the stage in a child process, so a job the
+    coordinator takes back is killed with everything it started; a custom
+    runner runs in-process and only has its upload / completion skipped.
+    """
+
+    def __init__(
+        self,
+        client: Client,
+        projects: dict[str, str],
+        *,
+        name: str | None = None,
+        kits: list[dict[str, str]] | None = None,
+        runner: Callable[[str, Path, dict[str, Any]], tuple[list[Finding], dict[str, Any], str | None]] = run_stage,
+        log: Callable[[str], None] = print,
+    ) -> None:
+        self.client = client
+        self.projects = projects
+        self.name = name or os.getenv("QT_TEST_AI_DIST_WORKER_NAME") or socket.gethostname()
+        self.kits = local_kits() if kits is None else kits
+        self.runner = runner
+        self.log = log
+        self.worker_id: str | None = None
+
+    def register(self) -> str:
+        r = self.client.call(
+            "POST",
+            "/api/register",
+            {"name": self.name, "kits": self.kits, "projects": sorted(self.projects), "platform": f"{platform.system()} {platform.machine()}"},
+        )
+        self.worker_id = r["worker_id"]
+        return self.worker_id
+
+    def _heartbeat(self, job_id: str, stop: threading.Event, period: float, revoked: threading.Event) -> None:
+        while not stop.wait(period):
+            try:
+                if not self.client.call("POST", "/api/heartbeat", {"worker_id": self.worker_id, "job_id": job_id}).get("keep", True):
+                    self.log(f"[dist] 作业 {job_id} 已被协调端收回，中止")
+                    revoked.set()
+                    return
+            except Exception as e:
+                self.log(f"[dist] 心跳失败: {e}")
+
+    def run_job(self, job: dict[str, Any]) -> dict[str, Any]:
+        project_root = Path(self.projects[job["project"]])
+        try:
+            # 协调端已经校验过；这里再查一遍，不信任线上来的作业
+            params = check_params(job.get("params"))
+        except ValueError as e:
+            self.log(f"[dist] 拒绝作业 {job['id']}: {e}")
+            result = {"worker_id": self.worker_id, "status": "error", "error": f"rejected by agent: {e}", "findings": [], "meta": {}}
+            return self.client.call("POST", f"/api/jobs/{quote(job['id'])}/complete", result, timeout_s=600)
+        saved = {k: os.environ.get(k) for k in (params.get("env") or {})}
+        os.environ.update({k: str(v) for k, v in (params.get("env") or {}).items()})
+        stop = threading.Event()
+        revoked = threading.Event()
+        threading.Thread(target=self._heartbeat, args=(job["id"], stop, max(5.0, lease_s() / 3), revoked), daemon=True).start()
+        t0 = time.perf_counter()
+        result: dict[str, Any] = {"worker_id": self.worker_id, "project_root": str(project_root)}
+        try:
+            if self.runner is run_stage:
+                findings, meta, exe = self._run_isolated(job["stage"], project_root, params, revoked)
+            else:
+                findings, meta, exe = self.runner(job["stage"], project_root, params)
+            if revoked.is_set():
+                raise JobRevoked(job["id"])
+            result.update(status="ok", findings=findings_to_wire(findings), meta=_jsonable(meta), exe_path=exe)
+            result["counts"] = {s: sum(1 for f in findings if f.severity == s) for s in ("info", "warning", "error")}
+            with tempfile.TemporaryDirectory(prefix="qt_test_ai_dist_") as tmp:
+                for p in collect_artifacts(job["stage"], project_root, meta, Path(tmp)):
+                    if revoked.is_set():
+                        raise JobRevoked(job["id"])
+                    self.log(f"[dist] 上传 {p.name}（{p.stat().st_size} 字节）")
+                    self.client.upload(self.worker_id or "", job["id"], p)
+        except JobRevoked:
+            # 作业已改派给别的 worker：结果作废，不上传也不提交
+            return {"status": "revoked", "job_id": job["id"]}
+        except StageFailed as e:
+            result.update(status="error", error=str(e), findings=[], meta={"traceback": e.child_traceback})
+        except Exception as e:
+            result.update(status="error", error=f"{type(e).__name__}: {e}", findings=result.get("findings") or [], meta={"traceback": traceback.format_exc()[-4000:]})
+        finally:
+            stop.set()
+            for k, v in saved.items():
+                if v is None:
+                    os.environ.pop(k, None)
+                else:
+                    os.environ[k] = v
+        result["duration_s"] = round(time.perf_counter() - t0, 3)
+        return self.client.call("POST", f"/api/jobs/{quote(job['id'])}/complete", result, timeout_s=600)
+
+    def _run_isolated(
+        self, stage: str, project_root: Path, params: dict[str, Any], revoked: threading.Event
+    ) -> tuple[list[Finding], dict[str, Any], str | None]:
+        """run_stage in a spawned child (it inherits this job's env overrides); killed as soon as the job is revoked."""
+        import multiprocessing
+
+        ctx = multiprocessing.get_context("spawn")
+        recv, send = ctx.Pipe(duplex=False)
+        proc = ctx.Process(target=_stage_child, args=(stage, str(project_root), params, send), name=f"qt-test-ai-stage-{stage}")
+        proc.start()
+        send.close()
+        try:
+            while not recv.poll(1.0):
+                if revoked.is_set():
+                    raise JobRevoked()
+                if not proc.is_alive() and not recv.poll(0):
+                    raise RuntimeError(f"stage process exited with code {proc.exitcode}")
+            try:
+                status, a, b, exe = recv.recv()
+            except EOFError:
+                raise RuntimeError(f"stage process exited with code {proc.exitcode}") from None
+        except BaseException:
+            # 收回 / Ctrl+C / 子进程异常退出：子进程自成进程组收不到终端信号，这里连同其子进程一起结束
+            _kill_tree(proc.pid)
+            raise
+        finally:
+            proc.join(10)
+            recv.close()
+        if status != "ok":
+            raise StageFailed(a, b)
+        return findings_from_wire(a), b, exe
+
+    def loop(self, *, once: bool = False, idle_exit_s: float | None = None) -> int:
+        """Serve jobs until interrupted; `once` stops after the first empty lease, `idle_exit_s` after that long idle."""
+        self.register()
+        self.log(f"[dist] {self.name} 已注册：工程 {', '.join(sorted(self.projects)) or '-'}；套件 {', '.join(k['qt'] + '/' + k['spec'] for k in self.kits) or '-'}")
+        done = 0
+        idle_since = time.time()
+        while True:
+            try:
+                job = self.client.call("POST", "/api/lease", {"worker_id": self.worker_id, "wait_s": 20}, timeout_s=60).get("job")
+            except Exception as e:
+                self.log(f"[dist] 连接协调端失败: {e}；10s 后重试")
+                time.sleep(10)
+                try:
+                    self.register()
+                except Exception:
+                    pass
+                continue
+            if not job:
+                if once or (idle_exit_s is not None and time.time() - idle_since >= idle_exit_s):
+                    return done
+                continue
+            self.log(f"[dist] 开始 {job['id']}：{job['project']} / {job['stage']}")
+            try:
+                r = self.run_job(job)
+                self.log(f"[dist] 完成 {job['id']}：{r.get('status')}" + (f"（run #{r['run_id']}）" if r.get("run_id") else ""))
+            except Exception as e:
+                self.log(f"[dist] 作业 {job['id']} 提交结果失败: {e}")
+            done += 1
+            idle_since = time.time()
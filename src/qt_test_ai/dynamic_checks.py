@@ -6,6 +6,7 @@ from pathlib import Path
 
 import psutil
 
+from . import startup_profile, tracing
 from .models import Finding
 from .utils import guess_exe_candidates
 
@@ -42,20 +43,33 @@ def pick_exe(project_root: Path, user_exe: Path | None) -> tuple[Path | None, li
 
 
 
-def run_smoke_test(exe_path: Path, workdir: Path | None = None, timeout_sec: int = 15) -> tuple[list[Finding], dict]:
+@tracing.traced("smoke test", tracing.SMOKE)
+def run_smoke_test(
+    exe_path: Path,
+    workdir: Path | None = None,
+    timeout_sec: int = 15,
+    *,
+    profile: bool | None = None,
+    update_baseline: bool = False,
+) -> tuple[list[Finding], dict]:
     """
     冒烟测试（Smoke Test）：
     - 验证应用是否能正常启动；
     - 监控 CPU、内存使用；
     - 检查是否异常退出；
     - 输出简要性能指标。
+
+    profile（默认取 QT_TEST_AI_STARTUP_PROFILE）：整个 timeout_sec 内高频采样，
+    测量到主窗口显示 / 首次绘制 / 可交互的时间，报告 p50/p95/峰值并与基线比较。
     """
     findings: list[Finding] = []
     meta: dict = {"exe": str(exe_path), "timeout_sec": timeout_sec}
+    profile = startup_profile.enabled() if profile is None else profile
 
     if not exe_path.exists():
         return [Finding(category="dynamic", severity="error", title="exe 不存在", details=str(exe_path))], meta
 
+    t0 = time.perf_counter()
     try:
         proc = subprocess.Popen(
             [str(exe_path)],
@@ -71,15 +85,26 @@ def run_smoke_test(exe_path: Path, workdir: Path | None = None, timeout_sec: int
     alive_ok = False
     startup_time = None
     cpu_samples, mem_samples = [], []
-
-    try:
-        p = psutil.Process(proc.pid)
-        p.cpu_percent(interval=None)  # 初始化CPU采样
-    except psutil.NoSuchProcess:
+    prof: dict | None = None
+
+    if profile:
+        # 采样贯穿整个时长；管道由采样器并发读取（启动标记在 stderr 上）
+        prof = startup_profile.profile_process(proc, t0, timeout_sec)
+        alive_ok = prof["startup"]["alive_ms"] is not None
+        ready_ms = prof["startup"]["ready_ms"] if prof["startup"]["ready_ms"] is not None else prof["startup"]["alive_ms"]
+        startup_time = (ready_ms or 0) / 1000.0
+        cpu_samples = prof["samples"]["cpu_percent"]
+        mem_samples = prof["samples"]["rss_mb"]
         p = None
+    else:
+        try:
+            p = psutil.Process(proc.pid)
+            p.cpu_percent(interval=None)  # 初始化CPU采样
+        except psutil.NoSuchProcess:
+            p = None
 
     # 主检测循环（启动+资源采样）
-    while time.time() - start_time < timeout_sec:
+    while prof is None and time.time() - start_time < timeout_sec:
         if proc.poll() is not None:  # 进程退出
             break
         alive_ok = True
@@ -109,6 +134,8 @@ def run_smoke_test(exe_path: Path, workdir: Path | None = None, timeout_sec: int
         "startup_time_s": round(startup_time or 0, 2),
         "duration_s": round(time.time() - start_time, 2)
     })
+    if prof is not None:
+        meta["profile"] = {k: v for k, v in prof.items() if k not in ("stdout", "stderr")}
 
     # 分析结果
     if not alive_ok:
@@ -170,9 +197,12 @@ def run_smoke_test(exe_path: Path, workdir: Path | None = None, timeout_sec: int
     else:
         findings.append(Finding(category="dynamic", severity="info",
                                 title="进程启动成功", details=f"pid={proc.pid}"))
-        findings.append(Finding(category="dynamic", severity="info",
-                                title=f"启动响应时间 {meta['startup_time_s']} 秒",
-                                details="应用成功启动并保持运行"))
+        if prof is not None:
+            findings.extend(startup_profile.findings_for(exe_path, meta["profile"], update_baseline=update_baseline))
+        else:
+            findings.append(Finding(category="dynamic", severity="info",
+                                    title=f"启动响应时间 {meta['startup_time_s']} 秒",
+                                    details="应用成功启动并保持运行"))
 
         # CPU 警告
         if cpu_samples and max(cpu_samples) > 80:
@@ -206,7 +236,7 @@ def run_smoke_test(exe_path: Path, workdir: Path | None = None, timeout_sec: int
 
     # 采集输出日志
     try:
-        out, err = proc.communicate(timeout=1)
+        out, err = (prof["stdout"], prof["stderr"]) if prof is not None else proc.communicate(timeout=1)
         if out.strip():
             findings.append(Finding(category="dynamic", severity="info", title="stdout", details=out.strip()[:5000]))
         if err.strip():
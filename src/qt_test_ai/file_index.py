@@ -0,0 +1,547 @@
+from __future__ import annotations
+
+import os
+import re
+import struct
+import sys
+import threading
+import time
+from pathlib import Path
+from typing import Callable, Iterable
+
+# 版本库 / 虚拟环境等目录从不索引；build 类目录要索引（.gcda / .gcno / exe 都在里面）
+_SKIP_DIRS = {".git", ".svn", ".hg", ".venv", "venv", "node_modules", "__pycache__", ".idea", ".vscode", ".vs"}
+
+# Windows 监视线程的同步哨兵：查询前在根目录建再删，从不进索引
+_SYNC_NAME = ".qt_test_ai_index_sync"
+
+SOURCE_SUFFIXES = (".cpp", ".cxx", ".cc", ".c++", ".c", ".h", ".hpp", ".ui")
+
+_registry: dict[Path, "FileIndex"] = {}
+_registry_lock = threading.Lock()
+
+
+def enabled() -> bool:
+    """Share one watched file index per project (QT_TEST_AI_FILE_INDEX, default on); off = walk the tree on every query."""
+    return (os.getenv("QT_TEST_AI_FILE_INDEX") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def ttl_s() -> float:
+    """Without a native watcher, an index older than this is rescanned on the next query (QT_TEST_AI_FILE_INDEX_TTL_S, default 2)."""
+    try:
+        return max(0.0, float(os.getenv("QT_TEST_AI_FILE_INDEX_TTL_S") or 2))
+    except ValueError:
+        return 2.0
+
+
+def _suffix(name: str) -> str:
+    i = name.rfind(".")
+    return name[i:].lower() if i > 0 else ""
+
+
+def _skipped(rel: str) -> bool:
+    return rel == _SYNC_NAME or any(part in _SKIP_DIRS for part in rel.split("/"))
+
+
+_GLOB_CACHE: dict[str, re.Pattern[str]] = {}
+
+
+def _segment_re(seg: str) -> str:
+    out = []
+    i = 0
+    while i < len(seg):
+        c = seg[i]
+        if c == "*":
+            out.append("[^/]*")
+        elif c == "?":
+            out.append("[^/]")
+        elif c == "[" and "]" in seg[i + 1:]:
+            j = seg.index("]", i + 1)
+            body = seg[i + 1:j]
+            out.append("[" + ("^" + body[1:] if body.startswith("!") else body) + "]")
+            i = j
+        else:
+            out.append(re.escape(c))
+        i += 1
+    return "".join(out)
+
+
+def _glob_re(pattern: str) -> re.Pattern[str]:
+    """Relative glob with `**` spanning directories (like Path.glob) to a regex on posix paths."""
+    rx = _GLOB_CACHE.get(pattern)
+    if rx is None:
+        body = ""
+        for seg in pattern.replace("\\", "/").split("/"):
+            body += "(?:[^/]+/)*" if seg == "**" else _segment_re(seg) + "/"
+        rx = _GLOB_CACHE[pattern] = re.compile(f"^{body.rstrip('/')}$", re.I if os.name == "nt" else 0)
+    return rx
+
+
+class FileIndex:
+    """
+    In-memory index of every file under one project root.
+
+    Built with a single scandir walk, bucketed by suffix, and kept current by
+    a native change watcher (inotify on Linux, ReadDirectoryChangesW on
+    Windows). Without one it falls back to rescanning when older than ttl_s().
+    Use get_index() rather than constructing this directly.
+    """
+
+    def __init__(self, root: Path, *, watch: bool = True) -> None:
+        self.root = Path(root).resolve()
+        self._lock = threading.RLock()
+        self._files: set[str] = set()
+        self._by_suffix: dict[str, set[str]] = {}
+        self._dirs: set[str] = set()
+        self._dirty = True
+        self._built_at = 0.0
+        self._watch = watch
+        self._watcher: _InotifyWatcher | _WinWatcher | None = None
+        self.stats = {"scans": 0, "events": 0, "queries": 0, "watcher": ""}
+
+    # ----------------------------
+    # maintenance
+    # ----------------------------
+    def _add(self, rel: str) -> None:
+        if rel in self._files or _skipped(rel):
+            return
+        self._files.add(rel)
+        self._by_suffix.setdefault(_suffix(rel), set()).add(rel)
+
+    def _discard(self, rel: str) -> None:
+        if rel in self._files:
+            self._files.discard(rel)
+            self._by_suffix.get(_suffix(rel), set()).discard(rel)
+
+    def _discard_tree(self, rel: str) -> None:
+        prefix = rel + "/"
+        for f in [f for f in self._files if f.startswith(prefix)]:
+            self._discard(f)
+        self._dirs = {d for d in self._dirs if d != rel and not d.startswith(prefix)}
+
+    def _scan(self, rel_dir: str = "") -> list[str]:
+        """Walk one subtree into the index; returns the directories seen (for watches)."""
+        seen: list[str] = []
+        stack = [rel_dir]
+        while stack:
+            rd = stack.pop()
+            if rd and _skipped(rd):
+                continue
+            seen.append(rd)
+            self._dirs.add(rd)
+            try:
+                with os.scandir(self.root / rd if rd else self.root) as it:
+                    for e in it:
+                        rel = f"{rd}/{e.name}" if rd else e.name
+                        try:
+                            if e.is_dir(follow_symlinks=False):
+                                if e.name not in _SKIP_DIRS:
+                                    stack.append(rel)
+                            elif e.is_file():
+                                self._add(rel)
+                        except OSError:
+                            continue
+            except OSError:
+                continue
+        return seen
+
+    def _rebuild(self) -> None:
+        if self._watcher is not None:
+            self._watcher.close()
+            self._watcher = None
+        self._files.clear()
+        self._by_suffix.clear()
+        self._dirs.clear()
+        dirs = self._scan("")
+        self._dirty = False
+        self._built_at = time.time()
+        self.stats["scans"] += 1
+        if self._watch:
+            self._watcher = _start_watcher(self, dirs)
+            self.stats["watcher"] = type(self._watcher).__name__ if self._watcher else "ttl"
+
+    def _fresh(self) -> None:
+        w = self._watcher
+        if isinstance(w, _WinWatcher):
+            # 监视线程应用事件时要拿锁，等待要在锁外
+            w.sync()
+        with self._lock:
+            self.stats["queries"] += 1
+            if isinstance(self._watcher, _InotifyWatcher):
+                self._watcher.sync()
+            elif self._watcher is None and time.time() - self._built_at > ttl_s():
+                self._dirty = True
+            if self._dirty:
+                self._rebuild()
+
+    def invalidate(self) -> None:
+        """Force a rescan on the next query (e.g. after a watcher overflow)."""
+        with self._lock:
+            self._dirty = True
+
+    def note_removed(self, path: Path) -> None:
+        """Callers that delete files themselves update the index right away instead of waiting for the watcher."""
+        try:
+            rel = Path(path).resolve().relative_to(self.root).as_posix()
+        except (ValueError, OSError):
+            return
+        with self._lock:
+            self._discard(rel)
+
+    def close(self) -> None:
+        with self._lock:
+            if self._watcher is not None:
+                self._watcher.close()
+                self._watcher = None
+            self._dirty = True
+
+    # ----------------------------
+    # raw queries (relative posix paths)
+    # ----------------------------
+    def _query(self, prefix: str, suffixes: Iterable[str] | None) -> list[str]:
+        self._fresh()
+        with self._lock:
+            if suffixes is None:
+                cand: Iterable[str] = list(self._files)
+            else:
+                cand = [f for s in {x.lower() for x in suffixes} for f in self._by_suffix.get(s, ())]
+        if prefix:
+            p = prefix + "/"
+            cand = [f for f in cand if f.startswith(p)]
+        return sorted(cand)
+
+
+class FileIndexView:
+    """
+    A FileIndex seen from `base` (the project root or a directory inside it).
+
+    Paths come back joined onto `base` as the caller spelled it, so existing
+    relative_to(project_root) calls keep working.
+    """
+
+    def __init__(self, index: FileIndex, base: Path, prefix: str) -> None:
+        self.index = index
+        self.base = Path(base)
+        self._prefix = prefix
+
+    def _paths(self, rels: list[str]) -> list[Path]:
+        n = len(self._prefix) + 1 if self._prefix else 0
+        return [self.base / r[n:] for r in rels]
+
+    def _rels(self, suffixes: Iterable[str] | None = None) -> list[str]:
+        rels = self.index._query(self._prefix, suffixes)
+        n = len(self._prefix) + 1 if self._prefix else 0
+        return [r[n:] for r in rels]
+
+    # ----------------------------
+    # typed queries
+    # ----------------------------
+    def files(self, suffixes: Iterable[str] | None = None, *, prune: Callable[[str], bool] | None = None) -> list[Path]:
+        """Files with one of `suffixes` (case-insensitive); `prune(dir_name)` True drops everything under such a directory."""
+        rels = self._rels(suffixes)
+        if prune is not None:
+            rels = [r for r in rels if not any(prune(d) for d in r.split("/")[:-1])]
+        return [self.base / r for r in rels]
+
+    def sources(self) -> list[Path]:
+        return self.files(SOURCE_SUFFIXES)
+
+    def gcda(self) -> list[Path]:
+        return self.files((".gcda",))
+
+    def gcno(self) -> list[Path]:
+        return self.files((".gcno",))
+
+    def pro_files(self) -> list[Path]:
+        return self.files((".pro",))
+
+    def executables(self) -> list[Path]:
+        if os.name == "nt":
+            return self.files((".exe",))
+        # POSIX：没有后缀且带执行位的文件
+        return [p for p in self.files(("",)) if os.access(p, os.X_OK)]
+
+    def count(self, suffix: str) -> int:
+        return len(self.index._query(self._prefix, (suffix,)))
+
+    def match(self, patterns: Iterable[str]) -> list[Path]:
+        """Same result as [p for p in walk(base) if any(p.match(pat) ...)], using the suffix buckets where possible."""
+        out: dict[str, None] = {}
+        for pat in patterns:
+            m = re.fullmatch(r"(?:\*\*/)?\*(\.[^*?\[\]/]+)", pat)
+            if m:
+                ext = m.group(1)
+                for r in self._rels((ext,)):
+                    if os.name == "nt" or r.endswith(ext):
+                        out[r] = None
+                continue
+            for r in self._rels():
+                if (self.base / r).match(pat):
+                    out[r] = None
+        return [self.base / r for r in sorted(out)]
+
+    def glob(self, pattern: str) -> list[Path]:
+        """Path.glob(pattern) equivalent for files (`**` spans directories)."""
+        rx = _glob_re(pattern)
+        suffix = _suffix(pattern) if "*" not in pattern.rsplit(".", 1)[-1] and not pattern.endswith("*") else None
+        return [self.base / r for r in self._rels((suffix,) if suffix else None) if rx.match(r)]
+
+    def dirs_with(self, suffix: str, pattern: str | None = None) -> list[Path]:
+        """Directories that directly contain a file with `suffix`, optionally only those matching glob `pattern` (relative to base)."""
+        dirs = sorted({r.rsplit("/", 1)[0] if "/" in r else "" for r in self._rels((suffix,))})
+        if pattern is not None:
+            rx = _glob_re(pattern)
+            dirs = [d for d in dirs if rx.match(d)]
+        return [self.base / d for d in dirs]
+
+    def invalidate(self) -> None:
+        self.index.invalidate()
+
+    def note_removed(self, path: Path) -> None:
+        self.index.note_removed(path)
+
+
+def get_index(root: Path) -> FileIndexView:
+    """The shared index covering `root` (built on first use, reused while the watcher keeps it fresh)."""
+    base = Path(root)
+    real = base.resolve()
+    if not enabled():
+        # 不缓存：每次查询都是一次完整遍历，等同于原来的 rglob
+        return FileIndexView(FileIndex(real, watch=False), base, "")
+    with _registry_lock:
+        for r, idx in _registry.items():
+            if real == r:
+                return FileIndexView(idx, base, "")
+            if r in real.parents:
+                return FileIndexView(idx, base, real.relative_to(r).as_posix())
+        # 新根包含已有的子树索引：合并为一个
+        for r in [r for r in _registry if real in r.parents]:
+            _registry.pop(r).close()
+        idx = _registry[real] = FileIndex(real)
+        return FileIndexView(idx, base, "")
+
+
+def close_all() -> None:
+    with _registry_lock:
+        for idx in _registry.values():
+            idx.close()
+        _registry.clear()
+
+
+# =========================================================
+# native watchers
+# =========================================================
+def _start_watcher(index: FileIndex, dirs: list[str]) -> "_InotifyWatcher | _WinWatcher | None":
+    try:
+        if sys.platform.startswith("linux"):
+            return _InotifyWatcher(index, dirs)
+        if os.name == "nt":
+            return _WinWatcher(index)
+    except Exception:
+        return None
+    return None
+
+
+class _InotifyWatcher:
+    """
+    inotify watches on every indexed directory.
+
+    The fd is non-blocking and drained synchronously at the start of each
+    query, so there is no thread and no window where a file written by a
+    finished child process is not yet visible.
+    """
+
+    IN_MOVED_FROM = 0x40
+    IN_MOVED_TO = 0x80
+    IN_CREATE = 0x100
+    IN_DELETE = 0x200
+    IN_DELETE_SELF = 0x400
+    IN_MOVE_SELF = 0x800
+    IN_Q_OVERFLOW = 0x4000
+    IN_IGNORED = 0x8000
+    IN_ISDIR = 0x40000000
+    _MASK = IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF
+    _HDR = struct.Struct("iIII")
+
+    def __init__(self, index: FileIndex, dirs: list[str]) -> None:
+        import ctypes
+
+        self.index = index
+        self._libc = ctypes.CDLL(None, use_errno=True)
+        fd = self._libc.inotify_init1(os.O_NONBLOCK | os.O_CLOEXEC)
+        if fd < 0:
+            raise OSError(ctypes.get_errno(), "inotify_init1")
+        self.fd = fd
+        self._wd: dict[int, str] = {}
+        for d in dirs:
+            self._add_watch(d)
+
+    def _add_watch(self, rel_dir: str) -> None:
+        path = str(self.index.root / rel_dir if rel_dir else self.index.root).encode()
+        wd = self._libc.inotify_add_watch(self.fd, path, self._MASK)
+        if wd < 0:
+            # 通常是 max_user_watches 用尽：退回 TTL 模式
+            raise OSError("inotify_add_watch")
+        self._wd[wd] = rel_dir
+
+    def sync(self) -> None:
+        while True:
+            try:
+                buf = os.read(self.fd, 1 << 16)
+            except BlockingIOError:
+                return
+            except OSError:
+                self.index._dirty = True
+                return
+            if not buf:
+                return
+            self._apply(buf)
+
+    def _apply(self, buf: bytes) -> None:
+        idx = self.index
+        off = 0
+        while off + self._HDR.size <= len(buf):
+            wd, mask, _cookie, ln = self._HDR.unpack_from(buf, off)
+            name = buf[off + self._HDR.size: off + self._HDR.size + ln].rstrip(b"\0").decode("utf-8", "surrogateescape")
+            off += self._HDR.size + ln
+            idx.stats["events"] += 1
+            if mask & self.IN_Q_OVERFLOW:
+                idx._dirty = True
+                continue
+            if mask & self.IN_IGNORED:
+                self._wd.pop(wd, None)
+                continue
+            d = self._wd.get(wd)
+            if d is None or not name:
+                continue
+            rel = f"{d}/{name}" if d else name
+            if mask & self.IN_ISDIR:
+                if mask & (self.IN_CREATE | self.IN_MOVED_TO):
+                    try:
+                        for sub in idx._scan(rel):
+                            self._add_watch(sub)
+                    except OSError:
+                        idx._dirty = True
+                elif mask & (self.IN_DELETE | self.IN_MOVED_FROM):
+                    idx._discard_tree(rel)
+            elif mask & (self.IN_CREATE | self.IN_MOVED_TO):
+                idx._add(rel)
+            elif mask & (self.IN_DELETE | self.IN_MOVED_FROM):
+                idx._discard(rel)
+
+    def close(self) -> None:
+        try:
+            os.close(self.fd)
+        except OSError:
+            pass
+
+
+class _WinWatcher:
+    """One recursive ReadDirectoryChangesW handle on the root, serviced by a daemon thread."""
+
+    FILE_LIST_DIRECTORY = 0x0001
+    OPEN_EXISTING = 3
+    FILE_FLAG_BACKUP_SEMANTICS = 0x02000000
+    FILE_NOTIFY_CHANGE_FILE_NAME = 0x1
+    FILE_NOTIFY_CHANGE_DIR_NAME = 0x2
+    # 等同步哨兵的删除事件最多这么久；超时就下次查询全量重扫
+    SYNC_TIMEOUT_S = 2.0
+
+    def __init__(self, index: FileIndex) -> None:
+        import ctypes
+        from ctypes import wintypes
+
+        self.index = index
+        self._k32 = ctypes.WinDLL("kernel32", use_last_error=True)
+        self._k32.CreateFileW.restype = wintypes.HANDLE
+        h = self._k32.CreateFileW(
+            str(index.root), self.FILE_LIST_DIRECTORY, 0x7, None, self.OPEN_EXISTING, self.FILE_FLAG_BACKUP_SEMANTICS, None
+        )
+        if not h or h == wintypes.HANDLE(-1).value:
+            raise OSError(ctypes.get_last_error(), "CreateFileW")
+        self._h = h
+        self._closed = False
+        self._sync_lock = threading.Lock()
+        self._synced = threading.Event()
+        self._thread = threading.Thread(target=self._run, name="qt-test-ai-file-index", daemon=True)
+        self._thread.start()
+
+    def _run(self) -> None:
+        import ctypes
+        from ctypes import wintypes
+
+        buf = ctypes.create_string_buffer(1 << 16)
+        got = wintypes.DWORD()
+        mask = self.FILE_NOTIFY_CHANGE_FILE_NAME | self.FILE_NOTIFY_CHANGE_DIR_NAME
+        while not self._closed:
+            ok = self._k32.ReadDirectoryChangesW(self._h, buf, len(buf), True, mask, ctypes.byref(got), None, None)
+            if self._closed:
+                return
+            if not ok:
+                with self.index._lock:
+                    self.index._dirty = True
+                self._synced.set()
+                return
+            if got.value == 0:
+                # 缓冲区溢出：变化太多，下次查询全量重扫（哨兵事件可能也丢了，不用再等）
+                with self.index._lock:
+                    self.index._dirty = True
+                self._synced.set()
+                continue
+            self._apply(buf.raw[: got.value])
+
+    def _apply(self, data: bytes) -> None:
+        idx = self.index
+        off = 0
+        with idx._lock:
+            while True:
+                nxt, action, ln = struct.unpack_from("III", data, off)
+                rel = data[off + 12: off + 12 + ln].decode("utf-16-le").replace("\\", "/")
+                idx.stats["events"] += 1
+                if rel == _SYNC_NAME:
+                    if action == 2:
+                        self._synced.set()
+                elif not _skipped(rel):
+                    if action in (1, 5):  # ADDED / RENAMED_NEW_NAME
+                        if (idx.root / rel).is_dir():
+                            idx._scan(rel)
+                        else:
+                            idx._add(rel)
+                    elif action in (2, 4):  # REMOVED / RENAMED_OLD_NAME（无法区分文件和目录，两者都处理）
+                        idx._discard(rel)
+                        idx._discard_tree(rel)
+                    elif action == 3:  # MODIFIED：按磁盘现状刷新这一项
+                        p = idx.root / rel
+                        if p.is_file():
+                            idx._add(rel)
+                        elif not p.exists():
+                            idx._discard(rel)
+                            idx._discard_tree(rel)
+                if not nxt:
+                    break
+                off += nxt
+
+    def sync(self) -> None:
+        # 屏障：建再删一个哨兵文件，监视线程报告它被删除时，此前（如刚结束的测试进程写 .gcda）的事件都已应用
+        with self._sync_lock:
+            self._synced.clear()
+            sentinel = self.index.root / _SYNC_NAME
+            try:
+                sentinel.touch()
+                sentinel.unlink()
+            except OSError:
+                ok = False
+            else:
+                ok = self._synced.wait(self.SYNC_TIMEOUT_S)
+            if not ok:
+                with self.index._lock:
+                    self.index._dirty = True
+
+    def close(self) -> None:
+        self._closed = True
+        try:
+            self._k32.CancelIoEx(self._h, None)
+            self._k32.CloseHandle(self._h)
+        except Exception:
+            pass
+
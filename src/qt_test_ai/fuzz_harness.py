@@ -0,0 +1,1122 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+import shutil
+import subprocess
+import time
+from datetime import datetime
+from pathlib import Path
+from typing import Any
+
+from . import coverage_build, project_lib, workload
+from .models import Finding
+from .utils import read_text_best_effort
+
+FUZZ_DIR = "fuzz"
+FUZZ_TARGET = "qt_test_ai_fuzz"
+HARNESS_FILE = "fuzz_harness.cpp"
+DRIVER_FILE = "fuzz_driver.cpp"
+COV_FILE = "fuzz_cov.c"
+HISTORY_FILE = "fuzz_results.json"
+ENGINES = {"builtin", "libfuzzer"}
+# 只在这些类上找入口：它们能从 MainWindow 直接拿到，不需要猜构造参数
+_OWNERS = ("MainWindow", "DiagramScene")
+
+
+def enabled() -> bool:
+    """Run the fuzz stage with the GUI pipeline (QT_TEST_AI_FUZZ, default off: it builds an instrumented binary)."""
+    return (os.getenv("QT_TEST_AI_FUZZ") or "0").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def engine() -> str:
+    """
+    builtin (default): bundled in-process engine, needs only gcc/clang -fsanitize-coverage=trace-pc (MinGW works);
+    libfuzzer: clang -fsanitize=fuzzer (QT_TEST_AI_FUZZ_ENGINE).
+    """
+    raw = (os.getenv("QT_TEST_AI_FUZZ_ENGINE") or "builtin").strip().lower()
+    return raw if raw in ENGINES else "builtin"
+
+
+def seconds() -> int:
+    """Fuzzing time per target (QT_TEST_AI_FUZZ_SECONDS, default 60)."""
+    return int(workload.float_env("QT_TEST_AI_FUZZ_SECONDS", 60, minimum=0.0)) or 60
+
+
+def max_len() -> int:
+    """Largest generated input in bytes (QT_TEST_AI_FUZZ_MAX_LEN, default 65536)."""
+    return int(workload.float_env("QT_TEST_AI_FUZZ_MAX_LEN", 65536, minimum=0.0)) or 65536
+
+
+def timeout_s() -> int:
+    """Per-input time limit; slower inputs are saved as timeout-* artifacts (QT_TEST_AI_FUZZ_TIMEOUT_S, default 10)."""
+    return int(workload.float_env("QT_TEST_AI_FUZZ_TIMEOUT_S", 10, minimum=0.0)) or 10
+
+
+def fuzz_dir(tests_dir: Path) -> Path:
+    return Path(tests_dir) / FUZZ_DIR
+
+
+def corpus_dir(tests_dir: Path, target: str) -> Path:
+    return fuzz_dir(tests_dir) / "corpus" / target
+
+
+def artifacts_dir(tests_dir: Path, target: str) -> Path:
+    return fuzz_dir(tests_dir) / "artifacts" / target
+
+
+# ----------------------------
+# entry points
+# ----------------------------
+_COMMENT_RE = re.compile(r"//[^\n]*|/\*.*?\*/", re.S)
+_CLASS_OPEN_RE = re.compile(r"\bclass\s+(?:\w+_EXPORT\s+)?(\w+)\b[^;{]*\{")
+_IO_METHOD_RE = re.compile(
+    r"\b(?:virtual\s+)?(?:bool|void|int)\s+(\w+)\s*\(\s*(QDataStream\s*&|QIODevice\s*\*|const\s+QString\s*&|QString)\s*(\w*)\s*\)"
+)
+_TEXT_METHOD_RE = re.compile(r"\b(?:virtual\s+)?void\s+(\w+)\s*\(\s*const\s+QString\s*&\s*\w*\s*(,\s*const\s+QString\s*&\s*\w*\s*)?\)")
+_LOAD_NAME_RE = re.compile(r"load|open|read|import|restore|deserial|parse", re.I)
+_SAVE_NAME_RE = re.compile(r"save|write|export|serial|store", re.I)
+_TEXT_NAME_RE = re.compile(r"find|replace|search", re.I)
+
+
+def _kind(param: str) -> str:
+    if "QDataStream" in param:
+        return "stream"
+    if "QIODevice" in param:
+        return "device"
+    return "file"
+
+
+def _owner_at(code: str, pos: int) -> str | None:
+    owner = None
+    for m in _CLASS_OPEN_RE.finditer(code):
+        if m.start() > pos:
+            break
+        owner = m.group(1)
+    return owner
+
+
+def _uniq(xs: list[dict[str, Any]]) -> list[dict[str, Any]]:
+    return [dict(t) for t in dict.fromkeys(tuple(sorted(x.items())) for x in xs)]
+
+
+def discover(project_root: Path) -> dict[str, Any]:
+    """
+    Scene / window deserialization and find-replace entry points declared in the project headers.
+
+    Returns {"load": [...], "save": [...], "text": [...], "dialog": {...} | None,
+    "headers": [...]} where load / save entries are {owner, method, kind}
+    (kind = stream: QDataStream&, device: QIODevice*, file: file name).
+    """
+    load: list[dict[str, str]] = []
+    save: list[dict[str, str]] = []
+    text: list[dict[str, Any]] = []
+    dialog = None
+    headers: list[str] = []
+    _, hdrs = project_lib.project_sources(project_root)
+    for h in hdrs:
+        code = _COMMENT_RE.sub(" ", read_text_best_effort(h))
+        headers.append(h.name)
+        for m in _IO_METHOD_RE.finditer(code):
+            owner = _owner_at(code, m.start())
+            if owner not in _OWNERS:
+                continue
+            name, param, pname = m.group(1), m.group(2), m.group(3)
+            kind = _kind(param)
+            # QString 参数只认文件名：setText(const QString &) 之类不是反序列化入口
+            if kind == "file" and not re.search(r"file|path", pname + name, re.I):
+                continue
+            entry = {"owner": owner, "method": name, "kind": kind}
+            if _LOAD_NAME_RE.search(name):
+                load.append(entry)
+            elif _SAVE_NAME_RE.search(name):
+                save.append(entry)
+        for m in _TEXT_METHOD_RE.finditer(code):
+            owner = _owner_at(code, m.start())
+            if owner == "MainWindow" and _TEXT_NAME_RE.search(m.group(1)):
+                text.append({"owner": owner, "method": m.group(1), "args": 2 if m.group(2) else 1})
+        if dialog is None and re.search(r"\bclass\s+FindReplaceDialog\b[^;{]*\{", code):
+            # 只在能无参或只传父窗口构造时用：(), (QWidget *parent = nullptr)
+            ctor = re.search(r"\bFindReplaceDialog\s*\(\s*(QWidget\s*\*\s*\w*\s*(?:=\s*(?:nullptr|0|NULL))?)?\s*\)", code)
+            dialog = {"header": h.name, "parent": bool(ctor and ctor.group(1))} if ctor else {"header": h.name, "parent": None}
+    return {"load": _uniq(load), "save": _uniq(save), "text": _uniq(text), "dialog": dialog, "headers": headers}
+
+
+def targets(found: dict[str, Any]) -> list[str]:
+    out = [f"{e['kind']}_{e['owner']}_{e['method']}".lower() for e in found.get("load") or []]
+    if found.get("text"):
+        out.append("find_replace")
+    if found.get("dialog"):
+        out.append("find_dialog")
+    return out
+
+
+# ----------------------------
+# generated sources
+# ----------------------------
+_HARNESS = r"""// Generated by Smart Testing Tools (fuzz harness). Do not edit.
+//
+// libFuzzer-style in-process harness: LLVMFuzzerInitialize() builds one
+// offscreen MainWindow, LLVMFuzzerTestOneInput() feeds each input to the
+// target named by $QT_TEST_AI_FUZZ_TARGET (one corpus per target). With
+// $QT_TEST_AI_FUZZ_SEED_OUT set it instead saves a small diagram through
+// every save entry point into that directory and exits.
+#include <QtWidgets>
+#include <QBuffer>
+#include <QDataStream>
+#include <QTemporaryDir>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "diagramitem.h"
+#include "diagramtextitem.h"
+#if __has_include("arrow.h")
+#include "arrow.h"
+#define QT_TEST_AI_HAS_ARROW 1
+#endif
+
+// 入口多是 MainWindow / DiagramScene 的私有成员；标准库与 Qt 头已在上面包含
+#define private public
+#define protected public
+@INCLUDES@
+#undef protected
+#undef private
+
+namespace {
+
+QApplication *g_app = nullptr;
+MainWindow *g_window = nullptr;
+DiagramScene *g_scene = nullptr;
+QMenu *g_menu = nullptr;
+QTemporaryDir *g_tmp = nullptr;
+QList<DiagramTextItem *> g_texts;
+std::function<void(const QByteArray &)> g_target;
+
+const int kTexts = 32;
+
+QString textSeed(int i)
+{
+    return QStringLiteral("node %1 alpha beta").arg(i);
+}
+
+void seedTexts()
+{
+    g_texts.clear();
+    for (int i = 0; i < kTexts; ++i) {
+        auto *t = new DiagramTextItem();
+        t->setPlainText(textSeed(i));
+        t->setPos((i % 8) * 150.0, (i / 8) * 150.0);
+        g_scene->addItem(t);
+        g_texts << t;
+    }
+}
+
+// 加载可能不断往场景里加元素：超过上限就清空重建，内存与单次耗时都有界
+void boundScene()
+{
+    if (g_scene->items().size() > 5000) {
+        g_scene->clear();
+        seedTexts();
+    }
+}
+
+QString tmpFile(const QByteArray &data)
+{
+    const QString path = g_tmp->filePath(QStringLiteral("input.bin"));
+    QFile f(path);
+    if (f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        f.write(data);
+    return path;
+}
+
+QList<QByteArray> parts(const QByteArray &data)
+{
+    QList<QByteArray> p = data.split('\0');
+    while (p.size() < 3)
+        p << QByteArray();
+    return p;
+}
+
+void buildDiagram()
+{
+    QList<DiagramItem *> items;
+    for (int i = 0; i < 6; ++i) {
+        auto *item = new DiagramItem(DiagramItem::Step, g_menu);
+        item->setPos(i * 150.0, (i % 2) * 120.0);
+        g_scene->addItem(item);
+        items << item;
+    }
+#ifdef QT_TEST_AI_HAS_ARROW
+    for (int i = 1; i < items.size(); ++i) {
+        auto *arrow = new Arrow(items[i - 1], items[i]);
+        items[i - 1]->addArrow(arrow);
+        items[i]->addArrow(arrow);
+        g_scene->addItem(arrow);
+        arrow->updatePosition();
+    }
+#endif
+}
+
+void writeSeed(const QString &dir, const QString &target, const QByteArray &data)
+{
+    QDir().mkpath(dir + QLatin1Char('/') + target);
+    QFile f(dir + QLatin1Char('/') + target + QStringLiteral("/seed-saved"));
+    if (f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        f.write(data);
+}
+
+std::map<std::string, std::function<void(const QByteArray &)>> targets()
+{
+    std::map<std::string, std::function<void(const QByteArray &)>> t;
+@TARGETS@
+    return t;
+}
+
+void saveSeeds(const QString &dir)
+{
+@SEEDS@
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    static int qargc = 1;
+    static char *qargv[] = {(*argv)[0], nullptr};
+    Q_UNUSED(argc);
+    g_app = new QApplication(qargc, qargv);
+    g_tmp = new QTemporaryDir();
+    g_menu = new QMenu();
+    g_window = new MainWindow();
+    for (QGraphicsView *view : g_window->findChildren<QGraphicsView *>()) {
+        if ((g_scene = qobject_cast<DiagramScene *>(view->scene())))
+            break;
+    }
+    if (!g_scene)
+        g_scene = g_window->findChild<DiagramScene *>();
+    if (!g_scene) {
+        fprintf(stderr, "qt_test_ai_fuzz: MainWindow has no DiagramScene\n");
+        std::exit(2);
+    }
+    // 入口可能弹出提示框：模态窗口自带事件循环，定时器在里面触发就把它关掉
+    auto *closer = new QTimer(g_app);
+    QObject::connect(closer, &QTimer::timeout, [] {
+        if (QWidget *w = QApplication::activeModalWidget())
+            w->close();
+    });
+    closer->start(0);
+
+    const QByteArray seedOut = qgetenv("QT_TEST_AI_FUZZ_SEED_OUT");
+    if (!seedOut.isEmpty()) {
+        saveSeeds(QString::fromLocal8Bit(seedOut));
+        std::exit(0);
+    }
+    seedTexts();
+    const std::string name = qgetenv("QT_TEST_AI_FUZZ_TARGET").toStdString();
+    auto all = targets();
+    auto it = all.find(name);
+    if (it == all.end()) {
+        fprintf(stderr, "qt_test_ai_fuzz: unknown target '%s'; available:", name.c_str());
+        for (const auto &kv : all)
+            fprintf(stderr, " %s", kv.first.c_str());
+        fprintf(stderr, "\n");
+        std::exit(2);
+    }
+    g_target = it->second;
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const QByteArray in(reinterpret_cast<const char *>(data), int(size));
+    g_target(in);
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    boundScene();
+    return 0;
+}
+"""
+
+_COV = r"""/* Generated by Smart Testing Tools (fuzz harness). Do not edit.
+ *
+ * Edge coverage for the builtin engine. Everything else is compiled with
+ * -fsanitize-coverage=trace-pc; this file is C and gets no such flag, so the
+ * callback itself is not instrumented. Counting is on only while the driver
+ * runs an input (qt_test_ai_cov_on), which keeps the engine's own code out.
+ */
+#include <stdint.h>
+
+#define QT_TEST_AI_COV_MAP (1 << 16)
+
+unsigned char qt_test_ai_cov_map[QT_TEST_AI_COV_MAP] __attribute__((aligned(8)));
+volatile int qt_test_ai_cov_on;
+static uintptr_t qt_test_ai_prev;
+
+void __sanitizer_cov_trace_pc(void)
+{
+    uintptr_t pc, cur;
+    if (!qt_test_ai_cov_on)
+        return;
+    pc = (uintptr_t)__builtin_return_address(0);
+    cur = ((pc >> 4) ^ (pc << 8)) & (QT_TEST_AI_COV_MAP - 1);
+    qt_test_ai_cov_map[cur ^ qt_test_ai_prev]++;
+    qt_test_ai_prev = cur >> 1;
+}
+
+void qt_test_ai_cov_begin(void)
+{
+    qt_test_ai_prev = 0;
+}
+"""
+
+_DRIVER = r"""// Generated by Smart Testing Tools (fuzz harness). Do not edit.
+//
+// Minimal libFuzzer-compatible engine for toolchains without libFuzzer
+// (MinGW gcc): same entry points, same command line subset and the same
+// "#N NEW cov: ..." / "stat::..." output, so the tool drives both alike.
+//
+//   fuzz [-max_total_time=S] [-runs=N] [-max_len=B] [-timeout=S] [-seed=N]
+//        [-artifact_prefix=dir/] [-print_final_stats=1] CORPUS [SEED_DIRS...]
+//   fuzz -merge=1 OUT_DIR IN_DIRS...     keep the smallest inputs that add coverage
+//   fuzz FILE...                         run each file once (reproduce a crash)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+using Bytes = std::vector<uint8_t>;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv);
+extern "C" unsigned char qt_test_ai_cov_map[];
+extern "C" volatile int qt_test_ai_cov_on;
+extern "C" void qt_test_ai_cov_begin(void);
+
+namespace {
+
+const size_t kMap = 1 << 16;
+uint8_t g_virgin[kMap];
+const Bytes *g_current = nullptr;
+std::string g_prefix;
+std::atomic<long long> g_started{0};
+long g_timeout = 10;
+
+long long nowMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string hexName(const Bytes &b)
+{
+    uint64_t h = 1469598103934665603ULL;
+    for (uint8_t c : b)
+        h = (h ^ c) * 1099511628211ULL;
+    char buf[17];
+    snprintf(buf, sizeof buf, "%016llx", (unsigned long long)h);
+    return buf;
+}
+
+bool readFile(const fs::path &p, Bytes *out, size_t maxLen)
+{
+    std::ifstream in(p, std::ios::binary);
+    if (!in)
+        return false;
+    out->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (out->size() > maxLen)
+        out->resize(maxLen);
+    return true;
+}
+
+void writeFile(const fs::path &p, const Bytes &b)
+{
+    std::ofstream out(p, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(b.data()), std::streamsize(b.size()));
+}
+
+void dumpCurrent(const char *kind)
+{
+    if (!g_current)
+        return;
+    const std::string path = g_prefix + kind + "-" + hexName(*g_current);
+    if (FILE *f = fopen(path.c_str(), "wb")) {
+        fwrite(g_current->data(), 1, g_current->size(), f);
+        fclose(f);
+    }
+    fprintf(stderr, "==qt_test_ai_fuzz== %s; test unit written to %s\n", kind, path.c_str());
+}
+
+void onSignal(int sig)
+{
+    fprintf(stderr, "==qt_test_ai_fuzz== ERROR: deadly signal %d\n", sig);
+    dumpCurrent("crash");
+    fflush(stderr);
+    std::_Exit(1);
+}
+
+void watchdog()
+{
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        const long long s = g_started.load();
+        if (s && nowMs() - s > g_timeout * 1000) {
+            fprintf(stderr, "==qt_test_ai_fuzz== ERROR: timeout after %ld seconds\n", g_timeout);
+            dumpCurrent("timeout");
+            fflush(stderr);
+            std::_Exit(70);
+        }
+    }
+}
+
+uint8_t bucket(uint8_t c)
+{
+    if (c <= 2)
+        return c;
+    if (c == 3)
+        return 4;
+    if (c < 8)
+        return 8;
+    if (c < 16)
+        return 16;
+    if (c < 32)
+        return 32;
+    if (c < 128)
+        return 64;
+    return 128;
+}
+
+// 跑一个输入；有新的 (边, 计数桶) 时返回 true
+bool runOne(const Bytes &in)
+{
+    memset(qt_test_ai_cov_map, 0, kMap);
+    g_current = &in;
+    g_started = nowMs();
+    qt_test_ai_cov_begin();
+    qt_test_ai_cov_on = 1;
+    LLVMFuzzerTestOneInput(in.data(), in.size());
+    qt_test_ai_cov_on = 0;
+    g_started = 0;
+    // 大部分边没走到：按 8 字节一组跳过全零的
+    bool fresh = false;
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(qt_test_ai_cov_map);
+    for (size_t w = 0; w < kMap / 8; ++w) {
+        if (!words[w])
+            continue;
+        for (size_t i = w * 8; i < w * 8 + 8; ++i) {
+            if (!qt_test_ai_cov_map[i])
+                continue;
+            const uint8_t b = bucket(qt_test_ai_cov_map[i]);
+            if (b & ~g_virgin[i]) {
+                g_virgin[i] |= b;
+                fresh = true;
+            }
+        }
+    }
+    return fresh;
+}
+
+void coverage(size_t *cov, size_t *ft)
+{
+    *cov = *ft = 0;
+    for (size_t i = 0; i < kMap; ++i) {
+        if (!g_virgin[i])
+            continue;
+        ++*cov;
+        for (uint8_t b = g_virgin[i]; b; b &= b - 1)
+            ++*ft;
+    }
+}
+
+struct Mutator
+{
+    std::mt19937_64 rng;
+    size_t maxLen;
+
+    size_t pick(size_t n) { return n ? size_t(rng() % n) : 0; }
+
+    // QDataStream 是大端：长度 / 计数字段按大端 32 位整体改动最容易打到边界
+    void mutate(Bytes *b, const std::vector<Bytes> &corpus)
+    {
+        static const uint32_t interesting[] = {0u, 1u, 0x7fu, 0x80u, 0xffu, 0x7fffu, 0x8000u, 0xffffu,
+                                               0x7fffffffu, 0x80000000u, 0xffffffffu, 0x100u, 0x1000u, 0x10000u};
+        const int rounds = 1 + int(pick(4));
+        for (int r = 0; r < rounds; ++r) {
+            switch (pick(b->empty() ? 2 : 10)) {
+            case 0: { // 插入随机字节
+                const size_t n = 1 + pick(16);
+                Bytes ins(n);
+                for (auto &c : ins)
+                    c = uint8_t(rng());
+                b->insert(b->begin() + long(pick(b->size() + 1)), ins.begin(), ins.end());
+                break;
+            }
+            case 1: { // 拼接另一个语料
+                if (corpus.empty())
+                    break;
+                const Bytes &o = corpus[pick(corpus.size())];
+                if (o.empty())
+                    break;
+                const size_t from = pick(o.size());
+                const size_t n = 1 + pick(o.size() - from);
+                b->insert(b->begin() + long(pick(b->size() + 1)), o.begin() + long(from), o.begin() + long(from + n));
+                break;
+            }
+            case 2:
+                (*b)[pick(b->size())] ^= uint8_t(1u << pick(8));
+                break;
+            case 3:
+                (*b)[pick(b->size())] = uint8_t(rng());
+                break;
+            case 4: { // 删除一段
+                const size_t at = pick(b->size());
+                const size_t n = 1 + pick(std::min<size_t>(b->size() - at, 64));
+                b->erase(b->begin() + long(at), b->begin() + long(at + n));
+                break;
+            }
+            case 5: { // 复制一段到别处（重复结构）
+                const size_t at = pick(b->size());
+                const size_t n = 1 + pick(std::min<size_t>(b->size() - at, 256));
+                Bytes chunk(b->begin() + long(at), b->begin() + long(at + n));
+                b->insert(b->begin() + long(pick(b->size() + 1)), chunk.begin(), chunk.end());
+                break;
+            }
+            case 6:
+            case 7: { // 大端 32 位：特殊值或小幅加减
+                if (b->size() < 4)
+                    break;
+                const size_t at = pick(b->size() - 3);
+                uint32_t v = (uint32_t((*b)[at]) << 24) | (uint32_t((*b)[at + 1]) << 16) | (uint32_t((*b)[at + 2]) << 8) | (*b)[at + 3];
+                v = pick(2) ? interesting[pick(sizeof interesting / sizeof *interesting)] : v + uint32_t(int(pick(33)) - 16);
+                for (int k = 0; k < 4; ++k)
+                    (*b)[at + size_t(k)] = uint8_t(v >> (24 - 8 * k));
+                break;
+            }
+            case 8: { // 整段放大：推大输入
+                if (b->size() * 2 <= maxLen) {
+                    const Bytes copy(*b);
+                    b->insert(b->end(), copy.begin(), copy.end());
+                }
+                break;
+            }
+            default:
+                (*b)[pick(b->size())] = uint8_t(interesting[pick(5)]);
+                break;
+            }
+        }
+        if (b->size() > maxLen)
+            b->resize(maxLen);
+    }
+};
+
+std::vector<fs::path> filesIn(const std::string &dir)
+{
+    std::vector<fs::path> out;
+    std::error_code ec;
+    for (const auto &e : fs::directory_iterator(dir, ec)) {
+        if (e.is_regular_file())
+            out.push_back(e.path());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    long long maxTime = 0, runs = -1;
+    size_t maxLen = 65536;
+    unsigned long long seed = (unsigned long long)nowMs();
+    bool merge = false, stats = false;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto val = [&](const char *key) -> const char * {
+            const size_t n = strlen(key);
+            return a.compare(0, n, key) == 0 ? a.c_str() + n : nullptr;
+        };
+        if (const char *v = val("-max_total_time="))
+            maxTime = atoll(v);
+        else if (const char *v = val("-runs="))
+            runs = atoll(v);
+        else if (const char *v = val("-max_len="))
+            maxLen = size_t(atoll(v));
+        else if (const char *v = val("-timeout="))
+            g_timeout = atol(v);
+        else if (const char *v = val("-seed="))
+            seed = strtoull(v, nullptr, 10);
+        else if (const char *v = val("-artifact_prefix="))
+            g_prefix = v;
+        else if (const char *v = val("-merge="))
+            merge = atoi(v) != 0;
+        else if (const char *v = val("-print_final_stats="))
+            stats = atoi(v) != 0;
+        else if (!a.empty() && a[0] != '-')
+            positional.push_back(a);
+    }
+    LLVMFuzzerInitialize(&argc, &argv);
+    signal(SIGSEGV, onSignal);
+    signal(SIGABRT, onSignal);
+    signal(SIGFPE, onSignal);
+    signal(SIGILL, onSignal);
+    std::thread(watchdog).detach();
+
+    // 复现：参数都是文件时每个跑一次
+    if (!positional.empty() && std::all_of(positional.begin(), positional.end(), [](const std::string &p) { return fs::is_regular_file(p); })) {
+        for (const auto &p : positional) {
+            Bytes b;
+            readFile(p, &b, size_t(-1));
+            fprintf(stderr, "Running: %s\n", p.c_str());
+            const long long t0 = nowMs();
+            runOne(b);
+            fprintf(stderr, "Executed %s in %lld ms\n", p.c_str(), nowMs() - t0);
+        }
+        return 0;
+    }
+    if (positional.empty()) {
+        fprintf(stderr, "usage: %s [options] CORPUS_DIR [SEED_DIRS...]\n", argv[0]);
+        return 2;
+    }
+    std::error_code ec;
+    fs::create_directories(positional[0], ec);
+
+    if (merge) {
+        // 先跑输出目录里已有的（基线），再按从小到大跑输入目录，只留带来新覆盖的
+        for (const auto &p : filesIn(positional[0])) {
+            Bytes b;
+            if (readFile(p, &b, maxLen))
+                runOne(b);
+        }
+        std::vector<std::pair<size_t, fs::path>> inputs;
+        for (size_t d = 1; d < positional.size(); ++d)
+            for (const auto &p : filesIn(positional[d]))
+                inputs.emplace_back(fs::file_size(p, ec), p);
+        std::sort(inputs.begin(), inputs.end());
+        size_t added = 0;
+        for (const auto &in : inputs) {
+            Bytes b;
+            if (readFile(in.second, &b, maxLen) && runOne(b)) {
+                writeFile(fs::path(positional[0]) / hexName(b), b);
+                ++added;
+            }
+        }
+        fprintf(stderr, "MERGE-OUTER: %zu new files added to %s\n", added, positional[0].c_str());
+        return 0;
+    }
+
+    std::vector<Bytes> corpus;
+    size_t corpusBytes = 0;
+    for (const auto &dir : positional) {
+        for (const auto &p : filesIn(dir)) {
+            Bytes b;
+            if (readFile(p, &b, maxLen)) {
+                runOne(b);
+                corpusBytes += b.size();
+                corpus.push_back(std::move(b));
+            }
+        }
+    }
+    if (corpus.empty()) {
+        corpus.emplace_back();
+        runOne(corpus.back());
+    }
+    size_t cov = 0, ft = 0;
+    coverage(&cov, &ft);
+    fprintf(stderr, "#%zu\tINITED cov: %zu ft: %zu corp: %zu/%zub\n", corpus.size(), cov, ft, corpus.size(), corpusBytes);
+
+    Mutator m{std::mt19937_64(seed), maxLen};
+    const long long start = nowMs();
+    long long execs = 0, lastPulse = start;
+    size_t added = 0;
+    while ((runs < 0 || execs < runs) && (maxTime <= 0 || nowMs() - start < maxTime * 1000)) {
+        Bytes b = corpus[m.pick(corpus.size())];
+        m.mutate(&b, corpus);
+        ++execs;
+        if (runOne(b)) {
+            writeFile(fs::path(positional[0]) / hexName(b), b);
+            corpusBytes += b.size();
+            ++added;
+            coverage(&cov, &ft);
+            const double secs = std::max(1e-3, (nowMs() - start) / 1000.0);
+            fprintf(stderr, "#%lld\tNEW    cov: %zu ft: %zu corp: %zu/%zub exec/s: %.0f len: %zu\n", execs, cov, ft, corpus.size() + 1,
+                    corpusBytes, execs / secs, b.size());
+            corpus.push_back(std::move(b));
+        }
+        if (nowMs() - lastPulse > 10000) {
+            lastPulse = nowMs();
+            const double secs = std::max(1e-3, (lastPulse - start) / 1000.0);
+            fprintf(stderr, "#%lld\tpulse  cov: %zu ft: %zu corp: %zu/%zub exec/s: %.0f\n", execs, cov, ft, corpus.size(), corpusBytes, execs / secs);
+        }
+    }
+    const double secs = std::max(1e-3, (nowMs() - start) / 1000.0);
+    coverage(&cov, &ft);
+    fprintf(stderr, "#%lld\tDONE   cov: %zu ft: %zu corp: %zu/%zub exec/s: %.0f\n", execs, cov, ft, corpus.size(), corpusBytes, execs / secs);
+    if (stats) {
+        fprintf(stderr, "stat::number_of_executed_units: %lld\n", execs);
+        fprintf(stderr, "stat::average_exec_per_sec:     %.0f\n", execs / secs);
+        fprintf(stderr, "stat::new_units_added:          %zu\n", added);
+    }
+    return 0;
+}
+"""
+
+
+def _owner_expr(owner: str) -> str:
+    return "g_window" if owner == "MainWindow" else "g_scene"
+
+
+def _load_call(e: dict[str, str]) -> str:
+    obj, fn = _owner_expr(e["owner"]), e["method"]
+    if e["kind"] == "stream":
+        return f"QDataStream s(in); {obj}->{fn}(s);"
+    if e["kind"] == "device":
+        return f"QByteArray copy(in); QBuffer b(&copy); b.open(QIODevice::ReadOnly); {obj}->{fn}(&b);"
+    return f"{obj}->{fn}(tmpFile(in));"
+
+
+def _save_call(e: dict[str, str]) -> str:
+    obj, fn = _owner_expr(e["owner"]), e["method"]
+    if e["kind"] == "stream":
+        return f"buf.clear(); {{ QDataStream s(&buf, QIODevice::WriteOnly); {obj}->{fn}(s); }}"
+    if e["kind"] == "device":
+        return f"buf.clear(); {{ QBuffer b(&buf); b.open(QIODevice::WriteOnly); {obj}->{fn}(&b); }}"
+    return (
+        f"buf.clear(); {{ const QString path = g_tmp->filePath(QStringLiteral(\"seed.bin\")); {obj}->{fn}(path); "
+        "QFile f(path); if (f.open(QIODevice::ReadOnly)) buf = f.readAll(); }"
+    )
+
+
+def harness_text(found: dict[str, Any]) -> str:
+    headers = set(found.get("headers") or [])
+    includes = [f'#include "{h}"' for h in ("diagramscene.h", "mainwindow.h") if h in headers or h == "mainwindow.h"]
+    dialog = found.get("dialog")
+    if dialog and dialog["header"] not in ("diagramscene.h", "mainwindow.h"):
+        includes.append(f'#include "{dialog["header"]}"')
+
+    lines: list[str] = []
+    for e, name in zip(found.get("load") or [], targets(found)):
+        lines.append(f'    t["{name}"] = [](const QByteArray &in) {{ {_load_call(e)} }};')
+    if found.get("text"):
+        # 每个输入先把文字元素恢复原样，替换不会在多次输入间累积放大
+        body = ["for (int i = 0; i < g_texts.size(); ++i) g_texts[i]->setPlainText(textSeed(i));", "const QList<QByteArray> p = parts(in);"]
+        for e in found["text"]:
+            args = "QString::fromUtf8(p[0])" + (", QString::fromUtf8(p[1])" if e["args"] == 2 else "")
+            body.append(f"g_window->{e['method']}({args});")
+        lines.append('    t["find_replace"] = [](const QByteArray &in) {\n        ' + "\n        ".join(body) + "\n    };")
+    if dialog:
+        make = (
+            "new FindReplaceDialog(g_window)" if dialog.get("parent") else "new FindReplaceDialog()" if dialog.get("parent") is False else "nullptr"
+        )
+        lines.append(
+            "    t[\"find_dialog\"] = [](const QByteArray &in) {\n"
+            "        // 用 MainWindow 自己的对话框（信号已连好）；没有时自建一个\n"
+            f"        static FindReplaceDialog *dlg = g_window->findChild<FindReplaceDialog *>() ? g_window->findChild<FindReplaceDialog *>() : {make};\n"
+            "        if (!dlg)\n"
+            "            return;\n"
+            "        for (int i = 0; i < g_texts.size(); ++i) g_texts[i]->setPlainText(textSeed(i));\n"
+            "        const QList<QByteArray> p = parts(in);\n"
+            "        const QList<QLineEdit *> edits = dlg->findChildren<QLineEdit *>();\n"
+            "        for (int i = 0; i < edits.size(); ++i)\n"
+            "            edits[i]->setText(QString::fromUtf8(p.value(i)));\n"
+            "        for (QAbstractButton *b : dlg->findChildren<QAbstractButton *>())\n"
+            "            b->click();\n"
+            "    };"
+        )
+    seeds: list[str] = []
+    names = dict(zip([json.dumps(e, sort_keys=True) for e in found.get("load") or []], targets(found)))
+    for e in found.get("load") or []:
+        # 同类参数、同一个对象上的保存入口生成的数据就是合法输入
+        partner = next((s for s in found.get("save") or [] if s["kind"] == e["kind"] and s["owner"] == e["owner"]), None)
+        partner = partner or next((s for s in found.get("save") or [] if s["kind"] == e["kind"]), None)
+        if partner:
+            seeds.append(f"    {_save_call(partner)}")
+            seeds.append(f'    writeSeed(dir, QStringLiteral("{names[json.dumps(e, sort_keys=True)]}"), buf);')
+    return (
+        _HARNESS.replace("@INCLUDES@", "\n".join(includes))
+        .replace("@TARGETS@", "\n".join(lines))
+        .replace("@SEEDS@", "\n".join(["    buildDiagram();", "    QByteArray buf;", *seeds]) if seeds else "    Q_UNUSED(dir);")
+    )
+
+
+def pro_text(project_root: Path, tests_dir: Path, eng: str | None = None) -> str:
+    """Application sources plus the harness, every C++ TU instrumented for the chosen engine."""
+    eng = eng or engine()
+    d = fuzz_dir(tests_dir)
+    srcs, hdrs = project_lib.project_sources(project_root)
+    own = [HARNESS_FILE] + ([DRIVER_FILE, COV_FILE] if eng == "builtin" else [])
+    src = " \\\n    ".join([*own, *(project_lib.rel_path(f, d) for f in srcs)])
+    hdr = " \\\n    ".join(project_lib.rel_path(f, d) for f in hdrs)
+    qrc = sorted(Path(project_root).glob("*.qrc"))
+    res = ("\nRESOURCES += \\\n    " + " \\\n    ".join(project_lib.rel_path(f, d) for f in qrc) + "\n") if qrc else ""
+    if eng == "libfuzzer":
+        flags = "QMAKE_CXXFLAGS += -g -fsanitize=fuzzer-no-link\nQMAKE_LFLAGS += -fsanitize=fuzzer\n"
+    else:
+        # 只有 C++ 编译单元插桩；fuzz_cov.c 走 QMAKE_CFLAGS，回调本身不插桩
+        flags = "QMAKE_CXXFLAGS += -g -fsanitize-coverage=trace-pc\n"
+    if (os.getenv("QT_TEST_AI_FUZZ_ASAN") or "").strip().lower() in {"1", "true", "yes", "y", "on"}:
+        flags += "QMAKE_CXXFLAGS += -fsanitize=address -fno-omit-frame-pointer\nQMAKE_CFLAGS += -fsanitize=address\nQMAKE_LFLAGS += -fsanitize=address\n"
+    return (
+        f"# Generated by Smart Testing Tools (fuzz harness, engine {eng}); do not edit.\n"
+        "TEMPLATE = app\n"
+        f"TARGET = {FUZZ_TARGET}\n"
+        "CONFIG += release c++17 console\n"
+        "CONFIG -= app_bundle debug\n"
+        f"QT += {project_lib.qt_modules(project_root)}\n"
+        f"INCLUDEPATH += {project_lib.rel_path(Path(project_root), d)}\n"
+        f"{flags}"
+        "\n"
+        f"SOURCES += \\\n    {src}\n"
+        "\n"
+        f"HEADERS += \\\n    {hdr}\n"
+        f"{res}"
+        "\n"
+        "DESTDIR = $$PWD/bin\n"
+        "OBJECTS_DIR = $$PWD/obj\n"
+        "MOC_DIR = $$PWD/moc\n"
+        "UI_DIR = $$PWD/ui\n"
+        "RCC_DIR = $$PWD/rcc\n"
+    )
+
+
+def write_harness(project_root: Path, tests_dir: Path, found: dict[str, Any] | None = None) -> Path:
+    found = found if found is not None else discover(project_root)
+    d = fuzz_dir(tests_dir)
+    coverage_build.write_if_changed(d / HARNESS_FILE, harness_text(found))
+    coverage_build.write_if_changed(d / DRIVER_FILE, _DRIVER)
+    coverage_build.write_if_changed(d / COV_FILE, _COV)
+    pro = d / f"{FUZZ_TARGET}.pro"
+    coverage_build.write_if_changed(pro, pro_text(project_root, tests_dir))
+    return pro
+
+
+def executable(tests_dir: Path) -> Path | None:
+    return workload.executable(fuzz_dir(tests_dir) / "bin", FUZZ_TARGET)
+
+
+def build(project_root: Path, tests_dir: Path, found: dict[str, Any] | None = None) -> tuple[bool, dict[str, Any]]:
+    pro = write_harness(project_root, tests_dir, found)
+    return coverage_build.build(pro, fuzz_dir(tests_dir), args=[])
+
+
+# ----------------------------
+# running
+# ----------------------------
+_STAT_RE = re.compile(r"^stat::(\w+):\s*([\d.]+)", re.M)
+_COV_RE = re.compile(r"^#(\d+)\s+(INITED|NEW|pulse|DONE|REDUCE)\s+cov: (\d+) ft: (\d+) corp: (\d+)/(\d+)(\w*)b?", re.M)
+
+
+def parse_output(text: str) -> dict[str, Any]:
+    """execs, exec/s, new units and the first / last coverage line of a libFuzzer(-style) log."""
+    stats = {k: float(v) for k, v in _STAT_RE.findall(text or "")}
+    lines = _COV_RE.findall(text or "")
+    first = next((ln for ln in lines if ln[1] == "INITED"), lines[0] if lines else None)
+    last = lines[-1] if lines else None
+    out: dict[str, Any] = {
+        "execs": int(stats.get("number_of_executed_units") or (int(last[0]) if last else 0)),
+        "exec_per_sec": stats.get("average_exec_per_sec"),
+        "new_units": int(stats.get("new_units_added") or sum(1 for ln in lines if ln[1] == "NEW")),
+    }
+    if first:
+        out["cov_start"], out["ft_start"] = int(first[2]), int(first[3])
+    if last:
+        out["cov"], out["ft"], out["corpus_units"] = int(last[2]), int(last[3]), int(last[4])
+    return out
+
+
+def _files(d: Path) -> list[Path]:
+    return sorted(p for p in d.glob("*") if p.is_file()) if d.is_dir() else []
+
+
+def _run(cmd: list[str], cwd: Path, env: dict[str, str], timeout: float) -> dict[str, Any]:
+    t0 = time.perf_counter()
+    try:
+        p = subprocess.run(cmd, cwd=str(cwd), env=env, capture_output=True, text=True, errors="replace", timeout=timeout)
+        out = {"returncode": p.returncode, "stderr": p.stderr or "", "stdout": p.stdout or ""}
+    except subprocess.TimeoutExpired as e:
+        err = e.stderr.decode("utf-8", "replace") if isinstance(e.stderr, bytes) else (e.stderr or "")
+        out = {"returncode": -1, "timed_out": True, "stderr": err, "stdout": ""}
+    except OSError as e:
+        out = {"returncode": -1, "stderr": str(e), "stdout": ""}
+    out["duration_s"] = round(time.perf_counter() - t0, 3)
+    return out
+
+
+def minimize(exe: Path, tests_dir: Path, target: str, env: dict[str, str]) -> dict[str, Any]:
+    """Replace the corpus with the smallest subset keeping its coverage (-merge=1 into an empty directory)."""
+    corpus = corpus_dir(tests_dir, target)
+    before = _files(corpus)
+    tmp = corpus.with_name(corpus.name + ".min")
+    shutil.rmtree(tmp, ignore_errors=True)
+    tmp.mkdir(parents=True)
+    # 合并时某个输入崩溃 / 超时，崩溃输入也要落进 artifacts 目录而不是运行目录
+    art = artifacts_dir(tests_dir, target)
+    cmd = [str(exe), "-merge=1", f"-max_len={max_len()}", f"-timeout={timeout_s()}", f"-artifact_prefix={art.as_posix()}/", str(tmp), str(corpus)]
+    r = _run(cmd, fuzz_dir(tests_dir), env, timeout=1800)
+    kept = _files(tmp)
+    if r["returncode"] != 0 or (before and not kept):
+        shutil.rmtree(tmp, ignore_errors=True)
+        return {"ok": False, "before": len(before), "returncode": r["returncode"]}
+    out = {
+        "ok": True,
+        "before": len(before),
+        "after": len(kept),
+        "bytes_before": sum(p.stat().st_size for p in before),
+        "bytes_after": sum(p.stat().st_size for p in kept),
+        "duration_s": r["duration_s"],
+    }
+    shutil.rmtree(corpus, ignore_errors=True)
+    tmp.rename(corpus)
+    return out
+
+
+def load_history(tests_dir: Path) -> dict[str, Any]:
+    return workload.load_history(fuzz_dir(tests_dir) / HISTORY_FILE)
+
+
+def record_run(tests_dir: Path, run: dict[str, Any]) -> None:
+    workload.record_run(fuzz_dir(tests_dir) / HISTORY_FILE, run)
+
+
+def as_benchmarks(results: dict[str, dict[str, Any]]) -> dict[str, dict[str, dict[str, Any]]]:
+    """Shape of benchmark_suite.results_from(), so db.save_benchmarks() keeps exec/s and coverage trends."""
+    out: dict[str, dict[str, dict[str, Any]]] = {}
+    for target, r in results.items():
+        rows: dict[str, dict[str, Any]] = {}
+        if r.get("exec_per_sec") is not None:
+            rows["exec_per_sec"] = {"metric": "execs/s", "value": float(r["exec_per_sec"]), "iterations": int(r.get("execs") or 1)}
+        if r.get("ft") is not None:
+            rows["features"] = {"metric": "features", "value": float(r["ft"]), "iterations": 1}
+        if rows:
+            out[f"fuzz:{target}"] = rows
+    return out
+
+
+def run(
+    project_root: Path, tests_dir: Path | None = None, *, only: list[str] | None = None, seconds_per_target: int | None = None
+) -> tuple[list[Finding], dict[str, Any]]:
+    """
+    Build the harness, then per target: seed, fuzz in-process, minimize the corpus.
+
+    Corpora persist under tests/generated/fuzz/corpus/<target> between runs.
+    Findings: crashes / timeouts found this run (error, with the reproducer),
+    per-target exec/s and the coverage gained (info).
+    """
+    project_root = Path(project_root)
+    tests_dir = Path(tests_dir) if tests_dir is not None else project_root / "tests" / "generated"
+    findings: list[Finding] = []
+    found = discover(project_root)
+    names = targets(found)
+    if only:
+        names = [n for n in names if n in only]
+    meta: dict[str, Any] = {"engine": engine(), "entry_points": found, "targets": names}
+    if not names:
+        findings.append(Finding("fuzz", "info", "未发现可模糊测试的入口", "在 MainWindow / DiagramScene 头文件里没有找到 QDataStream / QIODevice / 文件名参数的加载函数，也没有查找替换入口"))
+        return findings, meta
+    ok, m_build = build(project_root, tests_dir, found)
+    meta["build"] = {k: m_build.get(k) for k in ("build_dir", "qmake_skipped", "jobs", "duration_s")}
+    if not ok:
+        findings.append(Finding("fuzz", "error", "模糊测试程序编译失败", workload.build_error(m_build)))
+        return findings, meta
+    exe = executable(tests_dir)
+    if exe is None:
+        findings.append(Finding("fuzz", "error", "未找到模糊测试程序", str(fuzz_dir(tests_dir) / "bin")))
+        return findings, meta
+
+    d = fuzz_dir(tests_dir)
+    d.mkdir(parents=True, exist_ok=True)
+    env = dict(os.environ)
+    env["QT_QPA_PLATFORM"] = "offscreen"
+    # 用保存入口生成合法的种子（每次都覆盖 seed-saved，跟着保存格式走）
+    seeds = d / "seeds"
+    _run([str(exe)], d, {**env, "QT_TEST_AI_FUZZ_SEED_OUT": str(seeds)}, timeout=120)
+    secs = seconds_per_target or seconds()
+    prev = next(iter(reversed(load_history(tests_dir).get("runs") or [])), None) or {}
+    results: dict[str, dict[str, Any]] = {}
+    for name in names:
+        corpus = corpus_dir(tests_dir, name)
+        art = artifacts_dir(tests_dir, name)
+        corpus.mkdir(parents=True, exist_ok=True)
+        art.mkdir(parents=True, exist_ok=True)
+        for s in _files(seeds / name):
+            if not (corpus / s.name).exists():
+                shutil.copy2(s, corpus / s.name)
+        before = {p.name for p in _files(art)}
+        t_env = {**env, "QT_TEST_AI_FUZZ_TARGET": name}
+        cmd = [
+            str(exe),
+            f"-max_total_time={secs}",
+            f"-max_len={max_len()}",
+            f"-timeout={timeout_s()}",
+            "-print_final_stats=1",
+            f"-artifact_prefix={art.as_posix()}/",
+            str(corpus),
+        ]
+        r = _run(cmd, d, t_env, timeout=secs + 300)
+        res = parse_output(r["stderr"])
+        res.update({"cmd": cmd, "returncode": r["returncode"], "duration_s": r["duration_s"], "log_tail": r["stderr"][-3000:]})
+        res["minimize"] = minimize(exe, tests_dir, name, t_env)
+        res["artifacts"] = [str(art / n) for n in sorted({p.name for p in _files(art)} - before)]
+        res["corpus_files"] = len(_files(corpus))
+        results[name] = res
+
+        for a in res["artifacts"]:
+            kind = Path(a).name.split("-", 1)[0]
+            findings.append(
+                Finding(
+                    "fuzz",
+                    "error",
+                    f"模糊测试 {name}: {'崩溃' if kind == 'crash' else '超时' if kind == 'timeout' else kind}（{Path(a).stat().st_size} 字节输入）",
+                    f"复现: QT_TEST_AI_FUZZ_TARGET={name} {exe} {a}\n\n{res['log_tail'][-1500:]}",
+                    rule_id=f"fuzz_{kind}",
+                )
+            )
+        if res.get("exec_per_sec") is None and not res["artifacts"]:
+            findings.append(Finding("fuzz", "error", f"模糊测试 {name} 没有运行起来（退出码 {r['returncode']}）", res["log_tail"][-2000:]))
+            continue
+        old = ((prev.get("results") or {}).get(name) or {})
+        gained = res.get("ft", 0) - res.get("ft_start", 0)
+        mini = res["minimize"]
+        findings.append(
+            Finding(
+                "fuzz",
+                "info",
+                f"模糊测试 {name}: {res.get('exec_per_sec') or 0:.0f} exec/s，新增覆盖 {gained} 个特征（{res.get('new_units', 0)} 个新输入）",
+                f"执行 {res.get('execs', 0)} 次 / {secs}s；覆盖边 {res.get('cov', 0)}，特征 {res.get('ft', 0)}"
+                + (f"（上次结束时 {old['ft']}）" if old.get("ft") is not None else "")
+                + (f"；语料 {mini['before']} → {mini['after']} 个文件（{mini['bytes_before']} → {mini['bytes_after']} 字节）" if mini.get("ok") else "")
+                + f"；语料目录 {corpus}",
+            )
+        )
+
+    meta["results"] = results
+    # 与基准套件同形，db 把它写进 benchmark_results（GUI 一键运行与 CLI 共用）
+    meta["benchmarks"] = {"backend": "fuzz", "results": as_benchmarks(results)}
+    record_run(
+        tests_dir,
+        {
+            "at": datetime.now().isoformat(timespec="seconds"),
+            "engine": engine(),
+            "results": {n: {k: r.get(k) for k in ("execs", "exec_per_sec", "cov", "ft", "new_units", "corpus_files")} for n, r in results.items()},
+        },
+    )
+    return findings, meta
@@ -0,0 +1,356 @@
+from __future__ import annotations
+
+import json
+import os
+import threading
+import time
+from collections import deque
+from typing import Any, Iterator
+
+from . import tracing
+from .llm_scheduler import provider_of
+
+
+def _env_int(name: str, default: int) -> int:
+    try:
+        return int((os.getenv(name) or "").strip() or default)
+    except Exception:
+        return default
+
+
+def _env_off(name: str, default: str) -> bool:
+    return (os.getenv(name) or default).strip().lower() in {"0", "false", "no", "off"}
+
+
+def max_concurrency() -> int:
+    """Cap on in-flight LLM HTTP requests across all threads (QT_TEST_AI_LLM_MAX_CONCURRENCY, default 8)."""
+    return max(1, _env_int("QT_TEST_AI_LLM_MAX_CONCURRENCY", 8))
+
+
+# ----------------------------
+# metrics
+# ----------------------------
+def _percentile(values: list[float], q: float) -> float | None:
+    if not values:
+        return None
+    vs = sorted(values)
+    k = min(len(vs) - 1, max(0, int(round(q * (len(vs) - 1)))))
+    return round(vs[k], 3)
+
+
+class LLMMetrics:
+    """
+    Process-wide log of LLM requests (latency, status, tokens).
+
+    Records are numbered; a run takes mark() at its start and summary(since=mark)
+    at its end, so concurrent or consecutive runs each see only their own calls.
+    """
+
+    def __init__(self, max_records: int = 5000) -> None:
+        self._records: deque[dict[str, Any]] = deque(maxlen=max_records)
+        self._seq = 0
+        self._lock = threading.Lock()
+
+    def mark(self) -> int:
+        with self._lock:
+            return self._seq
+
+    def record(self, **fields: Any) -> dict[str, Any]:
+        with self._lock:
+            self._seq += 1
+            rec = {"seq": self._seq, "ts": time.time(), **fields}
+            self._records.append(rec)
+            return rec
+
+    def records(self, since: int = 0) -> list[dict[str, Any]]:
+        with self._lock:
+            return [dict(r) for r in self._records if r["seq"] > since]
+
+    def summary(self, since: int = 0) -> dict[str, Any]:
+        recs = self.records(since)
+        out: dict[str, Any] = {"requests": 0}
+        if not recs:
+            return out
+        by_provider: dict[str, list[dict[str, Any]]] = {}
+        for r in recs:
+            by_provider.setdefault(r.get("provider") or "default", []).append(r)
+
+        def _agg(rs: list[dict[str, Any]]) -> dict[str, Any]:
+            net = [r for r in rs if not r.get("cached")]
+            lat = [float(r["latency_s"]) for r in net if r.get("latency_s") is not None]
+            ttfb = [float(r["ttfb_s"]) for r in net if r.get("ttfb_s") is not None]
+            return {
+                "requests": len(rs),
+                "cache_hits": sum(1 for r in rs if r.get("cached")),
+                "errors": sum(1 for r in net if r.get("error") or int(r.get("status") or 0) >= 400),
+                "prompt_tokens": sum(int(r.get("prompt_tokens") or 0) for r in rs),
+                "completion_tokens": sum(int(r.get("completion_tokens") or 0) for r in rs),
+                "latency_p50_s": _percentile(lat, 0.5),
+                "latency_p95_s": _percentile(lat, 0.95),
+                "latency_total_s": round(sum(lat), 3),
+                "ttfb_p50_s": _percentile(ttfb, 0.5),
+                # 同一 provider 之前已建立过连接的请求数（keep-alive 池可直接复用）
+                "warm_requests": sum(1 for r in net if r.get("warm")),
+            }
+
+        out = _agg(recs)
+        out["by_provider"] = {k: _agg(v) for k, v in sorted(by_provider.items())}
+        out["http_backend"] = default_client().backend
+        return out
+
+
+metrics = LLMMetrics()
+
+
+def record_usage(rec: dict[str, Any] | None, usage: Any) -> None:
+    """Copy an OpenAI/Anthropic style usage block into a metrics record."""
+    if rec is None or usage is None:
+        return
+    get = usage.get if isinstance(usage, dict) else (lambda k, d=None: getattr(usage, k, d))
+    pt = get("prompt_tokens", None)
+    if pt is None:
+        pt = get("input_tokens", None)
+    ct = get("completion_tokens", None)
+    if ct is None:
+        ct = get("output_tokens", None)
+    if pt is not None:
+        rec["prompt_tokens"] = int(pt)
+    if ct is not None:
+        rec["completion_tokens"] = int(ct)
+
+
+# ----------------------------
+# responses
+# ----------------------------
+class PooledResponse:
+    """
+    Thin wrapper giving requests and httpx responses the same surface
+    (status_code, headers, text, json(), iter_lines(), close()).
+
+    Holds a concurrency slot until the body is consumed or close() is called.
+    """
+
+    def __init__(self, raw: Any, *, backend: str, release, rec: dict[str, Any], started: float, stream: bool) -> None:
+        self._raw = raw
+        self._backend = backend
+        self._release = release
+        self.metric = rec
+        self._started = started
+        self._stream = stream
+        self._closed = False
+        if not stream:
+            # 非流式：正文已读完，立即归还并发名额
+            self._done()
+
+    @property
+    def status_code(self) -> int:
+        return int(self._raw.status_code)
+
+    @property
+    def headers(self):
+        return self._raw.headers
+
+    @property
+    def text(self) -> str:
+        self._read()
+        return self._raw.text
+
+    @property
+    def encoding(self):
+        return getattr(self._raw, "encoding", None)
+
+    @encoding.setter
+    def encoding(self, value) -> None:
+        try:
+            self._raw.encoding = value
+        except Exception:
+            pass
+
+    def json(self) -> Any:
+        self._read()
+        return self._raw.json()
+
+    def raise_for_status(self) -> None:
+        try:
+            self._raw.raise_for_status()
+        except Exception:
+            # 错误响应不会再被读取：关闭连接并归还名额
+            self.close()
+            raise
+
+    def _read(self) -> None:
+        # 流式请求按普通正文读取（错误体、网关不支持流式时的 JSON）：httpx 必须先 read()；读完即归还名额
+        if not self._stream or self._closed:
+            return
+        try:
+            if self._backend == "httpx":
+                self._raw.read()
+            else:
+                _ = self._raw.content
+        finally:
+            self._done()
+
+    def iter_lines(self, decode_unicode: bool = True) -> Iterator[Any]:
+        try:
+            if self._backend == "httpx":
+                yield from self._raw.iter_lines()
+            else:
+                yield from self._raw.iter_lines(decode_unicode=decode_unicode)
+        finally:
+            self._done()
+
+    def _done(self) -> None:
+        if self._closed:
+            return
+        self._closed = True
+        self.metric["latency_s"] = round(time.perf_counter() - self._started, 4)
+        # 同一个记录字典作为 span 属性：之后才解析出的 token 数也会进导出
+        tracing.record(f"llm {self.metric.get('label') or self.metric.get('provider')}", tracing.LLM, self._started, live=self.metric)
+        try:
+            self._release()
+        except Exception:
+            pass
+
+    def close(self) -> None:
+        try:
+            self._raw.close()
+        except Exception:
+            pass
+        self._done()
+
+    def __del__(self) -> None:
+        try:
+            self._done()
+        except Exception:
+            pass
+
+
+# ----------------------------
+# client
+# ----------------------------
+class PooledHttpClient:
+    """
+    One keep-alive connection pool shared by every LLM call in the process.
+
+    Uses httpx with HTTP/2 when httpx and h2 are installed (and
+    QT_TEST_AI_LLM_HTTP2 is not 0), otherwise a requests.Session with a sized
+    HTTPAdapter. Requests are thread-safe; in-flight calls are capped by a
+    semaphore so concurrent generation modes cannot open unbounded sockets.
+    """
+
+    def __init__(self, *, max_in_flight: int | None = None) -> None:
+        self.max_in_flight = max_in_flight or max_concurrency()
+        self._sem = threading.BoundedSemaphore(self.max_in_flight)
+        self._lock = threading.Lock()
+        self._hosts_seen: set[str] = set()
+        self.backend = "requests"
+        self._client: Any = None
+
+        if not _env_off("QT_TEST_AI_LLM_HTTP2", "1"):
+            try:
+                import h2  # noqa: F401  httpx 的 http2 依赖
+                import httpx
+
+                self._client = httpx.Client(
+                    http2=True,
+                    limits=httpx.Limits(
+                        max_connections=self.max_in_flight,
+                        max_keepalive_connections=self.max_in_flight,
+                        keepalive_expiry=90.0,
+                    ),
+                )
+                self.backend = "httpx"
+            except Exception:
+                self._client = None
+
+        if self._client is None:
+            import requests
+
+            session = requests.Session()
+            try:
+                from requests.adapters import HTTPAdapter
+
+                adapter = HTTPAdapter(pool_connections=8, pool_maxsize=self.max_in_flight, max_retries=0)
+                session.mount("https://", adapter)
+                session.mount("http://", adapter)
+            except Exception:
+                pass
+            self._client = session
+
+    def post(
+        self,
+        url: str,
+        *,
+        headers: dict[str, str] | None = None,
+        data: str | bytes | None = None,
+        json_body: Any = None,
+        timeout: float | None = None,
+        stream: bool = False,
+        label: str = "",
+    ) -> PooledResponse:
+        provider = provider_of(url)
+        with self._lock:
+            warm = provider in self._hosts_seen
+            self._hosts_seen.add(provider)
+        rec = metrics.record(provider=provider, label=label, stream=stream, warm=warm)
+
+        t_wait = time.perf_counter()
+        self._sem.acquire()
+        rec["queue_s"] = round(time.perf_counter() - t_wait, 4)
+        started = time.perf_counter()
+        try:
+            if data is None and json_body is not None:
+                data = json.dumps(json_body)
+                headers = {"Content-Type": "application/json", **(headers or {})}
+            if self.backend == "httpx":
+                req = self._client.build_request("POST", url, headers=headers, content=data, timeout=timeout)
+                raw = self._client.send(req, stream=stream)
+            else:
+                raw = self._client.post(url, headers=headers, data=data, timeout=timeout, stream=stream)
+        except Exception as e:
+            rec["error"] = f"{type(e).__name__}: {e}"[:300]
+            rec["latency_s"] = round(time.perf_counter() - started, 4)
+            self._sem.release()
+            raise
+        rec["status"] = int(getattr(raw, "status_code", 0) or 0)
+        rec["ttfb_s"] = round(time.perf_counter() - started, 4)
+        return PooledResponse(raw, backend=self.backend, release=self._sem.release, rec=rec, started=started, stream=stream)
+
+    def close(self) -> None:
+        try:
+            self._client.close()
+        except Exception:
+            pass
+
+
+_default: PooledHttpClient | None = None
+_default_lock = threading.Lock()
+
+
+def default_client() -> PooledHttpClient:
+    global _default
+    with _default_lock:
+        if _default is None:
+            _default = PooledHttpClient()
+        return _default
+
+
+def post(url: str, **kwargs: Any) -> PooledResponse:
+    """Module-level shortcut for default_client().post()."""
+    return default_client().post(url, **kwargs)
+
+
+def record_sdk_call(provider: str, *, label: str = "", started: float, usage: Any = None, error: str | None = None, stream: bool = False) -> None:
+    """Metrics for calls made through the openai / anthropic SDKs (they own their pools)."""
+    rec = metrics.record(provider=provider_of(provider), label=label, stream=stream, sdk=True)
+    rec["latency_s"] = round(time.perf_counter() - started, 4)
+    if error:
+        rec["error"] = error[:300]
+    else:
+        rec["status"] = 200
+    record_usage(rec, usage)
+    tracing.record(f"llm {label or rec.get('provider')}", tracing.LLM, started, live=rec)
+
+
+def record_cache_hit(provider: str, *, label: str = "") -> None:
+    metrics.record(provider=provider_of(provider), label=label, cached=True)
@@ -5,7 +5,9 @@ import os
 from dataclasses import dataclass
 from typing import Any
 
-import requests
+from . import http_client, llm_cache
+from .llm_scheduler import RateLimitError, call_with_backoff, retry_after_from_headers
+from .llm_stream import ProgressFn, StreamAbortedError, StreamMonitor, consume_stream, iter_sse_data, stream_enabled
 
 
 @dataclass(frozen=True)
@@ -68,13 +70,29 @@ def _chat_completions_url(cfg: LLMConfig) -> str:
     return base + "/v1/chat/completions"
 
 
-def chat_completion_text(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_tokens: int = 8000) -> str:
+def chat_completion_text(
+    cfg: LLMConfig,
+    *,
+    messages: list[dict[str, Any]],
+    max_tokens: int = 8000,
+    use_cache: bool | None = None,
+    stream: bool | None = None,
+    expect: str | None = None,
+    on_progress: ProgressFn | None = None,
+    label: str = "",
+) -> str:
     """Returns assistant text content. Raises Exception on error.
     
     Args:
         cfg: LLM configuration
         messages: Chat messages
         max_tokens: Maximum tokens for the response (default 8000, compatible with most APIs including DeepSeek's 8192 limit)
+        use_cache: False skips the on-disk response cache for this call (see llm_cache.py)
+        stream: request SSE streaming (default: QT_TEST_AI_LLM_STREAM)
+        expect: "json" / "code" lets the stream monitor stop early on a complete answer
+            and abort doomed ones (StreamAbortedError, see llm_stream.py)
+        on_progress: receives short progress lines while streaming
+        label: prefix for progress lines (e.g. the file being generated)
     """
 
     url = _chat_completions_url(cfg)
@@ -98,9 +116,40 @@ def chat_completion_text(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_
         except Exception:
             pass
 
-    resp = requests.post(url, headers=headers, data=json.dumps(payload), timeout=cfg.timeout_s)
+    # 相同 (model, messages, temperature, max_tokens) 的请求直接复用磁盘缓存
+    cache_key, cached = llm_cache.lookup(
+        model=cfg.model,
+        messages=messages,
+        temperature=payload["temperature"],
+        max_tokens=max_tokens,
+        endpoint=url,
+        use_cache=use_cache,
+    )
+    if cached is not None:
+        if do_log:
+            print(f"[LLM] cache hit key={cache_key[:12] if cache_key else ''}")
+        http_client.record_cache_hit(url, label=label)
+        return cached
+
+    use_stream = stream_enabled() if stream is None else bool(stream)
+    if use_stream:
+        payload["stream"] = True
+
+    def _post():
+        # 共享连接池：keep-alive 复用 TLS 连接，并受全局并发上限约束
+        r = http_client.post(url, headers=headers, data=json.dumps(payload), timeout=cfg.timeout_s, stream=use_stream, label=label)
+        if r.status_code == 429:
+            retry_after = retry_after_from_headers(r.headers)
+            # 重试前先关掉这次响应，否则流式请求一直占着连接和并发名额
+            r.close()
+            raise RateLimitError(f"LLM请求失败: url={url} HTTP 429 Too Many Requests", retry_after=retry_after)
+        return r
+
+    # 按 provider 令牌桶限流；429 时按 Retry-After / 指数退避重试
+    resp = call_with_backoff(_post, provider=url)
     if resp.status_code == 402:
         err = f"LLM请求失败: url={url} HTTP 402 Insufficient Balance (余额不足)"
+        resp.close()
         if do_log:
             print(f"[LLM] error: {err}")
         raise InsufficientBalanceError(err)
@@ -111,7 +160,32 @@ def chat_completion_text(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_
             print(f"[LLM] error: {err}")
         raise RuntimeError(err)
 
+    if use_stream and "text/event-stream" in (resp.headers.get("Content-Type") or ""):
+        monitor = StreamMonitor(expect=expect, on_progress=on_progress, label=label)
+        try:
+            resp.encoding = "utf-8"
+            content = consume_stream(iter_sse_data(resp.iter_lines(decode_unicode=True)), monitor)
+        except StreamAbortedError as e:
+            if do_log:
+                print(f"[LLM] stream aborted ({e.reason}): {e} stats={monitor.stats()}")
+            raise
+        finally:
+            # 提前结束时关闭连接，服务端随之停止生成
+            resp.close()
+        if do_log:
+            print(f"[LLM] stream done stats={monitor.stats()}")
+        # 流式响应不带 usage，按字符数估算
+        resp.metric["completion_tokens"] = max(1, monitor.chars // 4)
+        resp.metric["tokens_estimated"] = True
+        if not content.strip():
+            raise RuntimeError("LLM返回content为空")
+        text = content.strip()
+        llm_cache.store(cache_key, text, info={"model": cfg.model, "stream": monitor.stats()})
+        return text
+
+    # 网关不支持流式时会直接返回完整 JSON
     data = resp.json()
+    http_client.record_usage(resp.metric, data.get("usage") if isinstance(data, dict) else None)
     if do_log:
         try:
             import datetime
@@ -126,7 +200,9 @@ def chat_completion_text(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_
     content = msg.get("content")
     if not isinstance(content, str) or not content.strip():
         raise RuntimeError("LLM返回content为空")
-    return content.strip()
+    text = content.strip()
+    llm_cache.store(cache_key, text, info={"model": cfg.model})
+    return text
 
 
 def parse_json_from_text(text: str):
@@ -218,7 +294,16 @@ def parse_json_from_text(text: str):
         raise ValueError(f"JSON parse failed at position {getattr(e, 'pos', '?')}: {e.msg}. Context: {repr(error_context)}")
 
 
-def chat_completion_json(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_retries: int = 3, expect_type: type | tuple[type, ...] | None = None, max_tokens: int = 8000) -> Any:
+def chat_completion_json(
+    cfg: LLMConfig,
+    *,
+    messages: list[dict[str, Any]],
+    max_retries: int = 3,
+    expect_type: type | tuple[type, ...] | None = None,
+    max_tokens: int = 8000,
+    on_progress: ProgressFn | None = None,
+    label: str = "",
+) -> Any:
     """
     Call the chat completion and attempt to parse a JSON object/array from the response.
     Retries up to `max_retries` times, appending a repair hint when parsing fails.
@@ -230,13 +315,27 @@ def chat_completion_json(cfg: LLMConfig, *, messages: list[dict[str, Any]], max_
         max_retries: Maximum number of retry attempts
         expect_type: Expected type of the parsed JSON (dict, list, or tuple of types)
         max_tokens: Maximum tokens for the response (default 8000, compatible with DeepSeek)
+        on_progress / label: streaming progress (see chat_completion_text)
     """
     if max_retries < 1:
         max_retries = 1
 
     last_text = ""
     for attempt in range(1, max_retries + 1):
-        last_text = chat_completion_text(cfg, messages=messages, max_tokens=max_tokens)
+        try:
+            last_text = chat_completion_text(
+                cfg, messages=messages, max_tokens=max_tokens, expect="json", on_progress=on_progress, label=label
+            )
+        except StreamAbortedError as e:
+            # 流式输出已判定无效：不等剩余 token，直接带着原因重试
+            if attempt == max_retries:
+                raise RuntimeError(f"Failed to obtain valid JSON after {max_retries} attempts: {e}\nLast response preview: {e.partial[:2000]}")
+            if e.reason == "truncated":
+                hint = "上一次回复过长，在输出上限处被截断。请精简内容（减少用例数量、去掉注释），只返回一个完整合法的 JSON。"
+            else:
+                hint = f"上一次回复已中止（{e}）。请只返回一个合法的 JSON 对象或数组，不要包含代码块标记或额外说明。"
+            messages = list(messages) + [{"role": "user", "content": hint}]
+            continue
         try:
             parsed = parse_json_from_text(last_text)
             if expect_type and not isinstance(parsed, expect_type):
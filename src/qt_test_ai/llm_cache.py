@@ -0,0 +1,186 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import threading
+import time
+from pathlib import Path
+from typing import Any
+
+from .utils import cache_dir
+
+
+def _env_off(name: str, default: str) -> bool:
+    return (os.getenv(name) or default).strip().lower() in {"0", "false", "no", "off"}
+
+
+def _env_on(name: str) -> bool:
+    return (os.getenv(name) or "").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def cache_enabled() -> bool:
+    return not _env_off("QT_TEST_AI_LLM_CACHE", "1")
+
+
+def cache_bypassed() -> bool:
+    """QT_TEST_AI_LLM_CACHE_BYPASS=1: skip cache reads (fresh request), still store the answer."""
+    return _env_on("QT_TEST_AI_LLM_CACHE_BYPASS")
+
+
+def make_key(*, model: str, messages: list[dict[str, Any]], temperature: float, max_tokens: int, endpoint: str = "") -> str:
+    """Content address of one completion request."""
+    blob = json.dumps(
+        {
+            "endpoint": (endpoint or "").rstrip("/"),
+            "model": model,
+            "messages": messages,
+            "temperature": temperature,
+            "max_tokens": max_tokens,
+        },
+        sort_keys=True,
+        ensure_ascii=False,
+        separators=(",", ":"),
+    ).encode("utf-8")
+    return hashlib.sha256(blob).hexdigest()
+
+
+class LLMResponseCache:
+    """
+    On-disk cache: one JSON file per response at <root>/<key[:2]>/<key>.json.
+
+    Hits touch the file mtime, so eviction (oldest mtime first, once the total
+    size exceeds max_bytes) behaves like LRU.
+    """
+
+    def __init__(self, root: Path, *, max_bytes: int) -> None:
+        self.root = root
+        self.max_bytes = max(1, int(max_bytes))
+        self._lock = threading.Lock()
+        self._approx_size: int | None = None
+
+    def _path(self, key: str) -> Path:
+        return self.root / key[:2] / f"{key}.json"
+
+    def get(self, key: str) -> str | None:
+        p = self._path(key)
+        try:
+            data = json.loads(p.read_text(encoding="utf-8"))
+        except Exception:
+            return None
+        text = data.get("text") if isinstance(data, dict) else None
+        if not isinstance(text, str) or not text:
+            return None
+        try:
+            os.utime(p, None)
+        except Exception:
+            pass
+        return text
+
+    def put(self, key: str, text: str, *, info: dict[str, Any] | None = None) -> None:
+        if not isinstance(text, str) or not text:
+            return
+        p = self._path(key)
+        payload = {"key": key, "created_at": time.time(), "text": text, **({"info": info} if info else {})}
+        try:
+            p.parent.mkdir(parents=True, exist_ok=True)
+            tmp = p.with_suffix(f".{threading.get_ident()}.tmp")
+            tmp.write_text(json.dumps(payload, ensure_ascii=False), encoding="utf-8")
+            os.replace(tmp, p)
+        except Exception:
+            return
+        with self._lock:
+            if self._approx_size is None:
+                self._approx_size = self._total_size()
+            else:
+                try:
+                    self._approx_size += p.stat().st_size
+                except Exception:
+                    pass
+            if self._approx_size > self.max_bytes:
+                self._evict()
+
+    def _entries(self) -> list[tuple[float, int, Path]]:
+        out: list[tuple[float, int, Path]] = []
+        try:
+            shards = [d for d in os.scandir(self.root) if d.is_dir()]
+        except Exception:
+            return out
+        for d in shards:
+            try:
+                for e in os.scandir(d.path):
+                    if e.is_file() and e.name.endswith(".json"):
+                        st = e.stat()
+                        out.append((st.st_mtime, st.st_size, Path(e.path)))
+            except Exception:
+                continue
+        return out
+
+    def _total_size(self) -> int:
+        return sum(size for _, size, _ in self._entries())
+
+    def _evict(self) -> None:
+        # 删到上限的 90%，避免每次写入都触发
+        entries = sorted(self._entries())
+        total = sum(size for _, size, _ in entries)
+        target = int(self.max_bytes * 0.9)
+        for _, size, path in entries:
+            if total <= target:
+                break
+            try:
+                path.unlink()
+                total -= size
+            except Exception:
+                continue
+        self._approx_size = total
+
+
+_default: LLMResponseCache | None = None
+_default_lock = threading.Lock()
+
+
+def default_cache() -> LLMResponseCache | None:
+    """Shared cache instance, or None when QT_TEST_AI_LLM_CACHE=0."""
+    global _default
+    if not cache_enabled():
+        return None
+    with _default_lock:
+        if _default is None:
+            try:
+                max_mb = float((os.getenv("QT_TEST_AI_LLM_CACHE_MAX_MB") or "200").strip())
+            except Exception:
+                max_mb = 200.0
+            _default = LLMResponseCache(cache_dir("llm"), max_bytes=int(max_mb * 1024 * 1024))
+        return _default
+
+
+def lookup(
+    *,
+    model: str,
+    messages: list[dict[str, Any]],
+    temperature: float,
+    max_tokens: int,
+    endpoint: str = "",
+    use_cache: bool | None = None,
+) -> tuple[str | None, str | None]:
+    """
+    Returns (key, cached_text). key is None when caching is off for this call;
+    cached_text is None on a miss or when reads are bypassed.
+    """
+    if use_cache is False:
+        return None, None
+    cache = default_cache()
+    if cache is None:
+        return None, None
+    key = make_key(model=model, messages=messages, temperature=temperature, max_tokens=max_tokens, endpoint=endpoint)
+    if cache_bypassed():
+        return key, None
+    return key, cache.get(key)
+
+
+def store(key: str | None, text: str, *, info: dict[str, Any] | None = None) -> None:
+    if not key:
+        return
+    cache = default_cache()
+    if cache is not None:
+        cache.put(key, text, info=info)
@@ -0,0 +1,162 @@
+from __future__ import annotations
+
+import os
+import random
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from typing import Any, Callable, Iterable, TypeVar
+from urllib.parse import urlparse
+
+from . import tracing
+
+
+T = TypeVar("T")
+R = TypeVar("R")
+
+
+class RateLimitError(RuntimeError):
+    """Raised on HTTP 429; retry_after comes from the Retry-After header when present."""
+
+    def __init__(self, message: str, retry_after: float | None = None) -> None:
+        super().__init__(message)
+        self.retry_after = retry_after
+
+
+def _env_float(name: str, default: float) -> float:
+    try:
+        return float((os.getenv(name) or "").strip() or default)
+    except Exception:
+        return default
+
+
+def _env_int(name: str, default: int) -> int:
+    try:
+        return int((os.getenv(name) or "").strip() or default)
+    except Exception:
+        return default
+
+
+class TokenBucket:
+    """
+    Classic token bucket: `rate` requests per second, up to `capacity` in a burst.
+
+    penalize() freezes the bucket for everyone after a 429, so concurrent
+    callers back off together instead of hammering the provider.
+    """
+
+    def __init__(self, rate: float, capacity: float) -> None:
+        self.rate = max(rate, 1e-6)
+        self.capacity = max(capacity, 1.0)
+        self._tokens = self.capacity
+        self._last = time.monotonic()
+        self._blocked_until = 0.0
+        self._lock = threading.Lock()
+
+    def acquire(self) -> float:
+        """Block until a token is available. Returns seconds waited."""
+        waited = 0.0
+        while True:
+            with self._lock:
+                now = time.monotonic()
+                self._tokens = min(self.capacity, self._tokens + (now - self._last) * self.rate)
+                self._last = now
+                if now >= self._blocked_until and self._tokens >= 1.0:
+                    self._tokens -= 1.0
+                    return waited
+                if now < self._blocked_until:
+                    delay = self._blocked_until - now
+                else:
+                    delay = (1.0 - self._tokens) / self.rate
+            delay = min(max(delay, 0.01), 5.0)
+            time.sleep(delay)
+            waited += delay
+
+    def penalize(self, seconds: float) -> None:
+        with self._lock:
+            self._blocked_until = max(self._blocked_until, time.monotonic() + max(0.0, seconds))
+            self._tokens = 0.0
+
+
+_buckets: dict[str, TokenBucket] = {}
+_buckets_lock = threading.Lock()
+
+
+def provider_of(url_or_name: str) -> str:
+    """Bucket key: host of the endpoint (api.deepseek.com, api.openai.com, ...), or the name itself."""
+    s = (url_or_name or "").strip()
+    try:
+        host = urlparse(s).netloc
+    except Exception:
+        host = ""
+    return (host or s or "default").lower()
+
+
+def provider_bucket(provider: str) -> TokenBucket:
+    """
+    Shared limiter per provider.
+    QT_TEST_AI_LLM_RPM   requests per minute (default 60)
+    QT_TEST_AI_LLM_BURST bucket size (default 4)
+    """
+    key = provider_of(provider)
+    with _buckets_lock:
+        b = _buckets.get(key)
+        if b is None:
+            rpm = _env_float("QT_TEST_AI_LLM_RPM", 60.0)
+            burst = _env_float("QT_TEST_AI_LLM_BURST", 4.0)
+            b = TokenBucket(rate=rpm / 60.0, capacity=burst)
+            _buckets[key] = b
+        return b
+
+
+def retry_after_from_headers(headers: Any) -> float | None:
+    try:
+        v = (headers or {}).get("Retry-After")
+        return float(v) if v is not None else None
+    except Exception:
+        return None
+
+
+def call_with_backoff(fn: Callable[[], R], *, provider: str, max_attempts: int | None = None) -> R:
+    """
+    Take a token from the provider bucket, call fn, and retry on RateLimitError
+    with Retry-After or exponential backoff plus jitter.
+    """
+    attempts = max_attempts or max(1, _env_int("QT_TEST_AI_LLM_429_RETRIES", 5))
+    bucket = provider_bucket(provider)
+    for attempt in range(attempts):
+        bucket.acquire()
+        try:
+            return fn()
+        except RateLimitError as e:
+            if attempt >= attempts - 1:
+                raise
+            delay = e.retry_after if e.retry_after is not None else min(60.0, 2.0 * (2 ** attempt))
+            delay += random.uniform(0, 0.5)
+            bucket.penalize(delay)
+            if (os.getenv("QT_TEST_AI_LOG_REQUESTS") or "").strip() in {"1", "true", "yes"}:
+                print(f"[LLM] 429 from {provider_of(provider)}; backing off {delay:.1f}s (attempt {attempt + 1}/{attempts})")
+            time.sleep(delay)
+    raise RuntimeError("unreachable")
+
+
+def testgen_concurrency() -> int:
+    """Parallel LLM generation requests (QT_TEST_AI_TESTGEN_CONCURRENCY, default 4)."""
+    return max(1, _env_int("QT_TEST_AI_TESTGEN_CONCURRENCY", 4))
+
+
+def map_concurrent(fn: Callable[[T], R], items: Iterable[T], *, concurrency: int | None = None) -> list[tuple[R | None, Exception | None]]:
+    """Run fn over items on a thread pool; returns (result, error) pairs in input order."""
+    seq = list(items)
+    n = max(1, min(concurrency or testgen_concurrency(), len(seq) or 1))
+
+    def _safe(x: T) -> tuple[R | None, Exception | None]:
+        try:
+            return fn(x), None
+        except Exception as e:
+            return None, e
+
+    if n == 1:
+        return [_safe(x) for x in seq]
+    with ThreadPoolExecutor(max_workers=n, thread_name_prefix="llm-gen") as pool:
+        return list(pool.map(tracing.propagate(_safe), seq))
@@ -0,0 +1,371 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+import time
+from typing import Any, Callable, Iterable, Iterator
+
+
+ProgressFn = Callable[[str], None]
+
+
+class StreamAbortedError(RuntimeError):
+    """
+    A streamed completion was cut off on purpose (or by the provider).
+
+    reason : truncated | repetition | malformed | no_json
+    partial: text received before the abort
+    """
+
+    def __init__(self, reason: str, message: str, partial: str = "") -> None:
+        super().__init__(message)
+        self.reason = reason
+        self.partial = partial
+
+
+def _env_on(name: str) -> bool:
+    return (os.getenv(name) or "").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def _env_off(name: str, default: str) -> bool:
+    return (os.getenv(name) or default).strip().lower() in {"0", "false", "no", "off"}
+
+
+def _env_int(name: str, default: int) -> int:
+    try:
+        return int((os.getenv(name) or "").strip() or default)
+    except Exception:
+        return default
+
+
+def stream_enabled() -> bool:
+    """QT_TEST_AI_LLM_STREAM=1 requests SSE streaming from OpenAI-compatible endpoints."""
+    return _env_on("QT_TEST_AI_LLM_STREAM")
+
+
+def early_stop_enabled() -> bool:
+    """QT_TEST_AI_LLM_STREAM_EARLY_STOP=0 keeps reading after the JSON / test file is complete."""
+    return not _env_off("QT_TEST_AI_LLM_STREAM_EARLY_STOP", "1")
+
+
+# 完整的无参成员/自由函数定义头：void Foo::testBar() {   或类内 void testBar() {
+# JSON 字符串里的代码换行是字面量 \n，函数头前面可能紧跟它
+_FUNC_HEAD_RE = re.compile(r"(?:(?<=\\n)|(?<=\\t)|\b)void\s+(?:\w+::)?(\w+)\s*\(\s*\)\s*(?:const\s*)?\{")
+_FENCE_OPEN_RE = re.compile(r"```[ \t]*(?:cpp|c\+\+|cxx|h|hpp)?[ \t]*\r?\n", re.I)
+_JSON_FENCE_RE = re.compile(r"^\s*(?:```[ \t]*(?:json)?[ \t]*\r?\n)?\s*$", re.I)
+
+
+class StreamMonitor:
+    """
+    Watches a completion while it streams in.
+
+    expect="json": tracks bracket structure outside strings; `complete` turns on
+                   when the top-level value closes, structural errors or a long
+                   answer with no JSON at all abort the stream.
+    expect="code": `complete` turns on when a fenced C++ block that looks like a
+                   whole QtTest file (test slots / QTEST_ macro) closes.
+
+    In both modes it counts complete test functions (brace-balanced bodies),
+    aborts on degenerate repetition and reports throttled progress lines.
+    """
+
+    def __init__(
+        self,
+        *,
+        expect: str | None = None,
+        on_progress: ProgressFn | None = None,
+        label: str = "",
+        progress_interval_s: float = 0.5,
+    ) -> None:
+        self.expect = expect
+        self.on_progress = on_progress
+        self.label = label
+        self.progress_interval_s = progress_interval_s
+        self.max_repeat = max(3, _env_int("QT_TEST_AI_LLM_STREAM_MAX_REPEAT", 20))
+
+        self._text = ""
+        self.chars = 0
+        self.complete = False
+        self.functions = 0
+        self.items = 0
+        self.started_at = time.monotonic()
+        self.first_token_s: float | None = None
+        self._last_progress = 0.0
+        self._last_msg = ""
+
+        # json 状态机
+        self._stack: list[str] = []
+        self._in_str = False
+        self._esc = False
+        self._json_pos = 0
+        self._json_started = False
+        self._json_clean_start = False
+
+        # 函数/代码块扫描位置
+        self._fn_pos = 0
+        self._fence_pos = 0
+        self._fence_open: int | None = None
+
+        # 重复检测
+        self._line_pos = 0
+        self._last_line = ""
+        self._repeat = 0
+
+    # ----------------------------
+    # feeding
+    # ----------------------------
+    def text(self) -> str:
+        return self._text
+
+    def feed(self, delta: str) -> bool:
+        """Add a chunk. Returns True once the answer is complete and the rest can be dropped."""
+        if not delta:
+            return self.complete
+        if self.first_token_s is None:
+            self.first_token_s = time.monotonic() - self.started_at
+        self._text += delta
+        self.chars += len(delta)
+        text = self._text
+
+        self._check_repetition(text)
+        if self.expect == "json":
+            self._scan_json(text)
+        self._scan_functions(text)
+        if self.expect == "code":
+            self._scan_fences(text)
+        self._maybe_progress()
+        return self.complete
+
+    def finish(self, finish_reason: str | None) -> str:
+        """Call after the last chunk; raises StreamAbortedError when the provider cut the answer off."""
+        text = self.text()
+        self._maybe_progress(force=True)
+        if (finish_reason or "").lower() == "length" and not self.complete:
+            raise StreamAbortedError(
+                "truncated",
+                f"LLM 输出在 max_tokens 处被截断（已接收 {self.chars} 字符）",
+                text,
+            )
+        return text
+
+    def stats(self) -> dict[str, Any]:
+        return {
+            "chars": self.chars,
+            "functions": self.functions,
+            "items": self.items,
+            "complete": self.complete,
+            "first_token_s": round(self.first_token_s, 3) if self.first_token_s is not None else None,
+            "elapsed_s": round(time.monotonic() - self.started_at, 3),
+        }
+
+    # ----------------------------
+    # checks
+    # ----------------------------
+    def _abort(self, reason: str, message: str) -> None:
+        self._maybe_progress(force=True)
+        raise StreamAbortedError(reason, message, self.text())
+
+    def _check_repetition(self, text: str) -> None:
+        # 逐行比较：同一非平凡行连续出现过多次视为模型陷入循环
+        while True:
+            nl = text.find("\n", self._line_pos)
+            if nl < 0:
+                break
+            line = text[self._line_pos:nl].strip()
+            self._line_pos = nl + 1
+            if len(line) < 8:
+                continue
+            if line == self._last_line:
+                self._repeat += 1
+                if self._repeat >= self.max_repeat:
+                    self._abort("repetition", f"LLM 输出陷入重复（同一行连续 {self._repeat} 次）：{line[:80]}")
+            else:
+                self._last_line = line
+                self._repeat = 1
+
+    def _scan_json(self, text: str) -> None:
+        if self.complete:
+            return
+        i = self._json_pos
+        n = len(text)
+        if not self._json_started:
+            while i < n and text[i] not in "{[":
+                i += 1
+            if i >= n:
+                self._json_pos = n
+                if n > 4000:
+                    self._abort("no_json", f"已接收 {n} 字符仍未出现 JSON")
+                return
+            # 只有前面是空白或 ```json 时才确信这就是答案本体；否则括号可能只是说明文字
+            self._json_clean_start = bool(_JSON_FENCE_RE.match(text[:i]))
+            self._json_started = True
+
+        stack = self._stack
+        in_str, esc = self._in_str, self._esc
+        while i < n:
+            c = text[i]
+            i += 1
+            if in_str:
+                if esc:
+                    esc = False
+                elif c == "\\":
+                    esc = True
+                elif c == '"':
+                    in_str = False
+                continue
+            if c == '"':
+                in_str = True
+            elif c == "{" or c == "[":
+                stack.append(c)
+            elif c == "}" or c == "]":
+                want = "{" if c == "}" else "["
+                if not stack or stack[-1] != want:
+                    if self._json_clean_start:
+                        self._in_str, self._esc, self._json_pos = in_str, esc, i
+                        self._abort("malformed", f"LLM 输出的 JSON 结构错误（位置 {i - 1} 的 {c!r} 不匹配）")
+                    # 说明文字里的括号：放弃结构跟踪，交给最终解析
+                    self._json_pos = n
+                    self.expect = None
+                    return
+                stack.pop()
+                if stack and stack[-1] == "[":
+                    self.items += 1
+                if not stack:
+                    self.complete = self._json_clean_start
+                    break
+        self._in_str, self._esc, self._json_pos = in_str, esc, i
+
+    def _scan_functions(self, text: str) -> None:
+        while True:
+            m = _FUNC_HEAD_RE.search(text, self._fn_pos)
+            if not m:
+                # 保留可能被截断的函数头
+                self._fn_pos = max(self._fn_pos, len(text) - 200)
+                return
+            depth = 0
+            end = None
+            for j in range(m.end() - 1, len(text)):
+                c = text[j]
+                if c == "{":
+                    depth += 1
+                elif c == "}":
+                    depth -= 1
+                    if depth == 0:
+                        end = j + 1
+                        break
+            if end is None:
+                self._fn_pos = m.start()
+                return
+            self.functions += 1
+            self._fn_pos = end
+
+    def _scan_fences(self, text: str) -> None:
+        if self.complete:
+            return
+        while True:
+            if self._fence_open is None:
+                m = _FENCE_OPEN_RE.search(text, self._fence_pos)
+                if not m:
+                    self._fence_pos = max(self._fence_pos, len(text) - 16)
+                    return
+                self._fence_open = m.end()
+                self._fence_pos = m.end()
+            close = text.find("```", self._fence_pos)
+            if close < 0:
+                self._fence_pos = max(self._fence_open, len(text) - 3)
+                return
+            block = text[self._fence_open:close]
+            self._fence_pos = close + 3
+            self._fence_open = None
+            if ("QTEST_" in block or "slots:" in block or "Q_SLOTS" in block) and block.count("{") == block.count("}"):
+                self.complete = True
+                return
+
+    def _maybe_progress(self, force: bool = False) -> None:
+        if self.on_progress is None:
+            return
+        now = time.monotonic()
+        if not force and now - self._last_progress < self.progress_interval_s:
+            return
+        self._last_progress = now
+        parts = [f"已接收 {self.chars} 字符"]
+        if self.functions:
+            parts.append(f"完整测试函数 {self.functions}")
+        if self.items:
+            parts.append(f"完整条目 {self.items}")
+        if self.complete:
+            parts.append("已完整")
+        prefix = f"[stream] {self.label}: " if self.label else "[stream] "
+        msg = prefix + "，".join(parts)
+        if msg == self._last_msg:
+            return
+        self._last_msg = msg
+        try:
+            self.on_progress(msg)
+        except Exception:
+            pass
+
+
+# ----------------------------
+# SSE / chunk plumbing
+# ----------------------------
+def iter_sse_data(lines: Iterable[Any]) -> Iterator[dict[str, Any]]:
+    """Yield the JSON payload of every `data:` event until `data: [DONE]`."""
+    for raw in lines:
+        if raw is None:
+            continue
+        line = raw.decode("utf-8", errors="replace") if isinstance(raw, bytes) else str(raw)
+        line = line.strip()
+        if not line or line.startswith(":") or not line.startswith("data:"):
+            continue
+        data = line[5:].strip()
+        if data == "[DONE]":
+            return
+        try:
+            obj = json.loads(data)
+        except Exception:
+            continue
+        if isinstance(obj, dict):
+            yield obj
+
+
+def chunk_delta(chunk: Any) -> tuple[str, str | None]:
+    """(content delta, finish_reason) from a dict SSE chunk or an openai-sdk chunk object."""
+    try:
+        if isinstance(chunk, dict):
+            choices = chunk.get("choices") or []
+            if not choices:
+                return "", None
+            ch = choices[0] or {}
+            delta = ch.get("delta") or ch.get("message") or {}
+            return (delta.get("content") or ""), ch.get("finish_reason")
+        choices = getattr(chunk, "choices", None) or []
+        if not choices:
+            return "", None
+        ch = choices[0]
+        delta = getattr(ch, "delta", None)
+        return (getattr(delta, "content", None) or ""), getattr(ch, "finish_reason", None)
+    except Exception:
+        return "", None
+
+
+def consume_stream(chunks: Iterable[Any], monitor: StreamMonitor) -> str:
+    """
+    Feed chunks into the monitor until the provider finishes or the answer is complete.
+
+    Stopping early (and letting the caller close the connection) is what saves
+    the tokens after a finished JSON value or test file.
+    """
+    finish_reason: str | None = None
+    stop_early = early_stop_enabled()
+    for chunk in chunks:
+        delta, fr = chunk_delta(chunk)
+        if fr:
+            finish_reason = fr
+        if monitor.feed(delta) and stop_early:
+            finish_reason = finish_reason or "complete"
+            break
+        if fr:
+            break
+    return monitor.finish(finish_reason)
@@ -11,11 +11,15 @@ import json
 import os
 import re
 import subprocess
+import threading
+import time
 from pathlib import Path
-from typing import Optional
+from typing import Any, Callable, Optional
 from dataclasses import dataclass
 
+from . import coverage_build, http_client, llm_cache, llm_scheduler, per_test_coverage, profiling, project_lib, qtest_results, symbol_index, test_runner, test_selection, tracing
 from .llm import load_llm_config_from_env
+from .llm_stream import StreamAbortedError, StreamMonitor, consume_stream, iter_sse_data, stream_enabled
 
 
 @dataclass
@@ -64,6 +68,22 @@ class LLMTestGenerator:
                     self.llm_config["openai_base_url"] = generic_config.base_url
         except Exception:
             pass
+
+        # 流式生成时的进度回调（默认打印到终端）
+        self.on_progress: Optional[Callable[[str], None]] = print
+
+        # SDK 客户端按 (类型, 参数) 复用，保持 keep-alive 连接池而不是每次调用重新握手
+        self._sdk_clients: dict[tuple, Any] = {}
+        self._sdk_lock = threading.Lock()
+
+    def _sdk_client(self, factory: Callable[..., Any], **kwargs: Any) -> Any:
+        key = (getattr(factory, "__module__", ""), getattr(factory, "__name__", ""), tuple(sorted(kwargs.items())))
+        with self._sdk_lock:
+            client = self._sdk_clients.get(key)
+            if client is None:
+                client = factory(**kwargs)
+                self._sdk_clients[key] = client
+            return client
         
     def load_prompts(self) -> dict:
         """从llm_prompts.json加载提示"""
@@ -105,6 +125,32 @@ class LLMTestGenerator:
                 except Exception:
                     pass
 
+        # 符号索引：只带目标真正依赖的头文件与调用点，代替整目录头文件 + mainwindow.cpp 前 500 行
+        targets = [f for f in source_map.get(task_name, []) if (self.project_root / f).exists()]
+        index = None
+        if targets and symbol_index.index_enabled():
+            try:
+                index = symbol_index.project_index(self.project_root)
+            except Exception as e:
+                print(f"Warning: symbol index unavailable: {e}")
+        if index is not None:
+            exclude = {index.rel(self.project_root / f) for f in targets}
+            budget = symbol_index.token_budget()
+            sel = index.select_context(self.project_root / targets[0], budget_tokens=budget, exclude=exclude)
+            context += "\n\n--- RELEVANT HEADER FILES (dependencies of the target) ---\n"
+            for rel, reason in sel.files:
+                if rel.lower().endswith((".h", ".hpp", ".hxx")):
+                    context += f"\nFile: {rel} ({reason})\n```cpp\n{index.text(rel)}\n```\n"
+            own = [c for f in exclude for c in index.classes_in(f)]
+            usage = index.usage_snippets(own, exclude=exclude, max_chars=max(2000, budget))
+            if usage:
+                context += "\n\nUsage Examples (call sites of " + ", ".join(sorted(set(own))) + "):\n" + usage
+            context += "\n\n=== TARGET CLASS DEFINITION (SOURCE OF TRUTH) ===\n"
+            context += "CRITICAL: You must STRICTLY follow the class definition below. Do NOT use methods that are not declared here.\n"
+            for filename in targets:
+                context += f"\n--- {filename} ---\n{index.text(index.rel(self.project_root / filename))}\n"
+            return context
+
         # 2. Add ALL Header Files (.h) - GLOBAL CONTEXT
         # This helps the LLM understand dependencies (Arrow, DiagramPath, etc.)
         context += "\n\n--- GLOBAL HEADER FILES ---\n"
@@ -170,92 +216,158 @@ class LLMTestGenerator:
                 error_message="未设置API密钥。请设置OPENAI_API_KEY或QT_TEST_AI_LLM_API_KEY。"
             )
 
-        # 尝试使用 openai 库
-        try:
-            import openai
+        system_msg = "你是一个精通Qt和C++的测试工程师。生成的代码应该是有效的Qt Test代码。"
+        chat_messages = [
+            {"role": "system", "content": system_msg},
+            {"role": "user", "content": prompt},
+        ]
+        # 字节相同的提示词（如单文件循环重试、崩溃后重跑）直接命中磁盘缓存
+        cache_key, test_content = llm_cache.lookup(
+            model=model,
+            messages=chat_messages,
+            temperature=0.7,
+            max_tokens=4000,
+            endpoint=base_url or "openai",
+        )
+        if test_content is not None:
+            http_client.record_cache_hit(base_url or "api.openai.com", label=task_name)
+        use_stream = stream_enabled()
+        monitor = StreamMonitor(expect="code", on_progress=self.on_progress, label=task_name, progress_interval_s=2.0)
+        if test_content is None:
+            # 尝试使用 openai 库
+            try:
+                import openai
             
-            # Check if we are using openai >= 1.0.0
-            if hasattr(openai, 'OpenAI'):
-                from openai import OpenAI
-                # Initialize client
-                client_kwargs = {"api_key": api_key}
-                if base_url:
-                    client_kwargs["base_url"] = base_url
+                # Check if we are using openai >= 1.0.0
+                if hasattr(openai, 'OpenAI'):
+                    from openai import OpenAI
+                    # Initialize client
+                    client_kwargs = {"api_key": api_key}
+                    if base_url:
+                        client_kwargs["base_url"] = base_url
                 
-                client = OpenAI(**client_kwargs)
+                    client = self._sdk_client(OpenAI, **client_kwargs)
+                    # openai 库自带 429 重试，这里只做 provider 级限流
+                    llm_scheduler.provider_bucket(base_url or "api.openai.com").acquire()
+                    started = time.perf_counter()
                 
-                response = client.chat.completions.create(
-                    model=model,
-                    messages=[
-                        {"role": "system", "content": "你是一个精通Qt和C++的测试工程师。生成的代码应该是有效的Qt Test代码。"},
-                        {"role": "user", "content": prompt}
-                    ],
-                    temperature=0.7,
-                    max_tokens=4000
-                )
-                test_content = response.choices[0].message.content
-            else:
-                # Old API (< 1.0.0)
-                if base_url:
-                    openai.api_base = base_url
-                openai.api_key = api_key
+                    response = client.chat.completions.create(
+                        model=model,
+                        messages=chat_messages,
+                        temperature=0.7,
+                        max_tokens=4000,
+                        **({"stream": True} if use_stream else {}),
+                    )
+                    if use_stream:
+                        # 测试文件的代码块一闭合就停止读取，余下的说明文字不再消耗 token
+                        try:
+                            test_content = consume_stream(response, monitor)
+                        finally:
+                            try:
+                                response.close()
+                            except Exception:
+                                pass
+                    else:
+                        test_content = response.choices[0].message.content
+                    http_client.record_sdk_call(
+                        base_url or "api.openai.com",
+                        label=task_name,
+                        started=started,
+                        usage=None if use_stream else getattr(response, "usage", None),
+                        stream=use_stream,
+                    )
+                else:
+                    # Old API (< 1.0.0)
+                    if base_url:
+                        openai.api_base = base_url
+                    openai.api_key = api_key
+                    llm_scheduler.provider_bucket(base_url or "api.openai.com").acquire()
                 
-                response = openai.ChatCompletion.create(
-                    model=model,
-                    messages=[
-                        {"role": "system", "content": "你是一个精通Qt和C++的测试工程师。生成的代码应该是有效的Qt Test代码。"},
-                        {"role": "user", "content": prompt}
-                    ],
-                    temperature=0.7,
-                    max_tokens=4000
-                )
-                test_content = response.choices[0].message.content
+                    response = openai.ChatCompletion.create(
+                        model=model,
+                        messages=chat_messages,
+                        temperature=0.7,
+                        max_tokens=4000
+                    )
+                    test_content = response.choices[0].message.content
             
-        except ImportError:
-            # 如果没有安装 openai 库，使用 requests 直接调用
-            if not base_url:
-                base_url = "https://api.openai.com/v1"
+            except ImportError:
+                # 如果没有安装 openai 库，使用 requests 直接调用
+                if not base_url:
+                    base_url = "https://api.openai.com/v1"
             
-            # 确保 base_url 不以 /chat/completions 结尾
-            if base_url.endswith("/chat/completions"):
-                base_url = base_url.replace("/chat/completions", "")
-            if base_url.endswith("/"):
-                base_url = base_url[:-1]
+                # 确保 base_url 不以 /chat/completions 结尾
+                if base_url.endswith("/chat/completions"):
+                    base_url = base_url.replace("/chat/completions", "")
+                if base_url.endswith("/"):
+                    base_url = base_url[:-1]
                 
-            url = f"{base_url}/chat/completions"
+                url = f"{base_url}/chat/completions"
             
-            try:
-                import requests
-                headers = {
-                    "Content-Type": "application/json",
-                    "Authorization": f"Bearer {api_key}"
-                }
-                data = {
-                    "model": model,
-                    "messages": [
-                        {"role": "system", "content": "你是一个精通Qt和C++的测试工程师。生成的代码应该是有效的Qt Test代码。"},
-                        {"role": "user", "content": prompt}
-                    ],
-                    "temperature": 0.7,
-                    "max_tokens": 4000
-                }
+                try:
+                    headers = {
+                        "Content-Type": "application/json",
+                        "Authorization": f"Bearer {api_key}"
+                    }
+                    data = {
+                        "model": model,
+                        "messages": chat_messages,
+                        "temperature": 0.7,
+                        "max_tokens": 4000
+                    }
+                    if use_stream:
+                        data["stream"] = True
                 
-                timeout = int(os.getenv("QT_TEST_AI_LLM_TIMEOUT_S", 300))
-                response = requests.post(url, headers=headers, json=data, timeout=timeout)
-                response.raise_for_status()
-                result_json = response.json()
-                test_content = result_json["choices"][0]["message"]["content"]
+                    timeout = int(os.getenv("QT_TEST_AI_LLM_TIMEOUT_S", 300))
+
+                    def _post():
+                        r = http_client.post(url, headers=headers, json_body=data, timeout=timeout, stream=use_stream, label=task_name)
+                        if r.status_code == 429:
+                            retry_after = llm_scheduler.retry_after_from_headers(r.headers)
+                            r.close()
+                            raise llm_scheduler.RateLimitError(f"HTTP 429 from {url}", retry_after=retry_after)
+                        return r
+
+                    response = llm_scheduler.call_with_backoff(_post, provider=url)
+                    response.raise_for_status()
+                    if use_stream and "text/event-stream" in (response.headers.get("Content-Type") or ""):
+                        try:
+                            response.encoding = "utf-8"
+                            test_content = consume_stream(iter_sse_data(response.iter_lines(decode_unicode=True)), monitor)
+                        finally:
+                            response.close()
+                    else:
+                        result_json = response.json()
+                        http_client.record_usage(response.metric, result_json.get("usage"))
+                        test_content = result_json["choices"][0]["message"]["content"]
                 
+                except StreamAbortedError as e:
+                    return GenerationResult(
+                        success=False,
+                        test_content=e.partial,
+                        error_message=f"流式生成已中止 ({e.reason}): {str(e)}"
+                    )
+                except Exception as e:
+                    return GenerationResult(
+                        success=False,
+                        error_message=f"API调用失败 (requests): {str(e)}"
+                    )
+                
+            except StreamAbortedError as e:
+                return GenerationResult(
+                    success=False,
+                    test_content=e.partial,
+                    error_message=f"流式生成已中止 ({e.reason}): {str(e)}"
+                )
             except Exception as e:
                 return GenerationResult(
                     success=False,
-                    error_message=f"API调用失败 (requests): {str(e)}"
+                    error_message=f"API调用失败 (openai): {str(e)}"
                 )
-                
-        except Exception as e:
-            return GenerationResult(
-                success=False,
-                error_message=f"API调用失败 (openai): {str(e)}"
+            llm_cache.store(
+                cache_key,
+                test_content,
+                info={"model": model, "task": task_name, **({"stream": monitor.stats()} if use_stream else {})},
             )
             
         # 提取C++代码块
@@ -285,17 +397,31 @@ class LLMTestGenerator:
                     error_message="未设置Anthropic API密钥。请设置ANTHROPIC_API_KEY环境变量。"
                 )
             
-            client = anthropic.Anthropic(api_key=self.llm_config["anthropic_api_key"])
-            
-            response = client.messages.create(
-                model=self.llm_config.get("anthropic_model", "claude-3-sonnet-20240229"),
+            claude_model = self.llm_config.get("anthropic_model", "claude-3-sonnet-20240229")
+            chat_messages = [{"role": "user", "content": prompt}]
+            cache_key, test_content = llm_cache.lookup(
+                model=claude_model,
+                messages=chat_messages,
+                temperature=1.0,  # Anthropic API 默认值
                 max_tokens=4000,
-                messages=[
-                    {"role": "user", "content": prompt}
-                ]
+                endpoint="anthropic",
             )
-            
-            test_content = response.content[0].text
+            if test_content is not None:
+                http_client.record_cache_hit("api.anthropic.com", label=task_name)
+            else:
+                client = self._sdk_client(anthropic.Anthropic, api_key=self.llm_config["anthropic_api_key"])
+                llm_scheduler.provider_bucket("api.anthropic.com").acquire()
+                started = time.perf_counter()
+                
+                response = client.messages.create(
+                    model=claude_model,
+                    max_tokens=4000,
+                    messages=chat_messages
+                )
+                
+                test_content = response.content[0].text
+                http_client.record_sdk_call("api.anthropic.com", label=task_name, started=started, usage=getattr(response, "usage", None))
+                llm_cache.store(cache_key, test_content, info={"model": claude_model, "task": task_name})
             
             # 提取C++代码块
             # Try to find code blocks with flexible whitespace
@@ -355,6 +481,11 @@ class LLMTestGenerator:
         source_context = self._get_source_context(task_name)
         if source_context:
             prompt += source_context
+
+        # 注入上次采样剖析的热点：目标文件里的热点函数要求额外生成 QBENCHMARK 性能用例
+        target_file = self._target_file_for_task(task_name)
+        if target_file:
+            prompt += profiling.prompt_context(self.tests_dir, files=[target_file])
             
         # 注入通用指导原则
         prompt += """
@@ -457,6 +588,83 @@ class LLMTestGenerator:
         
         return result
     
+    @staticmethod
+    def _target_file_for_task(task_name: str) -> Optional[str]:
+        """Map a task name to the source file whose coverage it targets."""
+        if "diagram_item" in task_name and "group" not in task_name:
+            return "diagramitem.cpp"
+        if "diagram_path" in task_name:
+            return "diagrampath.cpp"
+        if "diagram_item_group" in task_name:
+            return "diagramitemgroup.cpp"
+        if "delete_command" in task_name:
+            return "deletecommand.cpp"
+        return None
+
+    def generate_tests_batch(
+        self,
+        task_names: list[str],
+        llm_service: str = "auto",
+        concurrency: int | None = None,
+        compile_tests: bool = True,
+    ) -> dict:
+        """
+        并发生成多个任务的测试。
+
+        LLM 请求在线程池中并发发出（每个 provider 共享令牌桶，429 自动退避）；
+        每个测试文件一写出就提交到编译队列。编译共用 tests/generated 目录，
+        因此编译本身串行，但与尚未完成的生成请求重叠执行。
+        """
+        from concurrent.futures import ThreadPoolExecutor, as_completed
+
+        n = max(1, concurrency or llm_scheduler.testgen_concurrency())
+        t_start = time.perf_counter()
+        mark = http_client.metrics.mark()
+        entries: dict[str, dict] = {t: {"task": t} for t in task_names}
+
+        with ThreadPoolExecutor(max_workers=1, thread_name_prefix="qt-test-build") as builder, \
+                ThreadPoolExecutor(max_workers=n, thread_name_prefix="llm-gen") as gen_pool:
+            gen_futs = {gen_pool.submit(tracing.propagate(self.generate_tests), t, llm_service): t for t in task_names}
+            build_futs = {}
+            for fut in as_completed(gen_futs):
+                task = gen_futs[fut]
+                try:
+                    res = fut.result()
+                except Exception as e:
+                    res = GenerationResult(success=False, error_message=str(e))
+                entries[task]["generation"] = {
+                    "success": res.success,
+                    "tests_generated": res.tests_generated,
+                    "file_path": str(res.file_path) if res.file_path else None,
+                    "error": res.error_message,
+                    "finished_at_s": round(time.perf_counter() - t_start, 2),
+                }
+                print(f"{'✅' if res.success else '❌'} 生成完成: {task} ({entries[task]['generation']['finished_at_s']}s)")
+                if compile_tests and res.success and res.file_path:
+                    bf = builder.submit(tracing.propagate(self.compile_and_test), res.file_path, self._target_file_for_task(task))
+                    build_futs[bf] = task
+
+            for bf in as_completed(build_futs):
+                task = build_futs[bf]
+                try:
+                    entries[task]["compilation"] = bf.result()
+                except Exception as e:
+                    entries[task]["compilation"] = {"success": False, "errors": str(e)}
+                entries[task]["compilation"]["finished_at_s"] = round(time.perf_counter() - t_start, 2)
+
+        ok = all(
+            (e.get("generation") or {}).get("success")
+            and (not compile_tests or (e.get("compilation") or {}).get("success"))
+            for e in entries.values()
+        )
+        return {
+            "status": "success" if ok and entries else "failed",
+            "concurrency": n,
+            "wall_s": round(time.perf_counter() - t_start, 2),
+            "tasks": [entries[t] for t in task_names],
+            "llm_metrics": http_client.metrics.summary(since=mark),
+        }
+
     def _postprocess_test_code(self, content: str, file_path: str) -> str:
         """Fix common LLM-generated test code errors."""
         # Remove garbage characters from the beginning of the file (e.g. Chinese characters, stray backticks)
@@ -470,7 +678,8 @@ class LLMTestGenerator:
         content = re.sub(r'^\s*```\s*$', '', content, flags=re.MULTILINE)
         
         # Remove existing QTEST_MAIN and moc include to avoid duplicates/errors
-        content = re.sub(r'QTEST_MAIN\s*\(.*?\)', '', content)
+        content = re.sub(r'(?:QTEST_MAIN|QT_TEST_AI_TEST_MAIN)\s*\(.*?\)', '', content)
+        content = re.sub(r'#include\s+"qt_test_ai_pertest\.h"\s*\n?', '', content)
         content = re.sub(r'#include\s+["<].*\.moc[">]', '', content)
         
         lines = content.split('\n')
@@ -916,8 +1125,13 @@ class LLMTestGenerator:
         if match:
             class_name = match.group(1)
         
+        # 逐测试覆盖率模式：用 harness 的 main，每个测试函数结束后导出一次 gcov 计数
+        per_test = per_test_coverage.enabled()
+        harness_include = f'#include "{per_test_coverage.HARNESS_HEADER}"\n' if per_test else ""
+        main_macro = "QT_TEST_AI_TEST_MAIN" if per_test else "QTEST_MAIN"
+
         return f"""#include <QtTest>
-#include <QObject>
+{harness_include}#include <QObject>
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QGraphicsItem>
@@ -927,7 +1141,7 @@ class LLMTestGenerator:
 
 {test_code}
 
-QTEST_MAIN({class_name})
+{main_macro}({class_name})
 #include "{moc_file}"
 """
     
@@ -949,117 +1163,43 @@ QTEST_MAIN({class_name})
         }
         
         try:
-            # 运行gcovr获取文本摘要
+            # 一次 gcovr 运行（gcov 按 QT_TEST_AI_GCOV_JOBS 并行）同时产出 JSON 模型和 HTML 报告，
+            # 文本摘要与目标文件覆盖率都从 JSON 模型派生，不再解析 --print-summary 文本
             # 注意: 我们在tests/generated目录下，源码在project_root (../..)
             # 添加 --gcov-ignore-errors=no_working_dir_found 以解决路径问题
-            # 同时生成 HTML 报告 和 JSON 报告
-            cmd = "gcovr -r ../.. --gcov-ignore-errors=no_working_dir_found --html-details -o coverage.html --print-summary --json coverage.json"
-            
-            result = subprocess.run(
-                cmd,
-                cwd=str(self.tests_dir),
-                shell=True,
-                capture_output=True,
-                text=True,
-                timeout=120,
-                errors="replace"
+            from .coverage_model import collect
+
+            model, meta = collect(
+                (self.tests_dir / ".." / "..").resolve(),
+                cwd=self.tests_dir,
+                json_path=self.tests_dir / "coverage.json",
+                html_path=self.tests_dir / "coverage.html",
+                extra_args=["--gcov-ignore-errors=no_working_dir_found"],
+                timeout_s=120,
             )
-            
-            if result.returncode == 0:
-                output = result.stdout
-                stats["summary"] = output
-                
+
+            if model is not None and meta.get("returncode") == 0:
+                stats["summary"] = model.summary_text()
+                stats["line_coverage"] = model.percent("lines")
+                stats["function_coverage"] = model.percent("functions")
+                stats["branch_coverage"] = model.percent("branches")
+
                 # 打印 HTML 报告位置
                 html_path = self.tests_dir / "coverage.html"
-                print(f"\n📊 覆盖率报告已生成: {html_path}")
-                
-                # 尝试从 JSON 中提取特定文件的覆盖率
-                json_path = self.tests_dir / "coverage.json"
-                if json_path.exists() and target_file_hint:
-                    try:
-                        import json
-                        data = json.loads(json_path.read_text(encoding="utf-8"))
-                        
-                        files = []
-                        if isinstance(data, dict):
-                            files = data.get("files", [])
-                        elif isinstance(data, list):
-                            # Handle list format (e.g. gcovr 4.x or multiple reports)
-                            if len(data) > 0 and isinstance(data[0], dict):
-                                if "files" in data[0]:
-                                    # List of reports
-                                    for report in data:
-                                        files.extend(report.get("files", []))
-                                else:
-                                    # List of file objects
-                                    files = data
-                        
-                        # 尝试匹配目标文件
-                        # 1. 精确匹配
-                        # 2. 模糊匹配 (移除下划线等)
-                        target_clean = target_file_hint.lower().replace("_", "")
-                        
-                        found_file = None
-                        for f in files:
-                            fname = f.get("file") or f.get("filename")
-                            if not fname: continue
-                            
-                            fname_base = Path(fname).name.lower()
-                            fname_clean = fname_base.replace("_", "")
-                            
-                            if fname_base == target_file_hint.lower():
-                                found_file = f
-                                break
-                            if fname_clean == target_clean:
-                                found_file = f
-                                break
-                                
-                        if found_file:
-                            # Handle different JSON formats for lines
-                            lines_data = found_file.get("lines", [])
-                            pct = 0.0
-                            covered = 0
-                            total = 0
-                            
-                            if isinstance(lines_data, list):
-                                # List of line objects
-                                total = len(lines_data)
-                                covered = sum(1 for l in lines_data if l.get("count", 0) > 0 or l.get("gcovr/noncode", False) is False)
-                                if total > 0:
-                                    pct = (covered / total) * 100.0
-                            elif isinstance(lines_data, dict):
-                                # Summary object
-                                pct = lines_data.get("percent", 0.0)
-                                covered = lines_data.get("covered", 0)
-                                total = lines_data.get("total", 0)
-                            
-                            stats["line_coverage"] = pct
-                            stats["summary"] = f"File: {found_file.get('file')}\nLines: {pct:.1f}% ({covered}/{total})"
-                            print(f"🎯 目标文件覆盖率 ({found_file.get('file')}): {pct:.1f}%")
-                            return stats
-                            
-                    except Exception as e:
-                        print(f"⚠️ 解析 JSON 覆盖率失败: {e}")
-
-                # 如果没有找到特定文件，回退到全局解析
-                # 解析行覆盖率
-                # lines: 61.9% (333 out of 538)
-                line_match = re.search(r"lines:\s+(\d+\.?\d*)%", output)
-                if line_match:
-                    stats["line_coverage"] = float(line_match.group(1))
-                
-                # 解析函数覆盖率
-                # functions: 66.7% (18 out of 27)
-                func_match = re.search(r"functions:\s+(\d+\.?\d*)%", output)
-                if func_match:
-                    stats["function_coverage"] = float(func_match.group(1))
-                
-                # 解析分支覆盖率
-                # branches: 29.3% (209 out of 713)
-                branch_match = re.search(r"branches:\s+(\d+\.?\d*)%", output)
-                if branch_match:
-                    stats["branch_coverage"] = float(branch_match.group(1))
-                    
+                print(f"\n📊 覆盖率报告已生成: {html_path}（gcov 并行 {meta.get('jobs')}，{meta.get('duration_s')}s）")
+
+                # 尝试匹配目标文件（精确匹配，或移除下划线后的模糊匹配）
+                if target_file_hint:
+                    found = model.file_stats(target_file_hint)
+                    if found is not None:
+                        pct = found.lines.percent
+                        stats["line_coverage"] = pct
+                        stats["function_coverage"] = found.functions.percent
+                        stats["branch_coverage"] = found.branches.percent
+                        stats["summary"] = f"File: {found.file}\nLines: {pct:.1f}% ({found.lines.covered}/{found.lines.total})"
+                        print(f"🎯 目标文件覆盖率 ({found.file}): {pct:.1f}%")
+                        return stats
+
         except Exception as e:
             print(f"⚠️ 获取覆盖率失败: {e}")
             
@@ -1153,19 +1293,10 @@ QTEST_MAIN({class_name})
         pro_file = self.tests_dir / "tests.pro"
         
         # Always start with a fresh template to ensure consistency
-        content = """QT += testlib widgets svg
-CONFIG += console
-CONFIG -= app_bundle
-CONFIG += debug
-
-# Add coverage flags
-QMAKE_CXXFLAGS += --coverage
-QMAKE_LFLAGS += --coverage
-
-# Include project headers
-INCLUDEPATH += ../..
-
-# Sources from the project
+        if project_lib.enabled():
+            project_block = project_lib.link_block(self.tests_dir, self.tests_dir)
+        else:
+            project_block = """# Sources from the project
 SOURCES += ../../diagramitem.cpp \\
            ../../diagrampath.cpp \\
            ../../diagramitemgroup.cpp \\
@@ -1186,12 +1317,89 @@ HEADERS += ../../diagramitem.h \\
            ../../diagramscene.h \\
            ../../mainwindow.h \\
            ../../findreplacedialog.h
+"""
+        content = """QT += testlib widgets svg
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += debug
 
+# Add coverage flags
+QMAKE_CXXFLAGS += --coverage
+QMAKE_LFLAGS += --coverage
+
+# Include project headers
+INCLUDEPATH += ../..
+
+{}
 # Test sources
 SOURCES += {}
-""".format(test_file_name)
+""".format(project_block, test_file_name)
+
+        # 内容不变时不重写，增量构建才能跳过 qmake
+        coverage_build.write_if_changed(pro_file, content)
+
+    @staticmethod
+    def _parse_qtest_totals(stdout: str) -> tuple[int | None, int | None]:
+        """
+        Passed / failed counts from QtTest output ("Totals: 27 passed, 0 failed").
+        Sums every Totals line: the per-test coverage harness runs one qExec pass per test function.
+        """
+        totals = re.findall(r"Totals:\s*(\d+)\s*passed,\s*(\d+)\s*failed", stdout)
+        if totals:
+            return sum(int(p) for p, _ in totals), sum(int(f) for _, f in totals)
+        passed_matches = re.findall(r"Totals:\s*(\d+)\s*passed", stdout) or re.findall(r"Passed\s*:\s*(\d+)", stdout)
+        failed_matches = re.findall(r",\s*(\d+)\s*failed", stdout) or re.findall(r"Failed\s*:\s*(\d+)", stdout)
+        return (
+            int(passed_matches[0]) if passed_matches else None,
+            int(failed_matches[0]) if failed_matches else None,
+        )
 
-        pro_file.write_text(content, encoding="utf-8")
+    def _collect_per_test_coverage(self, result: dict, *, merge: bool = False):
+        """Build the per-test -> (file, line) map from the dumps the harness wrote."""
+        ptc, meta = per_test_coverage.collect_map(self.project_root, self.tests_dir, merge=merge)
+        result["per_test_coverage"] = {k: v for k, v in meta.items() if k != "buckets"}
+        if ptc is not None:
+            top = ", ".join(f"{r['test']}(+{r['unique']})" for r in ptc.summary(top=5)["top"])
+            print(f"🧩 逐测试覆盖率: {len(ptc.test_names())} 个测试，独有行贡献最多: {top}")
+        elif meta.get("error"):
+            print(f"⚠️ 逐测试覆盖率: {meta['error']}")
+        return ptc
+
+    def _apply_selection_results(self, result: dict, selection, output: str, statuses: dict | None = None) -> None:
+        """Fold the statuses of tests skipped by change-based selection back into the totals."""
+        merged = test_selection.merge_results(self.tests_dir, output, selection, statuses=statuses)
+        result["test_selection"] = merged
+        if selection is None or selection.full:
+            return
+        result["passed"] = merged["passed"]
+        result["failed"] = merged["failed"]
+        if merged["failed_cached"]:
+            result["success"] = False
+            result["errors"] = (result.get("errors") or "") + f"\n沿用缓存结果的失败测试: {', '.join(merged['failed_cached'])}"
+        print(f"🎯 增量测试: 运行 {merged['ran']} 个，沿用缓存 {merged['cached']} 个")
+
+    def _apply_test_results(self, result: dict, res) -> None:
+        """Take totals and failure locations from the QtTest XML log instead of scraping stdout."""
+        result["test_results"] = res.to_meta()
+        t = res.totals()
+        result["passed"] = t["passed"]
+        result["failed"] = t["failed"] + t["crashed"]
+        report = res.failure_report()
+        if report:
+            result["errors"] = ((result.get("errors") or "").rstrip() + "\n失败位置:\n" + report).lstrip()
+        if res.errors:
+            print(f"⚠️ QtTest 结果日志不完整: {'; '.join(res.errors)}")
+
+    def _map_coverage_stats(self, stats: dict, ptc, target_file_hint: str | None) -> dict:
+        """After a partial run the gcda only hold the selected tests; take the target file's coverage from the merged map."""
+        if ptc is None or not target_file_hint:
+            return stats
+        fc = ptc.file_coverage(target_file_hint)
+        if fc and fc[1]:
+            pct = round(100.0 * fc[0] / fc[1], 1)
+            stats["line_coverage"] = pct
+            stats["summary"] = f"File: {target_file_hint}\nLines: {pct:.1f}% ({fc[0]}/{fc[1]}) [merged per-test map]"
+        return stats
 
     def compile_and_test(self, test_file_path: Path = None, target_file_hint: str = None) -> dict:
         """编译并运行生成的测试"""
@@ -1213,37 +1421,62 @@ SOURCES += {}
             # Update tests.pro if a specific test file is provided
             if test_file_path:
                 self._update_project_file(test_file_path.name)
+
+            # 被测项目编成一次性的覆盖率静态库，测试目标只编译测试文件再链接它
+            if project_lib.enabled():
+                lib_ok, lib_meta = project_lib.ensure_built(self.project_root, self.tests_dir)
+                result["project_lib"] = {k: lib_meta.get(k) for k in ("build_dir", "qmake_skipped", "duration_s")}
+                if not lib_ok:
+                    step = lib_meta.get("make") or lib_meta.get("qmake") or {}
+                    result["errors"] = f"项目静态库编译失败: {step.get('stderr') or step.get('stdout') or ''}"
+                    return result
+
+            # 逐测试覆盖率：确保测试文件使用 harness 的 main，并给测试进程设置导出目录
+            run_env = None
+            per_test = per_test_coverage.enabled()
+            if per_test:
+                per_test_coverage.write_harness(self.tests_dir)
+                if test_file_path:
+                    per_test_coverage.instrument_file(test_file_path)
+                run_env = {**os.environ, **per_test_coverage.prepare_run(self.tests_dir)}
+            else:
+                # 旧的逐测试导出不能混进这次的整体覆盖率
+                per_test_coverage.discard_dumps(self.tests_dir)
+
+            # 基于变更的测试选择：只跑覆盖记录与改动相交的测试函数，其余沿用缓存结果
+            selection = test_selection.plan_run(self.project_root, self.tests_dir)
+            partial = selection is not None and not selection.full
+            run_args = selection.run_args() if selection is not None else []
+            if selection is not None:
+                print(f"🎯 测试选择: {selection.describe()}")
             
             # Check for custom test command (e.g. from .env)
             custom_cmd = os.getenv("QT_TEST_AI_TEST_CMD")
             if custom_cmd:
+                if run_args:
+                    custom_cmd = f"{custom_cmd} {' '.join(run_args)}"
                 print(f"Running custom test command: {custom_cmd}")
-                cmd_result = subprocess.run(
+                cmd_result = tracing.run(
                     custom_cmd,
+                    trace_cat=tracing.TEST,
                     shell=True,
                     capture_output=True,
                     text=True,
                     timeout=600,
-                    errors="replace"
+                    errors="replace",
+                    env=run_env,
                 )
                 
                 result["output"] = cmd_result.stdout
                 result["errors"] = cmd_result.stderr
                 
                 # Parse results (QtTest format: "Totals: 27 passed, 0 failed")
-                passed_matches = re.findall(r"Totals:\s*(\d+)\s*passed", cmd_result.stdout)
-                failed_matches = re.findall(r",\s*(\d+)\s*failed", cmd_result.stdout)
-                
-                if not passed_matches:
-                    # Fallback to other formats
-                    passed_matches = re.findall(r"Passed\s*:\s*(\d+)", cmd_result.stdout)
-                if not failed_matches:
-                    failed_matches = re.findall(r"Failed\s*:\s*(\d+)", cmd_result.stdout)
-                
-                if passed_matches:
-                    result["passed"] = int(passed_matches[0])
-                if failed_matches:
-                    result["failed"] = int(failed_matches[0])
+                passed, failed = self._parse_qtest_totals(cmd_result.stdout)
+                passed_matches = passed is not None
+                if passed is not None:
+                    result["passed"] = passed
+                if failed is not None:
+                    result["failed"] = failed
                 
                 result["success"] = (cmd_result.returncode == 0)
 
@@ -1252,6 +1485,12 @@ SOURCES += {}
                     stdout_tail = "\n".join(result["output"].splitlines()[-20:])
                     result["errors"] = f"Test crashed or failed without stderr output.\nLast 20 lines of output:\n{stdout_tail}"
                 
+                if selection is not None:
+                    self._apply_selection_results(result, selection, cmd_result.stdout)
+
+                # 先建逐测试映射（会把 .gcno 拷到各测试的 gcda 目录），整体覆盖率随后由 gcovr 合并各目录得到
+                if per_test:
+                    self._collect_per_test_coverage(result, merge=partial)
                 if result["success"]:
                      coverage_stats = self._get_coverage_stats()
                      result["coverage"] = coverage_stats
@@ -1260,8 +1499,13 @@ SOURCES += {}
 
             # Force clean build by removing object files and coverage data
             # This is critical to avoid "stamp mismatch" errors with gcov
+            # 增量构建（默认）只删 .gcda：重编的目标文件会带新的 .gcno，未改动的 .o/.gcno 仍然匹配
+            incremental = coverage_build.enabled()
+            tests_pro = self.tests_dir / "tests.pro"
             debug_dir = self.tests_dir / "debug"
-            if debug_dir.exists():
+            if incremental:
+                coverage_build.clear_gcda(self.tests_dir)
+            elif debug_dir.exists():
                 for file in debug_dir.glob("*.o"):
                     try: file.unlink()
                     except: pass
@@ -1276,28 +1520,31 @@ SOURCES += {}
             for file in self.tests_dir.glob("*.gcda"):
                 try: file.unlink()
                 except: pass
-            for file in self.tests_dir.glob("*.gcno"):
+            for file in [] if incremental else self.tests_dir.glob("*.gcno"):
                 try: file.unlink()
                 except: pass
 
-            # 运行qmake
-            qmake_result = subprocess.run(
-                "qmake tests.pro",
-                cwd=str(self.tests_dir),
-                shell=True,
-                capture_output=True,
-                text=True,
-                timeout=300,
-                errors="replace"
-            )
-            
-            if qmake_result.returncode != 0:
-                result["errors"] = f"qmake失败: {qmake_result.stderr}"
-                return result
+            # 运行qmake（tests.pro 与上次配置时一致且 Makefile 还在则跳过）
+            if not incremental or coverage_build.needs_qmake(tests_pro, self.tests_dir, []):
+                qmake_result = tracing.run(
+                    "qmake tests.pro",
+                    cwd=str(self.tests_dir),
+                    shell=True,
+                    capture_output=True,
+                    text=True,
+                    timeout=300,
+                    errors="replace"
+                )
+                
+                if qmake_result.returncode != 0:
+                    result["errors"] = f"qmake失败: {qmake_result.stderr}"
+                    return result
+                if incremental:
+                    coverage_build.mark_configured(tests_pro, self.tests_dir, [])
             
-            # 运行mingw32-make
-            make_result = subprocess.run(
-                "mingw32-make",
+            # 运行mingw32-make（-j<核数>，QT_TEST_AI_BUILD_JOBS 可调）
+            make_result = tracing.run(
+                coverage_build.make_command(),
                 cwd=str(self.tests_dir),
                 shell=True,
                 capture_output=True,
@@ -1317,37 +1564,73 @@ SOURCES += {}
             
             if exe_files:
                 exe_path = exe_files[0]
-                test_result = subprocess.run(
-                    str(exe_path),
-                    cwd=str(self.tests_dir),
-                    capture_output=True,
-                    text=True,
-                    timeout=300,
-                    errors="replace"
-                )
+                if selection is not None and selection.empty:
+                    # 没有受影响的测试：不运行，整体结果来自缓存
+                    self._apply_selection_results(result, selection, "")
+                    result["success"] = not result["test_selection"]["failed_cached"]
+                    ptc = per_test_coverage.load_map(self.tests_dir)
+                    result["coverage"] = self._map_coverage_stats(
+                        {"line_coverage": 0.0, "function_coverage": 0.0, "branch_coverage": 0.0, "summary": ""},
+                        ptc,
+                        target_file_hint,
+                    )
+                    return result
+
+                # XML 日志写到文件、文本照常到 stdout；逐测试模式下 harness 会给文件名加上函数名
+                xml_results = qtest_results.enabled()
+                qtest_results.clear(self.tests_dir)
+                if test_runner.shard_count() > 1:
+                    # 测试函数按历史耗时分到多个 offscreen 进程并行跑，结果合并成一次运行
+                    sharded = test_runner.run_sharded(
+                        exe_path,
+                        cwd=self.tests_dir,
+                        functions=run_args or None,
+                        env=run_env,
+                        timeout_s=300,
+                        results_dir=self.tests_dir if xml_results else None,
+                    )
+                    result["shards"] = sharded["shards"]
+                    test_result = subprocess.CompletedProcess(
+                        [str(exe_path), *run_args], sharded["returncode"], sharded["stdout"], sharded["stderr"]
+                    )
+                else:
+                    out_args = qtest_results.output_args(self.tests_dir) if xml_results else []
+                    test_result = tracing.run(
+                        [str(exe_path), *out_args, *run_args],
+                        trace_cat=tracing.TEST,
+                        cwd=str(self.tests_dir),
+                        capture_output=True,
+                        text=True,
+                        timeout=300,
+                        errors="replace",
+                        env=run_env,
+                    )
                 
                 result["output"] = test_result.stdout
                 result["errors"] = test_result.stderr
                 
                 # 简单的测试结果解析 (QtTest format: "Totals: 27 passed, 0 failed")
-                passed_matches = re.findall(r"Totals:\s*(\d+)\s*passed", test_result.stdout)
-                failed_matches = re.findall(r",\s*(\d+)\s*failed", test_result.stdout)
-                
-                if not passed_matches:
-                    passed_matches = re.findall(r"Passed\s*:\s*(\d+)", test_result.stdout)
-                if not failed_matches:
-                    failed_matches = re.findall(r"Failed\s*:\s*(\d+)", test_result.stdout)
-                
-                if passed_matches:
-                    result["passed"] = int(passed_matches[0])
-                if failed_matches:
-                    result["failed"] = int(failed_matches[0])
+                passed, failed = self._parse_qtest_totals(test_result.stdout)
+                if passed is not None:
+                    result["passed"] = passed
+                if failed is not None:
+                    result["failed"] = failed
                 
                 result["success"] = test_result.returncode == 0
+                res = qtest_results.collect(self.tests_dir) if xml_results else None
+                if res is not None:
+                    self._apply_test_results(result, res)
+                    if test_runner.shard_count() <= 1:
+                        test_runner.record_durations(self.tests_dir, res.durations_s())
+                if selection is not None:
+                    self._apply_selection_results(result, selection, test_result.stdout, res.statuses() if res else None)
                 
-                # 获取覆盖率
+                # 获取覆盖率（逐测试模式下先建映射，见上）
+                ptc = self._collect_per_test_coverage(result, merge=partial) if per_test else None
                 if result["success"]:
                     coverage_stats = self._get_coverage_stats(target_file_hint)
+                    if partial:
+                        coverage_stats = self._map_coverage_stats(coverage_stats, ptc, target_file_hint)
                     result["coverage"] = coverage_stats
             else:
                 result["errors"] = "找不到生成的测试可执行文件"
@@ -1369,8 +1652,14 @@ SOURCES += {}
             max_retries: 最大重试次数
             
         Returns:
-            包含完整结果的字典
+            包含完整结果的字典（llm_metrics 为本周期内的 LLM 请求延迟 / token 统计）
         """
+        mark = http_client.metrics.mark()
+        full_result = self._run_full_cycle(task_name, llm_service, max_retries)
+        full_result["llm_metrics"] = http_client.metrics.summary(since=mark)
+        return full_result
+
+    def _run_full_cycle(self, task_name: str, llm_service: str, max_retries: int) -> dict:
         full_result = {
             "task": task_name,
             "llm_service": llm_service,
@@ -1403,15 +1692,7 @@ SOURCES += {}
             print(f"\n🔄 尝试 {attempt}/{max_retries + 1}...")
             
             # Determine target file for coverage based on task name
-            target_file = None
-            if "diagram_item" in task_name and "group" not in task_name:
-                target_file = "diagramitem.cpp"
-            elif "diagram_path" in task_name:
-                target_file = "diagrampath.cpp"
-            elif "diagram_item_group" in task_name:
-                target_file = "diagramitemgroup.cpp"
-            elif "delete_command" in task_name:
-                target_file = "deletecommand.cpp"
+            target_file = self._target_file_for_task(task_name)
             
             # 编译并运行
             print("🔨 编译测试...")
@@ -0,0 +1,507 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import re
+import shutil
+import subprocess
+from datetime import datetime
+from pathlib import Path
+from typing import Any
+
+from .coverage_model import collect
+
+
+HARNESS_HEADER = "qt_test_ai_pertest.h"
+MAP_FILE = "coverage_per_test.json"
+DUMP_DIR = "pertest_gcda"
+# 不属于某个测试函数的计数：静态初始化 / 退出阶段
+SETUP_BUCKET = "__setup__"
+TEARDOWN_BUCKET = "__teardown__"
+
+
+def enabled() -> bool:
+    """QT_TEST_AI_PER_TEST_COVERAGE=1 dumps gcov counters after every QtTest function."""
+    return (os.getenv("QT_TEST_AI_PER_TEST_COVERAGE") or "").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+# ----------------------------
+# harness
+# ----------------------------
+_HARNESS = r"""// Generated by Smart Testing Tools (per-test coverage harness). Do not edit.
+//
+// QT_TEST_AI_TEST_MAIN(TestObject) replaces QTEST_MAIN(TestObject).
+// Without QT_TEST_AI_PER_TEST_DIR in the environment it behaves like QTEST_MAIN.
+// With it, every test function runs in its own QTest::qExec() pass; after each
+// pass the gcov counters are dumped under $QT_TEST_AI_PER_TEST_DIR/<function>
+// (via GCOV_PREFIX) and reset, so each directory holds exactly what that test
+// executed (including its init()/cleanup() and initTestCase()/cleanupTestCase()).
+#pragma once
+
+#include <QtTest>
+#include <QApplication>
+#include <QByteArray>
+#include <QHash>
+#include <QMetaMethod>
+#include <QStringList>
+
+#if defined(__GNUC__) && !defined(QT_TEST_AI_NO_GCOV_HOOKS)
+extern "C" void __gcov_dump(void);
+extern "C" void __gcov_reset(void);
+#define QT_TEST_AI_GCOV_FLUSH() (__gcov_dump(), __gcov_reset())
+#else
+#define QT_TEST_AI_GCOV_FLUSH() ((void)0)
+#endif
+
+namespace qt_test_ai {
+
+inline bool isTestFunction(const QMetaMethod &m)
+{
+    if (m.methodType() != QMetaMethod::Slot || m.access() != QMetaMethod::Private || m.parameterCount() != 0)
+        return false;
+    const QByteArray n = m.name();
+    return n != "initTestCase" && n != "cleanupTestCase" && n != "init" && n != "cleanup"
+        && !n.endsWith("_data");
+}
+
+inline void flushTo(const QByteArray &root, const QByteArray &bucket)
+{
+    qputenv("GCOV_PREFIX", root + "/" + bucket);
+    QT_TEST_AI_GCOV_FLUSH();
+}
+
+// 每一轮 qExec 都会重写 -o 指定的日志文件：文件名后缀上函数名，各轮结果互不覆盖
+inline QString perFunctionOutput(const QString &spec, const QByteArray &fn)
+{
+    const int comma = spec.lastIndexOf(QLatin1Char(','));
+    QString file = comma >= 0 ? spec.left(comma) : spec;
+    const QString format = comma >= 0 ? spec.mid(comma) : QString();
+    if (file == QLatin1String("-"))
+        return spec;
+    const int dot = file.lastIndexOf(QLatin1Char('.'));
+    const int slash = qMax(file.lastIndexOf(QLatin1Char('/')), file.lastIndexOf(QLatin1Char('\\')));
+    const QString suffix = QLatin1Char('-') + QString::fromLatin1(fn);
+    if (dot > slash)
+        file.insert(dot, suffix);
+    else
+        file.append(suffix);
+    return file + format;
+}
+
+inline int runPerTest(QObject *tc, int argc, char **argv)
+{
+    const QByteArray root = qgetenv("QT_TEST_AI_PER_TEST_DIR");
+    if (root.isEmpty())
+        return QTest::qExec(tc, argc, argv);
+
+    // 命令行：输出选项（-o、-silent 等）原样转发给每一轮；
+    // 非选项参数是要运行的测试函数（testFoo 或 testFoo:tag），为空时运行全部
+    static const char *const valueOptions[] = {"-o", "-maxwarnings", "-eventdelay", "-keydelay", "-mousedelay", "-seed", "-repeat", "-platform"};
+    QStringList options;
+    QHash<QByteArray, QString> selected;
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray a(argv[i]);
+        if (!a.startsWith('-')) {
+            QByteArray name = a.left(a.indexOf(':') > 0 ? a.indexOf(':') : a.size());
+            if (name.endsWith("()"))
+                name.chop(2);
+            selected.insert(name, QString::fromLocal8Bit(a));
+            continue;
+        }
+        options << QString::fromLocal8Bit(a);
+        for (const char *v : valueOptions) {
+            if (a == v && i + 1 < argc) {
+                options << QString::fromLocal8Bit(argv[++i]);
+                break;
+            }
+        }
+    }
+
+    flushTo(root, "__setup__");
+    int failed = 0;
+    const QMetaObject *mo = tc->metaObject();
+    for (int i = mo->methodOffset(); i < mo->methodCount(); ++i) {
+        const QMetaMethod m = mo->method(i);
+        if (!isTestFunction(m))
+            continue;
+        if (!selected.isEmpty() && !selected.contains(m.name()))
+            continue;
+        QStringList args;
+        args << QString::fromLocal8Bit(argv[0]);
+        for (int k = 0; k < options.size(); ++k) {
+            args << options[k];
+            if (options[k] == QLatin1String("-o") && k + 1 < options.size())
+                args << perFunctionOutput(options[++k], m.name());
+        }
+        args << selected.value(m.name(), QString::fromLatin1(m.name()));
+        failed += QTest::qExec(tc, args);
+        flushTo(root, m.name());
+    }
+    // 进程退出时 libgcov 还会再写一次，归到 teardown
+    qputenv("GCOV_PREFIX", root + "/__teardown__");
+    return failed;
+}
+
+} // namespace qt_test_ai
+
+// 聚合运行器（qt_test_ai_runner.h）已把它定义成注册宏时不覆盖
+#ifndef QT_TEST_AI_TEST_MAIN
+#define QT_TEST_AI_TEST_MAIN(TestObject) \
+int main(int argc, char *argv[]) \
+{ \
+    QApplication app(argc, argv); \
+    app.setAttribute(Qt::AA_Use96Dpi, true); \
+    TestObject tc; \
+    QTEST_SET_MAIN_SOURCE_PATH \
+    return qt_test_ai::runPerTest(&tc, argc, argv); \
+}
+#endif
+"""
+
+
+def write_harness(tests_dir: Path) -> Path:
+    p = Path(tests_dir) / HARNESS_HEADER
+    try:
+        if p.exists() and p.read_text(encoding="utf-8") == _HARNESS:
+            return p
+    except Exception:
+        pass
+    p.write_text(_HARNESS, encoding="utf-8")
+    return p
+
+
+_QTEST_MAIN_RE = re.compile(r"\bQTEST_MAIN\s*\(\s*(\w+)\s*\)")
+
+
+def instrument_source(code: str) -> str:
+    """Swap QTEST_MAIN(X) for QT_TEST_AI_TEST_MAIN(X) and include the harness header."""
+    if "QT_TEST_AI_TEST_MAIN" in code or not _QTEST_MAIN_RE.search(code):
+        return code
+    code = _QTEST_MAIN_RE.sub(r"QT_TEST_AI_TEST_MAIN(\1)", code, count=1)
+    m = re.search(r"^[ \t]*#include\s*<QtTest>.*$", code, flags=re.M)
+    inc = f'#include "{HARNESS_HEADER}"'
+    if m:
+        return code[: m.end()] + "\n" + inc + code[m.end():]
+    return inc + "\n" + code
+
+
+def instrument_file(test_file: Path) -> bool:
+    """Instrument a generated test file in place and drop the harness header next to it."""
+    try:
+        code = Path(test_file).read_text(encoding="utf-8", errors="replace")
+        new = instrument_source(code)
+        write_harness(Path(test_file).parent)
+        if new != code:
+            Path(test_file).write_text(new, encoding="utf-8")
+        return "QT_TEST_AI_TEST_MAIN" in new
+    except Exception:
+        return False
+
+
+# ----------------------------
+# run side
+# ----------------------------
+def prepare_run(tests_dir: Path) -> dict[str, str]:
+    """Empty the dump directory; returns the env vars the test process needs."""
+    d = Path(tests_dir) / DUMP_DIR
+    discard_dumps(tests_dir)
+    d.mkdir(parents=True, exist_ok=True)
+    return {"QT_TEST_AI_PER_TEST_DIR": str(d.resolve()).replace("\\", "/")}
+
+
+def discard_dumps(tests_dir: Path) -> None:
+    shutil.rmtree(Path(tests_dir) / DUMP_DIR, ignore_errors=True)
+
+
+def _gcno_index(tests_dir: Path) -> dict[str, Path]:
+    out: dict[str, Path] = {}
+    dump = (Path(tests_dir) / DUMP_DIR).resolve()
+    for p in Path(tests_dir).rglob("*.gcno"):
+        try:
+            p.resolve().relative_to(dump)
+            continue
+        except ValueError:
+            pass
+        out.setdefault(p.stem, p)
+    return out
+
+
+# ----------------------------
+# what a map was recorded against
+# ----------------------------
+_TEST_FN_RE = re.compile(r"\bvoid\s+(?:\w+::)?(\w+)\s*\(\s*\)\s*(?:const\s*)?\{")
+
+
+def test_function_hashes(tests_dir: Path) -> dict[str, str]:
+    """
+    Body hash of every `void name()` definition in the generated test sources.
+    Fixtures (init/cleanup/initTestCase/cleanupTestCase) are included under their own names.
+    """
+    out: dict[str, str] = {}
+    for p in sorted(Path(tests_dir).glob("test_*.cpp")):
+        try:
+            text = p.read_text(encoding="utf-8", errors="replace")
+        except Exception:
+            continue
+        for m in _TEST_FN_RE.finditer(text):
+            depth, end = 0, None
+            for j in range(m.end() - 1, len(text)):
+                c = text[j]
+                if c == "{":
+                    depth += 1
+                elif c == "}":
+                    depth -= 1
+                    if depth == 0:
+                        end = j + 1
+                        break
+            if end is None:
+                continue
+            body = re.sub(r"\s+", " ", text[m.end() - 1:end])
+            out[m.group(1)] = hashlib.sha1(body.encode("utf-8")).hexdigest()[:16]
+    return out
+
+
+def git_head(project_root: Path) -> str | None:
+    try:
+        p = subprocess.run(
+            ["git", "rev-parse", "HEAD"],
+            cwd=str(project_root),
+            capture_output=True,
+            text=True,
+            timeout=15,
+        )
+        return (p.stdout.strip() or None) if p.returncode == 0 else None
+    except Exception:
+        return None
+
+
+def git_dirty(project_root: Path) -> list[str] | None:
+    """Tracked files that differ from HEAD (staged or not), relative to project_root; None without git."""
+    try:
+        p = subprocess.run(
+            ["git", "diff", "--name-only", "--relative", "HEAD", "--"],
+            cwd=str(project_root),
+            capture_output=True,
+            text=True,
+            timeout=30,
+        )
+        return [ln.strip() for ln in p.stdout.splitlines() if ln.strip()] if p.returncode == 0 else None
+    except Exception:
+        return None
+
+
+def source_mtimes(project_root: Path, files: list[str]) -> dict[str, int]:
+    out: dict[str, int] = {}
+    for rel in files:
+        try:
+            out[rel] = (Path(project_root) / rel).stat().st_mtime_ns
+        except Exception:
+            pass
+    return out
+
+
+class PerTestCoverage:
+    """
+    test function -> {source file -> covered line numbers}.
+
+    Saved as tests/generated/coverage_per_test.json; answers "which tests touch
+    this file/line" (targeted re-runs) and "which test adds lines nobody else covers".
+    """
+
+    def __init__(self, tests: dict[str, dict[str, list[int]]] | None = None, *, created_at: str | None = None, meta: dict[str, Any] | None = None) -> None:
+        self.tests = tests or {}
+        self.created_at = created_at or datetime.now().isoformat(timespec="seconds")
+        self.meta = meta or {}
+
+    # ----------------------------
+    # persistence
+    # ----------------------------
+    def to_dict(self) -> dict[str, Any]:
+        return {"version": 1, "created_at": self.created_at, "meta": self.meta, "tests": self.tests}
+
+    def save(self, path: Path) -> Path:
+        Path(path).write_text(json.dumps(self.to_dict(), ensure_ascii=False, indent=1), encoding="utf-8")
+        return Path(path)
+
+    @classmethod
+    def load(cls, path: Path) -> "PerTestCoverage | None":
+        try:
+            d = json.loads(Path(path).read_text(encoding="utf-8"))
+            return cls(d.get("tests") or {}, created_at=d.get("created_at"), meta=d.get("meta") or {})
+        except Exception:
+            return None
+
+    # ----------------------------
+    # queries
+    # ----------------------------
+    def test_names(self) -> list[str]:
+        return [t for t in self.tests if t not in (SETUP_BUCKET, TEARDOWN_BUCKET)]
+
+    @staticmethod
+    def _match(name: str, file: str) -> bool:
+        a = name.replace("\\", "/").lower()
+        b = file.replace("\\", "/").lower()
+        return a == b or a.endswith("/" + b) or b.endswith("/" + a)
+
+    def tests_covering(self, file: str, line: int | None = None) -> list[str]:
+        out = []
+        for t in self.test_names():
+            for f, lines in self.tests[t].items():
+                if self._match(f, file) and (line is None or line in lines):
+                    out.append(t)
+                    break
+        return out
+
+    def contribution(self, file: str | None = None) -> list[dict[str, Any]]:
+        """Per test: covered lines and lines covered by no other test (optionally one file). Sorted by unique desc."""
+        per: dict[str, set[tuple[str, int]]] = {}
+        for t in self.test_names():
+            per[t] = {
+                (f, ln)
+                for f, lines in self.tests[t].items()
+                if file is None or self._match(f, file)
+                for ln in lines
+            }
+        count: dict[tuple[str, int], int] = {}
+        for s in per.values():
+            for k in s:
+                count[k] = count.get(k, 0) + 1
+        rows = [
+            {"test": t, "lines": len(s), "unique": sum(1 for k in s if count[k] == 1)}
+            for t, s in per.items()
+        ]
+        rows.sort(key=lambda r: (-r["unique"], -r["lines"], r["test"]))
+        return rows
+
+    def files(self) -> list[str]:
+        return sorted({f for cov in self.tests.values() for f in cov})
+
+    def file_coverage(self, file: str, *, tests: list[str] | None = None) -> tuple[int, int] | None:
+        """
+        (covered, executable) lines of a file over the union of all tests (or just `tests`,
+        plus setup/teardown); needs meta["line_totals"].
+        """
+        totals = self.meta.get("line_totals") or {}
+        total = next((n for f, n in totals.items() if self._match(f, file)), None)
+        if not total:
+            return None
+        keep = None if not tests else set(tests) | {SETUP_BUCKET, TEARDOWN_BUCKET}
+        covered: set[int] = set()
+        for t, cov in self.tests.items():
+            if keep is not None and t not in keep:
+                continue
+            for f, lines in cov.items():
+                if self._match(f, file):
+                    covered.update(lines)
+        return len(covered), int(total)
+
+    def summary(self, top: int = 10) -> dict[str, Any]:
+        rows = self.contribution()
+        return {
+            "tests": len(rows),
+            "redundant": [r["test"] for r in rows if r["lines"] and not r["unique"]],
+            "empty": [r["test"] for r in rows if not r["lines"]],
+            "top": rows[:top],
+        }
+
+
+def collect_map(
+    project_root: Path,
+    tests_dir: Path,
+    *,
+    extra_args: list[str] | None = None,
+    merge: bool = False,
+) -> tuple[PerTestCoverage | None, dict[str, Any]]:
+    """
+    Turn the per-test dump directories into a PerTestCoverage map.
+
+    Each bucket gets the matching .gcno copied next to its .gcda files, then
+    one gcovr pass (parallel gcov) per bucket reads only that bucket.
+    merge=True (after a selective run) keeps the recorded entries of tests that
+    were not re-run, as long as they still exist in the test sources and none
+    of the files they cover changed since they were recorded (their line
+    numbers would no longer match; such tests get re-run next time).
+    """
+    dump = Path(tests_dir) / DUMP_DIR
+    meta: dict[str, Any] = {"dump_dir": str(dump), "buckets": {}}
+    if not dump.exists():
+        meta["error"] = "未找到逐测试的 gcda 目录（测试未用 QT_TEST_AI_TEST_MAIN 构建或未运行）"
+        return None, meta
+
+    gcno = _gcno_index(tests_dir)
+    tests: dict[str, dict[str, list[int]]] = {}
+    line_totals: dict[str, int] = {}
+    for bucket in sorted(p for p in dump.iterdir() if p.is_dir()):
+        gcdas = list(bucket.rglob("*.gcda"))
+        if not gcdas:
+            continue
+        for g in gcdas:
+            src = gcno.get(g.stem)
+            if src is not None and not g.with_suffix(".gcno").exists():
+                try:
+                    shutil.copy2(src, g.with_suffix(".gcno"))
+                except Exception:
+                    pass
+        model, m = collect(
+            Path(project_root),
+            cwd=Path(project_root),
+            extra_args=(extra_args or ["--gcov-ignore-errors=no_working_dir_found", "--exclude", ".*moc_.*", "--exclude", ".*qrc_.*"]),
+            search_paths=[bucket],
+        )
+        meta["buckets"][bucket.name] = {"gcda": len(gcdas), "returncode": m.get("returncode"), "duration_s": m.get("duration_s")}
+        if model is None:
+            continue
+        tests[bucket.name] = {
+            f.file.replace("\\", "/"): sorted(set(f.covered_lines))
+            for f in model.files
+            if f.covered_lines
+        }
+        for f in model.files:
+            key = f.file.replace("\\", "/")
+            line_totals[key] = max(line_totals.get(key, 0), f.lines.total)
+
+    if not tests:
+        meta["error"] = "逐测试覆盖率为空"
+        return None, meta
+
+    hashes = test_function_hashes(tests_dir)
+    if merge:
+        old = load_map(tests_dir)
+        if old is not None:
+            recorded = old.meta.get("sources") or {}
+            now = source_mtimes(project_root, list(recorded))
+            kept = {
+                t: cov
+                for t, cov in old.tests.items()
+                if t not in tests and t not in (SETUP_BUCKET, TEARDOWN_BUCKET) and (not hashes or t in hashes)
+            }
+            stale = sorted(t for t, cov in kept.items() if any(f not in now or now[f] != recorded.get(f) for f in cov))
+            for t in stale:
+                del kept[t]
+            meta["merged_from_previous"] = sorted(kept)
+            meta["dropped_stale"] = stale
+            tests = {**kept, **tests}
+            line_totals = {**(old.meta.get("line_totals") or {}), **line_totals}
+
+    files = sorted({f for cov in tests.values() for f in cov})
+    ptc = PerTestCoverage(
+        tests,
+        meta={
+            "project_root": str(project_root),
+            "git_head": git_head(project_root),
+            # 记录时工作区相对 HEAD 已有改动：行号不是 HEAD 的编号，下次不能按 git diff 选测试
+            "git_dirty": git_dirty(project_root),
+            "sources": source_mtimes(project_root, files),
+            "test_hashes": hashes,
+            "line_totals": line_totals,
+        },
+    )
+    meta["map"] = str(ptc.save(Path(tests_dir) / MAP_FILE))
+    meta["summary"] = ptc.summary()
+    return ptc, meta
+
+
+def load_map(tests_dir: Path) -> PerTestCoverage | None:
+    p = Path(tests_dir) / MAP_FILE
+    return PerTestCoverage.load(p) if p.exists() else None
@@ -0,0 +1,579 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import time
+from collections import Counter
+from datetime import datetime
+from pathlib import Path
+from typing import Any, Iterable
+
+from . import benchmark_suite, coverage_build, project_lib, tracing, ui_load, workload
+from .models import Finding
+from .utils import read_text_best_effort
+
+PROFILE_DIR = "profile"
+HOTSPOTS_FILE = "hotspots.json"
+PROFILERS = {"auto", "perf", "gprof", "xperf"}
+TARGETS = ("uiload", "bench", "app")
+# 每个工作负载在 hotspots.json / meta 里保留的函数数
+_KEEP_FUNCTIONS = 30
+
+
+def enabled() -> bool:
+    """Run the profiling stage with the GUI pipeline (QT_TEST_AI_PROFILE, default off: it rebuilds the workloads)."""
+    return (os.getenv("QT_TEST_AI_PROFILE") or "0").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def profiler() -> tuple[str, str | None]:
+    """
+    Sampling profiler (QT_TEST_AI_PROFILER, default auto: perf on Linux, else gprof).
+
+    Returns (profiler, note); "none" when nothing usable is on PATH. xperf is
+    accepted but falls back to gprof: ETW stacks are symbolized from PDBs and
+    MinGW builds only carry DWARF.
+    """
+    raw = (os.getenv("QT_TEST_AI_PROFILER") or "auto").strip().lower()
+    note = None
+    if raw not in PROFILERS:
+        raw, note = "auto", f"未知的剖析器 {raw}，改为自动选择"
+    if raw == "xperf":
+        raw, note = "gprof", "xperf / ETW 只能用 PDB 符号化，MinGW 构建没有 PDB，改用 gprof"
+    if raw == "perf" and not shutil.which("perf"):
+        raw, note = "gprof", "PATH 上没有 perf，改用 gprof"
+    if raw == "auto":
+        raw = "perf" if sys.platform.startswith("linux") and shutil.which("perf") else "gprof"
+    if raw == "gprof" and not shutil.which("gprof"):
+        return "none", "PATH 上既没有 perf 也没有 gprof，跳过剖析"
+    return raw, note
+
+
+def targets() -> list[str]:
+    """Workloads to profile, comma separated (QT_TEST_AI_PROFILE_TARGETS, default "uiload,bench")."""
+    raw = (os.getenv("QT_TEST_AI_PROFILE_TARGETS") or "uiload,bench").replace(";", ",")
+    out = [t.strip().lower() for t in raw.split(",") if t.strip().lower() in TARGETS]
+    return list(dict.fromkeys(out)) or ["uiload", "bench"]
+
+
+def frequency() -> int:
+    """perf sampling frequency in Hz (QT_TEST_AI_PROFILE_FREQ, default 999; gprof's rate is fixed by the C runtime)."""
+    return int(workload.float_env("QT_TEST_AI_PROFILE_FREQ", 999, minimum=0.0)) or 999
+
+
+def call_graph() -> str:
+    """perf --call-graph mode (QT_TEST_AI_PROFILE_CALLGRAPH, default dwarf: Qt's own libraries omit frame pointers)."""
+    raw = (os.getenv("QT_TEST_AI_PROFILE_CALLGRAPH") or "dwarf").strip().lower()
+    return raw if raw.split(",")[0] in {"dwarf", "fp", "lbr"} else "dwarf"
+
+
+def app_seconds() -> int:
+    """How long the application itself runs under the profiler before it is stopped (QT_TEST_AI_PROFILE_SECONDS, default 20)."""
+    return int(workload.float_env("QT_TEST_AI_PROFILE_SECONDS", 20, minimum=0.0)) or 20
+
+
+def top() -> int:
+    """Hot project functions reported per workload (QT_TEST_AI_PROFILE_TOP, default 10)."""
+    return int(workload.float_env("QT_TEST_AI_PROFILE_TOP", 10, minimum=0.0)) or 10
+
+
+def hot_pct() -> float:
+    """Self time share from which a hotspot is a warning rather than info (QT_TEST_AI_PROFILE_HOT_PCT, default 10)."""
+    return workload.float_env("QT_TEST_AI_PROFILE_HOT_PCT", 10.0, minimum=0.0)
+
+
+def prompt_enabled() -> bool:
+    """Feed the last profile's hotspots into test generation prompts (QT_TEST_AI_PROFILE_PROMPT, default on)."""
+    return (os.getenv("QT_TEST_AI_PROFILE_PROMPT") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def profile_dir(tests_dir: Path) -> Path:
+    return Path(tests_dir) / PROFILE_DIR
+
+
+# ----------------------------
+# profiled builds
+# ----------------------------
+def build_args(out_dir: Path, prof: str) -> list[str]:
+    """
+    qmake assignments for a profiled copy of a generated workload.
+
+    They follow -after so they override the .pro's own DESTDIR / OBJECTS_DIR
+    (which point next to the regular build) and add the profiler's flags:
+    frame pointers and line info for perf, -pg instrumentation for gprof.
+    """
+    d = Path(out_dir)
+    args = ["-after", *(f"{k}={(d / v).as_posix()}" for k, v in (("DESTDIR", "bin"), ("OBJECTS_DIR", "obj"), ("MOC_DIR", "moc"), ("UI_DIR", "ui"), ("RCC_DIR", "rcc")))]
+    if prof == "gprof":
+        args += ["QMAKE_CXXFLAGS+=-pg", "QMAKE_LFLAGS+=-pg"]
+    else:
+        args += ["QMAKE_CXXFLAGS+=-g -fno-omit-frame-pointer"]
+    return args
+
+
+def prepare(project_root: Path, tests_dir: Path, target: str, prof: str, work: Path) -> tuple[Path | None, list[str], dict[str, Any]]:
+    """Write and build the workload's profiled copy; returns (exe, argv, build meta)."""
+    if target == "uiload":
+        pro, name = ui_load.write_driver(project_root, tests_dir), ui_load.DRIVER_TARGET
+        script = next((p for p in ui_load.write_scripts(tests_dir) if p.stem == ui_load.DEFAULT_SCRIPT), None)
+        argv = ["-platform", "offscreen", "--script", str(script), "--out", str(work / "uiload_result.json")]
+    else:
+        pro, name = benchmark_suite.write_suite(project_root, tests_dir), benchmark_suite.BENCH_TARGET
+        argv = ["-platform", "offscreen"]
+    ok, m_build = coverage_build.build(pro, work / "build", args=build_args(work, prof))
+    meta = {k: m_build.get(k) for k in ("build_dir", "qmake_skipped", "jobs", "duration_s")}
+    if not ok:
+        meta["error"] = workload.build_error(m_build)
+        return None, argv, meta
+    return workload.executable(work / "bin", name), argv, meta
+
+
+# ----------------------------
+# symbols
+# ----------------------------
+_OFFSET_RE = re.compile(r"\+0x[0-9a-fA-F]+$")
+_CLONE_RE = re.compile(r"\s*\[clone [^\]]*\]|\.(?:part|isra|constprop|cold|lto_priv)\.\d+")
+
+
+def clean_symbol(sym: str) -> str:
+    """Drop the +0x offset and GCC clone suffixes so clones and parts count as the function they came from."""
+    return _CLONE_RE.sub("", _OFFSET_RE.sub("", (sym or "").strip())).strip()
+
+
+def base_name(sig: str) -> str:
+    """`Class::method` of a demangled signature; lambdas and local classes fold into the enclosing function."""
+    depth = 0
+    for i, ch in enumerate(sig):
+        head = sig[:i]
+        if (head.endswith("operator") and ch in "(<>=") or (head.endswith("operator(") and ch == ")") or (head[-9:-1] == "operator" and ch in "<>="):
+            # operator()、operator<、operator<<= 等名字里的符号不是参数表 / 模板括号
+            continue
+        if ch == "<":
+            depth += 1
+        elif ch == ">":
+            depth = max(0, depth - 1)
+        elif ch == "(" and depth == 0:
+            return sig[:i].strip()
+    return sig.strip()
+
+
+# 定义从行首开始；缩进的 Base::method( 是函数体里的调用，不算
+_DEF_RE = re.compile(r"^(?:\w[\w:<>,\*&~ \t]*[\s\*&])?((?:[A-Za-z_]\w*::)+~?[A-Za-z_]\w*)\s*\(", re.M)
+
+
+def definitions(project_root: Path) -> dict[str, tuple[str, int]]:
+    """`Class::method` -> (file relative to the project, line) for member functions defined in the application sources."""
+    root = Path(project_root)
+    out: dict[str, tuple[str, int]] = {}
+    srcs, _ = project_lib.project_sources(root)
+    main = root / "main.cpp"
+    for f in [*srcs, *([main] if main.is_file() else [])]:
+        text = read_text_best_effort(f)
+        for m in _DEF_RE.finditer(text):
+            name = m.group(1)
+            if name not in out:
+                try:
+                    rel = f.relative_to(root).as_posix()
+                except ValueError:
+                    rel = f.name
+                out[name] = (rel, text.count("\n", 0, m.start()) + 1)
+    return out
+
+
+# ----------------------------
+# perf
+# ----------------------------
+_FRAME_RE = re.compile(r"^\s*([0-9a-fA-F]+)\s+(.*\S)\s+\(([^()]*)\)\s*$")
+
+
+def parse_perf_script(lines: Iterable[str]) -> dict[str, Any]:
+    """
+    Aggregate `perf script -F comm,tid,ip,sym,dso` output.
+
+    Each sample is a header line followed by its call chain, leaf first, and a
+    blank line. Self time goes to the leaf; inclusive time once to every
+    distinct function on the chain (recursion counts once).
+    """
+    self_n: Counter[str] = Counter()
+    incl_n: Counter[str] = Counter()
+    callers: dict[str, Counter[str]] = {}
+    info: dict[str, dict[str, str]] = {}
+    total = 0
+    chain: list[str] = []
+
+    def _flush() -> None:
+        nonlocal total
+        if not chain:
+            return
+        total += 1
+        self_n[chain[0]] += 1
+        for fn in set(chain):
+            incl_n[fn] += 1
+        for fn, parent in zip(chain, chain[1:]):
+            if fn != parent:
+                callers.setdefault(fn, Counter())[parent] += 1
+        chain.clear()
+
+    for line in lines:
+        if not line.strip():
+            _flush()
+            continue
+        m = _FRAME_RE.match(line)
+        if not m:
+            # 新样本的头一行（comm tid）；没有空行分隔时也当作边界
+            _flush()
+            continue
+        sym = clean_symbol(m.group(2))
+        if not sym or sym == "[unknown]":
+            continue
+        name = base_name(sym)
+        if name not in info:
+            info[name] = {"signature": sym, "dso": Path(m.group(3).strip()).name}
+        chain.append(name)
+    _flush()
+
+    functions = []
+    for name, n in incl_n.items():
+        c = callers.get(name) or Counter()
+        functions.append(
+            {
+                "name": name,
+                **info[name],
+                "self_pct": round(100.0 * self_n[name] / total, 2) if total else 0.0,
+                "incl_pct": round(100.0 * n / total, 2) if total else 0.0,
+                "self_samples": self_n[name],
+                "callers": [{"name": k, "pct": round(100.0 * v / max(1, sum(c.values())), 1)} for k, v in c.most_common(3)],
+            }
+        )
+    return {"samples": total, "functions": functions}
+
+
+def _wait_stopping(proc: subprocess.Popen, limit_s: float, *, graceful: bool) -> bool:
+    """Wait up to `limit_s`; then stop the profiler (SIGINT lets perf write its data and end the workload). True when stopped by us."""
+    try:
+        proc.wait(timeout=limit_s)
+        return False
+    except subprocess.TimeoutExpired:
+        pass
+    if graceful and hasattr(signal, "SIGINT"):
+        proc.send_signal(signal.SIGINT)
+        try:
+            proc.wait(timeout=60)
+            return True
+        except subprocess.TimeoutExpired:
+            pass
+    proc.kill()
+    proc.wait()
+    return True
+
+
+def run_perf(exe: Path, argv: list[str], work: Path, *, limit_s: float, stop_expected: bool = False) -> tuple[dict[str, Any], dict[str, Any] | None]:
+    """Record `exe argv` with perf and aggregate its samples; returns (run meta, profile or None)."""
+    data = work / "perf.data"
+    data.unlink(missing_ok=True)
+    cmd = ["perf", "record", "-F", str(frequency()), "--call-graph", call_graph(), "-o", str(data), "--", str(exe), *argv]
+    env = dict(os.environ)
+    env["QT_QPA_PLATFORM"] = "offscreen"
+    meta: dict[str, Any] = {"cmd": cmd}
+    t0 = time.perf_counter()
+    log = work / "perf_record.log"
+    with tracing.span(tracing.command_name(cmd), tracing.SHELL) as s:
+        # 被测程序的输出也走 perf 的 stderr：写文件，免得管道写满卡住
+        with log.open("w", encoding="utf-8", errors="replace") as fh:
+            try:
+                proc = subprocess.Popen(cmd, cwd=str(work), env=env, stdout=fh, stderr=subprocess.STDOUT)
+            except OSError as e:
+                meta["error"] = str(e)
+                return meta, None
+            stopped = _wait_stopping(proc, limit_s, graceful=True)
+        meta["stderr"] = read_text_best_effort(log)[-3000:]
+        meta["returncode"] = proc.returncode
+        s.set(returncode=proc.returncode, stopped=stopped)
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    if stopped and not stop_expected:
+        meta["timed_out"] = True
+    if not data.is_file() or data.stat().st_size == 0:
+        meta["error"] = meta.get("stderr") or "perf 没有写出数据"
+        return meta, None
+
+    script = ["perf", "script", "-i", str(data), "-F", "comm,tid,ip,sym,dso"]
+    with tracing.span(tracing.command_name(script), tracing.SHELL):
+        try:
+            # 调用链输出可能有几百 MB，逐行解析而不是整段读入
+            proc = subprocess.Popen(script, cwd=str(work), stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True, errors="replace")
+        except OSError as e:
+            meta["error"] = str(e)
+            return meta, None
+        prof = parse_perf_script(proc.stdout or [])
+        proc.wait()
+    return meta, prof
+
+
+# ----------------------------
+# gprof
+# ----------------------------
+_FLAT_RE = re.compile(r"^\s*(\d+\.\d+)\s+(\d+\.\d+)\s+(\d+\.\d+)\s+(?:(\d+)\s+(\d+\.\d+)\s+(\d+\.\d+)\s+)?(\S.*?)\s*$")
+_PRIMARY_RE = re.compile(r"^\[(\d+)\]\s+(\d+\.\d+)\s+(\d+\.\d+)\s+(\d+\.\d+)\s+(?:(\d+(?:\+\d+)?)\s+)?(.+?)\s+\[\d+\]\s*$")
+_PARENT_RE = re.compile(r"^\s+(\d+\.\d+)\s+(\d+\.\d+)\s+(\d+)/(\d+)\s+(.+?)\s+\[\d+\]\s*$")
+_CYCLE_RE = re.compile(r"\s*<cycle \d+(?: as a whole)?>")
+
+
+def parse_gprof(text: str) -> dict[str, Any]:
+    """
+    Flat profile (self time) and call graph (inclusive % and callers) of `gprof -b`.
+
+    "samples" is the sampled CPU time in seconds; gprof only sees code
+    compiled with -pg, so Qt's own libraries do not appear.
+    """
+    flat_part, _, graph_part = (text or "").partition("Call graph")
+    rows: dict[str, dict[str, Any]] = {}
+    for line in flat_part.splitlines():
+        m = _FLAT_RE.match(line)
+        if not m:
+            continue
+        sym = clean_symbol(m.group(7))
+        name = base_name(sym)
+        r = rows.setdefault(name, {"name": name, "signature": sym, "self_s": 0.0, "calls": 0})
+        r["self_s"] += float(m.group(3))
+        r["calls"] += int(m.group(4) or 0)
+    total = sum(r["self_s"] for r in rows.values())
+
+    incl: dict[str, float] = {}
+    callers: dict[str, list[dict[str, Any]]] = {}
+    for block in re.split(r"^-{5,}\s*$", graph_part, flags=re.M):
+        parents: list[tuple[str, int]] = []
+        for line in block.splitlines():
+            m = _PRIMARY_RE.match(line)
+            if m:
+                name = base_name(clean_symbol(_CYCLE_RE.sub("", m.group(6))))
+                incl[name] = max(incl.get(name, 0.0), float(m.group(2)))
+                n = sum(c for _, c in parents) or 1
+                callers[name] = [{"name": p, "pct": round(100.0 * c / n, 1)} for p, c in sorted(parents, key=lambda x: -x[1])[:3]]
+                break
+            m = _PARENT_RE.match(line)
+            if m:
+                parents.append((base_name(clean_symbol(_CYCLE_RE.sub("", m.group(5)))), int(m.group(3))))
+
+    functions = []
+    for name in set(rows) | set(incl):
+        r = rows.get(name) or {"name": name, "signature": name, "self_s": 0.0, "calls": 0}
+        functions.append(
+            {
+                **r,
+                "self_s": round(r["self_s"], 4),
+                "self_pct": round(100.0 * r["self_s"] / total, 2) if total else 0.0,
+                "incl_pct": round(incl.get(name, 0.0), 2),
+                "callers": callers.get(name) or [],
+            }
+        )
+    return {"samples": round(total, 4), "functions": functions}
+
+
+def run_gprof(exe: Path, argv: list[str], work: Path, *, limit_s: float) -> tuple[dict[str, Any], dict[str, Any] | None]:
+    """Run the -pg build (gmon.out lands in the working directory at exit) and read it back with gprof."""
+    gmon = work / "gmon.out"
+    gmon.unlink(missing_ok=True)
+    cmd = [str(exe), *argv]
+    env = dict(os.environ)
+    env["QT_QPA_PLATFORM"] = "offscreen"
+    env.pop("GMON_OUT_PREFIX", None)
+    meta: dict[str, Any] = {"cmd": cmd}
+    t0 = time.perf_counter()
+    try:
+        p = tracing.run(cmd, cwd=str(work), env=env, capture_output=True, text=True, errors="replace", timeout=limit_s)
+        meta["returncode"] = p.returncode
+        meta["stderr"] = (p.stderr or "")[-3000:]
+    except subprocess.TimeoutExpired:
+        # 被杀掉的进程不会写 gmon.out
+        meta["timed_out"] = True
+    except OSError as e:
+        meta["error"] = str(e)
+        return meta, None
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    if not gmon.is_file():
+        meta["error"] = "没有生成 gmon.out（程序需要正常退出）"
+        return meta, None
+    try:
+        p = tracing.run(["gprof", "-b", str(exe), str(gmon)], cwd=str(work), capture_output=True, text=True, errors="replace", timeout=600)
+    except (OSError, subprocess.TimeoutExpired) as e:
+        meta["error"] = f"gprof 失败: {e}"
+        return meta, None
+    if p.returncode != 0:
+        meta["error"] = (p.stderr or "")[-2000:]
+        return meta, None
+    return meta, parse_gprof(p.stdout or "")
+
+
+# ----------------------------
+# hotspots
+# ----------------------------
+def classify(prof: dict[str, Any], defs: dict[str, tuple[str, int]]) -> list[dict[str, Any]]:
+    """Functions by self time, each marked as project code (with its definition) or library code."""
+    out = []
+    for f in prof.get("functions") or []:
+        loc = defs.get(f["name"])
+        out.append({**f, "project": loc is not None, **({"file": loc[0], "line": loc[1]} if loc else {})})
+    out.sort(key=lambda f: (-f["self_pct"], -f["incl_pct"], f["name"]))
+    return out
+
+
+def _keep(functions: list[dict[str, Any]]) -> list[dict[str, Any]]:
+    project = [f for f in functions if f["project"]][:_KEEP_FUNCTIONS]
+    library = [f for f in functions if not f["project"]][:10]
+    return project + library
+
+
+def save_hotspots(tests_dir: Path, run: dict[str, Any]) -> Path:
+    p = profile_dir(tests_dir) / HOTSPOTS_FILE
+    p.parent.mkdir(parents=True, exist_ok=True)
+    p.write_text(json.dumps(run, ensure_ascii=False, indent=2), encoding="utf-8")
+    return p
+
+
+def load_hotspots(tests_dir: Path) -> dict[str, Any]:
+    try:
+        return json.loads((profile_dir(tests_dir) / HOTSPOTS_FILE).read_text(encoding="utf-8"))
+    except Exception:
+        return {}
+
+
+def prompt_context(tests_dir: Path, files: list[str] | None = None, limit: int = 8) -> str:
+    """
+    Prompt section listing the last profile's hot project functions.
+
+    With `files`, only functions defined in those files (matched by file
+    name) are listed; empty when there is nothing relevant.
+    """
+    if not prompt_enabled():
+        return ""
+    data = load_hotspots(tests_dir)
+    wanted = {Path(f).name.lower() for f in files or []}
+    best: dict[str, dict[str, Any]] = {}
+    for target, entry in (data.get("targets") or {}).items():
+        for f in entry.get("functions") or []:
+            if not f.get("project") or (wanted and Path(f.get("file") or "").name.lower() not in wanted):
+                continue
+            if f["name"] not in best or f["self_pct"] > best[f["name"]]["self_pct"]:
+                best[f["name"]] = {**f, "target": target}
+    rows = sorted(best.values(), key=lambda f: (-f["self_pct"], -f["incl_pct"]))[:limit]
+    if not rows:
+        return ""
+    lines = [
+        f"\n\n=== PERFORMANCE HOTSPOTS (sampling profile, {data.get('profiler')}, {data.get('at')}) ===",
+        "These functions of the class under test dominate CPU time in a realistic workload:",
+    ]
+    for f in rows:
+        lines.append(f"- {f['signature']} — self {f['self_pct']:.1f}%, inclusive {f['incl_pct']:.1f}% ({f.get('file')}:{f.get('line')}, workload {f['target']})")
+    lines += [
+        "In addition to the functional tests, add performance-focused test functions for these hotspots:",
+        "- Use QBENCHMARK around the hot call with a realistic scene size (hundreds of items / arrows) built in the test itself.",
+        "- Still assert the result after the benchmark loop (geometry, counts, state), so a faster but wrong implementation fails.",
+        "- Keep each benchmark body free of setup work; create the scene and items before QBENCHMARK.",
+    ]
+    return "\n".join(lines) + "\n"
+
+
+def run(
+    project_root: Path,
+    tests_dir: Path | None = None,
+    *,
+    only: list[str] | None = None,
+    app_exe: Path | None = None,
+    timeout_s: float = 1800,
+) -> tuple[list[Finding], dict[str, Any]]:
+    """
+    Build profiled copies of the generated workloads, run them (and the application) under the sampler and report hotspots.
+
+    Findings: the top() project functions per workload by self time, with
+    self / inclusive share and main callers (warning from hot_pct() self
+    time), one summary per workload with the hottest library functions, and
+    build / profiler failures. The result is kept in profile/hotspots.json
+    for prompt_context().
+    """
+    project_root = Path(project_root)
+    tests_dir = Path(tests_dir) if tests_dir is not None else project_root / "tests" / "generated"
+    findings: list[Finding] = []
+    prof, note = profiler()
+    meta: dict[str, Any] = {"profiler": prof, "targets": {}}
+    if note:
+        meta["note"] = note
+        findings.append(Finding("performance", "info", note))
+    if prof == "none":
+        return findings, meta
+
+    names = [t for t in (only or targets()) if t in TARGETS]
+    if "app" in names and (app_exe is None or prof != "perf"):
+        # gprof 需要重新编译并正常退出，直接剖析被测程序只支持 perf
+        names.remove("app")
+        if app_exe is not None:
+            findings.append(Finding("performance", "info", "直接剖析被测程序需要 perf（gprof 需要 -pg 重新编译），已跳过 app"))
+    defs = definitions(project_root)
+    n_top, hot = top(), hot_pct()
+    saved: dict[str, Any] = {}
+    for target in names:
+        work = (profile_dir(tests_dir) / target).resolve()
+        work.mkdir(parents=True, exist_ok=True)
+        entry: dict[str, Any] = {}
+        meta["targets"][target] = entry
+        if target == "app":
+            exe, argv = Path(app_exe), ["-platform", "offscreen"]
+        else:
+            exe, argv, entry["build"] = prepare(project_root, tests_dir, target, prof, work)
+            if exe is None:
+                findings.append(Finding("performance", "error", f"剖析用 {target} 构建失败", entry["build"].get("error") or str(work / "bin")))
+                continue
+
+        if prof == "perf":
+            is_app = target == "app"
+            entry["run"], result = run_perf(exe, argv, work, limit_s=app_seconds() if is_app else timeout_s, stop_expected=is_app)
+        else:
+            entry["run"], result = run_gprof(exe, argv, work, limit_s=timeout_s)
+        if result is None or not result.get("samples"):
+            err = entry["run"].get("error") or entry["run"].get("stderr") or "没有采到样本"
+            hint = "（检查 /proc/sys/kernel/perf_event_paranoid，或以有权限的用户运行）" if prof == "perf" and "paranoid" in err else ""
+            findings.append(Finding("performance", "warning", f"剖析 {target} 失败{hint}", err[-2000:]))
+            continue
+        if entry["run"].get("timed_out"):
+            findings.append(Finding("performance", "warning", f"剖析 {target} 超时（{timeout_s:.0f}s），结果只含已采到的部分"))
+
+        functions = classify(result, defs)
+        entry["samples"] = result["samples"]
+        entry["project_pct"] = round(sum(f["self_pct"] for f in functions if f["project"]), 2)
+        entry["functions"] = _keep(functions)
+        saved[target] = {"samples": result["samples"], "functions": entry["functions"]}
+
+        unit = "s CPU" if prof == "gprof" else " 个样本"
+        library = [f for f in functions if not f["project"] and f["self_pct"] > 0][:5]
+        findings.append(
+            Finding(
+                "performance",
+                "info",
+                f"剖析 {target}（{prof}）：{result['samples']}{unit}，项目代码自身耗时 {entry['project_pct']:.1f}%",
+                ("库函数热点：\n" + "\n".join(f"  {f['self_pct']:.1f}% {f['signature']}" + (f" ({f['dso']})" if f.get("dso") else "") for f in library)) if library else "",
+                evidence=str(work),
+            )
+        )
+        for f in [f for f in functions if f["project"]][:n_top]:
+            callers = "，".join(f"{c['name']} {c['pct']:.0f}%" for c in f.get("callers") or [])
+            findings.append(
+                Finding(
+                    "performance",
+                    "warning" if f["self_pct"] >= hot else "info",
+                    f"热点 {f['name']}：self {f['self_pct']:.1f}% / inclusive {f['incl_pct']:.1f}%（{target}）",
+                    f"{f['signature']}\n"
+                    + (f"调用方：{callers}\n" if callers else "")
+                    + f"阈值 self {hot:.0f}%；剖析器 {prof}，工作负载 {target}",
+                    file=f.get("file"),
+                    line=f.get("line"),
+                    rule_id="profile.hotspot",
+                    evidence=str(profile_dir(tests_dir) / HOTSPOTS_FILE),
+                )
+            )
+
+    if saved:
+        meta["hotspots"] = str(save_hotspots(tests_dir, {"at": datetime.now().isoformat(timespec="seconds"), "profiler": prof, "targets": saved}))
+    return findings, meta
@@ -0,0 +1,127 @@
+from __future__ import annotations
+
+import os
+import re
+from pathlib import Path
+from typing import Any
+
+from . import coverage_build
+
+LIB_DIR = "project_lib"
+LIB_TARGET = "qt_test_ai_project"
+DEFAULT_QT = "widgets gui core svg"
+
+_SKIP_PREFIXES = ("moc_", "qrc_", "ui_")
+
+
+def enabled() -> bool:
+    """Link generated tests against one coverage-built static library of the project (QT_TEST_AI_PROJECT_LIB)."""
+    return (os.getenv("QT_TEST_AI_PROJECT_LIB") or "0").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+def lib_dir(tests_dir: Path) -> Path:
+    return Path(tests_dir) / LIB_DIR
+
+
+def project_sources(project_root: Path) -> tuple[list[Path], list[Path]]:
+    """Application .cpp/.h under the project root and src/ (main.cpp and generated moc/qrc/ui files excluded)."""
+    sources: list[Path] = []
+    headers: list[Path] = []
+    for d in (Path(project_root), Path(project_root) / "src"):
+        if not d.is_dir():
+            continue
+        for f in sorted(d.glob("*.cpp")):
+            if f.name.lower() == "main.cpp" or f.name.startswith(_SKIP_PREFIXES):
+                continue
+            sources.append(f)
+        for f in sorted(d.glob("*.h")):
+            if not f.name.startswith(_SKIP_PREFIXES):
+                headers.append(f)
+    return sources, headers
+
+
+def qt_modules(project_root: Path) -> str:
+    """QT modules of the application's own .pro, minus testlib."""
+    mods: list[str] = []
+    for pro in sorted(Path(project_root).glob("*.pro")):
+        if "test" in pro.stem.lower():
+            continue
+        try:
+            text = pro.read_text(encoding="utf-8", errors="replace")
+        except Exception:
+            continue
+        for m in re.finditer(r"^\s*QT\s*\+?=\s*(.+)$", text, re.M):
+            for mod in m.group(1).split():
+                if mod not in mods and mod != "testlib":
+                    mods.append(mod)
+        break
+    return " ".join(mods) or DEFAULT_QT
+
+
+def rel_path(p: Path, base: Path) -> str:
+    try:
+        return Path(os.path.relpath(p, base)).as_posix()
+    except ValueError:
+        # Windows 下跨盘符没有相对路径
+        return Path(p).as_posix()
+
+
+def lib_pro_text(project_root: Path, tests_dir: Path) -> str:
+    """TEMPLATE = lib static library holding every application TU, compiled once with coverage flags."""
+    d = lib_dir(tests_dir)
+    sources, headers = project_sources(project_root)
+    src = " \\\n    ".join(rel_path(f, d) for f in sources)
+    hdr = " \\\n    ".join(rel_path(f, d) for f in headers)
+    return (
+        "# Generated by Smart Testing Tools (QT_TEST_AI_PROJECT_LIB=1); do not edit.\n"
+        "TEMPLATE = lib\n"
+        f"TARGET = {LIB_TARGET}\n"
+        "CONFIG += staticlib debug c++17\n"
+        "CONFIG -= app_bundle\n"
+        f"QT += {qt_modules(project_root)}\n"
+        f"INCLUDEPATH += {rel_path(Path(project_root), d)}\n"
+        "QMAKE_CXXFLAGS += --coverage\n"
+        "\n"
+        f"SOURCES += \\\n    {src}\n"
+        "\n"
+        f"HEADERS += \\\n    {hdr}\n"
+        "\n"
+        "DESTDIR = $$PWD/lib\n"
+        "OBJECTS_DIR = $$PWD/obj\n"
+        "MOC_DIR = $$PWD/moc\n"
+        "UI_DIR = $$PWD/ui\n"
+    )
+
+
+def link_block(pro_dir: Path, tests_dir: Path) -> str:
+    """
+    qmake lines for a test .pro in `pro_dir` that link the project library instead of listing its SOURCES.
+
+    Project HEADERS are left out on purpose: their moc output already lives in the library.
+    """
+    rel = rel_path(lib_dir(tests_dir) / "lib", Path(pro_dir))
+    return (
+        f"# Project under test is linked from {LIB_DIR}/ (built once, see QT_TEST_AI_PROJECT_LIB)\n"
+        f"LIBS += -L$$PWD/{rel} -l{LIB_TARGET}\n"
+        f"PRE_TARGETDEPS += $$PWD/{rel}/lib{LIB_TARGET}.a\n"
+    )
+
+
+def write_lib_pro(project_root: Path, tests_dir: Path) -> Path:
+    pro = lib_dir(tests_dir) / f"{LIB_TARGET}.pro"
+    coverage_build.write_if_changed(pro, lib_pro_text(project_root, tests_dir))
+    return pro
+
+
+def ensure_built(project_root: Path, tests_dir: Path | None = None) -> tuple[bool, dict[str, Any]]:
+    """
+    (Re)write the library .pro and build it incrementally; a no-op make when no application source changed.
+
+    Test targets relink automatically through PRE_TARGETDEPS when the archive changes.
+    """
+    tests_dir = Path(tests_dir) if tests_dir is not None else Path(project_root) / "tests" / "generated"
+    pro = write_lib_pro(project_root, tests_dir)
+    # ccache / PCH 设置与覆盖率全流程一致；覆盖率标志已写在库的 .pro 里
+    ok, meta = coverage_build.build(pro, lib_dir(tests_dir), args=coverage_build.qmake_args(pro, lib_dir(tests_dir)))
+    meta["pro"] = str(pro)
+    return ok, meta
@@ -5,6 +5,7 @@ import re
 from dataclasses import dataclass
 from pathlib import Path
 
+from . import file_index, symbol_index
 from .utils import read_text_best_effort
 
 
@@ -34,15 +35,9 @@ class ProjectContext:
 
 
 def _iter_files_pruned(project_root: Path, *, suffixes: tuple[str, ...]) -> list[Path]:
-    out: list[Path] = []
-    for dirpath, dirnames, filenames in os.walk(project_root):
-        # prune
-        dirnames[:] = [d for d in dirnames if d not in _EXCLUDE_DIR_NAMES and not d.lower().startswith("build")]
-        for name in filenames:
-            p = Path(dirpath) / name
-            if p.suffix.lower() in suffixes:
-                out.append(p)
-    return out
+    return file_index.get_index(project_root).files(
+        suffixes, prune=lambda d: d in _EXCLUDE_DIR_NAMES or d.lower().startswith("build")
+    )
 
 
 def _parse_pro_file_list(text: str) -> dict[str, list[str]]:
@@ -95,22 +90,68 @@ def _parse_pro_file_list(text: str) -> dict[str, list[str]]:
     return out
 
 
-def build_project_context(project_root: Path, *, max_files: int = 12, max_chars: int = 40_000, top_level_only: bool = False) -> ProjectContext:
-    # Allow env var override
-    if "QT_TEST_AI_CTX_MAX_FILES" in os.environ:
+def build_project_context(
+    project_root: Path,
+    *,
+    max_files: int | None = None,
+    max_chars: int | None = None,
+    top_level_only: bool = False,
+    target: Path | None = None,
+    budget_tokens: int | None = None,
+) -> ProjectContext:
+    """Prompt context for the project.
+
+    With `target` (and the symbol index enabled) only the files that target needs
+    (own header/impl, transitive includes, headers of referenced classes) are
+    included, within budget_tokens (default QT_TEST_AI_CTX_TOKEN_BUDGET).
+
+    max_files / max_chars default to QT_TEST_AI_CTX_MAX_FILES / _MAX_CHARS
+    (12 / 40000); an explicit value from the caller wins over the env.
+    """
+    # 调用方没显式传值时才用环境变量覆盖默认值
+    if max_files is None:
+        max_files = 12
         try:
-            max_files = int(os.environ["QT_TEST_AI_CTX_MAX_FILES"])
+            max_files = int(os.environ.get("QT_TEST_AI_CTX_MAX_FILES") or max_files)
         except ValueError:
             pass
-    
-    if "QT_TEST_AI_CTX_MAX_CHARS" in os.environ:
+
+    if max_chars is None:
+        max_chars = 40_000
         try:
-            max_chars = int(os.environ["QT_TEST_AI_CTX_MAX_CHARS"])
+            max_chars = int(os.environ.get("QT_TEST_AI_CTX_MAX_CHARS") or max_chars)
         except ValueError:
             pass
 
     pro_files = sorted(project_root.glob("*.pro"), key=lambda p: p.name.lower())
 
+    index = None
+    if symbol_index.index_enabled():
+        try:
+            index = symbol_index.project_index(project_root)
+        except Exception:
+            index = None
+
+    if index is not None and target is not None:
+        sel = index.select_context(target, budget_tokens=budget_tokens)
+        if sel.files:
+            own = index.classes_in(sel.files[0][0])
+            chunks = [f"项目根目录：{project_root}"]
+            if pro_files:
+                chunks.append(".pro 文件：" + ", ".join([p.name for p in pro_files]))
+            if own:
+                chunks.append("目标类：" + ", ".join(own))
+            chunks.append(f"按依赖选取的源文件（约 {sel.tokens}/{sel.budget} tokens）：")
+            chunks.append(sel.text)
+            if sel.skipped:
+                chunks.append("因预算省略：" + ", ".join(sel.skipped))
+            return ProjectContext(
+                project_root=project_root,
+                pro_files=pro_files,
+                selected_files=[index.project_root / rel for rel, _ in sel.files],
+                prompt_text="\n".join(chunks),
+            )
+
     # Prefer files referenced by .pro
     preferred: list[Path] = []
     for pro in pro_files:
@@ -131,6 +172,9 @@ def build_project_context(project_root: Path, *, max_files: int = 12, max_chars:
                     scanned.append(p)
         except Exception:
             scanned = []
+    elif index is not None:
+        # 索引里已有文件列表（按 mtime 增量维护），不必再遍历目录
+        scanned = index.paths((".h", ".hpp", ".cpp", ".cxx", ".ui"))
     else:
         scanned = _iter_files_pruned(project_root, suffixes=(".h", ".hpp", ".cpp", ".cxx", ".ui"))
 
@@ -153,12 +197,15 @@ def build_project_context(project_root: Path, *, max_files: int = 12, max_chars:
     chunks.append(f"项目根目录：{project_root}")
     if pro_files:
         chunks.append(".pro 文件：" + ", ".join([p.name for p in pro_files]))
+    if index is not None and index.classes:
+        overview = index.summary()
+        chunks.append("类索引（声明位置 / 基类 / 依赖 / 调用）：\n" + overview)
     chunks.append("选取的源文件片段（可能截断）：")
 
     used = 0
     for p in selected:
         try:
-            txt = read_text_best_effort(p)
+            txt = index.text(index.rel(p)) if index is not None and index.rel(p) in index.files else read_text_best_effort(p)
         except Exception:
             continue
         # Truncate per file
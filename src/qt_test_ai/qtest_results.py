@@ -0,0 +1,230 @@
+from __future__ import annotations
+
+import os
+import xml.etree.ElementTree as ET
+from dataclasses import asdict, dataclass, field
+from pathlib import Path
+from typing import Any
+
+RESULTS_STEM = "qtest_results"
+FIXTURES = {"initTestCase", "cleanupTestCase", "init", "cleanup"}
+
+# xfail / bpass 等其余类型都算通过
+_FAIL = {"fail", "xpass", "bfail", "bxpass"}
+
+
+def enabled() -> bool:
+    """Ask QtTest for a machine-readable log next to the text output (QT_TEST_AI_RESULTS_XML, default on)."""
+    return (os.getenv("QT_TEST_AI_RESULTS_XML") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def log_format() -> str:
+    """QtTest logger for the results file: "xml" (default, has file:line) or "junitxml"."""
+    raw = (os.getenv("QT_TEST_AI_RESULTS_XML") or "").strip().lower()
+    return "junitxml" if raw in {"junit", "junitxml"} else "xml"
+
+
+def results_path(directory: Path, tag: str = "") -> Path:
+    return Path(directory).resolve() / f"{RESULTS_STEM}{'-' + tag if tag else ''}.xml"
+
+
+def output_args(directory: Path, tag: str = "") -> list[str]:
+    """
+    `-o <file>,xml -o -,txt`: structured log to a file, the usual text to stdout.
+
+    The per-test harness and the aggregate runner append the function / class
+    name to the file, so collect() reads every `qtest_results*.xml`.
+    """
+    return ["-o", f"{results_path(directory, tag).as_posix()},{log_format()}", "-o", "-,txt"]
+
+
+def clear(directory: Path) -> None:
+    for p in Path(directory).glob(f"{RESULTS_STEM}*.xml"):
+        try:
+            p.unlink()
+        except Exception:
+            pass
+
+
+@dataclass
+class FunctionResult:
+    cls: str
+    name: str
+    status: str = "pass"  # pass | fail | skip | crash
+    duration_ms: float | None = None
+    failures: list[dict[str, Any]] = field(default_factory=list)
+    # QBENCHMARK 结果：每个数据行一条 {tag, metric, value, iterations}
+    benchmarks: list[dict[str, Any]] = field(default_factory=list)
+
+    def _set(self, status: str) -> None:
+        rank = {"pass": 0, "skip": 1, "fail": 2, "crash": 3}
+        if rank[status] > rank[self.status]:
+            self.status = status
+
+
+def _text(elem: ET.Element | None) -> str:
+    return (elem.text or "").strip() if elem is not None else ""
+
+
+def parse_file(path: Path) -> tuple[list[FunctionResult], str | None]:
+    """
+    Stream a QtTest xml or junitxml log into per-function results.
+
+    Elements are cleared as soon as a function is complete, so memory stays
+    flat for large logs. A log cut short by a crash still yields every finished
+    function, plus the one that was running, marked "crash".
+    """
+    out: list[FunctionResult] = []
+    cls = ""
+    cur: FunctionResult | None = None
+    error: str | None = None
+    try:
+        for event, elem in ET.iterparse(str(path), events=("start", "end")):
+            tag = elem.tag
+            if event == "start":
+                if tag in ("TestCase", "testsuite"):
+                    cls = elem.get("name") or cls
+                elif tag == "TestFunction":
+                    cur = FunctionResult(cls, elem.get("name") or "")
+                elif tag == "testcase":
+                    cur = FunctionResult(elem.get("classname") or cls, elem.get("name") or "")
+                    t = elem.get("time")
+                    if t:
+                        try:
+                            cur.duration_ms = float(t) * 1000.0
+                        except ValueError:
+                            pass
+                continue
+
+            # end events
+            if cur is None:
+                if tag in ("TestCase", "testsuite"):
+                    elem.clear()
+                continue
+            if tag == "Incident":
+                kind = (elem.get("type") or "").lower()
+                if kind in _FAIL:
+                    cur._set("fail")
+                    cur.failures.append({
+                        "file": elem.get("file") or "",
+                        "line": int(elem.get("line") or 0),
+                        "tag": _text(elem.find("DataTag")),
+                        "message": _text(elem.find("Description"))[:1000],
+                    })
+                elif kind == "skip":
+                    cur._set("skip")
+            elif tag == "Message" and (elem.get("type") or "").lower() == "skip":
+                cur._set("skip")
+            elif tag in ("failure", "error"):
+                cur._set("fail")
+                cur.failures.append({"file": "", "line": 0, "tag": "", "message": ((elem.get("message") or "") + " " + (elem.text or "")).strip()[:1000]})
+            elif tag == "skipped":
+                cur._set("skip")
+            elif tag == "BenchmarkResult":
+                try:
+                    cur.benchmarks.append({
+                        "tag": elem.get("tag") or "",
+                        "metric": elem.get("metric") or "",
+                        "value": float(elem.get("value") or 0),
+                        "iterations": int(elem.get("iterations") or 1),
+                    })
+                except ValueError:
+                    pass
+            elif tag == "Duration":
+                try:
+                    cur.duration_ms = float(elem.get("msecs") or 0)
+                except ValueError:
+                    pass
+            elif tag in ("TestFunction", "testcase"):
+                out.append(cur)
+                cur = None
+                elem.clear()
+    except ET.ParseError as e:
+        error = f"{Path(path).name}: {e}"
+    except OSError as e:
+        return out, f"{Path(path).name}: {e}"
+    if cur is not None:
+        # 日志在函数中途结束：进程在这个测试函数里崩溃了
+        cur._set("crash")
+        out.append(cur)
+    return out, error
+
+
+@dataclass
+class TestResults:
+    functions: list[FunctionResult]
+    files: list[str] = field(default_factory=list)
+    errors: list[str] = field(default_factory=list)
+
+    def totals(self) -> dict[str, int]:
+        """Counts over every function including fixtures, the way QtTest's Totals line counts."""
+        t = {"passed": 0, "failed": 0, "skipped": 0, "crashed": 0}
+        key = {"pass": "passed", "fail": "failed", "skip": "skipped", "crash": "crashed"}
+        for f in self.functions:
+            t[key[f.status]] += 1
+        return t
+
+    def statuses(self) -> dict[str, str]:
+        """Per test function (fixtures excluded): pass / skip / fail, a crash counts as fail; worst status wins across runs."""
+        rank = {"pass": 0, "skip": 1, "fail": 2}
+        out: dict[str, str] = {}
+        for f in self.functions:
+            if f.name in FIXTURES:
+                continue
+            st = "fail" if f.status == "crash" else f.status
+            if f.name not in out or rank[st] > rank[out[f.name]]:
+                out[f.name] = st
+        return out
+
+    def failed_names(self) -> set[str]:
+        return {n for n, st in self.statuses().items() if st == "fail"}
+
+    def crashed(self) -> list[FunctionResult]:
+        return [f for f in self.functions if f.status == "crash"]
+
+    def durations_s(self, qualified: bool = False) -> dict[str, float]:
+        out: dict[str, float] = {}
+        for f in self.functions:
+            if f.name in FIXTURES or f.duration_ms is None:
+                continue
+            key = f"{f.cls}::{f.name}" if qualified else f.name
+            out[key] = out.get(key, 0.0) + f.duration_ms / 1000.0
+        return out
+
+    def failure_report(self, limit: int = 30) -> str:
+        """One line per failure / crash: Class::func(tag) file:line: message."""
+        lines: list[str] = []
+        for f in self.functions:
+            if f.status == "crash":
+                lines.append(f"{f.cls}::{f.name}() CRASHED (log ends inside this function)")
+            for fl in f.failures:
+                loc = f"{fl['file']}:{fl['line']}: " if fl.get("file") else ""
+                tag = f"({fl['tag']})" if fl.get("tag") else "()"
+                lines.append(f"{f.cls}::{f.name}{tag} {loc}{fl.get('message') or 'failed'}")
+        more = len(lines) - limit
+        return "\n".join(lines[:limit]) + (f"\n... {more} more" if more > 0 else "")
+
+    def to_meta(self) -> dict[str, Any]:
+        return {
+            "totals": self.totals(),
+            "failed": sorted(self.failed_names()),
+            "crashed": [f"{f.cls}::{f.name}" for f in self.crashed()],
+            "report": self.failure_report(),
+            "functions": [asdict(f) for f in self.functions],
+            "files": self.files,
+            "errors": self.errors,
+        }
+
+
+def collect(directory: Path) -> TestResults | None:
+    """Parse every results file in `directory`; None when QtTest wrote none (e.g. the binary never started)."""
+    files = sorted(Path(directory).glob(f"{RESULTS_STEM}*.xml"))
+    if not files:
+        return None
+    res = TestResults(functions=[], files=[str(p) for p in files])
+    for p in files:
+        fs, err = parse_file(p)
+        res.functions.extend(fs)
+        if err:
+            res.errors.append(err)
+    return res
@@ -0,0 +1,269 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+from datetime import datetime
+from pathlib import Path
+from typing import Any, Callable
+
+from .per_test_coverage import test_function_hashes
+
+GUARD_HEADER = "qt_test_ai_quarantine.h"
+LIST_FILE = "qt_test_ai_quarantine.txt"
+STATE_FILE = "quarantine.json"
+GUARD_CALL = "QT_TEST_AI_QUARANTINE_GUARD();"
+
+_FIXTURES = {"initTestCase", "cleanupTestCase", "init", "cleanup"}
+
+
+def enabled() -> bool:
+    """Quarantine failing test functions at runtime instead of rewriting the source (QT_TEST_AI_QUARANTINE, default on)."""
+    return (os.getenv("QT_TEST_AI_QUARANTINE") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def rerun_count() -> int:
+    """How often failing functions are re-run by name to tell deterministic from flaky failures (QT_TEST_AI_RERUN_COUNT, default 2)."""
+    try:
+        return max(1, int(os.getenv("QT_TEST_AI_RERUN_COUNT") or 2))
+    except ValueError:
+        return 2
+
+
+def list_path(tests_dir: Path) -> Path:
+    return Path(tests_dir).resolve() / LIST_FILE
+
+
+# ----------------------------
+# guard compiled into the generated tests
+# ----------------------------
+_HEADER = r"""// Generated by Smart Testing Tools (test quarantine). Do not edit.
+//
+// Every generated test function starts with QT_TEST_AI_QUARANTINE_GUARD().
+// The guard reads a skip list once per process ($QT_TEST_AI_QUARANTINE_FILE,
+// default @LIST@): one "function" or "Class::function" per line. Listed
+// functions QSKIP, so quarantining a test needs no recompile or relink.
+#pragma once
+
+#include <QtTest>
+#include <QFile>
+#include <QSet>
+#include <QString>
+
+namespace qt_test_ai {
+
+inline const QSet<QString> &quarantinedFunctions()
+{
+    static const QSet<QString> names = [] {
+        QSet<QString> out;
+        QString path = qEnvironmentVariable("QT_TEST_AI_QUARANTINE_FILE");
+        if (path.isEmpty())
+            path = QStringLiteral("@LIST@");
+        QFile f(path);
+        if (f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            while (!f.atEnd()) {
+                const QString line = QString::fromUtf8(f.readLine()).trimmed();
+                if (!line.isEmpty() && !line.startsWith(QLatin1Char('#')))
+                    out.insert(line);
+            }
+        }
+        return out;
+    }();
+    return names;
+}
+
+inline bool isQuarantined(const QObject *tc, const char *function)
+{
+    const QSet<QString> &q = quarantinedFunctions();
+    if (q.isEmpty() || !function)
+        return false;
+    const QString name = QString::fromLatin1(function);
+    return q.contains(name) || q.contains(QString::fromLatin1(tc->metaObject()->className()) + QLatin1String("::") + name);
+}
+
+} // namespace qt_test_ai
+
+#define QT_TEST_AI_QUARANTINE_GUARD() \
+    do { \
+        if (qt_test_ai::isQuarantined(this, QTest::currentTestFunction())) \
+            QSKIP("quarantined by Smart Testing Tools (see qt_test_ai_quarantine.txt)"); \
+    } while (0)
+"""
+
+
+def header_text(tests_dir: Path) -> str:
+    return _HEADER.replace("@LIST@", list_path(tests_dir).as_posix())
+
+
+def write_header(tests_dir: Path) -> Path:
+    p = Path(tests_dir) / GUARD_HEADER
+    text = header_text(tests_dir)
+    try:
+        if p.exists() and p.read_text(encoding="utf-8") == text:
+            return p
+    except Exception:
+        pass
+    p.write_text(text, encoding="utf-8")
+    return p
+
+
+_SLOTS_RE = re.compile(r"\bprivate\s+(?:slots|Q_SLOTS)\s*:(.*?)(?=\b(?:public|protected|private|signals|Q_SIGNALS)\b[^:]*:|\};)", re.S)
+_SLOT_DECL_RE = re.compile(r"\bvoid\s+(\w+)\s*\(\s*\)")
+
+
+def test_slots(code: str) -> list[str]:
+    """Test functions declared under `private slots:` (fixtures and `_data` functions excluded)."""
+    out: list[str] = []
+    for sec in _SLOTS_RE.finditer(code):
+        for m in _SLOT_DECL_RE.finditer(sec.group(1)):
+            name = m.group(1)
+            if name in _FIXTURES or name.endswith("_data") or name in out:
+                continue
+            out.append(name)
+    return out
+
+
+def instrument_source(code: str) -> str:
+    """Open every test function body with the quarantine guard and include its header."""
+    if "QTEST_MAIN" not in code and "QT_TEST_AI_TEST_MAIN" not in code:
+        return code
+    slots = test_slots(code)
+    if not slots:
+        return code
+    pat = re.compile(r"\bvoid\s+(?:\w+::)?(" + "|".join(map(re.escape, slots)) + r")\s*\(\s*\)\s*(?:const\s*)?\{")
+    parts: list[str] = []
+    last = 0
+    for m in pat.finditer(code):
+        parts.append(code[last:m.end()])
+        last = m.end()
+        if not code[last:last + 200].lstrip().startswith(GUARD_CALL):
+            parts.append(f"\n    {GUARD_CALL}")
+    parts.append(code[last:])
+    new = "".join(parts)
+    if f'#include "{GUARD_HEADER}"' not in new:
+        inc = f'#include "{GUARD_HEADER}"'
+        m = re.search(r"^[ \t]*#include\s*<QtTest>.*$", new, flags=re.M)
+        new = (new[: m.end()] + "\n" + inc + new[m.end():]) if m else (inc + "\n" + new)
+    return new
+
+
+def instrument_file(test_file: Path) -> bool:
+    """Instrument a generated test file in place and drop the guard header next to it; True when the guard is in."""
+    try:
+        code = Path(test_file).read_text(encoding="utf-8", errors="replace")
+        new = instrument_source(code)
+        write_header(Path(test_file).parent)
+        if new != code:
+            Path(test_file).write_text(new, encoding="utf-8")
+        return GUARD_CALL in new
+    except Exception:
+        return False
+
+
+def is_instrumented(test_file: Path) -> bool:
+    try:
+        return GUARD_CALL in Path(test_file).read_text(encoding="utf-8", errors="replace")
+    except Exception:
+        return False
+
+
+# ----------------------------
+# skip list
+# ----------------------------
+def load(tests_dir: Path) -> dict[str, dict[str, Any]]:
+    """{function: {reason, runs, failed_runs, body_hash, at}}"""
+    try:
+        return json.loads((Path(tests_dir) / STATE_FILE).read_text(encoding="utf-8")).get("functions") or {}
+    except Exception:
+        return {}
+
+
+def save(tests_dir: Path, entries: dict[str, dict[str, Any]]) -> None:
+    """Write the state file and the plain list the guard reads."""
+    d = Path(tests_dir)
+    d.mkdir(parents=True, exist_ok=True)
+    (d / STATE_FILE).write_text(json.dumps({"functions": entries}, ensure_ascii=False, indent=2), encoding="utf-8")
+    lines = ["# Generated by Smart Testing Tools: quarantined test functions (QSKIP at runtime)", *sorted(entries)]
+    list_path(d).write_text("\n".join(lines) + "\n", encoding="utf-8")
+
+
+def env(tests_dir: Path) -> dict[str, str]:
+    """Point the guard at this tests directory's list, whatever the test command's working directory is."""
+    return {"QT_TEST_AI_QUARANTINE_FILE": str(list_path(tests_dir)).replace("\\", "/")}
+
+
+def add(tests_dir: Path, results: dict[str, dict[str, Any]]) -> dict[str, dict[str, Any]]:
+    """Quarantine the functions in `results` ({function: {reason, runs, failed_runs}}); returns the whole list."""
+    entries = load(tests_dir)
+    hashes = test_function_hashes(tests_dir)
+    now = datetime.now().isoformat(timespec="seconds")
+    for name, info in results.items():
+        entries[name] = {**info, "body_hash": hashes.get(name), "at": now}
+    save(tests_dir, entries)
+    return entries
+
+
+def release_changed(tests_dir: Path) -> list[str]:
+    """
+    Drop entries whose function body changed or disappeared since it was quarantined.
+
+    A regenerated test gets a fresh chance instead of staying skipped under a reused name.
+    """
+    entries = load(tests_dir)
+    if not entries:
+        return []
+    hashes = test_function_hashes(tests_dir)
+    released = [n for n, e in entries.items() if hashes.get(n) is None or (e.get("body_hash") and hashes[n] != e["body_hash"])]
+    if released:
+        for n in released:
+            entries.pop(n, None)
+        save(tests_dir, entries)
+    return released
+
+
+# ----------------------------
+# triage
+# ----------------------------
+_FAIL_RE = re.compile(r"(?:FAIL!|QFAIL)\s*:\s*\w+::(\w+)\(\)")
+_PASS_RE = re.compile(r"PASS\s*:\s*\w+::(\w+)\(\)")
+
+
+def _failed_in(meta: dict[str, Any], names: set[str]) -> set[str]:
+    res = meta.get("test_results") or {}
+    if res:
+        failed = names & set(res.get("failed") or [])
+        if meta.get("returncode") not in (0, None):
+            # 进程中途崩溃时后面的函数根本没跑到，不能算通过
+            failed |= names - {f.get("name") for f in res.get("functions") or []}
+        return failed
+    out = (meta.get("stdout") or "") + "\n" + (meta.get("stderr") or "")
+    failed = names & set(_FAIL_RE.findall(out))
+    if not failed and meta.get("returncode") not in (0, None):
+        # 没有逐函数结果又非零退出（多半是崩溃）：没打出 PASS 的都算失败
+        failed = names - set(_PASS_RE.findall(out))
+    return failed
+
+
+def triage(failing: set[str], run: Callable[[list[str]], dict[str, Any]], runs: int | None = None) -> dict[str, Any]:
+    """
+    Re-run only `failing` by name against the existing binary, `runs` times.
+
+    `run(names)` executes the test command for those functions and returns its
+    meta. Functions that fail on every re-run are deterministic, the rest flaky.
+    """
+    runs = runs or rerun_count()
+    names = set(failing)
+    fail_counts = {n: 0 for n in names}
+    durations: list[float] = []
+    for _ in range(runs):
+        m = run(sorted(names))
+        durations.append(float(m.get("duration_s") or 0.0))
+        for n in _failed_in(m, names):
+            fail_counts[n] += 1
+    deterministic = sorted(n for n, c in fail_counts.items() if c == runs)
+    flaky = sorted(n for n, c in fail_counts.items() if c < runs)
+    return {"runs": runs, "fail_counts": fail_counts, "deterministic": deterministic, "flaky": flaky, "duration_s": round(sum(durations), 3)}
+
+
+def describe(entries: dict[str, dict[str, Any]]) -> str:
+    return "\n".join(f"{n}: {e.get('reason')}（重跑 {e.get('runs')} 次失败 {e.get('failed_runs')} 次）" for n, e in sorted(entries.items()))
@@ -5,43 +5,61 @@ import json
 from dataclasses import asdict
 from datetime import datetime
 from pathlib import Path
+from typing import Iterable
 
-from .models import TestRun
+from .models import Finding, TestRun
 
 
-def write_json(run: TestRun, out_path: Path) -> None:
-    payload = {
-        "created_at": run.created_at.isoformat(timespec="seconds"),
-        "project_root": run.project_root,
-        "exe_path": run.exe_path,
-        "meta": run.meta,
-        "findings": [asdict(f) for f in run.findings],
-        "summary": run.summary_counts(),
-    }
-    out_path.parent.mkdir(parents=True, exist_ok=True)
-    out_path.write_text(json.dumps(payload, ensure_ascii=False, indent=2), encoding="utf-8")
-
+def write_json(run: TestRun, out_path: Path, findings: Iterable[Finding] | None = None) -> None:
+    """
+    Stream the run to `out_path`, one finding at a time.
 
-def write_html(run: TestRun, out_path: Path) -> None:
+    `findings` overrides run.findings, e.g. db.iter_findings() for a run loaded
+    from history without details, so the full details never sit in memory together.
+    """
+    out_path.parent.mkdir(parents=True, exist_ok=True)
+    with out_path.open("w", encoding="utf-8") as fh:
+        fh.write("{\n")
+        for key, value in (
+            ("created_at", run.created_at.isoformat(timespec="seconds")),
+            ("project_root", run.project_root),
+            ("exe_path", run.exe_path),
+            ("meta", run.meta),
+        ):
+            fh.write(f"  {json.dumps(key)}: ")
+            # json.dump 内部用 iterencode 分块写入，大 meta 也不会先拼成整串
+            json.dump(value, fh, ensure_ascii=False, indent=2)
+            fh.write(",\n")
+        fh.write('  "findings": [')
+        for i, f in enumerate(run.findings if findings is None else findings):
+            fh.write(",\n    " if i else "\n    ")
+            json.dump(asdict(f), fh, ensure_ascii=False)
+        fh.write("\n  ],\n")
+        fh.write(f'  "summary": {json.dumps(run.summary_counts())}\n}}\n')
+
+
+def _finding_row(f: Finding) -> str:
+    return (
+        "<tr>"
+        f"<td>{html.escape(f.category)}</td>"
+        f"<td>{html.escape(f.severity)}</td>"
+        f"<td>{html.escape(f.title)}</td>"
+        f"<td>{html.escape(f.file or '')}</td>"
+        f"<td>{html.escape(str(f.line) if f.line else '')}</td>"
+        f"<td><pre style='white-space:pre-wrap;margin:0'>{html.escape(f.details)}</pre></td>"
+        "</tr>\n"
+    )
+
+
+def write_html(run: TestRun, out_path: Path, findings: Iterable[Finding] | None = None) -> None:
+    """Stream the HTML report; the findings table is written row by row (see write_json for `findings`)."""
     out_path.parent.mkdir(parents=True, exist_ok=True)
     s = run.summary_counts()
     functional_cases = (run.meta or {}).get("functional_cases") or []
     testgen = (run.meta or {}).get("testgen") or {}
     tests = (run.meta or {}).get("tests") or {}
     coverage = (run.meta or {}).get("coverage") or {}
-    rows = []
-    for f in run.findings:
-        rows.append(
-            "<tr>"
-            f"<td>{html.escape(f.category)}</td>"
-            f"<td>{html.escape(f.severity)}</td>"
-            f"<td>{html.escape(f.title)}</td>"
-            f"<td>{html.escape(f.file or '')}</td>"
-            f"<td>{html.escape(str(f.line) if f.line else '')}</td>"
-            f"<td><pre style='white-space:pre-wrap;margin:0'>{html.escape(f.details)}</pre></td>"
-            "</tr>"
-        )
-
+    trace = (run.meta or {}).get("trace") or {}
     def _kv_row(k: str, v: str) -> str:
         return (
             "<tr>"
@@ -74,6 +92,30 @@ def write_html(run: TestRun, out_path: Path) -> None:
         if coverage.get("summary"):
             automation_rows.append(_kv_row("覆盖率摘要", str(coverage.get("summary") or "")))
 
+    trace_rows: list[str] = []
+    for name, st in (trace.get("stages") or {}).items():
+        cats = "\n".join(
+            f"{cat}: {c.get('count', 0)} 次，共 {c.get('total_s', 0)}s，最长 {c.get('max_s', 0)}s" + (f"，失败 {c['errors']}" if c.get("errors") else "")
+            for cat, c in sorted((st.get("by_category") or {}).items(), key=lambda kv: -float(kv[1].get("total_s") or 0))
+        )
+        trace_rows.append(
+            "<tr>"
+            f"<td>{html.escape(str(name))}</td>"
+            f"<td>{html.escape(str(st.get('wall_s', '')))}</td>"
+            f"<td><pre style='white-space:pre-wrap;margin:0'>{html.escape(cats)}</pre></td>"
+            "</tr>"
+        )
+    trace_notes: list[str] = []
+    llm_trace = trace.get("llm") or {}
+    if llm_trace.get("calls"):
+        trace_notes.append(
+            f"LLM 调用 {llm_trace['calls']} 次，prompt {llm_trace.get('prompt_tokens', 0)} / completion {llm_trace.get('completion_tokens', 0)} tokens，累计 {llm_trace.get('latency_s', 0)}s"
+        )
+    if trace.get("slowest"):
+        trace_notes.append("最慢的 span：\n" + "\n".join(f"  {x.get('duration_s')}s [{x.get('cat')}] {x.get('stage') or ''} {x.get('name')}" for x in trace["slowest"]))
+    if (trace.get("export") or {}).get("chrome"):
+        trace_notes.append(f"chrome trace（chrome://tracing / Perfetto 打开）：{trace['export']['chrome']}")
+
     functional_rows = []
     for c in functional_cases:
         steps = "\n".join([str(x) for x in (c.get("steps") or []) if str(x)])
@@ -99,7 +141,7 @@ def write_html(run: TestRun, out_path: Path) -> None:
     if isinstance(llm_meta, dict) and llm_meta.get("summary"):
         llm_summary = str(llm_meta.get("summary") or "")
 
-    doc = f"""<!doctype html>
+    head = f"""<!doctype html>
 <html lang="zh-cn">
 <head>
 <meta charset="utf-8" />
@@ -134,6 +176,17 @@ th {{ background: #f6f6f6; text-align:left; }}
   </tbody>
 </table>
 
+<h2>耗时追踪（trace）</h2>
+<table>
+  <thead>
+    <tr><th>阶段</th><th>墙钟时间 (s)</th><th>分类耗时</th></tr>
+  </thead>
+  <tbody>
+    {"".join(trace_rows) if trace_rows else "<tr><td colspan='3' style='color:#666'>未启用或无数据</td></tr>"}
+  </tbody>
+</table>
+{f'<pre style="white-space:pre-wrap">{html.escape(chr(10).join(trace_notes))}</pre>' if trace_notes else ""}
+
 <h2>功能度测试用例</h2>
 <table>
   <thead>
@@ -150,8 +203,8 @@ th {{ background: #f6f6f6; text-align:left; }}
     <tr><th>类别</th><th>级别</th><th>标题</th><th>文件</th><th>行</th><th>详情</th></tr>
   </thead>
   <tbody>
-    {"".join(rows)}
-  </tbody>
+"""
+    tail = f"""  </tbody>
 </table>
 
 <h2>LLM 总结（可选）</h2>
@@ -164,4 +217,8 @@ th {{ background: #f6f6f6; text-align:left; }}
 </body>
 </html>"""
 
-    out_path.write_text(doc, encoding="utf-8")
+    with out_path.open("w", encoding="utf-8") as fh:
+        fh.write(head)
+        for f in run.findings if findings is None else findings:
+            fh.write(_finding_row(f))
+        fh.write(tail)
@@ -0,0 +1,247 @@
+from __future__ import annotations
+
+import mmap
+import os
+import re
+from concurrent.futures import Executor, ProcessPoolExecutor, ThreadPoolExecutor
+from dataclasses import dataclass
+from functools import lru_cache
+from pathlib import Path
+from typing import Literal
+
+from .models import Finding
+
+
+Severity = Literal["info", "warning", "error"]
+
+
+@dataclass(frozen=True)
+class Rule:
+    """
+    A lightweight text rule for the custom static checks.
+
+    pattern  : regex source, matched against raw file bytes (keep it ASCII)
+    flags    : re flags for this rule only (re.M, re.I, re.S)
+    title    : format string; {0} is the whole match, {1}.. are the rule's groups
+    details  : fixed details text; None means "the stripped matched text"
+    first_only: report at most one finding per file (like re.search)
+    """
+
+    rule_id: str
+    pattern: str
+    severity: Severity
+    title: str
+    details: str | None = None
+    flags: int = 0
+    first_only: bool = False
+
+
+_RULES: list[Rule] = [
+    Rule(
+        rule_id="todo-fixme",
+        pattern=r"\b(TODO|FIXME)\b(.{0,80})",
+        severity="info",
+        title="发现 {1}",
+    ),
+    Rule(
+        rule_id="using-namespace-std",
+        pattern=r"^\s*using\s+namespace\s+std\s*;",
+        severity="warning",
+        title="不建议在头/源文件中使用 using namespace std;",
+        details="建议使用 std:: 前缀，或在更小作用域内 using。",
+        flags=re.M,
+        first_only=True,
+    ),
+]
+
+
+def register_rule(rule: Rule) -> None:
+    """Add a project-specific rule; it joins the same single scan pass."""
+    _RULES[:] = [r for r in _RULES if r.rule_id != rule.rule_id] + [rule]
+    _compile.cache_clear()
+
+
+def registered_rules() -> tuple[Rule, ...]:
+    return tuple(_RULES)
+
+
+def _inline_flags(flags: int) -> str:
+    s = ""
+    if flags & re.I:
+        s += "i"
+    if flags & re.M:
+        s += "m"
+    if flags & re.S:
+        s += "s"
+    return s
+
+
+@lru_cache(maxsize=8)
+def _compile(rules: tuple[Rule, ...]) -> tuple[re.Pattern[bytes], tuple[re.Pattern[bytes], ...], tuple[int, ...]]:
+    """
+    Build one alternation of zero-width lookaheads, one branch per rule.
+
+    Lookaheads let a match of one rule not consume text another rule needs;
+    per-rule non-overlap is restored in _scan_buffer via last-end tracking.
+    """
+    singles = tuple(re.compile(r.pattern.encode("ascii"), r.flags) for r in rules)
+    branches: list[str] = []
+    for i, r in enumerate(rules):
+        fl = _inline_flags(r.flags)
+        body = f"(?{fl}:{r.pattern})" if fl else f"(?:{r.pattern})"
+        branches.append(f"(?=(?P<r{i}>{body}))")
+    combined = re.compile("|".join(branches).encode("ascii"))
+    # 每条规则的第 0 组在组合正则中的编号，自身的捕获组紧随其后
+    offsets = tuple(combined.groupindex[f"r{i}"] for i in range(len(rules)))
+    return combined, singles, offsets
+
+
+def _decode(b: bytes) -> str:
+    # 按字节截取的片段可能切断末尾的多字节 UTF-8 字符
+    for cut in range(0, 4):
+        try:
+            return b[: len(b) - cut].decode("utf-8")
+        except UnicodeDecodeError:
+            continue
+    for enc in ("gbk", "cp1252"):
+        try:
+            return b.decode(enc)
+        except UnicodeDecodeError:
+            continue
+    return b.decode("utf-8", errors="replace")
+
+
+def _make_finding(rule: Rule, groups: list[bytes | None], path: Path, line: int) -> Finding:
+    texts = [_decode(g) if g is not None else "" for g in groups]
+    try:
+        title = rule.title.format(*texts)
+    except Exception:
+        title = rule.title
+    return Finding(
+        category="static",
+        severity=rule.severity,
+        title=title,
+        details=rule.details if rule.details is not None else texts[0].strip(),
+        file=str(path),
+        line=line,
+        rule_id=rule.rule_id,
+    )
+
+
+def _scan_buffer(buf, end: int, path: Path, rules: tuple[Rule, ...]) -> list[Finding]:
+    combined, singles, offsets = _compile(rules)
+    hits: list[tuple[int, int, Finding]] = []
+    last_end = [-1] * len(rules)
+    done = [False] * len(rules)
+    line = 1
+    line_pos = 0
+
+    def _line_at(pos: int) -> int:
+        # 命中位置单调递增，只需统计上次位置之后的换行
+        nonlocal line, line_pos
+        if pos > line_pos:
+            line += buf[line_pos:pos].count(b"\n")
+            line_pos = pos
+        return line
+
+    for m in combined.finditer(buf, 0, end):
+        pos = m.start()
+        first = next(i for i, off in enumerate(offsets) if m.start(off) != -1)
+        # 同一位置可能有多条规则命中：按规则顺序逐一检查（仅在已命中的位置发生）
+        for i in range(first, len(rules)):
+            if done[i] or pos < last_end[i]:
+                continue
+            if i == first:
+                ngroups = singles[i].groups
+                off = offsets[i]
+                span_end = m.end(off)
+                groups = [m.group(off + g) for g in range(ngroups + 1)]
+            else:
+                mm = singles[i].match(buf, pos, end)
+                if not mm:
+                    continue
+                span_end = mm.end()
+                groups = [mm.group(g) for g in range(singles[i].groups + 1)]
+            last_end[i] = span_end if span_end > pos else pos + 1
+            if rules[i].first_only:
+                done[i] = True
+            hits.append((pos, i, _make_finding(rules[i], groups, path, _line_at(pos))))
+        if all(done):
+            break
+
+    hits.sort(key=lambda h: (h[1], h[0]))
+    return [h[2] for h in hits]
+
+
+def scan_file(path: Path, rules: tuple[Rule, ...] | None = None, max_bytes: int = 2_000_000) -> list[Finding]:
+    """
+    Scan one file once for all rules, memory-mapping it instead of decoding it.
+
+    Only the first `max_bytes` are scanned; a longer file gets an info finding
+    saying so, rather than silently passing the rules beyond that point.
+    """
+    rules = rules if rules is not None else registered_rules()
+    if not rules:
+        return []
+    try:
+        with open(path, "rb") as fh:
+            size = os.fstat(fh.fileno()).st_size
+            if size == 0:
+                return []
+            with mmap.mmap(fh.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+                found = _scan_buffer(mm, min(size, max_bytes), path, rules)
+    except (OSError, ValueError):
+        return []
+    if size > max_bytes:
+        found.append(
+            Finding(
+                category="static",
+                severity="info",
+                title="文件过大，自定义规则只扫描了开头部分",
+                details=f"文件 {size} 字节，仅扫描前 {max_bytes} 字节；之后的内容未做自定义规则检查",
+                file=str(path),
+                rule_id="rules-truncated",
+            )
+        )
+    return found
+
+
+def _scan_file_task(args: tuple[Path, tuple[Rule, ...]]) -> list[Finding]:
+    return scan_file(args[0], args[1])
+
+
+def _rule_workers() -> int:
+    try:
+        n = int((os.getenv("QT_TEST_AI_RULE_WORKERS") or "").strip() or 0)
+    except Exception:
+        n = 0
+    return n if n > 0 else min(8, os.cpu_count() or 1)
+
+
+def scan_files(paths: list[Path], rules: tuple[Rule, ...] | None = None) -> list[Finding]:
+    """
+    Run all rules over all files, fanning out across a worker pool.
+
+    Results keep the input file order. Threads are the default (safe inside
+    the GUI; overlaps file I/O); QT_TEST_AI_RULE_POOL=process uses processes
+    for CPU-bound scans of large trees.
+    """
+    rules = rules if rules is not None else registered_rules()
+    if not paths or not rules:
+        return []
+    workers = _rule_workers()
+    if workers <= 1 or len(paths) < 8:
+        return [f for p in paths for f in scan_file(p, rules)]
+
+    kind = (os.getenv("QT_TEST_AI_RULE_POOL") or "thread").strip().lower()
+    pool: Executor
+    if kind == "process":
+        pool = ProcessPoolExecutor(max_workers=workers)
+    else:
+        pool = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="rule-scan")
+    try:
+        with pool:
+            chunks = pool.map(_scan_file_task, [(p, rules) for p in paths], chunksize=max(1, len(paths) // (workers * 4)))
+            return [f for per_file in chunks for f in per_file]
+    except Exception:
+        return [f for p in paths for f in scan_file(p, rules)]
@@ -0,0 +1,153 @@
+from __future__ import annotations
+
+import os
+import time
+import traceback
+from concurrent.futures import FIRST_COMPLETED, Future, ThreadPoolExecutor, wait
+from dataclasses import dataclass, field
+from typing import Any, Callable
+
+from . import tracing
+from .models import Finding
+
+
+# 阶段函数签名：接收已完成依赖阶段的结果，返回 (findings, meta_updates)
+StageFn = Callable[[dict[str, "StageResult"]], tuple[list[Finding], dict]]
+
+
+@dataclass(frozen=True)
+class Stage:
+    name: str
+    fn: StageFn
+    deps: tuple[str, ...] = ()
+    # 独占：等其他阶段都结束后单独运行，期间不启动别的阶段（计时 / 采样类阶段不能和 CPU 密集阶段重叠）
+    exclusive: bool = False
+
+
+@dataclass
+class StageResult:
+    name: str
+    findings: list[Finding] = field(default_factory=list)
+    meta: dict = field(default_factory=dict)
+    duration_s: float = 0.0
+    status: str = "ok"  # ok | error | skipped
+    error: str | None = None
+
+
+def stage_workers_from_env(default: int = 4) -> int:
+    """Pool size for independent stages (QT_TEST_AI_STAGE_WORKERS, 1 = sequential)."""
+    try:
+        n = int((os.getenv("QT_TEST_AI_STAGE_WORKERS") or "").strip() or default)
+    except Exception:
+        n = default
+    return max(1, n)
+
+
+def run_stages(
+    stages: list[Stage],
+    *,
+    max_workers: int | None = None,
+    on_start: Callable[[Stage], None] | None = None,
+    on_done: Callable[[StageResult], None] | None = None,
+) -> dict[str, StageResult]:
+    """Run stages as a small dependency graph on a bounded thread pool.
+
+    A stage is submitted as soon as all of its deps finished successfully; if a
+    dependency failed or was skipped, the stage is reported as skipped. Ready
+    stages are submitted in declaration order, so max_workers=1 reproduces the
+    old sequential pipeline exactly. Callbacks run on the scheduler thread.
+
+    An exclusive stage is a barrier in declaration order: once it is ready,
+    later stages wait; it starts when nothing else is running and nothing
+    starts beside it. Its deps keep their usual skip-on-failure meaning.
+    """
+    by_name = {s.name: s for s in stages}
+    for s in stages:
+        for d in s.deps:
+            if d not in by_name:
+                raise ValueError(f"stage {s.name!r} depends on unknown stage {d!r}")
+
+    workers = max(1, int(max_workers or stage_workers_from_env()))
+    results: dict[str, StageResult] = {}
+    pending = list(stages)
+    running: dict[Future, tuple[Stage, float]] = {}
+
+    def _call(stage: Stage, dep_results: dict[str, StageResult]) -> tuple[list[Finding], dict]:
+        with tracing.span(stage.name, tracing.STAGE):
+            out = stage.fn(dep_results)
+        if out is None:
+            return [], {}
+        f, m = out
+        return list(f or []), dict(m or {})
+
+    def _finish(res: StageResult) -> None:
+        results[res.name] = res
+        if on_done:
+            try:
+                on_done(res)
+            except Exception:
+                pass
+
+    with ThreadPoolExecutor(max_workers=workers, thread_name_prefix="qt-test-ai-stage") as pool:
+        while pending or running:
+            # 依赖失败的阶段直接标记为跳过
+            progressed = True
+            while progressed:
+                progressed = False
+                for s in list(pending):
+                    bad = [d for d in s.deps if d in results and results[d].status != "ok"]
+                    if bad:
+                        pending.remove(s)
+                        _finish(StageResult(name=s.name, status="skipped", error=f"依赖阶段未成功: {', '.join(bad)}"))
+                        progressed = True
+
+            for s in list(pending):
+                if len(running) >= workers or any(r.exclusive for r, _ in running.values()):
+                    break
+                if all(d in results for d in s.deps):
+                    if s.exclusive and running:
+                        break
+                    pending.remove(s)
+                    if on_start:
+                        try:
+                            on_start(s)
+                        except Exception:
+                            pass
+                    deps = {d: results[d] for d in s.deps}
+                    # 阶段线程继承调用方的 trace 上下文，阶段里的 span 归到本次运行
+                    running[pool.submit(tracing.propagate(_call), s, deps)] = (s, time.perf_counter())
+                    if s.exclusive:
+                        break
+
+            if not running:
+                if pending:
+                    # 循环依赖：无法再调度
+                    for s in pending:
+                        _finish(StageResult(name=s.name, status="skipped", error="无法满足的阶段依赖"))
+                    pending.clear()
+                break
+
+            done, _ = wait(list(running), return_when=FIRST_COMPLETED)
+            for fut in done:
+                s, t0 = running.pop(fut)
+                dt = time.perf_counter() - t0
+                try:
+                    f, m = fut.result()
+                    res = StageResult(name=s.name, findings=f, meta=m, duration_s=dt)
+                except Exception as e:
+                    res = StageResult(
+                        name=s.name,
+                        duration_s=dt,
+                        status="error",
+                        error=f"{e}\n\nTraceback:\n{''.join(traceback.format_exception(e))}",
+                    )
+                _finish(res)
+
+    return results
+
+
+def stage_timings(results: dict[str, StageResult]) -> dict[str, Any]:
+    return {
+        name: {"status": r.status, "duration_s": round(r.duration_s, 3), **({"error": r.error.splitlines()[0]} if r.error else {})}
+        for name, r in results.items()
+    }
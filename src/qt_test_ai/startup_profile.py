@@ -0,0 +1,495 @@
+from __future__ import annotations
+
+import json
+import math
+import os
+import re
+import subprocess
+import sys
+import threading
+import time
+from datetime import datetime
+from pathlib import Path
+from typing import IO, Any
+
+from .models import Finding
+
+MARK_PREFIX = "QT_TEST_AI_MARK"
+MARKER_HEADER = "qt_test_ai_startup_marker.h"
+BASELINE_FILE = "startup_baseline.json"
+# 里程碑按先后顺序；"ready" 取能拿到的最晚一个
+MILESTONES = ("app", "shown", "painted", "interactive")
+# 与基线比较的指标：(meta 中的路径, 显示名)。CPU 占用随机器负载波动太大，只报告不把关
+COMPARED = (
+    ("startup.ready_ms", "启动到可交互"),
+    ("rss_mb.p95", "内存 p95"),
+    ("rss_mb.peak", "内存峰值"),
+    ("handles.peak", "句柄峰值"),
+)
+# 基线取最近几次正常运行的中位数；攒够 BASELINE_MIN_RUNS 次才开始比较
+BASELINE_RUNS = 5
+BASELINE_MIN_RUNS = 3
+
+_MARK_RE = re.compile(rf"^{MARK_PREFIX}\s+(\w+)(?:\s+(\d+))?")
+_ON = {"1", "true", "yes", "y", "on"}
+
+
+def enabled() -> bool:
+    """Full startup / resource profiling in run_smoke_test (QT_TEST_AI_STARTUP_PROFILE)."""
+    return (os.getenv("QT_TEST_AI_STARTUP_PROFILE") or "").strip().lower() in _ON
+
+
+def marker_enabled() -> bool:
+    """Force-include the startup marker header into the project's coverage build (QT_TEST_AI_STARTUP_MARKER)."""
+    return (os.getenv("QT_TEST_AI_STARTUP_MARKER") or "").strip().lower() in _ON
+
+
+def _float_env(name: str, default: float) -> float:
+    try:
+        return float((os.getenv(name) or "").strip() or default)
+    except Exception:
+        return default
+
+
+def interval_s() -> float:
+    """Sampling period (QT_TEST_AI_PROFILE_INTERVAL_MS, default 50 ms, floor 5 ms)."""
+    return max(5.0, _float_env("QT_TEST_AI_PROFILE_INTERVAL_MS", 50.0)) / 1000.0
+
+
+def regression_pct() -> float:
+    """Allowed growth over the baseline median before a regression is reported (QT_TEST_AI_STARTUP_REGRESSION_PCT, default 20)."""
+    return max(0.0, _float_env("QT_TEST_AI_STARTUP_REGRESSION_PCT", 20.0))
+
+
+def baseline_path() -> Path:
+    raw = (os.getenv("QT_TEST_AI_STARTUP_BASELINE") or "").strip()
+    if raw:
+        return Path(raw)
+    return Path(__file__).resolve().parents[2] / "reports" / "dynamic" / BASELINE_FILE
+
+
+# ----------------------------
+# marker header
+# ----------------------------
+_MARKER_TEXT = r"""// Generated by Smart Testing Tools (QT_TEST_AI_STARTUP_MARKER=1). Do not edit.
+//
+// Force-included (-include) into every C++ translation unit of the coverage
+// build. When QCoreApplication is constructed it installs an application-wide
+// event filter that prints one stderr line per startup milestone:
+//   QT_TEST_AI_MARK app <ms>          QApplication constructed
+//   QT_TEST_AI_MARK shown <ms>        first QMainWindow shown (else first window exposed)
+//   QT_TEST_AI_MARK painted <ms>      first paint after that
+//   QT_TEST_AI_MARK interactive <ms>  event loop idle after the first paint
+// <ms> counts from static initialisation. The filter removes itself once
+// "interactive" is printed, so the application runs unobserved afterwards.
+#pragma once
+#if defined(__cplusplus)
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QTimer>
+#include <cstdio>
+
+namespace qt_test_ai_marker {
+
+inline QElapsedTimer &clock()
+{
+    static QElapsedTimer t;
+    if (!t.isValid())
+        t.start();
+    return t;
+}
+
+inline void mark(const char *name)
+{
+    std::fprintf(stderr, "QT_TEST_AI_MARK %s %lld\n", name, static_cast<long long>(clock().elapsed()));
+    std::fflush(stderr);
+}
+
+class Filter : public QObject
+{
+public:
+    using QObject::QObject;
+
+    bool eventFilter(QObject *obj, QEvent *e) override
+    {
+        const QEvent::Type t = e->type();
+        if (stage == 0 && ((t == QEvent::Show && obj->inherits("QMainWindow")) || (t == QEvent::Expose && obj->inherits("QWindow")))) {
+            stage = 1;
+            mark("shown");
+        } else if (stage == 1 && (t == QEvent::Paint || t == QEvent::UpdateRequest)) {
+            stage = 2;
+            mark("painted");
+            QTimer::singleShot(0, this, [this] {
+                mark("interactive");
+                QCoreApplication::instance()->removeEventFilter(this);
+                deleteLater();
+            });
+        }
+        return QObject::eventFilter(obj, e);
+    }
+
+private:
+    int stage = 0;
+};
+
+inline void install()
+{
+    static bool done = false;
+    if (done || !QCoreApplication::instance())
+        return;
+    done = true;
+    mark("app");
+    QCoreApplication::instance()->installEventFilter(new Filter(QCoreApplication::instance()));
+}
+
+// inline 变量在所有翻译单元中只初始化一次
+inline const bool registered = (clock(), qAddPreRoutine(&install), true);
+
+} // namespace qt_test_ai_marker
+#endif
+"""
+
+
+def marker_text() -> str:
+    return _MARKER_TEXT
+
+
+# ----------------------------
+# sampling
+# ----------------------------
+def percentile(values: list[float], pct: float) -> float | None:
+    """Nearest-rank percentile; None for no samples."""
+    if not values:
+        return None
+    s = sorted(values)
+    k = max(0, min(len(s) - 1, math.ceil(pct / 100.0 * len(s)) - 1))
+    return s[k]
+
+
+def summarize(values: list[float]) -> dict[str, Any]:
+    r = lambda v: round(v, 2) if v is not None else None  # noqa: E731
+    return {
+        "n": len(values),
+        "p50": r(percentile(values, 50)),
+        "p95": r(percentile(values, 95)),
+        "peak": r(max(values)) if values else None,
+    }
+
+
+def _handles(p: Any) -> int | None:
+    try:
+        return p.num_handles() if sys.platform == "win32" else p.num_fds()
+    except Exception:
+        return None
+
+
+class _Reader(threading.Thread):
+    """Drain one pipe, timestamp QT_TEST_AI_MARK lines relative to `t0`, keep the rest (capped)."""
+
+    def __init__(self, stream: IO[str], t0: float, marks: dict[str, float], lock: threading.Lock, limit: int = 200_000) -> None:
+        super().__init__(daemon=True)
+        self.stream, self.t0, self.marks, self.lock, self.limit = stream, t0, marks, lock, limit
+        self.chunks: list[str] = []
+        self.size = 0
+
+    def run(self) -> None:
+        try:
+            for line in self.stream:
+                now = time.perf_counter()
+                m = _MARK_RE.match(line.strip())
+                if m:
+                    with self.lock:
+                        self.marks.setdefault(m.group(1), round((now - self.t0) * 1000.0, 1))
+                    continue
+                if self.size < self.limit:
+                    self.chunks.append(line)
+                    self.size += len(line)
+        except Exception:
+            pass
+
+    def text(self) -> str:
+        return "".join(self.chunks)
+
+
+def _window_probe(pid: int):
+    """Windows only: callable returning True once the process owns a visible, non-empty top-level window."""
+    if sys.platform != "win32":
+        return None
+    try:
+        import ctypes
+        from ctypes import wintypes
+
+        user32 = ctypes.windll.user32
+        proc_t = ctypes.WINFUNCTYPE(wintypes.BOOL, wintypes.HWND, wintypes.LPARAM)
+    except Exception:
+        return None
+
+    def probe() -> bool:
+        found = []
+
+        def cb(hwnd, _lp):
+            owner = wintypes.DWORD()
+            user32.GetWindowThreadProcessId(hwnd, ctypes.byref(owner))
+            if owner.value == pid and user32.IsWindowVisible(hwnd):
+                rect = wintypes.RECT()
+                if user32.GetWindowRect(hwnd, ctypes.byref(rect)) and rect.right > rect.left and rect.bottom > rect.top:
+                    found.append(hwnd)
+                    return False
+            return True
+
+        try:
+            user32.EnumWindows(proc_t(cb), 0)
+        except Exception:
+            return False
+        return bool(found)
+
+    return probe
+
+
+def _wait_input_idle(proc: subprocess.Popen, t0: float, marks: dict[str, float], lock: threading.Lock, timeout_s: float) -> None:
+    # WaitForInputIdle 在 GUI 线程首次空等输入时返回：没有注入标记时作为“可交互”的近似
+    try:
+        import ctypes
+
+        handle = getattr(proc, "_handle", None)
+        if handle is None:
+            return
+        if ctypes.windll.user32.WaitForInputIdle(int(handle), int(timeout_s * 1000)) == 0:
+            with lock:
+                marks.setdefault("input_idle", round((time.perf_counter() - t0) * 1000.0, 1))
+    except Exception:
+        pass
+
+
+def profile_process(proc: subprocess.Popen, t0: float, duration_s: float, *, interval: float | None = None) -> dict[str, Any]:
+    """
+    Sample RSS / CPU / handles / threads of a running process every `interval`
+    seconds for `duration_s` (or until it exits) and capture startup milestones.
+
+    Milestones come from the injected marker (QT_TEST_AI_MARK lines on stderr)
+    when the binary has it, else on Windows from the first visible top-level
+    window and WaitForInputIdle. Pipes are drained concurrently, so the result
+    also carries "stdout" / "stderr".
+    """
+    interval = interval or interval_s()
+    marks: dict[str, float] = {}
+    lock = threading.Lock()
+    readers = [_Reader(s, t0, marks, lock) for s in (proc.stdout, proc.stderr) if s is not None]
+    for r in readers:
+        r.start()
+    if sys.platform == "win32":
+        threading.Thread(target=_wait_input_idle, args=(proc, t0, marks, lock, duration_s), daemon=True).start()
+    probe = _window_probe(proc.pid)
+
+    # psutil 只在真正采样时需要：coverage_build 也会导入本模块（取标记头）
+    import psutil
+
+    rss: list[float] = []
+    cpu: list[float] = []
+    handles: list[float] = []
+    threads: list[float] = []
+    alive_ms: float | None = None
+    try:
+        p = psutil.Process(proc.pid)
+        p.cpu_percent(interval=None)
+    except psutil.NoSuchProcess:
+        p = None
+
+    deadline = t0 + duration_s
+    next_at = time.perf_counter()
+    while time.perf_counter() < deadline and proc.poll() is None and p is not None:
+        now = time.perf_counter()
+        if alive_ms is None:
+            alive_ms = round((now - t0) * 1000.0, 1)
+        try:
+            with p.oneshot():
+                rss.append(p.memory_info().rss / 1024 / 1024)
+                cpu.append(p.cpu_percent(interval=None))
+                h = _handles(p)
+                if h is not None:
+                    handles.append(float(h))
+                threads.append(float(p.num_threads()))
+        except psutil.NoSuchProcess:
+            break
+        if probe is not None and "window_visible" not in marks and probe():
+            with lock:
+                marks.setdefault("window_visible", round((time.perf_counter() - t0) * 1000.0, 1))
+        next_at += interval
+        time.sleep(max(0.0, next_at - time.perf_counter()))
+
+    measured_s = round(time.perf_counter() - t0, 3)
+    exited = proc.poll() is not None
+    if not exited:
+        try:
+            proc.terminate()
+            proc.wait(timeout=3)
+        except Exception:
+            try:
+                proc.kill()
+            except Exception:
+                pass
+    for r in readers:
+        r.join(timeout=2)
+
+    with lock:
+        ms = dict(marks)
+    injected = [k for k in MILESTONES if k in ms]
+    # 可交互时刻：注入标记优先，其次 Windows 的 WaitForInputIdle / 首个可见窗口
+    ready_key = injected[-1] if injected else next((k for k in ("input_idle", "window_visible") if k in ms), None)
+    return {
+        "interval_ms": round(interval * 1000.0, 1),
+        "duration_s": measured_s,
+        "exited_early": exited,
+        "returncode": proc.poll(),
+        "startup": {
+            "alive_ms": alive_ms,
+            "milestones_ms": ms,
+            "source": "marker" if injected else ("window" if ready_key else "liveness"),
+            "ready": ready_key,
+            "ready_ms": ms.get(ready_key) if ready_key else None,
+        },
+        "rss_mb": summarize(rss),
+        "cpu_percent": summarize(cpu),
+        "handles": summarize(handles),
+        "threads": summarize(threads),
+        "samples": {"rss_mb": [round(v, 2) for v in rss], "cpu_percent": cpu},
+        "stdout": "".join(r.text() for r in readers[:1]),
+        "stderr": "".join(r.text() for r in readers[1:]),
+    }
+
+
+# ----------------------------
+# baseline
+# ----------------------------
+def _get(d: dict[str, Any], dotted: str) -> float | None:
+    cur: Any = d
+    for part in dotted.split("."):
+        if not isinstance(cur, dict):
+            return None
+        cur = cur.get(part)
+    return float(cur) if isinstance(cur, (int, float)) else None
+
+
+def _baseline_key(exe: Path) -> str:
+    # 按解析后的完整路径区分：不同项目里同名的 app.exe 不能共用一份基线
+    try:
+        path = Path(exe).resolve()
+    except OSError:
+        path = Path(exe).absolute()
+    return os.path.normcase(str(path))
+
+
+def _median(values: list[float]) -> float | None:
+    vals = sorted(values)
+    if not vals:
+        return None
+    mid = len(vals) // 2
+    return vals[mid] if len(vals) % 2 else (vals[mid - 1] + vals[mid]) / 2
+
+
+def load_baseline(exe: Path, path: Path | None = None) -> dict[str, Any] | None:
+    try:
+        data = json.loads(Path(path or baseline_path()).read_text(encoding="utf-8"))
+        return data.get(_baseline_key(exe))
+    except Exception:
+        return None
+
+
+def save_baseline(exe: Path, profile: dict[str, Any], path: Path | None = None, *, reset: bool = False) -> Path:
+    """Add this run to the rolling window (last BASELINE_RUNS runs); "metrics" is their per-metric median."""
+    path = Path(path or baseline_path())
+    try:
+        data = json.loads(path.read_text(encoding="utf-8"))
+    except Exception:
+        data = {}
+    key = _baseline_key(exe)
+    source = profile["startup"]["source"]
+    old = data.get(key) or {}
+    # 计时来源变了（标记 / 窗口探测 / 存活时间）旧样本不可比，从头攒
+    runs = [] if reset or old.get("source") != source else list(old.get("runs") or [])
+    runs = (runs + [{k: _get(profile, k) for k, _ in COMPARED}])[-BASELINE_RUNS:]
+    data[key] = {
+        "exe": str(exe),
+        "recorded_at": datetime.now().isoformat(timespec="seconds"),
+        "source": source,
+        "runs": runs,
+        "metrics": {k: _median([r[k] for r in runs if r.get(k) is not None]) for k, _ in COMPARED},
+    }
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(json.dumps(data, ensure_ascii=False, indent=2), encoding="utf-8")
+    return path
+
+
+def compare(profile: dict[str, Any], baseline: dict[str, Any], *, pct: float | None = None) -> list[dict[str, Any]]:
+    """Metrics that grew more than `pct` percent over the baseline median (startup only when both use the same source)."""
+    pct = regression_pct() if pct is None else pct
+    out: list[dict[str, Any]] = []
+    base = baseline.get("metrics") or {}
+    for key, label in COMPARED:
+        if key == "startup.ready_ms" and baseline.get("source") != profile["startup"]["source"]:
+            continue
+        old, new = base.get(key), _get(profile, key)
+        if old is None or new is None or old <= 0:
+            continue
+        growth = (new - old) / old * 100.0
+        if growth > pct:
+            out.append({"metric": key, "label": label, "baseline": old, "current": round(new, 2), "growth_pct": round(growth, 1)})
+    return out
+
+
+def findings_for(exe: Path, profile: dict[str, Any], *, update_baseline: bool = False) -> list[Finding]:
+    """Report percentiles, then check against (or record) the stored baseline."""
+    findings: list[Finding] = []
+    st = profile["startup"]
+    if st["ready_ms"] is not None:
+        steps = ", ".join(f"{k} {v:.0f}ms" for k, v in sorted(st["milestones_ms"].items(), key=lambda kv: kv[1]))
+        findings.append(Finding("dynamic", "info", f"启动到可交互 {st['ready_ms'] / 1000:.2f} 秒（{st['ready']}）", steps))
+    else:
+        findings.append(
+            Finding(
+                "dynamic",
+                "warning" if st["alive_ms"] is not None else "error",
+                "未测到窗口显示时刻",
+                "被测程序没有启动标记（QT_TEST_AI_STARTUP_MARKER=1 重新构建可注入），当前平台也无法探测窗口；只有进程存活时间",
+            )
+        )
+    fmt = lambda s, unit: f"p50 {s['p50']}{unit} / p95 {s['p95']}{unit} / 峰值 {s['peak']}{unit}" if s["n"] else "无样本"  # noqa: E731
+    findings.append(
+        Finding(
+            "dynamic",
+            "info",
+            f"资源采样 {profile['rss_mb']['n']} 次（每 {profile['interval_ms']:.0f}ms，共 {profile['duration_s']}s）",
+            f"内存 {fmt(profile['rss_mb'], 'MB')}\nCPU {fmt(profile['cpu_percent'], '%')}\n"
+            f"句柄 {fmt(profile['handles'], '')}\n线程 {fmt(profile['threads'], '')}",
+        )
+    )
+
+    usable = bool(profile["rss_mb"]["n"]) and not profile["exited_early"]
+    baseline = load_baseline(exe)
+    runs = len((baseline or {}).get("runs") or [])
+    if baseline is None or update_baseline or runs < BASELINE_MIN_RUNS or baseline.get("source") != profile["startup"]["source"]:
+        if usable:
+            path = save_baseline(exe, profile, reset=update_baseline)
+            n = len((load_baseline(exe) or {}).get("runs") or [])
+            findings.append(Finding("dynamic", "info", f"已记录启动性能基线（{n}/{BASELINE_MIN_RUNS} 次运行后开始比较）", str(path)))
+        return findings
+    profile["baseline"] = baseline
+    regressions = compare(profile, baseline)
+    profile["regressions"] = regressions
+    # 单次运行有噪声：回退只记为警告；没有回退的运行并入基线窗口
+    for r in regressions:
+        findings.append(
+            Finding(
+                "dynamic",
+                "warning",
+                f"启动性能回退: {r['label']} +{r['growth_pct']}%",
+                f"{r['metric']}: 基线中位数 {r['baseline']} → 本次 {r['current']}"
+                f"（阈值 {regression_pct():.0f}%，基线为最近 {runs} 次运行，更新于 {baseline.get('recorded_at')}）",
+            )
+        )
+    if not regressions:
+        if usable:
+            save_baseline(exe, profile)
+        findings.append(Finding("dynamic", "info", "启动性能未超出基线", f"基线为最近 {runs} 次运行的中位数，更新于 {baseline.get('recorded_at')}"))
+    return findings
@@ -3,10 +3,13 @@ from __future__ import annotations
 import os
 import re
 import subprocess
+import time
 from pathlib import Path
 from typing import Any
 
+from . import artifact_store, tracing
 from .models import Finding
+from .rules import scan_files
 from .utils import extract_pro_info, iter_files, read_text_best_effort, which
 
 
@@ -100,10 +103,12 @@ _CPPHECK_GCC_LINE = re.compile(
 def _parse_cppcheck_output_to_findings(out: str, project_root: Path, max_items: int = 200) -> tuple[list[Finding], dict]:
     """
     Parse --template=gcc output into structured findings.
+    Identical diagnostic lines are reported once.
     Returns (findings, stats).
     """
-    stats: dict[str, Any] = {"parsed": 0, "dropped": 0, "by_severity": {}}
+    stats: dict[str, Any] = {"parsed": 0, "dropped": 0, "duplicates": 0, "by_severity": {}}
     findings: list[Finding] = []
+    seen: set[str] = set()
 
     for raw in (out or "").splitlines():
         line = raw.strip()
@@ -112,6 +117,11 @@ def _parse_cppcheck_output_to_findings(out: str, project_root: Path, max_items:
         m = _CPPHECK_GCC_LINE.match(line)
         if not m:
             continue
+        # 按 TU 拆分运行时，同一头文件的问题会在多个 TU 的输出里重复出现
+        if line in seen:
+            stats["duplicates"] += 1
+            continue
+        seen.add(line)
 
         sev_raw = (m.group("sev") or "").lower()
         if sev_raw == "error":
@@ -166,6 +176,232 @@ def _is_under(path: Path, parent: Path) -> bool:
         return False
 
 
+# cppcheck 对目录递归时会分析的源文件后缀
+_CPPCHECK_SOURCE_PATTERNS = ("**/*.cpp", "**/*.cxx", "**/*.cc", "**/*.c++", "**/*.c")
+
+
+def _cppcheck_cache_enabled() -> bool:
+    v = (os.getenv("QT_TEST_AI_CPPCHECK_CACHE") or "1").strip().lower()
+    return v not in {"0", "false", "no", "off"}
+
+
+def _cppcheck_sources(project_root: Path, ignore_paths: list[Path]) -> list[Path]:
+    ignored = [ip.resolve() for ip in ignore_paths]
+    out: list[Path] = []
+    for p in iter_files(project_root, _CPPCHECK_SOURCE_PATTERNS):
+        rp = p.resolve()
+        if any(rp == ip or ip in rp.parents for ip in ignored):
+            continue
+        out.append(p)
+    return sorted(out, key=lambda x: str(x).lower())
+
+
+def _cppcheck_version(cppcheck: str, env: dict[str, str]) -> str:
+    try:
+        p = subprocess.run([cppcheck, "--version"], capture_output=True, text=True, timeout=20, env=env, errors="replace")
+        return (p.stdout or p.stderr or "").strip()
+    except Exception:
+        return ""
+
+
+def _run_cppcheck_one(base_cmd: list[str], tu: Path, env: dict[str, str], timeout_s: float = 300) -> dict[str, Any]:
+    t0 = time.perf_counter()
+    try:
+        proc = tracing.run(
+            base_cmd + [str(tu)],
+            trace_cat=tracing.CPPCHECK,
+            capture_output=True,
+            text=True,
+            timeout=timeout_s,
+            env=env,
+            errors="replace",
+        )
+        out = ((proc.stderr or "") + "\n" + (proc.stdout or "")).strip()
+        return {"tu": tu, "output": out, "returncode": proc.returncode, "timed_out": False, "cost_s": time.perf_counter() - t0}
+    except subprocess.TimeoutExpired as e:
+        out = e.stderr if isinstance(e.stderr, str) else ""
+        return {"tu": tu, "output": out or "", "returncode": 124, "timed_out": True, "cost_s": time.perf_counter() - t0}
+
+
+def _cppcheck_jobs() -> int:
+    try:
+        n = int((os.getenv("QT_TEST_AI_CPPCHECK_JOBS") or "").strip() or 0)
+    except Exception:
+        n = 0
+    if n <= 0:
+        n = os.cpu_count() or 1
+    return max(1, n)
+
+
+def _estimate_cost(tu: Path, cost_of) -> float:
+    c = cost_of(tu)
+    if c is not None:
+        return max(c, 0.001)
+    # 没有历史耗时：按文件大小粗估（约 1s / 20KB）
+    try:
+        return max(tu.stat().st_size / 20_000.0, 0.05)
+    except Exception:
+        return 1.0
+
+
+def _plan_shards(tus: list[Path], cost_of, jobs: int) -> list[list[Path]]:
+    """Longest-processing-time-first bin packing of TUs into at most `jobs` shards."""
+    import heapq
+
+    if not tus:
+        return []
+    n = max(1, min(jobs, len(tus)))
+    heap: list[tuple[float, int]] = [(0.0, i) for i in range(n)]
+    shards: list[list[Path]] = [[] for _ in range(n)]
+    for tu in sorted(tus, key=lambda p: _estimate_cost(p, cost_of), reverse=True):
+        load, i = heapq.heappop(heap)
+        shards[i].append(tu)
+        heapq.heappush(heap, (load + _estimate_cost(tu, cost_of), i))
+    return [sh for sh in shards if sh]
+
+
+def _cppcheck_deadline_s() -> float:
+    """Wall-clock budget for one incremental cppcheck run across all shards (QT_TEST_AI_CPPCHECK_DEADLINE_S, default 300)."""
+    try:
+        v = float((os.getenv("QT_TEST_AI_CPPCHECK_DEADLINE_S") or "").strip() or 300)
+    except Exception:
+        v = 300.0
+    return max(1.0, v)
+
+
+def _iter_sharded_results(base_cmd: list[str], shards: list[list[Path]], env: dict[str, str], deadline: float | None = None):
+    """
+    Run every shard on its own worker thread; yield per-TU results as they finish.
+
+    deadline is a time.monotonic() value: each TU's timeout is clipped to the
+    time left, and TUs not started by then come back with "skipped": True.
+    """
+    import queue
+    from concurrent.futures import ThreadPoolExecutor
+
+    if not shards:
+        return
+    q: queue.Queue = queue.Queue()
+    total = sum(len(sh) for sh in shards)
+
+    def _work(shard: list[Path]) -> None:
+        for tu in shard:
+            left = 300.0 if deadline is None else deadline - time.monotonic()
+            if left <= 0:
+                q.put({"tu": tu, "output": "", "returncode": 0, "timed_out": False, "cost_s": 0.0, "skipped": True})
+                continue
+            try:
+                q.put(_run_cppcheck_one(base_cmd, tu, env, timeout_s=min(300.0, left)))
+            except Exception as e:
+                q.put({"tu": tu, "output": "", "returncode": 1, "timed_out": False, "cost_s": 0.0, "error": str(e)})
+
+    with ThreadPoolExecutor(max_workers=len(shards), thread_name_prefix="cppcheck-shard") as pool:
+        for sh in shards:
+            pool.submit(tracing.propagate(_work), sh)
+        for _ in range(total):
+            yield q.get()
+
+
+def _run_cppcheck_incremental(
+    project_root: Path,
+    *,
+    base_cmd: list[str],
+    ignore_paths: list[Path],
+    include_dirs: list[str],
+    defines: list[str],
+    env: dict[str, str],
+    meta: dict,
+) -> tuple[str, int]:
+    """
+    Run cppcheck per translation unit, re-analyzing only TUs whose content or
+    (transitively) included project headers changed since the cached run.
+    Returns (merged output in stable TU order, max returncode).
+
+    The run is bounded by QT_TEST_AI_CPPCHECK_DEADLINE_S: TUs still pending
+    then are left uncached (meta "unfinished") and picked up by the next run.
+    Whole-program (CTU) checks need every TU in one cppcheck process, so they
+    do not run in this mode; meta "whole_program" records that.
+    """
+    from .cppcheck_cache import CppcheckCache, config_key
+
+    cfg = config_key(
+        {
+            "cmd": base_cmd[1:],
+            "version": _cppcheck_version(base_cmd[0], env),
+            "includes": include_dirs,
+            "defines": defines,
+        }
+    )
+    cache = CppcheckCache(project_root, config=cfg, include_dirs=include_dirs)
+    sources = _cppcheck_sources(project_root, ignore_paths)
+
+    outputs: dict[Path, str] = {}
+    keys: dict[Path, str] = {}
+    todo: list[Path] = []
+    for tu in sources:
+        key = cache.key_for(tu)
+        keys[tu] = key
+        cached = cache.get(tu, key)
+        if cached is None:
+            todo.append(tu)
+        else:
+            outputs[tu] = cached
+
+    returncode = 0
+    timed_out: list[str] = []
+    failed: list[str] = []
+    unfinished: list[str] = []
+    errors: dict[str, str] = {}
+    deadline_s = _cppcheck_deadline_s()
+    jobs = _cppcheck_jobs()
+    shards = _plan_shards(todo, cache.cost, jobs)
+    meta["cppcheck_shards"] = {
+        "jobs": jobs,
+        "shards": len(shards),
+        "planned_cost_s": [round(sum(_estimate_cost(tu, cache.cost) for tu in sh), 3) for sh in shards],
+    }
+    # 各分片结果按完成顺序流式合并（写缓存），最终输出仍按 TU 顺序拼接后统一去重
+    for r in _iter_sharded_results(base_cmd, shards, env, deadline=time.monotonic() + deadline_s):
+        tu = r["tu"]
+        if r.get("skipped"):
+            # 总时限已到、没来得及分析：不写缓存，下次运行再分析
+            unfinished.append(cache.rel(tu))
+            continue
+        outputs[tu] = r["output"]
+        returncode = max(returncode, int(r["returncode"] or 0))
+        if r["timed_out"]:
+            timed_out.append(cache.rel(tu))
+        elif r.get("error") or int(r["returncode"] or 0) != 0:
+            # 非零退出是 cppcheck 自身出错（没用 --error-exitcode）；分片线程里启动失败则带 error。输出不完整，不能缓存
+            failed.append(cache.rel(tu))
+            if r.get("error"):
+                errors[cache.rel(tu)] = str(r["error"])[:500]
+        else:
+            cache.put(tu, keys[tu], r["output"], cost_s=r["cost_s"])
+
+    cache.prune(sources)
+    cache.save()
+
+    meta["cppcheck_cache"] = {
+        "enabled": True,
+        "path": str(cache.path),
+        "files": len(sources),
+        "hits": len(sources) - len(todo),
+        "reanalyzed": len(todo),
+        "reanalyzed_files": [cache.rel(p) for p in todo[:50]],
+        "timed_out": timed_out,
+        "failed": failed,
+        "errors": errors,
+        "deadline_s": deadline_s,
+        "unfinished": unfinished,
+        # 逐 TU 运行时 cppcheck 看不到其它 TU，跨文件（CTU）检查不会执行；需要时设 QT_TEST_AI_CPPCHECK_CACHE=0
+        "whole_program": False,
+    }
+
+    merged = "\n".join(outputs[tu] for tu in sources if outputs.get(tu))
+    return merged, returncode
+
+
 def run_static_checks(project_root: Path) -> tuple[list[Finding], dict]:
     findings: list[Finding] = []
     meta: dict = {}
@@ -206,35 +442,13 @@ def run_static_checks(project_root: Path) -> tuple[list[Finding], dict]:
     # -----------------------------------------------------
     # 2) Simple custom static rules (lightweight) - skip tests/
     # -----------------------------------------------------
-    for p in iter_files(project_root, ("**/*.h", "**/*.hpp", "**/*.cpp", "**/*.cc", "**/*.cxx")):
-        if tests_dir.exists() and _is_under(p, tests_dir):
-            continue  # ✅ 不扫描 tests/
-
-        text = read_text_best_effort(p)
-
-        # rule: TODO/FIXME
-        for m in re.finditer(r"\b(TODO|FIXME)\b(.{0,80})", text):
-            findings.append(
-                Finding(
-                    category="static",
-                    severity="info",
-                    title=f"发现 {m.group(1)}",
-                    details=m.group(0).strip(),
-                    file=str(p),
-                )
-            )
-
-        # rule: using namespace std;
-        if re.search(r"^\s*using\s+namespace\s+std\s*;", text, re.M):
-            findings.append(
-                Finding(
-                    category="static",
-                    severity="warning",
-                    title="不建议在头/源文件中使用 using namespace std;",
-                    details="建议使用 std:: 前缀，或在更小作用域内 using。",
-                    file=str(p),
-                )
-            )
+    # 所有已注册规则合并为一个正则，每个文件只扫描一遍（见 rules.py）
+    rule_files = [
+        p
+        for p in iter_files(project_root, ("**/*.h", "**/*.hpp", "**/*.cpp", "**/*.cc", "**/*.cxx"))
+        if not (tests_dir.exists() and _is_under(p, tests_dir))  # ✅ 不扫描 tests/
+    ]
+    findings.extend(scan_files(rule_files))
 
     # -----------------------------------------------------
     # 3) cppcheck (structured output) - skip tests/ via -i
@@ -333,6 +547,8 @@ def run_static_checks(project_root: Path) -> tuple[list[Finding], dict]:
     for inc in include_dirs:
         cmd.append(f"-I{inc}")
 
+    base_cmd = list(cmd)
+
     # ✅ 用 -i 忽略目录，替代不兼容的 --exclude=
     for ip in ignore_paths:
         cmd += ["-i", str(ip)]
@@ -343,27 +559,65 @@ def run_static_checks(project_root: Path) -> tuple[list[Finding], dict]:
     meta["cppcheck_cmd"] = " ".join(cmd)
 
     try:
-        proc = subprocess.run(
-            cmd,
-            capture_output=True,
-            text=True,
-            timeout=300,
-            env=_build_tool_env(cppcheck_path=cppcheck),
-            errors="replace",
-        )
-
-        out = ((proc.stderr or "") + "\n" + (proc.stdout or "")).strip()
-        meta["cppcheck_returncode"] = proc.returncode
+        tool_env = _build_tool_env(cppcheck_path=cppcheck)
+        if _cppcheck_cache_enabled():
+            # 增量模式：逐个 TU 分析，未变化的 TU 直接复用缓存输出
+            out, returncode = _run_cppcheck_incremental(
+                project_root,
+                base_cmd=base_cmd,
+                ignore_paths=ignore_paths,
+                include_dirs=include_dirs,
+                defines=defines,
+                env=tool_env,
+                meta=meta,
+            )
+            cc = meta.get("cppcheck_cache") or {}
+            if cc.get("unfinished") or cc.get("timed_out"):
+                left = list(cc.get("unfinished") or []) + list(cc.get("timed_out") or [])
+                findings.append(
+                    Finding(
+                        category="static",
+                        severity="warning",
+                        title=f"cppcheck 未在时限内完成：{len(left)} 个文件未分析完（总时限 {cc.get('deadline_s')}s）",
+                        details="这些文件未写入缓存，下次运行会继续分析（QT_TEST_AI_CPPCHECK_DEADLINE_S 可调整时限）：\n" + "\n".join(left[:50]),
+                        rule_id="cppcheck",
+                    )
+                )
+        else:
+            jobs = _cppcheck_jobs()
+            if jobs > 1:
+                cmd = cmd[:-1] + [f"-j{jobs}", cmd[-1]]
+                meta["cppcheck_cmd"] = " ".join(cmd)
+            proc = tracing.run(
+                cmd,
+                trace_cat=tracing.CPPCHECK,
+                capture_output=True,
+                text=True,
+                timeout=300,
+                env=tool_env,
+                errors="replace",
+            )
+            out = ((proc.stderr or "") + "\n" + (proc.stdout or "")).strip()
+            returncode = proc.returncode
+        meta["cppcheck_returncode"] = returncode
 
         # Save full report to tool-root ./reports with timestamp
         from datetime import datetime
         ts = datetime.now().strftime("%Y%m%d_%H%M%S")
-        report_dir = _repo_root() / "reports" / "cppcheck" / project_root.name
-        report_dir.mkdir(parents=True, exist_ok=True)
-        report_path = report_dir / f"cppcheck_{ts}.txt"
         try:
-            report_path.write_text(out, encoding="utf-8")
-            meta["cppcheck_report_path"] = str(report_path)
+            if artifact_store.enabled():
+                # 结果没变（缓存命中时很常见）就只多一份清单，不再重复写整份报告
+                store = artifact_store.ArtifactStore(_repo_root() / "reports" / "artifacts")
+                man = store.commit(f"cppcheck/{project_root.name}", ts, {"cppcheck.txt": out})
+                artifact_store.maybe_gc(store)
+                meta["cppcheck_report_path"] = str(store.object_path(man["files"]["cppcheck.txt"]["sha256"]))
+                meta["cppcheck_report_manifest"] = str(store.manifest_path(f"cppcheck/{project_root.name}", ts))
+            else:
+                report_dir = _repo_root() / "reports" / "cppcheck" / project_root.name
+                report_dir.mkdir(parents=True, exist_ok=True)
+                report_path = report_dir / f"cppcheck_{ts}.txt"
+                report_path.write_text(out, encoding="utf-8")
+                meta["cppcheck_report_path"] = str(report_path)
         except Exception:
             pass
 
@@ -375,7 +629,7 @@ def run_static_checks(project_root: Path) -> tuple[list[Finding], dict]:
             findings.append(
                 Finding(
                     category="static",
-                    severity="warning" if proc.returncode != 0 else "info",
+                    severity="warning" if returncode != 0 else "info",
                     title="cppcheck 已运行，但未解析到结构化问题",
                     details=(
                         "可能原因：缺少 Qt include/defines 或 cppcheck 输出格式变化。\n"
@@ -0,0 +1,437 @@
+from __future__ import annotations
+
+import hashlib
+import json
+import os
+import re
+import threading
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Any
+
+from .utils import cache_dir, read_text_best_effort
+
+
+_INDEX_VERSION = 1
+
+_SOURCE_SUFFIXES = (".h", ".hpp", ".hxx", ".cpp", ".cxx", ".cc")
+_HEADER_SUFFIXES = (".h", ".hpp", ".hxx")
+# 只记录路径与 stat、不解析内容的文件（供 build_project_context 列文件，免去再次遍历目录）
+_LISTED_SUFFIXES = (".ui",)
+
+_COMMENT_RE = re.compile(r"//[^\n]*|/\*.*?\*/", re.S)
+_STRING_RE = re.compile(r'"(?:\\.|[^"\\\n])*"')
+_INCLUDE_RE = re.compile(r'^[ \t]*#[ \t]*include[ \t]*[<"]([^>"\n]+)[>"]', re.M)
+_CLASS_RE = re.compile(
+    r"\b(?:class|struct)\s+(?:\w+_EXPORT\s+|Q_DECL_EXPORT\s+)?([A-Za-z_]\w*)\s*(?:final\s*)?(?::\s*([^{;]+))?([{;])"
+)
+_METHOD_DEF_RE = re.compile(r"\b([A-Za-z_]\w*)::~?[A-Za-z_]\w*\s*\(")
+_TYPE_IDENT_RE = re.compile(r"\b[A-Z]\w+\b")
+
+
+def index_enabled() -> bool:
+    """QT_TEST_AI_CTX_INDEX=0 falls back to the old "read every header" prompt context."""
+    return (os.getenv("QT_TEST_AI_CTX_INDEX") or "1").strip().lower() not in {"0", "false", "no", "off"}
+
+
+def token_budget(default: int = 6000) -> int:
+    """Prompt context budget in tokens (QT_TEST_AI_CTX_TOKEN_BUDGET)."""
+    try:
+        return max(500, int((os.getenv("QT_TEST_AI_CTX_TOKEN_BUDGET") or "").strip() or default))
+    except Exception:
+        return default
+
+
+def estimate_tokens(text: str) -> int:
+    # 粗略估算：ASCII 代码约 4 字节/token，中文约 1.5 字/token，按 UTF-8 字节数折算足够
+    return (len(text.encode("utf-8", errors="replace")) + 3) // 4
+
+
+def _line_of(text: str, pos: int) -> int:
+    return text.count("\n", 0, pos) + 1
+
+
+def parse_source(text: str) -> dict[str, Any]:
+    """Extract includes, class declarations, method definitions and type references from one file."""
+    includes = [m.group(1).strip() for m in _INCLUDE_RE.finditer(text)]
+    # 保持偏移不变地去掉注释和字符串，避免把注释里的类名当成依赖
+    code = _COMMENT_RE.sub(lambda m: re.sub(r"[^\n]", " ", m.group(0)), text)
+    code = _STRING_RE.sub(lambda m: " " * len(m.group(0)), code)
+
+    classes: list[dict[str, Any]] = []
+    forward: list[str] = []
+    for m in _CLASS_RE.finditer(code):
+        name = m.group(1)
+        if m.group(3) == ";":
+            if not m.group(2):
+                forward.append(name)
+            continue
+        bases = []
+        for part in (m.group(2) or "").split(","):
+            toks = [t for t in re.split(r"[\s<>]+", part.strip()) if t and t not in {"public", "protected", "private", "virtual"}]
+            if toks:
+                bases.append(toks[0].split("::")[-1])
+        classes.append({"name": name, "bases": bases, "line": _line_of(code, m.start())})
+
+    defines = sorted({m.group(1) for m in _METHOD_DEF_RE.finditer(code)})
+    idents = sorted(set(_TYPE_IDENT_RE.findall(code)))
+    return {"includes": includes, "classes": classes, "forward": sorted(set(forward)), "defines": defines, "idents": idents}
+
+
+@dataclass
+class ClassInfo:
+    name: str
+    decl: str  # 声明所在文件（相对路径）
+    line: int
+    bases: list[str] = field(default_factory=list)
+    impl: list[str] = field(default_factory=list)  # 定义成员函数的源文件
+    deps: list[str] = field(default_factory=list)  # 头文件接口里引用到的项目类
+    calls: list[str] = field(default_factory=list)  # 实现里额外用到的项目类
+    users: list[str] = field(default_factory=list)  # 引用该类的其它文件
+
+
+@dataclass
+class ContextSelection:
+    files: list[tuple[str, str]]  # (rel path, reason)
+    text: str
+    tokens: int
+    budget: int
+    skipped: list[str] = field(default_factory=list)
+
+
+class ProjectIndex:
+    """
+    Persistent symbol index of a Qt/C++ project.
+
+    Per file we keep (mtime, size) plus what parse_source() extracted; a refresh
+    only re-reads files whose stat changed. Class-level edges (declaration,
+    implementation files, interface deps, call edges, users) are derived from
+    that in memory. Stored under cache_dir("symbols").
+    """
+
+    def __init__(self, project_root: Path) -> None:
+        self.project_root = project_root.resolve()
+        tag = hashlib.sha1(str(self.project_root).lower().encode("utf-8")).hexdigest()[:10]
+        self.path = cache_dir("symbols") / f"{self.project_root.name}_{tag}.json"
+        self.files: dict[str, dict[str, Any]] = {}
+        self.classes: dict[str, ClassInfo] = {}
+        self._by_name: dict[str, list[str]] = {}
+        self._texts: dict[str, tuple[int, str]] = {}
+        self._refreshed_at = 0.0
+        self._lock = threading.RLock()
+        self.last_refresh: dict[str, Any] = {}
+        self._load()
+
+    # ----------------------------
+    # persistence
+    # ----------------------------
+    def _load(self) -> None:
+        try:
+            data = json.loads(self.path.read_text(encoding="utf-8"))
+        except Exception:
+            return
+        if isinstance(data, dict) and data.get("version") == _INDEX_VERSION and isinstance(data.get("files"), dict):
+            self.files = data["files"]
+            self._derive()
+
+    def save(self) -> None:
+        payload = {"version": _INDEX_VERSION, "root": str(self.project_root), "saved_at": time.time(), "files": self.files}
+        tmp = self.path.with_suffix(f".{threading.get_ident()}.tmp")
+        try:
+            tmp.write_text(json.dumps(payload, ensure_ascii=False), encoding="utf-8")
+            os.replace(tmp, self.path)
+        except Exception:
+            pass
+
+    # ----------------------------
+    # refresh
+    # ----------------------------
+    def _scan_paths(self) -> list[Path]:
+        from .qt_project import _iter_files_pruned
+
+        gen_dir = self.project_root / "tests" / "generated"
+        out = []
+        for p in _iter_files_pruned(self.project_root, suffixes=_SOURCE_SUFFIXES + _LISTED_SUFFIXES):
+            # 生成的测试不是被测代码，不参与上下文
+            if gen_dir in p.parents:
+                continue
+            out.append(p)
+        return out
+
+    def rel(self, path: Path) -> str:
+        try:
+            return path.resolve().relative_to(self.project_root).as_posix()
+        except Exception:
+            return path.as_posix()
+
+    def refresh(self, *, max_age_s: float = 2.0) -> dict[str, Any]:
+        """Bring the index up to date; a refresh younger than max_age_s is reused."""
+        with self._lock:
+            if self._refreshed_at and time.monotonic() - self._refreshed_at < max_age_s:
+                return self.last_refresh
+            t0 = time.perf_counter()
+            seen: set[str] = set()
+            parsed = 0
+            for p in self._scan_paths():
+                rel = self.rel(p)
+                seen.add(rel)
+                try:
+                    st = p.stat()
+                except OSError:
+                    continue
+                old = self.files.get(rel)
+                if old and old.get("mtime_ns") == st.st_mtime_ns and old.get("size") == st.st_size:
+                    continue
+                try:
+                    info = parse_source(read_text_best_effort(p)) if p.suffix.lower() in _SOURCE_SUFFIXES else {}
+                except Exception:
+                    continue
+                self.files[rel] = {"mtime_ns": st.st_mtime_ns, "size": st.st_size, **info}
+                self._texts.pop(rel, None)
+                parsed += 1
+            removed = [k for k in self.files if k not in seen]
+            for k in removed:
+                del self.files[k]
+                self._texts.pop(k, None)
+            if parsed or removed or not self.classes:
+                self._derive()
+            if parsed or removed:
+                self.save()
+            self._refreshed_at = time.monotonic()
+            self.last_refresh = {
+                "files": len(self.files),
+                "parsed": parsed,
+                "removed": len(removed),
+                "classes": len(self.classes),
+                "duration_s": round(time.perf_counter() - t0, 4),
+            }
+            return self.last_refresh
+
+    def _derive(self) -> None:
+        by_name: dict[str, list[str]] = {}
+        for rel in self.files:
+            by_name.setdefault(rel.rsplit("/", 1)[-1].lower(), []).append(rel)
+        self._by_name = by_name
+
+        classes: dict[str, ClassInfo] = {}
+        for rel, info in sorted(self.files.items(), key=lambda kv: (not kv[0].lower().endswith(_HEADER_SUFFIXES), kv[0])):
+            for c in info.get("classes") or []:
+                name = c.get("name")
+                if name and name not in classes:
+                    classes[name] = ClassInfo(name=name, decl=rel, line=int(c.get("line") or 1), bases=list(c.get("bases") or []))
+
+        known = set(classes)
+        for rel, info in self.files.items():
+            for name in info.get("defines") or []:
+                ci = classes.get(name)
+                if ci is not None and rel != ci.decl and rel not in ci.impl:
+                    ci.impl.append(rel)
+        for ci in classes.values():
+            decl_refs = set((self.files.get(ci.decl) or {}).get("idents") or []) & known
+            impl_refs: set[str] = set()
+            for rel in ci.impl:
+                impl_refs |= set((self.files.get(rel) or {}).get("idents") or []) & known
+            ci.deps = sorted(decl_refs - {ci.name})
+            ci.calls = sorted(impl_refs - decl_refs - {ci.name})
+        for rel, info in self.files.items():
+            for name in set(info.get("idents") or []) & known:
+                ci = classes[name]
+                if rel != ci.decl and rel not in ci.impl:
+                    ci.users.append(rel)
+        for ci in classes.values():
+            ci.users.sort()
+        self.classes = classes
+
+    # ----------------------------
+    # queries
+    # ----------------------------
+    def paths(self, suffixes: tuple[str, ...] | None = None) -> list[Path]:
+        rels = sorted(self.files)
+        if suffixes:
+            rels = [r for r in rels if r.lower().endswith(suffixes)]
+        return [self.project_root / r for r in rels]
+
+    def resolve_include(self, name: str, from_rel: str) -> str | None:
+        base = from_rel.rsplit("/", 1)[0] if "/" in from_rel else ""
+        cand = f"{base}/{name}" if base else name
+        cand = os.path.normpath(cand).replace("\\", "/")
+        if cand in self.files:
+            return cand
+        if name in self.files:
+            return name
+        hits = self._by_name.get(name.rsplit("/", 1)[-1].lower()) or []
+        return hits[0] if len(hits) == 1 else (sorted(hits, key=len)[0] if hits else None)
+
+    def transitive_includes(self, rel: str) -> list[tuple[str, int]]:
+        """Project files reachable through #include from rel, BFS order with depth."""
+        out: list[tuple[str, int]] = []
+        seen = {rel}
+        frontier = [rel]
+        depth = 0
+        while frontier:
+            depth += 1
+            nxt: list[str] = []
+            for cur in frontier:
+                for inc in (self.files.get(cur) or {}).get("includes") or []:
+                    hit = self.resolve_include(inc, cur)
+                    if hit and hit not in seen:
+                        seen.add(hit)
+                        out.append((hit, depth))
+                        nxt.append(hit)
+            frontier = nxt
+        return out
+
+    def classes_in(self, rel: str) -> list[str]:
+        info = self.files.get(rel) or {}
+        names = [c["name"] for c in info.get("classes") or [] if c.get("name") in self.classes]
+        names += [n for n in info.get("defines") or [] if n in self.classes and n not in names]
+        return names
+
+    def related_files(self, target: Path | str) -> list[tuple[str, str, int]]:
+        """
+        Files a prompt about `target` needs, most important first:
+        the target, its own header / implementation, transitive includes,
+        headers of classes it references, then headers of their bases.
+        """
+        t = self.rel(Path(target)) if isinstance(target, Path) else str(target)
+        if t not in self.files:
+            hits = self._by_name.get(t.rsplit("/", 1)[-1].lower()) or []
+            if not hits:
+                return []
+            t = hits[0]
+        out: list[tuple[str, str, int]] = [(t, "target", 0)]
+        seen = {t}
+
+        def _add(rel: str | None, reason: str, rank: int) -> None:
+            if rel and rel not in seen and rel in self.files:
+                seen.add(rel)
+                out.append((rel, reason, rank))
+
+        own = self.classes_in(t)
+        for name in own:
+            ci = self.classes[name]
+            _add(ci.decl, f"declaration of {name}", 1)
+            for impl in ci.impl:
+                _add(impl, f"implementation of {name}", 2)
+        for rel, depth in self.transitive_includes(t):
+            _add(rel, f"include (depth {depth})", 2 + depth)
+        refs = set((self.files.get(t) or {}).get("idents") or []) & set(self.classes)
+        for name in own:
+            ci = self.classes[name]
+            refs |= set(ci.deps) | set(ci.calls)
+        for name in sorted(refs - set(own)):
+            ci = self.classes[name]
+            _add(ci.decl, f"uses {name}", 5)
+            for base in ci.bases:
+                if base in self.classes:
+                    _add(self.classes[base].decl, f"base of {name}", 6)
+        return sorted(out, key=lambda x: x[2])
+
+    def text(self, rel: str) -> str:
+        info = self.files.get(rel) or {}
+        hit = self._texts.get(rel)
+        if hit is not None and hit[0] == info.get("mtime_ns"):
+            return hit[1]
+        txt = read_text_best_effort(self.project_root / rel)
+        self._texts[rel] = (int(info.get("mtime_ns") or 0), txt)
+        return txt
+
+    def usage_snippets(self, class_names: list[str], *, exclude: set[str] | None = None, context_lines: int = 2, max_chars: int = 4000) -> str:
+        """Lines around references to the given classes in their user files (call-site examples)."""
+        exclude = exclude or set()
+        pat = re.compile(r"\b(?:" + "|".join(re.escape(n) for n in class_names) + r")\b") if class_names else None
+        if pat is None:
+            return ""
+        users: list[str] = []
+        for n in class_names:
+            ci = self.classes.get(n)
+            for u in ci.users if ci else []:
+                if u not in exclude and u not in users and not u.lower().endswith(_HEADER_SUFFIXES):
+                    users.append(u)
+        chunks: list[str] = []
+        used = 0
+        for u in users:
+            lines = self.text(u).splitlines()
+            keep: set[int] = set()
+            for i, line in enumerate(lines):
+                if pat.search(line):
+                    keep.update(range(max(0, i - context_lines), min(len(lines), i + context_lines + 1)))
+            if not keep:
+                continue
+            parts: list[str] = []
+            prev = -2
+            for i in sorted(keep):
+                if i != prev + 1:
+                    parts.append(f"// ... line {i + 1}")
+                parts.append(lines[i])
+                prev = i
+            block = f"\n--- usage in {u} ---\n" + "\n".join(parts) + "\n"
+            if used + len(block) > max_chars:
+                break
+            chunks.append(block)
+            used += len(block)
+        return "".join(chunks)
+
+    def select_context(
+        self,
+        target: Path | str,
+        *,
+        budget_tokens: int | None = None,
+        exclude: set[str] | None = None,
+        per_file_max_chars: int = 12_000,
+    ) -> ContextSelection:
+        """Greedy pick of related_files() in priority order until the token budget is spent."""
+        budget = budget_tokens or token_budget()
+        exclude = exclude or set()
+        picked: list[tuple[str, str]] = []
+        skipped: list[str] = []
+        blocks: list[str] = []
+        used = 0
+        for rel, reason, _ in self.related_files(target):
+            if rel in exclude:
+                continue
+            txt = self.text(rel)
+            if len(txt) > per_file_max_chars:
+                txt = txt[:per_file_max_chars] + "\n/* ... truncated ... */\n"
+            block = f"\n--- FILE: {rel} ({reason}) ---\n{txt}\n"
+            cost = estimate_tokens(block)
+            if used + cost > budget:
+                skipped.append(rel)
+                continue
+            picked.append((rel, reason))
+            blocks.append(block)
+            used += cost
+        return ContextSelection(files=picked, text="".join(blocks), tokens=used, budget=budget, skipped=skipped)
+
+    def summary(self, max_classes: int = 80) -> str:
+        """One line per class: declaration, bases and edges (cheap overview for planning prompts)."""
+        lines = []
+        for name in sorted(self.classes)[:max_classes]:
+            ci = self.classes[name]
+            bits = [f"{name} @ {ci.decl}:{ci.line}"]
+            if ci.bases:
+                bits.append("bases=" + ",".join(ci.bases))
+            if ci.deps:
+                bits.append("deps=" + ",".join(ci.deps))
+            if ci.calls:
+                bits.append("calls=" + ",".join(ci.calls))
+            lines.append("  ".join(bits))
+        return "\n".join(lines)
+
+
+_indexes: dict[Path, ProjectIndex] = {}
+_indexes_lock = threading.Lock()
+
+
+def project_index(project_root: Path, *, refresh: bool = True) -> ProjectIndex:
+    """Shared, lazily refreshed index per project root."""
+    root = Path(project_root).resolve()
+    with _indexes_lock:
+        idx = _indexes.get(root)
+        if idx is None:
+            idx = ProjectIndex(root)
+            _indexes[root] = idx
+    if refresh:
+        idx.refresh()
+    return idx
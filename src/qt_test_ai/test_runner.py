@@ -0,0 +1,315 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+from typing import Any
+
+from . import qtest_results, tracing
+
+DURATIONS_FILE = "test_durations.json"
+_FIXTURES = {"initTestCase", "cleanupTestCase", "init", "cleanup"}
+# 新旧耗时的加权：新测量占 0.5，单次抖动不会让分片大起大落
+_EMA = 0.5
+# 分片各自的 .gcda 先写到这里（GCOV_PREFIX），全部结束后再用 gcov-tool 合并回原位置
+GCOV_SHARDS_DIR = ".gcov_shards"
+# QtTest 的退出码是失败个数（上限 127）；超出这个范围（负数 = 信号，Windows 上 0xC0000005 之类）是崩溃
+_MAX_QTEST_RC = 127
+
+
+def shard_count() -> int:
+    """
+    Worker processes for one QtTest binary (QT_TEST_AI_TEST_SHARDS).
+
+    Unset / 1 keeps the single serial run; "auto" or 0 means one per CPU.
+    """
+    raw = (os.getenv("QT_TEST_AI_TEST_SHARDS") or "1").strip().lower()
+    if raw in {"auto", "0"}:
+        return max(1, os.cpu_count() or 1)
+    try:
+        return max(1, int(raw))
+    except Exception:
+        return 1
+
+
+def _offscreen_env(env: dict[str, str] | None) -> dict[str, str]:
+    # 并行的 GUI 测试不能抢同一个桌面：统一走 offscreen 平台插件
+    return {**os.environ, **(env or {}), "QT_QPA_PLATFORM": (env or {}).get("QT_QPA_PLATFORM") or "offscreen"}
+
+
+def list_functions(
+    exe: Path, *, cwd: Path, env: dict[str, str] | None = None, timeout_s: float = 60, flag: str = "-functions"
+) -> list[str]:
+    """
+    Test functions reported by `<exe> -functions` (fixtures and duplicates dropped, order kept).
+
+    `flag` selects another listing option; names may come back qualified as
+    "Class::func" (the aggregate runner lists every class that way).
+    """
+    try:
+        p = subprocess.run(
+            [str(exe), flag],
+            cwd=str(cwd),
+            capture_output=True,
+            text=True,
+            errors="replace",
+            timeout=timeout_s,
+            env=_offscreen_env(env),
+        )
+    except Exception:
+        return []
+    names: list[str] = []
+    for line in (p.stdout or "").splitlines():
+        m = re.match(r"^\s*((?:\w+::)?\w+)\(\)\s*$", line)
+        if m and m.group(1).rpartition("::")[2] not in _FIXTURES and m.group(1) not in names:
+            names.append(m.group(1))
+    return names
+
+
+# ----------------------------
+# duration history
+# ----------------------------
+def load_durations(tests_dir: Path) -> dict[str, float]:
+    try:
+        data = json.loads((Path(tests_dir) / DURATIONS_FILE).read_text(encoding="utf-8"))
+        return {str(k): float(v) for k, v in (data.get("functions") or {}).items()}
+    except Exception:
+        return {}
+
+
+def record_durations(tests_dir: Path, measured: dict[str, float]) -> dict[str, float]:
+    """Fold new per-function durations (seconds) into the history and save it."""
+    hist = load_durations(tests_dir)
+    for name, secs in measured.items():
+        if secs is None or secs < 0:
+            continue
+        old = hist.get(name)
+        hist[name] = round(secs if old is None else (1 - _EMA) * old + _EMA * secs, 4)
+    try:
+        (Path(tests_dir) / DURATIONS_FILE).write_text(
+            json.dumps({"updated_at": time.time(), "functions": hist}, ensure_ascii=False, indent=1), encoding="utf-8"
+        )
+    except Exception:
+        pass
+    return hist
+
+
+def partition(functions: list[str], durations: dict[str, float], shards: int) -> list[list[str]]:
+    """
+    Longest-processing-time-first split: slowest functions first, each onto the least loaded shard.
+
+    Functions without history are estimated at the median known duration (1s if nothing is known).
+    """
+    shards = max(1, min(shards, len(functions)))
+    known = sorted(v for f, v in durations.items() if f in functions)
+    guess = known[len(known) // 2] if known else 1.0
+    est = {f: durations.get(f, guess) for f in functions}
+    buckets: list[list[str]] = [[] for _ in range(shards)]
+    loads = [0.0] * shards
+    for f in sorted(functions, key=lambda f: (-est[f], functions.index(f))):
+        i = loads.index(min(loads))
+        buckets[i].append(f)
+        loads[i] += est[f]
+    order = {f: i for i, f in enumerate(functions)}
+    return [sorted(b, key=order.__getitem__) for b in buckets if b]
+
+
+# ----------------------------
+# coverage isolation
+# ----------------------------
+def _instrumented(exe: Path) -> bool:
+    # 链接了 libgcov 的程序里一定有它读取的 "GCOV_PREFIX" 字符串
+    try:
+        import mmap
+
+        with open(exe, "rb") as fh, mmap.mmap(fh.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            return mm.find(b"GCOV_PREFIX") >= 0
+    except Exception:
+        return False
+
+
+def gcov_tool() -> str | None:
+    """gcov-tool next to QT_TEST_AI_GCOV_EXE if set, else from PATH."""
+    gcov = os.getenv("QT_TEST_AI_GCOV_EXE")
+    if gcov:
+        p = Path(gcov)
+        cand = p.with_name(p.name.replace("gcov", "gcov-tool", 1))
+        if cand.exists():
+            return str(cand)
+    return shutil.which("gcov-tool")
+
+
+def merge_gcov_shards(shard_roots: list[Path], anchor: Path, tool: str) -> dict[str, Any]:
+    """
+    Fold the .gcda trees written under each GCOV_PREFIX back into their real locations.
+
+    A file whose target does not exist yet is moved there; the others are
+    merged with one `gcov-tool merge` per shard (both sides mirrored into
+    scratch directories so unrelated .gcda files are never touched).
+    """
+    out: dict[str, Any] = {"moved": 0, "merged": 0, "errors": []}
+    for root in shard_roots:
+        pairs: list[tuple[Path, Path]] = []
+        for g in sorted(root.rglob("*.gcda")) if root.exists() else []:
+            rel = g.relative_to(root)
+            target = anchor / rel
+            if target.exists():
+                pairs.append((g, target))
+                continue
+            target.parent.mkdir(parents=True, exist_ok=True)
+            shutil.move(str(g), str(target))
+            out["moved"] += 1
+        if pairs:
+            with tempfile.TemporaryDirectory(prefix="qt_test_ai_gcov_") as tmp:
+                a, b, o = Path(tmp, "a"), Path(tmp, "b"), Path(tmp, "o")
+                for i, (g, target) in enumerate(pairs):
+                    # 同一 gcov-tool 调用里按相对路径配对：用序号目录避免同名文件冲突
+                    for side, src in ((a, g), (b, target)):
+                        (side / str(i)).mkdir(parents=True, exist_ok=True)
+                        shutil.copy2(src, side / str(i) / target.name)
+                p = subprocess.run([tool, "merge", "-o", str(o), str(a), str(b)], capture_output=True, text=True, errors="replace")
+                if p.returncode != 0:
+                    out["errors"].append((p.stderr or p.stdout or "").strip()[-500:])
+                else:
+                    for i, (_g, target) in enumerate(pairs):
+                        merged = o / str(i) / target.name
+                        if merged.exists():
+                            shutil.copy2(merged, target)
+                            out["merged"] += 1
+        shutil.rmtree(root, ignore_errors=True)
+    return out
+
+
+# ----------------------------
+# running
+# ----------------------------
+def _run_shard(exe: Path, functions: list[str], extra: list[str], cwd: Path, env: dict[str, str], timeout_s: float) -> dict[str, Any]:
+    cmd = [str(exe), "-platform", "offscreen", *extra, *functions]
+    meta: dict[str, Any] = {"cmd": cmd, "functions": functions}
+    t0 = time.perf_counter()
+    try:
+        p = tracing.run(cmd, trace_cat=tracing.TEST, cwd=str(cwd), capture_output=True, text=True, errors="replace", timeout=timeout_s, env=env)
+        meta["returncode"] = p.returncode
+        meta["stdout"] = p.stdout or ""
+        meta["stderr"] = p.stderr or ""
+    except subprocess.TimeoutExpired as e:
+        meta["returncode"] = -1
+        meta["stdout"] = (e.stdout.decode(errors="replace") if isinstance(e.stdout, bytes) else e.stdout) or ""
+        meta["stderr"] = "TIMEOUT"
+        meta["timed_out"] = True
+    except Exception as e:
+        meta["returncode"] = -1
+        meta["stdout"] = ""
+        meta["stderr"] = str(e)
+    meta["duration_s"] = round(time.perf_counter() - t0, 3)
+    return meta
+
+
+def run_sharded(
+    exe: Path,
+    *,
+    cwd: Path,
+    tests_dir: Path | None = None,
+    functions: list[str] | None = None,
+    extra_args: list[str] | None = None,
+    env: dict[str, str] | None = None,
+    shards: int | None = None,
+    timeout_s: float = 600,
+    results_dir: Path | None = None,
+    list_flag: str = "-functions",
+) -> dict[str, Any]:
+    """
+    Run a QtTest binary as N concurrent processes, each on a slice of its test functions.
+
+    `functions` limits the run (e.g. a test selection); otherwise the binary is
+    asked via `list_flag` (-functions by default). Returns the merged result in
+    the shape of a single run (returncode, stdout, stderr, duration_s) plus "shards". With one shard, or
+    when functions cannot be listed, the binary runs once as before.
+
+    A coverage-instrumented binary gets its own GCOV_PREFIX per shard, so no
+    two processes ever write the same .gcda; the shard trees are merged back
+    with gcov-tool afterwards ("gcov_merge"). Without gcov-tool such a binary
+    runs unsharded.
+
+    With `results_dir`, each shard also writes its own QtTest XML log there;
+    the merged per-function results come back as "test_results" and their
+    exact durations replace the apportioned estimate.
+    """
+    cwd = Path(cwd)
+    tests_dir = Path(tests_dir) if tests_dir is not None else cwd
+    n = shards or shard_count()
+    run_env = _offscreen_env(env)
+    funcs = list(functions) if functions else list_functions(exe, cwd=cwd, env=env, flag=list_flag)
+    hist = load_durations(tests_dir)
+    groups = partition(funcs, hist, n) if funcs and n > 1 else [list(functions or [])]
+    gcov_roots: list[Path] = []
+    tool = None
+    if len(groups) > 1 and _instrumented(Path(exe)):
+        tool = gcov_tool()
+        if tool is None:
+            groups = [list(functions or [])]
+        else:
+            scratch = tests_dir / GCOV_SHARDS_DIR
+            shutil.rmtree(scratch, ignore_errors=True)
+            gcov_roots = [(scratch / f"shard{i}").resolve() for i in range(len(groups))]
+
+    def shard_args(i: int) -> list[str]:
+        extra = list(extra_args or [])
+        if results_dir is not None:
+            extra += qtest_results.output_args(Path(results_dir), f"shard{i}" if len(groups) > 1 else "")
+        return extra
+
+    def shard_env(i: int) -> dict[str, str]:
+        if not gcov_roots:
+            return run_env
+        # GCOV_PREFIX_STRIP=0：绝对路径整体挂到前缀下面，合并时原样映射回去
+        return {**run_env, "GCOV_PREFIX": str(gcov_roots[i]), "GCOV_PREFIX_STRIP": "0"}
+
+    if results_dir is not None:
+        qtest_results.clear(Path(results_dir))
+    t0 = time.perf_counter()
+    with ThreadPoolExecutor(max_workers=len(groups)) as pool:
+        metas = list(pool.map(tracing.propagate(lambda ig: _run_shard(exe, ig[1], shard_args(ig[0]), cwd, shard_env(ig[0]), timeout_s)), enumerate(groups)))
+    gcov_merge = None
+    if gcov_roots and tool:
+        gcov_merge = merge_gcov_shards(gcov_roots, Path(Path(cwd).resolve().anchor), tool)
+        shutil.rmtree(tests_dir / GCOV_SHARDS_DIR, ignore_errors=True)
+    wall = round(time.perf_counter() - t0, 3)
+
+    results = qtest_results.collect(Path(results_dir)) if results_dir is not None else None
+    # 单测函数耗时：有 XML 日志就用 QtTest 自己量的；否则在分片内按历史比例分摊分片耗时（没有历史就平均分）
+    measured: dict[str, float] = results.durations_s(qualified=any("::" in f for f in funcs)) if results else {}
+    for m in metas if not measured else []:
+        fs = m["functions"]
+        if not fs or m.get("timed_out"):
+            continue
+        weights = [hist.get(f, 1.0) for f in fs]
+        total = sum(weights) or 1.0
+        for f, w in zip(fs, weights):
+            measured[f] = m["duration_s"] * w / total
+    if measured:
+        record_durations(tests_dir, measured)
+
+    # QtTest 的退出码是失败个数：各分片相加（同样封顶 127）；任一分片崩溃 / 超时则整体记为 -1
+    codes = [int(m.get("returncode") or 0) for m in metas]
+    crashed = any(c < 0 or c > _MAX_QTEST_RC for c in codes)
+    return {
+        "returncode": -1 if crashed else min(sum(codes), _MAX_QTEST_RC),
+        "stdout": "".join(m["stdout"] for m in metas),
+        "stderr": "".join(m["stderr"] for m in metas),
+        "duration_s": wall,
+        "timed_out": any(m.get("timed_out") for m in metas),
+        "shards": [
+            {k: m.get(k) for k in ("functions", "returncode", "duration_s", "timed_out")}
+            for m in metas
+        ],
+        "cpu_s": round(sum(m["duration_s"] for m in metas), 3),
+        "gcov_merge": gcov_merge,
+        "test_results": results.to_meta() if results else None,
+    }
@@ -0,0 +1,368 @@
+from __future__ import annotations
+
+import json
+import os
+import re
+import subprocess
+from dataclasses import asdict, dataclass, field
+from datetime import datetime
+from pathlib import Path
+from typing import Any
+
+from .per_test_coverage import SETUP_BUCKET, PerTestCoverage, load_map, test_function_hashes
+
+
+RESULTS_FILE = "test_results_cache.json"
+FIXTURES = ("initTestCase", "cleanupTestCase", "init", "cleanup")
+SOURCE_SUFFIXES = {".cpp", ".cc", ".cxx", ".c", ".h", ".hpp", ".hh", ".hxx"}
+# 这些文件一变就无法按行推断影响范围：整体重跑
+GLOBAL_SUFFIXES = {".pro", ".pri", ".qrc", ".ui"}
+
+
+def selection_enabled() -> bool:
+    """QT_TEST_AI_TEST_SELECTION=1 runs only the tests affected by source / test changes."""
+    return (os.getenv("QT_TEST_AI_TEST_SELECTION") or "").strip().lower() in {"1", "true", "yes", "y", "on"}
+
+
+# ----------------------------
+# what changed
+# ----------------------------
+_HUNK_RE = re.compile(r"^@@ -(\d+)(?:,(\d+))? \+\d+(?:,\d+)? @@")
+
+
+def _git(project_root: Path, *args: str) -> str | None:
+    try:
+        p = subprocess.run(
+            ["git", *args],
+            cwd=str(project_root),
+            capture_output=True,
+            text=True,
+            errors="replace",
+            timeout=60,
+        )
+        return p.stdout if p.returncode == 0 else None
+    except Exception:
+        return None
+
+
+def git_changed_lines(project_root: Path, base: str | None = None) -> dict[str, set[int] | None] | None:
+    """
+    Changed lines per file between `base` (default HEAD) and the working tree,
+    in base-side numbering (the numbering the coverage map was recorded in).
+    None for a file means "treat the whole file as changed" (new / deleted / untracked).
+    Returns None when git is unavailable or base is unknown.
+    """
+    # --relative：project_root 是仓库子目录时，路径相对它（与覆盖率映射、ls-files 一致），目录外的改动不列出
+    out = _git(project_root, "diff", "-U0", "--no-color", "--no-ext-diff", "--relative", base or "HEAD", "--")
+    if out is None:
+        return None
+    changed: dict[str, set[int] | None] = {}
+    cur: str | None = None
+    for line in out.splitlines():
+        if line.startswith("diff --git "):
+            cur = None
+        elif line.startswith("--- "):
+            path = line[4:].strip()
+            cur = path[2:] if path.startswith("a/") else None
+            if cur is not None:
+                changed.setdefault(cur, set())
+        elif line.startswith("+++ "):
+            path = line[4:].strip()
+            if cur is None and path.startswith("b/"):
+                # 新文件
+                changed[path[2:]] = None
+        elif line.startswith("@@") and cur is not None:
+            m = _HUNK_RE.match(line)
+            lines = changed.get(cur)
+            if not m or lines is None:
+                continue
+            start, count = int(m.group(1)), int(m.group(2) if m.group(2) is not None else 1)
+            if count == 0:
+                # 纯插入：落在 start 行之后，相邻两行都算受影响
+                lines.update({start, start + 1})
+            else:
+                lines.update(range(start, start + count))
+    untracked = _git(project_root, "ls-files", "--others", "--exclude-standard")
+    for rel in (untracked or "").splitlines():
+        if rel.strip():
+            changed[rel.strip()] = None
+    return changed
+
+
+def mtime_changed(project_root: Path, recorded: dict[str, int]) -> dict[str, set[int] | None]:
+    """Files (of those the map was recorded against) whose mtime moved; whole-file granularity."""
+    out: dict[str, set[int] | None] = {}
+    for rel, mt in recorded.items():
+        try:
+            if (Path(project_root) / rel).stat().st_mtime_ns != int(mt):
+                out[rel] = None
+        except Exception:
+            out[rel] = None
+    # 记录之后新改动的 .pro / .ui 等同样要整体重跑
+    newest = max((int(v) for v in recorded.values()), default=0)
+    for p in Path(project_root).iterdir() if Path(project_root).exists() else []:
+        try:
+            if p.is_file() and p.suffix.lower() in GLOBAL_SUFFIXES and p.stat().st_mtime_ns > newest:
+                out[p.name] = None
+        except Exception:
+            pass
+    return out
+
+
+_SLOTS_RE = re.compile(r"\b(?:private|protected|public)\s+(?:slots|Q_SLOTS)\s*:")
+_ACCESS_RE = re.compile(r"\b(?:private|protected|public)\s*(?:slots|Q_SLOTS|signals|Q_SIGNALS)?\s*:|\bsignals\s*:")
+_SLOT_DECL_RE = re.compile(r"\bvoid\s+(\w+)\s*\(\s*\)")
+
+
+def test_slots(tests_dir: Path) -> list[str]:
+    """Test functions declared in slot sections of the generated test classes (fixtures excluded)."""
+    names: list[str] = []
+    for p in sorted(Path(tests_dir).glob("test_*.cpp")):
+        try:
+            text = p.read_text(encoding="utf-8", errors="replace")
+        except Exception:
+            continue
+        for m in _SLOTS_RE.finditer(text):
+            # 只看大括号深度 0 的部分（类内定义的函数体里也可能出现 void x()），到类结束为止
+            flat, depth = [], 0
+            for c in text[m.end():]:
+                if c == "{":
+                    depth += 1
+                elif c == "}":
+                    depth -= 1
+                    if depth < 0:
+                        break
+                elif depth == 0:
+                    flat.append(c)
+            section = "".join(flat)
+            nxt = _ACCESS_RE.search(section)
+            if nxt:
+                section = section[: nxt.start()]
+            for d in _SLOT_DECL_RE.finditer(section):
+                n = d.group(1)
+                if n not in FIXTURES and not n.endswith("_data") and n not in names:
+                    names.append(n)
+    return names
+
+
+# ----------------------------
+# selection
+# ----------------------------
+@dataclass
+class TestSelection:
+    tests: list[str]
+    full: bool
+    source: str  # git | mtime | none
+    reasons: dict[str, list[str]] = field(default_factory=dict)
+    changed: dict[str, list[int] | None] = field(default_factory=dict)
+    skipped: list[str] = field(default_factory=list)
+    note: str = ""
+
+    @property
+    def empty(self) -> bool:
+        return not self.full and not self.tests
+
+    def run_args(self) -> list[str]:
+        """Function names for the QtTest command line (nothing for a full run)."""
+        return [] if self.full else list(self.tests)
+
+    def describe(self) -> str:
+        if self.full:
+            return f"全部测试（{self.note or '无法增量选择'}）"
+        if not self.tests:
+            return f"无需运行（{len(self.skipped)} 个测试沿用缓存结果）"
+        return f"{len(self.tests)} 个测试: {', '.join(self.tests)}（{len(self.skipped)} 个沿用缓存结果）"
+
+    def to_dict(self) -> dict[str, Any]:
+        d = asdict(self)
+        d["changed"] = {k: (sorted(v)[:200] if v is not None else None) for k, v in self.changed.items()}
+        return d
+
+
+def _full(note: str, source: str = "none", slots: list[str] | None = None, changed: dict | None = None) -> TestSelection:
+    return TestSelection(tests=list(slots or []), full=True, source=source, note=note, changed=changed or {})
+
+
+def select_tests(project_root: Path, tests_dir: Path, *, base: str | None = None) -> TestSelection:
+    """
+    Pick the QtTest functions affected by what changed since the coverage map was recorded.
+
+    - new / edited test functions are selected;
+    - edited fixtures or helpers, .pro/.ui/.qrc changes, or a missing map -> full run;
+    - for source changes (git diff -U0 against the map's commit, else mtimes),
+      tests whose recorded lines intersect the changed lines are selected;
+      header edits outside any covered line (declarations) select the tests
+      covering the same-named .cpp, or force a full run if there is none.
+    """
+    project_root = Path(project_root)
+    tests_dir = Path(tests_dir)
+    slots = test_slots(tests_dir)
+    ptc = load_map(tests_dir)
+    if ptc is None:
+        return _full("没有逐测试覆盖率映射", slots=slots)
+
+    recorded_hashes: dict[str, str] = ptc.meta.get("test_hashes") or {}
+    current_hashes = test_function_hashes(tests_dir)
+    reasons: dict[str, list[str]] = {}
+
+    def pick(t: str, why: str) -> None:
+        reasons.setdefault(t, [])
+        if why not in reasons[t] and len(reasons[t]) < 5:
+            reasons[t].append(why)
+
+    # 1. 测试源码本身的变化
+    for fx in FIXTURES:
+        if current_hashes.get(fx) != recorded_hashes.get(fx):
+            return _full(f"测试夹具 {fx}() 已修改", slots=slots)
+    for name, h in current_hashes.items():
+        if name in FIXTURES or recorded_hashes.get(name) == h:
+            continue
+        if name in slots:
+            pick(name, "测试已修改" if name in recorded_hashes else "新测试")
+        else:
+            return _full(f"辅助函数 {name}() 已修改", slots=slots)
+    for name in slots:
+        if name not in ptc.tests and name not in reasons:
+            pick(name, "没有覆盖记录")
+
+    # 2. 被测源码的变化
+    tests_prefix = tests_dir.resolve().relative_to(project_root.resolve()).as_posix() + "/" if _is_under(tests_dir, project_root) else ""
+    source = "git"
+    changed = None
+    head = ptc.meta.get("git_head")
+    # 映射记录时被测源码已有未提交改动：它的行号不是 head 的编号，git diff 对不上，退回 mtime
+    dirty = [p for p in ptc.meta.get("git_dirty") or [] if not (tests_prefix and p.startswith(tests_prefix))]
+    if base or (head and not dirty):
+        changed = git_changed_lines(project_root, base or head)
+    if changed is None:
+        source = "mtime"
+        changed = mtime_changed(project_root, ptc.meta.get("sources") or {})
+    relevant: dict[str, set[int] | None] = {}
+    for rel, lines in changed.items():
+        rel = rel.replace("\\", "/")
+        if tests_prefix and rel.startswith(tests_prefix):
+            continue
+        suffix = Path(rel).suffix.lower()
+        if suffix in GLOBAL_SUFFIXES:
+            return _full(f"{rel} 已修改", source, slots, relevant)
+        if suffix in SOURCE_SUFFIXES:
+            relevant[rel] = lines
+
+    setup = ptc.tests.get(SETUP_BUCKET) or {}
+    for rel, lines in relevant.items():
+        # 静态初始化阶段覆盖到的行变了：所有测试都可能受影响
+        for f, covered in setup.items():
+            if PerTestCoverage._match(f, rel) and (lines is None or lines.intersection(covered)):
+                return _full(f"{rel} 的静态初始化代码已修改", source, slots, relevant)
+
+        hit_lines: set[int] = set()
+        for t in ptc.test_names():
+            for f, covered in ptc.tests[t].items():
+                if not PerTestCoverage._match(f, rel):
+                    continue
+                if lines is None:
+                    pick(t, f"{rel} 已修改")
+                    break
+                hit = lines.intersection(covered)
+                if hit:
+                    hit_lines |= hit
+                    pick(t, f"{rel}:{min(hit)}")
+                    break
+        is_header = Path(rel).suffix.lower() in {".h", ".hpp", ".hh", ".hxx"}
+        if is_header and (lines is None or lines - hit_lines):
+            # 声明变化（类布局、内联函数签名……）会影响所有使用者
+            stem = Path(rel).stem.lower()
+            peers = [f for f in ptc.files() if Path(f).stem.lower() == stem and Path(f).suffix.lower() not in {".h", ".hpp", ".hh", ".hxx"}]
+            if not peers:
+                return _full(f"头文件 {rel} 的声明已修改", source, slots, relevant)
+            for t in ptc.test_names():
+                if any(PerTestCoverage._match(f, p) for f in ptc.tests[t] for p in peers):
+                    pick(t, f"头文件 {rel} 已修改")
+
+    tests = [t for t in slots if t in reasons] if slots else sorted(reasons)
+    return TestSelection(
+        tests=tests,
+        full=False,
+        source=source,
+        reasons={t: reasons[t] for t in tests},
+        changed=relevant,
+        skipped=[t for t in slots if t not in reasons],
+    )
+
+
+def _is_under(p: Path, root: Path) -> bool:
+    try:
+        Path(p).resolve().relative_to(Path(root).resolve())
+        return True
+    except Exception:
+        return False
+
+
+def plan_run(project_root: Path, tests_dir: Path) -> TestSelection | None:
+    """Selection for the next run, or None when QT_TEST_AI_TEST_SELECTION is off."""
+    if not selection_enabled():
+        return None
+    try:
+        return select_tests(project_root, tests_dir)
+    except Exception as e:
+        return _full(f"选择失败：{e}")
+
+
+# ----------------------------
+# cached results
+# ----------------------------
+_RESULT_RE = re.compile(r"^(PASS|FAIL!|SKIP|XFAIL|XPASS|BPASS|BFAIL|BXPASS|BXFAIL)\s*:\s*\w+::(\w+)\(", re.M)
+_STATUS = {"PASS": "pass", "XFAIL": "pass", "BPASS": "pass", "BXFAIL": "pass", "SKIP": "skip", "FAIL!": "fail", "XPASS": "fail", "BFAIL": "fail", "BXPASS": "fail"}
+_RANK = {"pass": 0, "skip": 1, "fail": 2}
+
+
+def parse_function_results(output: str) -> dict[str, str]:
+    """Per-function status from QtTest plain-text output; any failing data row makes the function fail."""
+    out: dict[str, str] = {}
+    for m in _RESULT_RE.finditer(output or ""):
+        name = m.group(2)
+        if name in FIXTURES:
+            continue
+        st = _STATUS[m.group(1)]
+        if name not in out or _RANK[st] > _RANK[out[name]]:
+            out[name] = st
+    return out
+
+
+def merge_results(
+    tests_dir: Path, output: str, selection: TestSelection | None = None, *, statuses: dict[str, str] | None = None
+) -> dict[str, Any]:
+    """
+    Record the statuses of the functions that just ran and fill in the rest from the cache.
+    Returns ran / cached counts plus the combined passed / failed totals.
+
+    `statuses` (from the QtTest XML log) takes precedence over parsing `output`.
+    """
+    path = Path(tests_dir) / RESULTS_FILE
+    try:
+        cache: dict[str, Any] = json.loads(path.read_text(encoding="utf-8"))
+    except Exception:
+        cache = {}
+    now = datetime.now().isoformat(timespec="seconds")
+    ran = dict(statuses) if statuses else parse_function_results(output)
+    for name, st in ran.items():
+        cache[name] = {"status": st, "at": now}
+    slots = test_slots(tests_dir)
+    if slots:
+        cache = {k: v for k, v in cache.items() if k in slots}
+    try:
+        path.write_text(json.dumps(cache, ensure_ascii=False, indent=1), encoding="utf-8")
+    except Exception:
+        pass
+
+    cached = [k for k in cache if k not in ran]
+    statuses = {k: v.get("status") for k, v in cache.items()}
+    return {
+        "ran": len(ran),
+        "cached": len(cached),
+        "passed": sum(1 for s in statuses.values() if s == "pass"),
+        "failed": sum(1 for s in statuses.values() if s == "fail"),
+        "failed_tests": sorted(k for k, s in statuses.items() if s == "fail"),
+        "failed_cached": sorted(k for k in cached if statuses.get(k) == "fail"),
+        "selection": selection.to_dict() if selection is not None else None,
+    }
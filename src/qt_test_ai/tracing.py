@@ -0,0 +1,362 @@
+from __future__ import annotations
+
+import contextvars
+import json
+import os
+import re
+import secrets
+import subprocess
+import threading
+import time
+import urllib.request
+from collections import deque
+from contextlib import contextmanager
+from functools import wraps
+from pathlib import Path
+from typing import Any, Callable, Iterator, TypeVar
+
+F = TypeVar("F", bound=Callable[..., Any])
+
+# 分类：Chrome trace 的 cat / OTLP 的 qt_test_ai.category，也是报告里按阶段汇总的维度
+SHELL = "shell"
+BUILD = "build"
+LLM = "llm"
+GCOVR = "gcovr"
+CPPCHECK = "cppcheck"
+SMOKE = "smoke"
+TEST = "test"
+STAGE = "stage"
+
+_OFF = {"0", "false", "no", "off"}
+# perf_counter_ns 与墙钟的换算基准：span 内部用单调时钟，导出时才换成 Unix 时间
+_EPOCH_NS = time.time_ns() - time.perf_counter_ns()
+_PID = os.getpid()
+
+_trace_id: contextvars.ContextVar[str] = contextvars.ContextVar("qt_test_ai_trace_id", default="")
+_current: contextvars.ContextVar["Span | None"] = contextvars.ContextVar("qt_test_ai_span", default=None)
+
+
+def enabled() -> bool:
+    """Record spans (QT_TEST_AI_TRACE, default on; in-memory, a few hundred bytes per span)."""
+    return (os.getenv("QT_TEST_AI_TRACE") or "1").strip().lower() not in _OFF
+
+
+def export_formats() -> set[str]:
+    """QT_TEST_AI_TRACE_EXPORT: comma list of chrome / otlp (default chrome; off = summary only)."""
+    raw = (os.getenv("QT_TEST_AI_TRACE_EXPORT") or "chrome").strip().lower()
+    return {f.strip() for f in raw.split(",") if f.strip() in {"chrome", "otlp"}}
+
+
+def otlp_endpoint() -> str:
+    """OTLP/HTTP JSON traces endpoint (QT_TEST_AI_OTLP_ENDPOINT, default the local collector)."""
+    return (os.getenv("QT_TEST_AI_OTLP_ENDPOINT") or "http://localhost:4318/v1/traces").strip()
+
+
+class Span:
+    __slots__ = ("trace_id", "span_id", "parent_id", "name", "cat", "stage", "start_ns", "end_ns", "tid", "thread", "attrs", "error")
+
+    def __init__(self, name: str, cat: str, parent: "Span | None", attrs: dict[str, Any], start_ns: int | None = None) -> None:
+        self.trace_id = _trace_id.get() or (parent.trace_id if parent else "")
+        self.span_id = secrets.token_hex(8)
+        self.parent_id = parent.span_id if parent else None
+        self.name = name
+        self.cat = cat
+        # 所属阶段沿父 span 继承，汇总时不用回溯整棵树
+        self.stage = attrs.pop("stage", None) or (parent.stage if parent else "") or ""
+        self.start_ns = start_ns if start_ns is not None else time.perf_counter_ns()
+        self.end_ns: int | None = None
+        self.tid = threading.get_ident()
+        self.thread = threading.current_thread().name
+        self.attrs = attrs
+        self.error: str | None = None
+
+    def set(self, **attrs: Any) -> None:
+        self.attrs.update({k: v for k, v in attrs.items() if v is not None})
+
+    @property
+    def duration_s(self) -> float:
+        return ((self.end_ns or time.perf_counter_ns()) - self.start_ns) / 1e9
+
+
+class Tracer:
+    """
+    Process-wide span buffer.
+
+    A run calls begin() for a fresh trace id; spans opened in that context
+    (and in stage threads started through the scheduler, which copies the
+    context) carry it, so concurrent runs export only their own spans.
+    """
+
+    def __init__(self, max_spans: int = 50000) -> None:
+        self._spans: deque[Span] = deque(maxlen=max_spans)
+        self._lock = threading.Lock()
+
+    def begin(self) -> str:
+        tid = secrets.token_hex(16)
+        _trace_id.set(tid)
+        _current.set(None)
+        return tid
+
+    def add(self, span: Span) -> None:
+        with self._lock:
+            self._spans.append(span)
+
+    def spans(self, trace_id: str | None = None) -> list[Span]:
+        with self._lock:
+            return [s for s in self._spans if s.end_ns is not None and (trace_id is None or s.trace_id == trace_id)]
+
+
+tracer = Tracer()
+
+
+def begin() -> str:
+    return tracer.begin()
+
+
+def current_trace_id() -> str:
+    return _trace_id.get()
+
+
+@contextmanager
+def span(name: str, cat: str = SHELL, **attrs: Any) -> Iterator[Span]:
+    """Time the block as a child of the current span; exceptions are recorded and re-raised."""
+    s = Span(name, cat, _current.get(), {k: v for k, v in attrs.items() if v is not None})
+    if cat == STAGE and not s.stage:
+        s.stage = name
+    token = _current.set(s)
+    try:
+        yield s
+    except BaseException as e:
+        s.error = f"{type(e).__name__}: {e}"[:300]
+        raise
+    finally:
+        _current.reset(token)
+        s.end_ns = time.perf_counter_ns()
+        if enabled():
+            tracer.add(s)
+
+
+def record(name: str, cat: str, started: float, ended: float | None = None, *, live: dict[str, Any] | None = None, **attrs: Any) -> None:
+    """
+    Add a finished span after the fact from perf_counter() seconds (calls whose timing is measured elsewhere).
+
+    With `live`, that dict itself becomes the span's attributes, so fields filled
+    in later (LLM token usage parsed after the body) still reach the export.
+    """
+    if not enabled():
+        return
+    s = Span(name, cat, _current.get(), live if live is not None else {k: v for k, v in attrs.items() if v is not None}, start_ns=int(started * 1e9))
+    s.end_ns = int((ended if ended is not None else time.perf_counter()) * 1e9)
+    if s.attrs.get("error"):
+        s.error = str(s.attrs["error"])[:300]
+    tracer.add(s)
+
+
+_TOOL_CATS = {
+    "qmake": BUILD, "make": BUILD, "mingw32-make": BUILD, "nmake": BUILD, "jom": BUILD, "ninja": BUILD, "cmake": BUILD,
+    "gcovr": GCOVR, "cppcheck": CPPCHECK, "ctest": TEST,
+}
+
+
+def command_category(cmd: str | list[str]) -> str:
+    """Category of a shell command from its program name (qmake / make -> build, gcovr, cppcheck, ctest -> test)."""
+    first = cmd[0] if isinstance(cmd, list) and cmd else str(cmd).strip().split(" ", 1)[0] if cmd else ""
+    prog = re.sub(r"\.(exe|bat|cmd)$", "", Path(first.strip('"')).name.lower())
+    return _TOOL_CATS.get(prog, SHELL)
+
+
+def command_name(cmd: str | list[str]) -> str:
+    text = " ".join(cmd) if isinstance(cmd, list) else str(cmd)
+    return text if len(text) <= 80 else text[:77] + "..."
+
+
+def run(cmd: Any, *args: Any, trace_cat: str | None = None, **kwargs: Any) -> subprocess.CompletedProcess:
+    """subprocess.run() inside a span named after the command; the category comes from the program unless given."""
+    with span(command_name(cmd), trace_cat or command_category(cmd), cwd=str(kwargs["cwd"]) if kwargs.get("cwd") else None) as s:
+        try:
+            p = subprocess.run(cmd, *args, **kwargs)
+        except subprocess.TimeoutExpired:
+            s.set(timed_out=True)
+            raise
+        s.set(returncode=p.returncode)
+        return p
+
+
+def traced(name: str, cat: str) -> Callable[[F], F]:
+    """Decorator: every call of the function is one span."""
+
+    def deco(fn: F) -> F:
+        @wraps(fn)
+        def inner(*args: Any, **kwargs: Any) -> Any:
+            with span(name, cat):
+                return fn(*args, **kwargs)
+
+        return inner  # type: ignore[return-value]
+
+    return deco
+
+
+def propagate(fn: F) -> F:
+    """
+    Bind `fn` to the caller's trace context for use on pool threads.
+
+    Executors do not carry context variables over; each call runs in its own
+    copy of the captured context so concurrent calls never share one.
+    """
+    ctx = contextvars.copy_context()
+
+    @wraps(fn)
+    def inner(*args: Any, **kwargs: Any) -> Any:
+        return ctx.copy().run(fn, *args, **kwargs)
+
+    return inner  # type: ignore[return-value]
+
+
+# ----------------------------
+# export
+# ----------------------------
+def _wall_us(ns: int) -> float:
+    return (ns + _EPOCH_NS) / 1000.0
+
+
+def _args(s: Span) -> dict[str, Any]:
+    out = {k: (v if isinstance(v, (int, float, bool, str)) or v is None else str(v)) for k, v in s.attrs.items()}
+    if s.stage:
+        out["stage"] = s.stage
+    if s.error:
+        out["error"] = s.error
+    return out
+
+
+def chrome_trace(spans: list[Span]) -> dict[str, Any]:
+    """Trace Event Format (chrome://tracing, ui.perfetto.dev): one complete ("X") event per span."""
+    events: list[dict[str, Any]] = []
+    threads: dict[int, str] = {}
+    for s in spans:
+        threads.setdefault(s.tid, s.thread)
+        events.append(
+            {
+                "name": s.name,
+                "cat": s.cat,
+                "ph": "X",
+                "ts": round(_wall_us(s.start_ns), 3),
+                "dur": round(((s.end_ns or s.start_ns) - s.start_ns) / 1000.0, 3),
+                "pid": _PID,
+                "tid": s.tid,
+                "args": _args(s),
+            }
+        )
+    events += [{"name": "thread_name", "ph": "M", "pid": _PID, "tid": t, "args": {"name": n}} for t, n in threads.items()]
+    return {"traceEvents": events, "displayTimeUnit": "ms"}
+
+
+def _otlp_value(v: Any) -> dict[str, Any]:
+    if isinstance(v, bool):
+        return {"boolValue": v}
+    if isinstance(v, int):
+        return {"intValue": str(v)}
+    if isinstance(v, float):
+        return {"doubleValue": v}
+    return {"stringValue": str(v)}
+
+
+def otlp_payload(spans: list[Span], service: str = "qt-test-ai") -> dict[str, Any]:
+    """OTLP/HTTP JSON ExportTraceServiceRequest; span ids and trace ids are the hex forms OTLP JSON expects."""
+    rows = []
+    for s in spans:
+        attrs = {"qt_test_ai.category": s.cat, "thread.name": s.thread, **_args(s)}
+        row = {
+            "traceId": s.trace_id or "0" * 32,
+            "spanId": s.span_id,
+            "name": s.name,
+            "kind": 1,
+            "startTimeUnixNano": str(s.start_ns + _EPOCH_NS),
+            "endTimeUnixNano": str((s.end_ns or s.start_ns) + _EPOCH_NS),
+            "attributes": [{"key": k, "value": _otlp_value(v)} for k, v in attrs.items()],
+            "status": {"code": 2, "message": s.error} if s.error else {"code": 1},
+        }
+        if s.parent_id:
+            row["parentSpanId"] = s.parent_id
+        rows.append(row)
+    return {
+        "resourceSpans": [
+            {
+                "resource": {"attributes": [{"key": "service.name", "value": {"stringValue": service}}]},
+                "scopeSpans": [{"scope": {"name": "qt_test_ai.tracing"}, "spans": rows}],
+            }
+        ]
+    }
+
+
+def export(trace_id: str, out_dir: Path, *, formats: set[str] | None = None, label: str = "trace") -> dict[str, Any]:
+    """Write / send the spans of `trace_id`; returns {chrome: path, otlp: status} for whatever was exported."""
+    formats = export_formats() if formats is None else formats
+    spans = tracer.spans(trace_id)
+    out: dict[str, Any] = {"spans": len(spans)}
+    if not spans:
+        return out
+    if "chrome" in formats:
+        try:
+            p = Path(out_dir) / f"{label}.trace.json"
+            p.parent.mkdir(parents=True, exist_ok=True)
+            p.write_text(json.dumps(chrome_trace(spans), ensure_ascii=False), encoding="utf-8")
+            out["chrome"] = str(p)
+        except Exception as e:
+            out["chrome_error"] = str(e)
+    if "otlp" in formats:
+        try:
+            req = urllib.request.Request(
+                otlp_endpoint(), data=json.dumps(otlp_payload(spans)).encode("utf-8"), method="POST", headers={"Content-Type": "application/json"}
+            )
+            with urllib.request.urlopen(req, timeout=10) as r:
+                out["otlp"] = r.status
+        except Exception as e:
+            out["otlp_error"] = f"{type(e).__name__}: {e}"[:300]
+    return out
+
+
+# ----------------------------
+# summary
+# ----------------------------
+def summary(trace_id: str, top: int = 10) -> dict[str, Any]:
+    """
+    Per stage: wall time and, per category, count / total / max seconds;
+    plus LLM token totals and the slowest individual spans.
+
+    Category totals can exceed the stage wall time when work inside a stage
+    runs in parallel (sharded tests, concurrent LLM calls).
+    """
+    spans = tracer.spans(trace_id)
+    stages: dict[str, dict[str, Any]] = {}
+    llm = {"calls": 0, "prompt_tokens": 0, "completion_tokens": 0, "latency_s": 0.0}
+    for s in spans:
+        st = stages.setdefault(s.stage or "(other)", {"wall_s": 0.0, "by_category": {}})
+        if s.cat == STAGE and s.name == s.stage:
+            st["wall_s"] = round(st["wall_s"] + s.duration_s, 3)
+            continue
+        c = st["by_category"].setdefault(s.cat, {"count": 0, "total_s": 0.0, "max_s": 0.0, "errors": 0})
+        c["count"] += 1
+        c["total_s"] = round(c["total_s"] + s.duration_s, 3)
+        c["max_s"] = round(max(c["max_s"], s.duration_s), 3)
+        c["errors"] += 1 if s.error else 0
+        if s.cat == LLM:
+            llm["calls"] += 1
+            llm["prompt_tokens"] += int(s.attrs.get("prompt_tokens") or 0)
+            llm["completion_tokens"] += int(s.attrs.get("completion_tokens") or 0)
+            llm["latency_s"] = round(llm["latency_s"] + s.duration_s, 3)
+    slow = sorted((s for s in spans if s.cat != STAGE), key=lambda s: s.duration_s, reverse=True)[:top]
+    return {
+        "spans": len(spans),
+        "stages": stages,
+        "llm": llm,
+        "slowest": [{"name": s.name, "cat": s.cat, "stage": s.stage, "duration_s": round(s.duration_s, 3), **({"error": s.error} if s.error else {})} for s in slow],
+    }
+
+
+def finish(trace_id: str, out_dir: Path, *, label: str = "trace") -> dict[str, Any]:
+    """summary() plus export(): what a run stores as meta["trace"]."""
+    if not trace_id or not enabled():
+        return {}
+    out = summary(trace_id)
+    out["export"] = export(trace_id, out_dir, label=label)
+    return out
@@ -5,19 +5,25 @@ import re
 import shutil
 from pathlib import Path
 
+from .file_index import get_index
+
 
 def which(cmd: str) -> str | None:
     return shutil.which(cmd)
 
 
+def cache_dir(*parts: str) -> Path:
+    """Persistent cache root (QT_TEST_AI_CACHE_DIR, default ~/.qt_test_ai/cache)."""
+    base = (os.getenv("QT_TEST_AI_CACHE_DIR") or "").strip()
+    root = Path(base) if base else Path.home() / ".qt_test_ai" / "cache"
+    p = root.joinpath(*parts)
+    p.mkdir(parents=True, exist_ok=True)
+    return p
+
+
 def iter_files(root: Path, patterns: tuple[str, ...]) -> list[Path]:
-    out: list[Path] = []
-    for dirpath, _, filenames in os.walk(root):
-        for name in filenames:
-            p = Path(dirpath) / name
-            if any(p.match(pattern) for pattern in patterns):
-                out.append(p)
-    return out
+    # 走共享文件索引（file_index），同一项目的多次扫描只遍历一次目录树
+    return get_index(root).match(patterns)
 
 
 def read_text_best_effort(path: Path, max_bytes: int = 2_000_000) -> str:
@@ -43,14 +49,12 @@ _QT_BUILD_HINTS = (
 
 
 def guess_exe_candidates(project_root: Path) -> list[Path]:
+    exes = get_index(project_root).files((".exe",))
     candidates: list[Path] = []
     for hint in _QT_BUILD_HINTS:
-        p = project_root / hint
-        if p.exists() and p.is_dir():
-            for exe in p.rglob("*.exe"):
-                candidates.append(exe)
+        candidates.extend(e for e in exes if e.relative_to(project_root).parts[0] == hint)
     # 常见 Qt Creator 构建目录：build-<name>-Debug/Release
-    for exe in project_root.rglob("*.exe"):
+    for exe in exes:
         if any(part.lower().startswith("build") for part in exe.parts):
             candidates.append(exe)
 
@@ -0,0 +1,59 @@
+from __future__ import annotations
+
+import json
+import os
+from pathlib import Path
+from typing import Any
+
+# 基准套件 / UI 负载驱动 / 模糊测试程序以及重建它们的剖析器共用的小工具：
+# 数值型环境变量、定位构建产物、每个负载的运行历史、编译错误摘要
+
+# 历史里保留的运行次数
+KEEP_RUNS = 50
+
+
+def float_env(name: str, default: float, *, minimum: float | None = None) -> float:
+    try:
+        v = float((os.getenv(name) or "").strip() or default)
+    except ValueError:
+        return default
+    return v if minimum is None else max(minimum, v)
+
+
+def int_env(name: str, default: int, *, minimum: int = 1) -> int:
+    try:
+        return max(minimum, int((os.getenv(name) or "").strip() or default))
+    except ValueError:
+        return default
+
+
+def executable(bin_dir: Path, target: str) -> Path | None:
+    """`target` (or `target.exe`) in a workload's DESTDIR."""
+    for name in (f"{target}.exe", target):
+        p = Path(bin_dir) / name
+        if p.is_file():
+            return p
+    return None
+
+
+def build_error(m_build: dict[str, Any], limit: int = 4000) -> str:
+    """Tail of the failing make (or qmake) step's output from coverage_build.build() meta."""
+    step = m_build.get("make") or m_build.get("qmake") or {}
+    return ((step.get("stderr") or "") + "\n" + (step.get("stdout") or ""))[-limit:]
+
+
+def load_history(path: Path) -> dict[str, Any]:
+    try:
+        return json.loads(Path(path).read_text(encoding="utf-8"))
+    except Exception:
+        return {"runs": []}
+
+
+def record_run(path: Path, run: dict[str, Any], keep: int = KEEP_RUNS) -> None:
+    """Append `run` to the history file, keeping the newest `keep` runs."""
+    hist = load_history(path)
+    hist["runs"] = [*(hist.get("runs") or []), run][-keep:]
+    try:
+        Path(path).write_text(json.dumps(hist, ensure_ascii=False, indent=1), encoding="utf-8")
+    except Exception:
+        pass
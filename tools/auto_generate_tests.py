@@ -7,9 +7,33 @@
 
 import json
 import os
+import time
 from pathlib import Path
 
 
+# SDK 客户端在整个进程内复用：连续生成多个任务时保持 keep-alive 连接，避免每次重新 TLS 握手
+_CLIENTS = {}
+
+
+def _cached_client(factory, **kwargs):
+    key = (factory.__module__, factory.__name__, tuple(sorted(kwargs.items())))
+    client = _CLIENTS.get(key)
+    if client is None:
+        client = factory(**kwargs)
+        _CLIENTS[key] = client
+    return client
+
+
+def _print_usage(started: float, usage) -> None:
+    """打印单次调用的耗时与 token 用量"""
+    pt = getattr(usage, "prompt_tokens", None) or getattr(usage, "input_tokens", None)
+    ct = getattr(usage, "completion_tokens", None) or getattr(usage, "output_tokens", None)
+    line = f"⏱️  耗时 {time.perf_counter() - started:.1f}s"
+    if pt is not None or ct is not None:
+        line += f"，tokens {pt or 0} + {ct or 0}"
+    print(line)
+
+
 def load_prompts():
     """加载 LLM 提示词库"""
     prompts_file = Path(__file__).parent / "llm_prompts.json"
@@ -40,10 +64,11 @@ def generate_tests_with_openai(prompt_text: str, output_file: str):
         return False
     
     try:
-        client = OpenAI(api_key=api_key)
+        client = _cached_client(OpenAI, api_key=api_key)
         
         print(f"\n🤖 正在调用 OpenAI API...")
         print(f"📝 生成文件: {output_file}")
+        started = time.perf_counter()
         
         response = client.chat.completions.create(
             model="gpt-4",  # 或 "gpt-3.5-turbo"
@@ -63,6 +88,7 @@ def generate_tests_with_openai(prompt_text: str, output_file: str):
         
         # 提取生成的代码
         generated_code = response.choices[0].message.content
+        _print_usage(started, getattr(response, "usage", None))
         
         # 保存到文件
         Path(output_file).parent.mkdir(parents=True, exist_ok=True)
@@ -98,10 +124,11 @@ def generate_tests_with_claude(prompt_text: str, output_file: str):
         return False
     
     try:
-        client = anthropic.Anthropic(api_key=api_key)
+        client = _cached_client(anthropic.Anthropic, api_key=api_key)
         
         print(f"\n🤖 正在调用 Claude API...")
         print(f"📝 生成文件: {output_file}")
+        started = time.perf_counter()
         
         message = client.messages.create(
             model="claude-3-opus-20240229",  # 或其他模型
@@ -115,6 +142,7 @@ def generate_tests_with_claude(prompt_text: str, output_file: str):
         )
         
         generated_code = message.content[0].text
+        _print_usage(started, getattr(message, "usage", None))
         
         Path(output_file).parent.mkdir(parents=True, exist_ok=True)
         with open(output_file, 'w', encoding='utf-8') as f:
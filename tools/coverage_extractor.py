@@ -4,44 +4,18 @@ from pathlib import Path
 
 # Usage: python coverage_extractor.py <coverage.json> [out_dir]
 
-def compute_totals(data):
-    # gcovr 0.14 format: top-level may include totals/metrics, but older versions only have files
-    totals = {
-        'lines': {'total': 0, 'covered': 0},
-        'functions': {'total': 0, 'covered': 0},
-        'branches': {'total': 0, 'covered': 0},
-    }
+_SRC = Path(__file__).resolve().parents[1] / 'src'
+if str(_SRC) not in sys.path:
+    sys.path.insert(0, str(_SRC))
 
-    # If gcovr already provided totals/metrics, prefer those
-    if isinstance(data, dict):
-        if 'totals' in data and isinstance(data['totals'], dict):
-            t = data['totals']
-            # expected keys may vary
-            for key in ['lines', 'functions', 'branches']:
-                if key in t:
-                    totals[key]['total'] = t[key].get('total', 0)
-                    totals[key]['covered'] = t[key].get('covered', 0)
-            return totals
+from qt_test_ai.coverage_model import CoverageModel  # noqa: E402
 
-    # Otherwise, compute from files
-    files = data.get('files', []) if isinstance(data, dict) else []
-    for f in files:
-        lines = f.get('lines', [])
-        for ln in lines:
-            totals['lines']['total'] += 1
-            if ln.get('count', 0) > 0:
-                totals['lines']['covered'] += 1
-        funcs = f.get('functions', [])
-        for fn in funcs:
-            totals['functions']['total'] += 1
-            if fn.get('count', 0) > 0:
-                totals['functions']['covered'] += 1
-        branches = f.get('branches', [])
-        for br in branches:
-            totals['branches']['total'] += 1
-            if br.get('taken', 0) > 0:
-                totals['branches']['covered'] += 1
-    return totals
+
+def compute_totals(data):
+    # Same parser as the coverage stage: handles gcovr --json / --json-summary,
+    # dict / list layouts, noncode lines and per-line branches.
+    model = CoverageModel.from_json(data)
+    return {k: {'total': m.total, 'covered': m.covered} for k, m in model.totals.items()}
 
 
 def percent(covered, total):